@@ -2,6 +2,7 @@
 #include "IBehaviour.h"
 #include <GLM/glm.hpp>
 #include <GLM/gtc/quaternion.hpp>
+#include <cereal/cereal.hpp>
 
 class CameraControlBehaviour : public IBehaviour
 {
@@ -9,6 +10,12 @@ public:
 	void OnLoad(entt::handle entity) override;
 	void Update(entt::handle entity) override;
 
+	// Only the settings are saved, the mouse state starts fresh
+	template <typename Archive>
+	void serialize(Archive& archive) {
+		archive(cereal::make_nvp("MoveSpeed", _moveSpeed));
+	}
+
 protected:
 	float _moveSpeed = 1.5f;
 	double _prevMouseX, _prevMouseY;
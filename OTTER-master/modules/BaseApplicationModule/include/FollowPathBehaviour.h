@@ -2,6 +2,7 @@
 #include "IBehaviour.h"
 #include <vector>
 #include <GLM/glm.hpp>
+#include <cereal/cereal.hpp>
 
 class FollowPathBehaviour final : public IBehaviour
 {
@@ -16,6 +17,12 @@ public:
 	float                  Speed;
 
 	void Update(entt::handle entity) override;
+
+	// Saves the path, where along it we are isn't kept
+	template <typename Archive>
+	void serialize(Archive& archive) {
+		archive(cereal::make_nvp("Points", Points), cereal::make_nvp("Speed", Speed));
+	}
 	
 private:
 	int _nextPointIx;
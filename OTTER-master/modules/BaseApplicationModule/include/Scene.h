@@ -1,11 +1,18 @@
 #pragma once
 #include "entt.hpp"
+#include <algorithm>
+#include <vector>
+#include <GLM/glm.hpp>
 #include <Macros.h>
 
 /// <summary>
 /// Represents a callback that may be used to customize how entity stamping works between registries
 /// </summary>
 typedef void(*StampFunction)(const entt::registry& from, const entt::entity src, entt::registry& to, const entt::entity dst);
+/// <summary>
+/// Represents a callback that stamps one component from <i>src</i> onto many entities at once
+/// </summary>
+typedef void(*BulkStampFunction)(const entt::registry& from, const entt::entity src, entt::registry& to, const entt::entity* dst, size_t count);
 
 typedef entt::handle GameObject;
 
@@ -17,25 +24,57 @@ public:
 	std::string Name;
 
 	GameScene(const std::string& name = "<default>");
-	~GameScene() = default;
+	~GameScene();
 	
 	entt::handle CreateEntity(const std::string& name = "");
 	entt::handle CreateEntity(entt::entity prefab, const std::string& name = "");
+	/// <summary>
+	/// Creates many copies of a prefab at once. The prefab's components are looked up a single time,
+	/// then each component type is reserved and inserted for every instance in one go.
+	/// Instances keep the prefab's name
+	/// </summary>
+	/// <param name="prefab">The entity within the prefab registry to copy</param>
+	/// <param name="count">The number of instances to create</param>
+	/// <param name="positions">Optional array of count local positions</param>
+	/// <param name="rotations">Optional array of count local rotations, in euler degrees</param>
+	/// <param name="scales">Optional array of count local scales</param>
+	/// <returns>The new entities, in the same order as the arrays</returns>
+	std::vector<entt::entity> CreateEntities(entt::entity prefab, size_t count, const glm::vec3* positions = nullptr,
+		const glm::vec3* rotations = nullptr, const glm::vec3* scales = nullptr);
+	/// <summary>
+	/// Queues an entity to be destroyed on the next Poll. Handles that are stale (the entity was already
+	/// destroyed, even if its id has been reused since) or that belong to another scene are ignored
+	/// </summary>
 	void RemoveEntity(entt::handle handle);
+	/// <summary>
+	/// Checks that a handle points at a live entity in this scene. Uses the entity's version, so a handle
+	/// to a destroyed entity stays invalid even once its id is reused
+	/// </summary>
+	bool IsValid(entt::handle handle) const;
 
+	/// <summary>
+	/// Finds the oldest entity with the given name, or a null handle if there isn't one. O(1) expected time
+	/// </summary>
 	entt::handle FindFirst(const std::string& name);
+	/// <summary>
+	/// Finds every entity with the given name, oldest first
+	/// </summary>
+	std::vector<entt::handle> FindAll(const std::string& name);
+	/// <summary>
+	/// Renames an entity, keeping the name index up to date. Names changed through
+	/// registry.patch or registry.replace are picked up too, but writing to GameObjectTag::Name
+	/// directly will leave the index pointing at the old name
+	/// </summary>
+	void SetName(entt::handle entity, const std::string& name);
 
 	entt::registry& Registry() { return _registry; }
 
 	/// <summary>
-	/// Perform any tasks that should happen at the end of a loop, such as deleting queued objects
+	/// Perform any tasks that should happen at the end of a loop, such as deleting queued objects.
+	/// Queued objects are removed a component pool at a time, and pools that end up mostly empty
+	/// give their memory back
 	/// </summary>
-	void Poll() {
-		for(entt::entity instance : _deletionQueue) {
-			_registry.destroy(instance);
-		}
-		_deletionQueue.clear();
-	}
+	void Poll();
 
 	/// <summary>
 	/// Creates a new entity in the <i>to</i> registry, copying the components from the <i>src</i> entity in the from registry
@@ -46,9 +85,19 @@ public:
 	/// <returns>A handle for the newly created entity</returns>
 	static entt::handle StampEntity(const entt::registry& from, entt::entity src, entt::registry& to);
 
+	/// <summary>
+	/// Lets a component type be stamped from prefabs. If only a single stamp override is given, bulk stamping
+	/// will call it once per instance
+	/// </summary>
 	template <typename Type>
-	static void RegisterComponentType(StampFunction stampOverride = nullptr) {
-		_stampFunctions[entt::type_info<Type>::id()] = stampOverride != nullptr ? stampOverride : &_DefaultComponentStamp<Type>;
+	static void RegisterComponentType(StampFunction stampOverride = nullptr, BulkStampFunction bulkOverride = nullptr) {
+		ComponentType& type = _componentTypes[entt::type_info<Type>::id()];
+		type.Stamp = stampOverride != nullptr ? stampOverride : &_DefaultComponentStamp<Type>;
+		type.BulkStamp = bulkOverride;
+		if (bulkOverride == nullptr && stampOverride == nullptr) {
+			type.BulkStamp = &_DefaultBulkComponentStamp<Type>;
+		}
+		type.Remove = &_RemoveComponents<Type>;
 	}
 	static entt::registry& Prefabs() { return _prefabRegistry; }
 	
@@ -56,11 +105,82 @@ private:
 	entt::registry _registry;
 	std::vector<entt::entity> _deletionQueue;
 
+	// Every entity with the same name hash is kept in a linked list, threaded through _nameLinks
+	// so that adding and removing names never allocates per name
+	struct NameBucket {
+		entt::entity First = entt::null;
+		entt::entity Last = entt::null;
+	};
+	struct NameLink {
+		uint32_t     Hash = 0;
+		entt::entity Prev = entt::null;
+		entt::entity Next = entt::null;
+	};
+	std::unordered_map<uint32_t, NameBucket> _nameIndex;
+	// Indexed by the entity's index (without the version)
+	std::vector<NameLink> _nameLinks;
+
+	void _OnTagAdded(entt::registry& registry, entt::entity entity);
+	void _OnTagChanged(entt::registry& registry, entt::entity entity);
+	void _OnTagRemoved(entt::registry& registry, entt::entity entity);
+	NameLink& _LinkOf(entt::entity entity);
+	void _IndexName(entt::entity entity, uint32_t hash);
+	void _UnindexName(entt::entity entity);
+
+	// How to stamp and remove one component type, a null BulkStamp means calling Stamp for every instance
+	struct ComponentType {
+		StampFunction     Stamp = nullptr;
+		BulkStampFunction BulkStamp = nullptr;
+		// Removes the component from every entity in the list that has it
+		size_t(*Remove)(entt::registry& registry, const std::vector<entt::entity>& entities, std::vector<entt::entity>& scratch) = nullptr;
+	};
+
 	static entt::registry _prefabRegistry;
-	static std::unordered_map<entt::id_type, StampFunction> _stampFunctions;
+	static std::unordered_map<entt::id_type, ComponentType> _componentTypes;
 
 	template <typename T>
 	static void _DefaultComponentStamp(const entt::registry& from, const entt::entity src, entt::registry& to, const entt::entity dst) {
 		to.emplace_or_replace<T>(dst, from.get<T>(src));
 	}
+	template <typename T>
+	static void _DefaultBulkComponentStamp(const entt::registry& from, const entt::entity src, entt::registry& to, const entt::entity* dst, size_t count) {
+		// The instances are brand new, so they can't have the component yet
+		to.reserve<T>(to.size<T>() + count);
+		to.insert<T>(dst, dst + count, from.get<T>(src));
+	}
+	template <typename T>
+	static size_t _RemoveComponents(entt::registry& registry, const std::vector<entt::entity>& entities, std::vector<entt::entity>& scratch) {
+		const auto pool = registry.view<T>();
+		scratch.clear();
+		for (entt::entity entity : entities) {
+			if (pool.contains(entity)) {
+				scratch.push_back(entity);
+			}
+		}
+		if (scratch.empty()) {
+			return 0;
+		}
+		// Removing swaps the last component into the hole, so going from the back of the pool
+		// to the front keeps the swaps near the end of the pool where they're cheap.
+		// Components are stored contiguously, so their addresses give their order in the pool
+		if constexpr (!entt::is_eto_eligible_v<T>) {
+			std::sort(scratch.begin(), scratch.end(), [&pool](entt::entity l, entt::entity r) {
+				return &pool.get(l) > &pool.get(r);
+			});
+		}
+		const size_t before = registry.size<T>();
+		registry.remove<T>(scratch.begin(), scratch.end());
+		// Give the memory back once the pool has shrunk to a fraction of what it held
+		const size_t after = registry.size<T>();
+		if (before >= _CompactThreshold && after < before / 4) {
+			registry.shrink_to_fit<T>();
+		}
+		return scratch.size();
+	}
+	// Pools smaller than this aren't worth compacting
+	static const size_t _CompactThreshold = 4096;
+
+	// Transforms hold a handle to their own entity, so they can't be copied as is
+	static void _StampTransform(const entt::registry& from, const entt::entity src, entt::registry& to, const entt::entity dst);
+	static void _StampTransforms(const entt::registry& from, const entt::entity src, entt::registry& to, const entt::entity* dst, size_t count);
 };
@@ -1,5 +1,6 @@
 #pragma once
 #include "IBehaviour.h"
+#include <cereal/cereal.hpp>
 
 
 class SimpleMoveBehaviour : public IBehaviour
@@ -10,4 +11,9 @@ public:
 	~SimpleMoveBehaviour() = default;
 
 	void Update(entt::handle entity) override;
+
+	template <typename Archive>
+	void serialize(Archive& archive) {
+		archive(cereal::make_nvp("Relative", Relative));
+	}
 };
@@ -1,6 +1,7 @@
 #pragma once
 #include <entt.hpp>
 #include <memory>
+#include <vector>
 #include <GLM/glm.hpp>
 #include <GLM/gtc/quaternion.hpp>
 
@@ -27,6 +28,18 @@ public:
 		_gameObject(gameObject),
 		_hierarchyDepth(0)
 	{}
+	/// <summary>
+	/// Copies another transform's local position, rotation and scale onto a different game object.
+	/// The parent is left off, since it may belong to another registry
+	/// </summary>
+	Transform(const Transform& other, entt::handle gameObject) :
+		Transform(other)
+	{
+		_gameObject = gameObject;
+		_parent = entt::null;
+		_hierarchyDepth = 0;
+		_isWorldDirty = true;
+	}
 	Transform(const Transform& other) = default;
 	Transform(Transform&& other) = default;
 	Transform& operator =(const Transform & other) = default;
@@ -189,6 +202,17 @@ public:
 	const glm::mat3& NormalMatrix() const;
 
 	void SetParent(entt::handle parent);
+	/// <summary>
+	/// Gets the entity this transform is parented to, or entt::null if it has no parent
+	/// </summary>
+	entt::entity GetParent() const { return _parent; }
+	/// <summary>
+	/// Parents many transforms at once, only re-sorting the transforms a single time at the end.
+	/// Use this over SetParent when building a whole hierarchy, like when loading a scene
+	/// </summary>
+	/// <param name="registry">The registry that all the entities belong to</param>
+	/// <param name="links">Pairs of child and parent entities, both need a transform</param>
+	static void SetParents(entt::registry& registry, const std::vector<std::pair<entt::entity, entt::entity>>& links);
 
 	void UpdateWorldMatrix() const;
 
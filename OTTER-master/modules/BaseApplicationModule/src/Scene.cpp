@@ -5,13 +5,25 @@
 #include "LoggingBase.h"
 
 entt::registry GameScene::_prefabRegistry;
-std::unordered_map<entt::id_type, StampFunction> GameScene::_stampFunctions;
+std::unordered_map<entt::id_type, GameScene::ComponentType> GameScene::_componentTypes;
 
 GameScene::GameScene(const std::string& name) {
 	Name = name;
 
-	RegisterComponentType<Transform>();
+	RegisterComponentType<Transform>(&GameScene::_StampTransform, &GameScene::_StampTransforms);
 	RegisterComponentType<GameObjectTag>();
+
+	// Keep the name index in sync with the tags, however they get added, changed or removed
+	_registry.on_construct<GameObjectTag>().connect<&GameScene::_OnTagAdded>(this);
+	_registry.on_update<GameObjectTag>().connect<&GameScene::_OnTagChanged>(this);
+	_registry.on_destroy<GameObjectTag>().connect<&GameScene::_OnTagRemoved>(this);
+}
+
+GameScene::~GameScene() {
+	// Registry teardown doesn't fire on_destroy, but disconnect anyways so nothing calls back into a dead scene
+	_registry.on_construct<GameObjectTag>().disconnect(this);
+	_registry.on_update<GameObjectTag>().disconnect(this);
+	_registry.on_destroy<GameObjectTag>().disconnect(this);
 }
 
 entt::handle GameScene::CreateEntity(const std::string& name) {
@@ -27,34 +39,213 @@ entt::handle GameScene::CreateEntity(entt::entity prefab, const std::string& nam
 	LOG_ASSERT(_prefabRegistry.valid(prefab), "Entity is not a valid prefab! You may need to call CreatePrefab(entity_id) first!");
 
 	const entt::entity instance = StampEntity(_prefabRegistry, prefab, _registry);
+	if (!name.empty() && _registry.has<GameObjectTag>(instance)) {
+		SetName(entt::handle(_registry, instance), name);
+	}
 	return entt::handle(_registry, instance);
 }
 
+std::vector<entt::entity> GameScene::CreateEntities(entt::entity prefab, size_t count, const glm::vec3* positions,
+	const glm::vec3* rotations, const glm::vec3* scales)
+{
+	LOG_ASSERT(_prefabRegistry.valid(prefab), "Entity is not a valid prefab! You may need to call CreatePrefab(entity_id) first!");
+
+	// Work out which stamp functions the prefab needs up front, instead of per instance
+	std::vector<const ComponentType*> plan;
+	_prefabRegistry.visit(prefab, [&plan](const auto type_id) {
+		auto it = _componentTypes.find(type_id);
+		LOG_ASSERT(it != _componentTypes.end(), "Prefab has a component that was never registered with RegisterComponentType!");
+		plan.push_back(&it->second);
+	});
+
+	std::vector<entt::entity> result(count);
+	_registry.reserve(_registry.size() + count);
+	_registry.create(result.begin(), result.end());
+
+	for (const ComponentType* type : plan) {
+		if (type->BulkStamp != nullptr) {
+			type->BulkStamp(_prefabRegistry, prefab, _registry, result.data(), count);
+		} else {
+			for (entt::entity instance : result) {
+				type->Stamp(_prefabRegistry, prefab, _registry, instance);
+			}
+		}
+	}
+
+	if (positions != nullptr || rotations != nullptr || scales != nullptr) {
+		LOG_ASSERT(_prefabRegistry.has<Transform>(prefab), "Prefab needs a transform to be placed!");
+		for (size_t i = 0; i < count; i++) {
+			Transform& transform = _registry.get<Transform>(result[i]);
+			if (positions != nullptr) transform.SetLocalPosition(positions[i]);
+			if (rotations != nullptr) transform.SetLocalRotation(rotations[i]);
+			if (scales != nullptr)    transform.SetLocalScale(scales[i]);
+		}
+	}
+	return result;
+}
+
 void GameScene::RemoveEntity(entt::handle handle)
 {
-	//Destroy entity handle
-	_registry.destroy(handle);
+	// Destroyed on the next Poll, so anything still looking at it this frame won't break
+	if (IsValid(handle)) {
+		_deletionQueue.push_back(handle.entity());
+	}
+}
+
+bool GameScene::IsValid(entt::handle handle) const
+{
+	return handle.entity() != entt::null && &handle.registry() == &_registry && _registry.valid(handle.entity());
+}
+
+void GameScene::Poll()
+{
+	if (_deletionQueue.empty()) {
+		return;
+	}
+
+	// Drop anything removed twice, or destroyed some other way since it was queued
+	std::sort(_deletionQueue.begin(), _deletionQueue.end());
+	_deletionQueue.erase(std::unique(_deletionQueue.begin(), _deletionQueue.end()), _deletionQueue.end());
+	_deletionQueue.erase(std::remove_if(_deletionQueue.begin(), _deletionQueue.end(), [this](entt::entity entity) {
+		return !_registry.valid(entity);
+	}), _deletionQueue.end());
+
+	// Strip each registered component type off every queued entity at once
+	std::vector<entt::entity> scratch;
+	scratch.reserve(_deletionQueue.size());
+	_registry.visit([&](const auto type_id) {
+		auto it = _componentTypes.find(type_id);
+		if (it != _componentTypes.end() && it->second.Remove != nullptr) {
+			it->second.Remove(_registry, _deletionQueue, scratch);
+		}
+	});
+
+	// Anything left over is from types that were never registered, destroy takes care of those
+	// and bumps each entity's version, so old handles to it stop being valid
+	_registry.destroy(_deletionQueue.begin(), _deletionQueue.end());
+	_deletionQueue.clear();
 }
 
 entt::handle GameScene::FindFirst(const std::string& name)
 {
-	entt::entity result = entt::null;
 	uint32_t hash = entt::hashed_string::value(name.c_str());
-	const auto view = _registry.view<GameObjectTag>();
-	
-	for(const entt::entity& entity : view) {
-		const GameObjectTag& tag = _registry.get<GameObjectTag>(entity);
-		if (tag.HashedName == hash && tag.Name == name) {
-			return entt::handle(_registry, entity);
+	auto it = _nameIndex.find(hash);
+	if (it != _nameIndex.end()) {
+		// Different names can share a hash, so the names still need comparing
+		for (entt::entity entity = it->second.First; entity != entt::null; entity = _LinkOf(entity).Next) {
+			if (_registry.get<GameObjectTag>(entity).Name == name) {
+				return entt::handle(_registry, entity);
+			}
 		}
 	}
 	return entt::handle(_registry, entt::null);
 }
 
+std::vector<entt::handle> GameScene::FindAll(const std::string& name)
+{
+	std::vector<entt::handle> result;
+	uint32_t hash = entt::hashed_string::value(name.c_str());
+	auto it = _nameIndex.find(hash);
+	if (it != _nameIndex.end()) {
+		for (entt::entity entity = it->second.First; entity != entt::null; entity = _LinkOf(entity).Next) {
+			if (_registry.get<GameObjectTag>(entity).Name == name) {
+				result.push_back(entt::handle(_registry, entity));
+			}
+		}
+	}
+	return result;
+}
+
+void GameScene::SetName(entt::handle entity, const std::string& name)
+{
+	_registry.replace<GameObjectTag>(entity, name);
+}
+
+void GameScene::_OnTagAdded(entt::registry& registry, entt::entity entity)
+{
+	_IndexName(entity, registry.get<GameObjectTag>(entity).HashedName);
+}
+
+void GameScene::_OnTagChanged(entt::registry& registry, entt::entity entity)
+{
+	const uint32_t hash = registry.get<GameObjectTag>(entity).HashedName;
+	// Only re-link if the hash moved, so patching other fields doesn't reorder anything
+	if (_LinkOf(entity).Hash != hash) {
+		_UnindexName(entity);
+		_IndexName(entity, hash);
+	}
+}
+
+void GameScene::_OnTagRemoved(entt::registry&, entt::entity entity)
+{
+	_UnindexName(entity);
+}
+
+GameScene::NameLink& GameScene::_LinkOf(entt::entity entity)
+{
+	return _nameLinks[entt::to_integral(entity) & entt::entt_traits<entt::entity>::entity_mask];
+}
+
+void GameScene::_IndexName(entt::entity entity, uint32_t hash)
+{
+	const size_t index = entt::to_integral(entity) & entt::entt_traits<entt::entity>::entity_mask;
+	if (index >= _nameLinks.size()) {
+		_nameLinks.resize(std::max(index + 1, _nameLinks.size() * 2));
+	}
+
+	// Appending keeps each list oldest first, which is what FindFirst returns
+	NameBucket& bucket = _nameIndex[hash];
+	NameLink& link = _LinkOf(entity);
+	link.Hash = hash;
+	link.Prev = bucket.Last;
+	link.Next = entt::null;
+	if (bucket.Last != entt::null) {
+		_LinkOf(bucket.Last).Next = entity;
+	} else {
+		bucket.First = entity;
+	}
+	bucket.Last = entity;
+}
+
+void GameScene::_UnindexName(entt::entity entity)
+{
+	NameLink& link = _LinkOf(entity);
+	auto it = _nameIndex.find(link.Hash);
+	LOG_ASSERT(it != _nameIndex.end(), "Entity is missing from the name index!");
+
+	if (link.Prev != entt::null) {
+		_LinkOf(link.Prev).Next = link.Next;
+	} else {
+		it->second.First = link.Next;
+	}
+	if (link.Next != entt::null) {
+		_LinkOf(link.Next).Prev = link.Prev;
+	} else {
+		it->second.Last = link.Prev;
+	}
+	if (it->second.First == entt::null) {
+		_nameIndex.erase(it);
+	}
+	link = NameLink();
+}
+
 entt::handle GameScene::StampEntity(const entt::registry& from, entt::entity src, entt::registry& to) {
 	entt::entity dst = to.create();
 	from.visit(src, [&from, &to, src, dst](const auto type_id) {
-		_stampFunctions[type_id](from, src, to, dst);
+		_componentTypes[type_id].Stamp(from, src, to, dst);
 	});
 	return entt::handle(to, dst);
 }
+
+void GameScene::_StampTransform(const entt::registry& from, const entt::entity src, entt::registry& to, const entt::entity dst) {
+	to.emplace_or_replace<Transform>(dst, from.get<Transform>(src), entt::handle(to, dst));
+}
+
+void GameScene::_StampTransforms(const entt::registry& from, const entt::entity src, entt::registry& to, const entt::entity* dst, size_t count) {
+	// Transforms are big, so they're built in place rather than staged in a vector and inserted
+	const Transform& source = from.get<Transform>(src);
+	to.reserve<Transform>(to.size<Transform>() + count);
+	for (size_t i = 0; i < count; i++) {
+		to.emplace<Transform>(dst[i], source, entt::handle(to, dst[i]));
+	}
+}
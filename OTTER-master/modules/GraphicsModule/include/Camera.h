@@ -66,6 +66,10 @@ public:
 	/// Sets the vertical field of view in degrees for this camera
 	/// </summary>
 	void SetFovDegrees(float value);
+	/// <summary>
+	/// Sets the distances to the near and far clipping planes
+	/// </summary>
+	void SetClippingPlanes(float nearPlane, float farPlane);
 
 	/// <summary>
 	/// Gets the camera's position in world space
@@ -81,6 +85,14 @@ public:
 	const glm::vec3& GetUp() const { return _up; }
 
 	float GetFovDegrees() const { return glm::degrees(_fovRadians); }
+	/// <summary>
+	/// Gets the distance to the near clipping plane
+	/// </summary>
+	float GetNearPlane() const { return _nearPlane; }
+	/// <summary>
+	/// Gets the distance to the far clipping plane
+	/// </summary>
+	float GetFarPlane() const { return _farPlane; }
 	
 	/// <summary>
 	/// Gets the view matrix for this camera
@@ -0,0 +1,138 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <GLM/glm.hpp>
+
+#include "TextureCubeMap.h"
+#include "TextureCubeMapData.h"
+#include "Shader.h"
+#include "Macros.h"
+
+/// <summary>
+/// Image based lighting baked from an environment cubemap. Holds the diffuse irradiance as L2 spherical harmonics,
+/// and the specular as a cubemap mip chain prefiltered with GGX, where each mip is a rougher surface
+/// </summary>
+class IBLData final {
+	SMART_MEMORY_MANAGED(IBLData)
+public:
+	IBLData();
+	~IBLData() = default;
+
+	// Irradiance coefficients (already convolved with the cosine lobe and divided by pi), in the order
+	// Y00, Y1-1, Y10, Y11, Y2-2, Y2-1, Y20, Y21, Y22
+	glm::vec3 Irradiance[9];
+	// Prefiltered specular, mip 0 is a mirror and the last mip is fully rough
+	std::vector<TextureCubeMapData::sptr> Specular;
+
+	/// <summary>
+	/// Evaluates the irradiance for a normal in cubemap space, this is what the shader does per pixel
+	/// </summary>
+	glm::vec3 EvaluateIrradiance(const glm::vec3& normal) const;
+
+	/// <summary>
+	/// Uploads the specular mip chain into a new cubemap
+	/// </summary>
+	TextureCubeMap::sptr CreateSpecularMap() const;
+
+	/// <summary>
+	/// Sets u_IrradianceSH and u_SpecularMaxLod on a shader
+	/// </summary>
+	void SetUniforms(const Shader::sptr& shader) const;
+};
+
+/// <summary>
+/// Settings for baking image based lighting, everything in here is part of the cache key
+/// </summary>
+struct IBLBakeSettings {
+	// Size of the sharpest specular mip
+	uint32_t SpecularSize;
+	// How many specular mips to make, roughness goes from 0 to 1 across them
+	uint32_t SpecularMips;
+	// GGX samples taken for every specular texel
+	uint32_t SampleCount;
+	// Converts 8 bit input from sRGB to linear before baking
+	bool     SrgbInput;
+
+	IBLBakeSettings() :
+		SpecularSize(128),
+		SpecularMips(6),
+		SampleCount(128),
+		SrgbInput(false)
+	{ }
+};
+
+/// <summary>
+/// Bakes image based lighting on the CPU, using all cores and SSE where it's available, and caches the results to disk
+/// so the same environment with the same settings only ever gets baked once
+/// </summary>
+class IBLBaker final {
+public:
+	/// <summary>
+	/// Timings and info about the last bake
+	/// </summary>
+	struct BakeStats {
+		bool     FromCache = false;
+		unsigned Threads = 0;
+		double   HashMs = 0.0;
+		double   ConvertMs = 0.0;
+		double   IrradianceMs = 0.0;
+		double   SpecularMs = 0.0;
+		double   TotalMs = 0.0;
+	};
+
+	/// <summary>
+	/// Bakes the lighting for an environment, or loads it from the cache if it's been baked before
+	/// </summary>
+	/// <param name="environment">The cubemap to bake, must be 8 bit or float, with 1 to 4 channels</param>
+	/// <param name="settings">The settings to bake with</param>
+	/// <returns>The baked lighting, or nullptr if the environment's format isn't supported</returns>
+	static IBLData::sptr Bake(const TextureCubeMapData::sptr& environment, const IBLBakeSettings& settings = IBLBakeSettings());
+
+	/// <summary>
+	/// Projects an environment onto L2 spherical harmonics and convolves it for irradiance. Doesn't touch the cache
+	/// </summary>
+	/// <param name="useSimd">False to use the scalar path, for checking the SIMD one against</param>
+	static bool ProjectIrradiance(const TextureCubeMapData::sptr& environment, bool srgbInput, glm::vec3 result[9], bool useSimd = true);
+
+	/// <summary>
+	/// Runs the bake on a few synthetic environments and checks the results against closed form answers
+	/// and the scalar path, logging the results
+	/// </summary>
+	static bool SelfTest();
+	/// <summary>
+	/// Times the SIMD + threaded bake against scalar + single threaded and logs the results
+	/// </summary>
+	static void RunBenchmark(uint32_t environmentSize = 256);
+
+	static const BakeStats& GetLastStats() { return _lastStats; }
+	static unsigned GetThreadCount() { return _threadCount; }
+	static bool GetCacheEnabled() { return _cacheEnabled; }
+	static const std::string& GetCachePath() { return _cachePath; }
+
+	/// <summary>
+	/// Sets how many threads a bake uses, 0 uses every core
+	/// </summary>
+	static void SetThreadCount(unsigned threads);
+	static void SetCacheEnabled(bool enabled) { _cacheEnabled = enabled; }
+	static void SetCachePath(const std::string& path) { _cachePath = path; }
+
+protected:
+	// An environment converted to linear float, one plane per channel so SIMD can load 4 texels at once
+	struct FloatCube {
+		uint32_t Size = 0;
+		std::vector<float> Planes[6][3];
+	};
+
+	static bool _ConvertToFloat(const TextureCubeMapData::sptr& environment, bool srgbInput, FloatCube& result);
+	static void _ProjectIrradiance(const FloatCube& cube, glm::vec3 result[9], bool useSimd, unsigned threads);
+	static void _PrefilterSpecular(const FloatCube& cube, const IBLBakeSettings& settings, std::vector<TextureCubeMapData::sptr>& result, bool useSimd, unsigned threads);
+
+	static uint64_t _ComputeKey(const TextureCubeMapData::sptr& environment, const IBLBakeSettings& settings);
+	static bool _LoadCached(uint64_t key, const IBLBakeSettings& settings, IBLData& result);
+	static void _SaveCached(uint64_t key, const IBLBakeSettings& settings, const IBLData& data);
+
+	static BakeStats   _lastStats;
+	static unsigned    _threadCount;
+	static bool        _cacheEnabled;
+	static std::string _cachePath;
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "VertexArrayObject.h"
+
+/// <summary>
+/// Makes index buffers smaller, both on the GPU and on disk
+///
+/// On the GPU, meshes with few enough vertices get 16 bit indices, and bigger ones can be split into sub-meshes
+/// that each fit in 16 bits and draw with a base vertex. 8 bit indices aren't used, most GPUs don't read them
+/// natively and the driver ends up converting them on the CPU
+///
+/// On disk, indices are stored a triangle at a time as variable length codes: a vertex used for the first time
+/// (which is most of them once MeshOptimizer has put vertices in the order they're used) is a single 0, anything
+/// else is the zigzagged difference from the index before it. Each triangle gets rotated to whichever starting
+/// corner takes the fewest bytes, so triangles can come back with a different first corner, but never a
+/// different winding
+/// </summary>
+class IndexPacking
+{
+public:
+	/// <summary>
+	/// Copies indices into 16 bits, every index has to be under MAX_16BIT_VERTICES
+	/// </summary>
+	static std::vector<uint16_t> Narrow(const std::vector<uint32_t>& indices);
+
+	/// <summary>
+	/// Splits a triangle list into sub-meshes that each use at most maxVertices vertices. Vertices used by more than
+	/// one sub-mesh get copied into each of them
+	/// </summary>
+	/// <param name="indices">Triangle list indices</param>
+	/// <param name="vertexCount">The number of vertices the indices point into</param>
+	/// <param name="vertexSources">Gets which source vertex goes in each slot of the split mesh's vertex buffer</param>
+	/// <param name="localIndices">Gets the indices of every sub-mesh, relative to its base vertex</param>
+	/// <param name="subMeshes">Gets the range of indices and the base vertex of each sub-mesh</param>
+	/// <param name="maxVertices">The most vertices a sub-mesh can use, no more than MAX_16BIT_VERTICES</param>
+	static void Split(const std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& vertexSources,
+		std::vector<uint16_t>& localIndices, std::vector<VertexArrayObject::SubMesh>& subMeshes, size_t maxVertices = MAX_16BIT_VERTICES);
+
+	/// <summary>
+	/// Compresses indices for storing on disk
+	/// </summary>
+	/// <param name="indices">The indices to compress, a triangle list</param>
+	/// <param name="count">The number of indices</param>
+	static std::vector<uint8_t> Encode(const uint32_t* indices, size_t count);
+	/// <summary>
+	/// Decompresses indices made by Encode, returns false if the data is cut short or points outside the vertices
+	/// </summary>
+	/// <param name="data">The compressed indices</param>
+	/// <param name="size">The size of the compressed indices, in bytes</param>
+	/// <param name="count">The number of indices that were compressed</param>
+	/// <param name="vertexCount">The number of vertices the indices point into</param>
+	/// <param name="indices">Gets the indices</param>
+	static bool Decode(const uint8_t* data, size_t size, size_t count, size_t vertexCount, std::vector<uint32_t>& indices);
+
+	/// <summary>
+	/// The most vertices 16 bit indices can reach
+	/// </summary>
+	inline static const size_t MAX_16BIT_VERTICES = 65536;
+
+protected:
+	IndexPacking() = default;
+	~IndexPacking() = default;
+};
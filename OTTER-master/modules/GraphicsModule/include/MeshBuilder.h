@@ -1,6 +1,10 @@
 #pragma once
+#include <type_traits>
 #include <vector>
 #include <VertexArrayObject.h>
+#include "IndexPacking.h"
+#include "MeshOptimizer.h"
+#include "VertexTypes.h"
 
 template <typename VertType>
 class MeshBuilder
@@ -8,7 +12,10 @@ class MeshBuilder
 public:
 	MeshBuilder() :
 		_vertices(std::vector<VertType>()),
-		_indices(std::vector<uint32_t>()) {}
+		_indices(std::vector<uint32_t>()),
+		_quantizeMin(glm::vec3(0.0f)),
+		_quantizeMax(glm::vec3(0.0f)),
+		_quantized(false) {}
 	~MeshBuilder() = default;
 
 	/// <summary>
@@ -81,16 +88,123 @@ public:
 	/// </summary>
 	size_t GetTriangleCount() const { return _indices.size() > 0 ? _indices.size() / 3 : _vertices.size() / 3; }
 
-	VertexArrayObject::sptr Bake() {
-		VertexBuffer::sptr vbo = VertexBuffer::Create();
-		vbo->LoadData(GetVertexDataPtr(), _vertices.size());
+	/// <summary>
+	/// Reorders the mesh so the GPU draws it faster without changing how it looks: triangles go in vertex
+	/// cache friendly order, sorted so the ones facing outwards draw first, then vertices are stored in the
+	/// order the triangles use them (see MeshOptimizer). Best done right before Bake
+	/// </summary>
+	/// <param name="stats">If not null, gets the vertex cache statistics from before and after</param>
+	void Optimize(MeshOptimizeStats* stats = nullptr) {
+		if (_indices.empty()) {
+			if (stats != nullptr) {
+				*stats = MeshOptimizeStats();
+			}
+			return;
+		}
+		std::vector<uint32_t> remap = MeshOptimizer::Optimize(_indices, _vertices.size(), &_vertices[0].Position, sizeof(VertType), stats);
+		std::vector<VertType> vertices(_vertices.size());
+		for (size_t ix = 0; ix < remap.size(); ix++) {
+			vertices[remap[ix]] = _vertices[ix];
+		}
+		_vertices.swap(vertices);
+	}
+
+	/// <summary>
+	/// Copies the mesh into a different vertex type, keeping the indices. Each new vertex is constructed from the
+	/// old one, followed by any extra arguments given
+	/// </summary>
+	/// <typeparam name="OutType">The vertex type to convert to, ex VertexPosNormTexColPacked</typeparam>
+	template <typename OutType, typename... Args>
+	MeshBuilder<OutType> Convert(const Args&... args) const {
+		MeshBuilder<OutType> result;
+		result._vertices.reserve(_vertices.size());
+		for (const VertType& vertex : _vertices) {
+			result._vertices.emplace_back(vertex, args...);
+		}
+		result._indices = _indices;
+		return result;
+	}
+
+	/// <summary>
+	/// Copies the mesh into VertexPosNormTexColQuantized, with positions quantized within the mesh's bounds. The
+	/// result remembers the bounds, so baking it puts them and the transform that undoes the quantization on the VAO
+	/// </summary>
+	MeshBuilder<VertexPosNormTexColQuantized> Quantize() const {
+		glm::vec3 min, max;
+		CalculateBounds(min, max);
+		MeshBuilder<VertexPosNormTexColQuantized> result = Convert<VertexPosNormTexColQuantized>(min, max);
+		result._quantizeMin = min;
+		result._quantizeMax = max;
+		result._quantized = true;
+		return result;
+	}
 
+	/// <summary>
+	/// Bakes the mesh with its vertices compressed (see VertexCompression), VertType has to convert to the packed
+	/// vertex types like VertexPosNormTexCol does
+	/// </summary>
+	/// <param name="compression">How to store the vertices</param>
+	/// <param name="split16BitIndices">See Bake()</param>
+	VertexArrayObject::sptr Bake(VertexCompression compression, bool split16BitIndices = false) {
+		switch (compression) {
+			case VertexCompression::Packed:
+				return Convert<VertexPosNormTexColPacked>().Bake(split16BitIndices);
+			case VertexCompression::Quantized:
+				return Quantize().Bake(split16BitIndices);
+			default:
+				return Bake(split16BitIndices);
+		}
+	}
+
+	/// <summary>
+	/// Uploads the mesh into a new VAO. Indices are stored in 16 bits whenever there are few enough vertices for
+	/// them to reach, bigger meshes use 32 bits unless they're split
+	/// </summary>
+	/// <param name="split16BitIndices">Splits meshes too big for 16 bit indices into sub-meshes that each fit (see
+	/// IndexPacking::Split), at the cost of copying the vertices the sub-meshes share</param>
+	VertexArrayObject::sptr Bake(bool split16BitIndices = false) {
+		VertexBuffer::sptr vbo = VertexBuffer::Create();
 		IndexBuffer::sptr ebo = IndexBuffer::Create();
-		ebo->LoadData(GetIndexDataPtr(), _indices.size());
+		std::vector<VertexArrayObject::SubMesh> subMeshes;
+
+		if (_vertices.size() <= IndexPacking::MAX_16BIT_VERTICES) {
+			vbo->LoadData(GetVertexDataPtr(), _vertices.size());
+			std::vector<uint16_t> indices = IndexPacking::Narrow(_indices);
+			ebo->LoadData(indices.data(), indices.size());
+		}
+		else if (split16BitIndices) {
+			std::vector<uint32_t> sources;
+			std::vector<uint16_t> indices;
+			IndexPacking::Split(_indices, _vertices.size(), sources, indices, subMeshes);
+			std::vector<VertType> vertices;
+			vertices.reserve(sources.size());
+			for (uint32_t source : sources) {
+				vertices.push_back(_vertices[source]);
+			}
+			vbo->LoadData(vertices.data(), vertices.size());
+			ebo->LoadData(indices.data(), indices.size());
+		}
+		else {
+			vbo->LoadData(GetVertexDataPtr(), _vertices.size());
+			ebo->LoadData(GetIndexDataPtr(), _indices.size());
+		}
 
 		VertexArrayObject::sptr result = VertexArrayObject::Create();
 		result->AddVertexBuffer(vbo, VertType::V_DECL);
 		result->SetIndexBuffer(ebo);
+		result->SetSubMeshes(subMeshes);
+
+		// Store the bounds so the mesh can be culled, quantized positions keep the bounds they were quantized within
+		if (_quantized) {
+			result->SetBounds(_quantizeMin, _quantizeMax);
+			result->SetDequantization(VertexPacking::Dequantization(_quantizeMin, _quantizeMax));
+		}
+		else if constexpr (std::is_same_v<decltype(VertType::Position), glm::vec3>) {
+			glm::vec3 min, max;
+			if (CalculateBounds(min, max)) {
+				result->SetBounds(min, max);
+			}
+		}
 
 		return result;
 	}
@@ -112,7 +226,30 @@ public:
 	
 protected:
 	friend class MeshFactory;
+	friend class MeshFile;
+	template <typename> friend class MeshBuilder;
+
+	/// <summary>
+	/// Finds the box around every vertex, returns false if there aren't any
+	/// </summary>
+	bool CalculateBounds(glm::vec3& min, glm::vec3& max) const {
+		min = max = glm::vec3(0.0f);
+		if (_vertices.empty()) {
+			return false;
+		}
+		min = max = _vertices[0].Position;
+		for (const VertType& vertex : _vertices) {
+			min = glm::min(min, vertex.Position);
+			max = glm::max(max, vertex.Position);
+		}
+		return true;
+	}
 	
 	std::vector<VertType> _vertices;
 	std::vector<uint32_t> _indices;
+
+	// The bounds the positions were quantized within, if they were
+	glm::vec3 _quantizeMin;
+	glm::vec3 _quantizeMax;
+	bool      _quantized;
 };
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "MeshBuilder.h"
+
+/// <summary>
+/// Saves and loads meshes in a baked binary format, so they load without being parsed or optimized again
+///
+/// A file is a small header, the vertices exactly as they are in memory, then the indices compressed with
+/// IndexPacking::Encode. The header records the vertex type's layout (its V_DECL), so a file only loads back
+/// into the vertex type it was saved from. Files are written to a temporary file and moved into place, so a
+/// crash mid write never leaves a truncated file behind
+/// </summary>
+class MeshFile
+{
+public:
+	/// <summary>
+	/// Writes a mesh to a file, returns false if the file couldn't be written
+	/// </summary>
+	/// <param name="path">The file to write</param>
+	/// <param name="mesh">The mesh to save</param>
+	template <typename VertType>
+	static bool Save(const std::string& path, const MeshBuilder<VertType>& mesh) {
+		return Write(path, LayoutId(VertType::V_DECL, sizeof(VertType)), mesh.GetVertexDataPtr(), sizeof(VertType), mesh.GetVertexCount(),
+			mesh.GetIndexDataPtr(), mesh.GetIndexCount());
+	}
+
+	/// <summary>
+	/// Reads a mesh from a file, returns false and leaves the mesh alone if the file is missing, broken or was saved
+	/// from a different vertex type
+	/// </summary>
+	/// <param name="path">The file to read</param>
+	/// <param name="mesh">Gets the mesh that was saved</param>
+	template <typename VertType>
+	static bool Load(const std::string& path, MeshBuilder<VertType>& mesh) {
+		std::vector<uint8_t> vertices;
+		std::vector<uint32_t> indices;
+		if (!Read(path, LayoutId(VertType::V_DECL, sizeof(VertType)), sizeof(VertType), vertices, indices)) {
+			return false;
+		}
+		mesh = MeshBuilder<VertType>();
+		mesh._vertices.resize(vertices.size() / sizeof(VertType));
+		if (!vertices.empty()) {
+			memcpy(mesh._vertices.data(), vertices.data(), vertices.size());
+		}
+		mesh._indices.swap(indices);
+		return true;
+	}
+
+	/// <summary>
+	/// Bumped whenever the layout of the file changes, older files fail to load
+	/// </summary>
+	inline static const uint32_t VERSION = 2;
+
+protected:
+	MeshFile() = default;
+	~MeshFile() = default;
+
+	/// <summary>
+	/// Hashes every attribute of a vertex layout along with the vertex size, so two vertex types only match if
+	/// their vertices are read the same way
+	/// </summary>
+	static uint32_t LayoutId(const std::vector<BufferAttribute>& layout, size_t vertexSize);
+
+	static bool Write(const std::string& path, uint32_t layout, const void* vertices, size_t vertexSize, size_t vertexCount, const uint32_t* indices, size_t indexCount);
+	static bool Read(const std::string& path, uint32_t layout, size_t vertexSize, std::vector<uint8_t>& vertices, std::vector<uint32_t>& indices);
+};
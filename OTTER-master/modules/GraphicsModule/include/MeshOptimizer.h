@@ -0,0 +1,119 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GLM/glm.hpp>
+
+/// <summary>
+/// How well an index buffer uses the GPU's post-transform vertex cache, simulated as a FIFO
+/// </summary>
+struct VertexCacheStats
+{
+	/// <summary>
+	/// Vertices that weren't in the cache, so had to be run through the vertex shader
+	/// </summary>
+	size_t Misses = 0;
+	/// <summary>
+	/// Average cache miss ratio, misses per triangle. 3 is every vertex of every triangle, 0.5 is about the
+	/// best a big regular grid can do
+	/// </summary>
+	float ACMR = 0.0f;
+	/// <summary>
+	/// Average transform to vertex ratio, misses per vertex used. 1 means every vertex is only shaded once
+	/// </summary>
+	float ATVR = 0.0f;
+};
+
+/// <summary>
+/// What MeshOptimizer::Optimize did to a mesh
+/// </summary>
+struct MeshOptimizeStats
+{
+	VertexCacheStats Before;
+	VertexCacheStats After;
+	/// <summary>
+	/// How many clusters the triangles were split into to be sorted for overdraw
+	/// </summary>
+	size_t Clusters = 0;
+};
+
+/// <summary>
+/// Reorders indexed triangle meshes so the GPU does less work drawing them, without changing what they look like
+///
+/// The triangles are reordered with Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex
+/// Locality and Reduced Overdraw") so neighbouring triangles reuse vertices still in the post-transform cache.
+/// The runs Tipsify makes are then split into clusters and sorted so the ones facing out from the middle of
+/// the mesh draw first, since those tend to hide the rest. Last, the vertices are renumbered in the order the
+/// indices first use them, so vertex fetches walk through memory instead of jumping around it
+///
+/// MeshBuilder::Optimize runs all of it on a mesh before it's baked
+/// </summary>
+class MeshOptimizer
+{
+public:
+	/// <summary>
+	/// Simulates a FIFO post-transform cache over an index buffer
+	/// </summary>
+	/// <param name="indices">Triangle list indices</param>
+	/// <param name="indexCount">The number of indices</param>
+	/// <param name="vertexCount">The number of vertices the indices point into</param>
+	/// <param name="cacheSize">How many vertices the cache holds</param>
+	static VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+
+	/// <summary>
+	/// Reorders the triangles for vertex cache reuse with Tipsify, linear in the size of the mesh
+	/// </summary>
+	/// <param name="indices">Triangle list indices, reordered in place</param>
+	/// <param name="vertexCount">The number of vertices the indices point into</param>
+	/// <param name="cacheSize">How many vertices the cache holds</param>
+	/// <param name="clusters">If not null, gets the first triangle of each run Tipsify had to restart for</param>
+	static void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = DEFAULT_CACHE_SIZE, std::vector<uint32_t>* clusters = nullptr);
+
+	/// <summary>
+	/// Sorts clusters of triangles so the ones facing out from the mesh's center draw first. Clusters are split
+	/// further wherever their vertex cache use is good enough on its own, so the ordering has more to work with
+	/// </summary>
+	/// <param name="indices">Vertex cache optimized triangle list indices, reordered in place</param>
+	/// <param name="vertexCount">The number of vertices the indices point into</param>
+	/// <param name="positions">Position of the first vertex</param>
+	/// <param name="stride">Bytes from one vertex's position to the next</param>
+	/// <param name="clusters">The first triangle of each cluster, from OptimizeVertexCache</param>
+	/// <param name="threshold">How much worse than the whole mesh's ACMR a cluster can be and still get split off</param>
+	/// <param name="cacheSize">How many vertices the cache holds</param>
+	/// <returns>The number of clusters that were sorted</returns>
+	static size_t OptimizeOverdraw(std::vector<uint32_t>& indices, size_t vertexCount, const glm::vec3* positions, size_t stride, const std::vector<uint32_t>& clusters, float threshold = 1.05f, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+
+	/// <summary>
+	/// Renumbers vertices in the order the indices first use them, vertices nothing uses go on the end
+	/// </summary>
+	/// <param name="indices">Triangle list indices, renumbered in place</param>
+	/// <param name="vertexCount">The number of vertices the indices point into</param>
+	/// <returns>Where each vertex should move to</returns>
+	static std::vector<uint32_t> OptimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount);
+
+	/// <summary>
+	/// Runs every pass over a mesh
+	/// </summary>
+	/// <param name="indices">Triangle list indices, reordered in place</param>
+	/// <param name="vertexCount">The number of vertices</param>
+	/// <param name="positions">Position of the first vertex</param>
+	/// <param name="stride">Bytes from one vertex's position to the next</param>
+	/// <param name="stats">If not null, gets the vertex cache statistics from before and after</param>
+	/// <returns>Where each vertex should move to</returns>
+	static std::vector<uint32_t> Optimize(std::vector<uint32_t>& indices, size_t vertexCount, const glm::vec3* positions, size_t stride, MeshOptimizeStats* stats = nullptr);
+
+	/// <summary>
+	/// Optimizes the OBJ files given, checks every triangle survives and logs each pass's vertex cache
+	/// statistics and timings
+	/// </summary>
+	static bool RunBenchmark(const std::vector<std::string>& files);
+
+	/// <summary>
+	/// Roughly the cache size of current desktop GPUs
+	/// </summary>
+	inline static const uint32_t DEFAULT_CACHE_SIZE = 16;
+
+protected:
+	MeshOptimizer() = default;
+	~MeshOptimizer() = default;
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include "MeshBuilder.h"
+#include "VertexTypes.h"
+
+/// <summary>
+/// What happened during a call to MeshSimplifier::Simplify
+/// </summary>
+struct SimplifyStats
+{
+	size_t TrianglesIn = 0;
+	size_t TrianglesOut = 0;
+	size_t VerticesIn = 0;
+	size_t VerticesOut = 0;
+	/// <summary>
+	/// How many edges were collapsed
+	/// </summary>
+	size_t Collapses = 0;
+	/// <summary>
+	/// Roughly how far (in model units) the worst collapse moved the surface
+	/// </summary>
+	float MaxError = 0.0f;
+};
+
+/// <summary>
+/// Reduces the triangle count of a mesh while keeping its shape, for building level of detail chains
+///
+/// Uses quadric error metrics (Garland and Heckbert): every vertex keeps the sum of the planes around it,
+/// and the edge whose collapse moves the surface the least goes first. Collapses move one end of an edge
+/// onto the other (half-edge collapses), so every vertex left in the result is one from the source mesh,
+/// and UVs, normals and colors never need to be interpolated. Open edges and UV / normal seams are weighted
+/// so the outline and texture layout hold up, and collapses that would flip a triangle are skipped
+/// </summary>
+class MeshSimplifier
+{
+public:
+	/// <summary>
+	/// Builds a simplified copy of a mesh with at most targetTriangles triangles
+	///
+	/// Stops early if no more edges can be collapsed without flipping triangles or tearing the mesh, so
+	/// the result can end up with more triangles than asked for
+	/// </summary>
+	/// <param name="mesh">The mesh to simplify, must be indexed triangles</param>
+	/// <param name="targetTriangles">The triangle count to stop at</param>
+	/// <param name="stats">If not null, filled in with what the simplifier did</param>
+	/// <returns>A new mesh, with only the vertices its triangles use</returns>
+	static MeshBuilder<VertexPosNormTexCol> Simplify(const MeshBuilder<VertexPosNormTexCol>& mesh, size_t targetTriangles, SimplifyStats* stats = nullptr);
+
+protected:
+	MeshSimplifier() = default;
+	~MeshSimplifier() = default;
+};
@@ -4,7 +4,17 @@
 class ObjLoader
 {
 public:
-	static VertexArrayObject::sptr LoadFromFile(const std::string& filename, const glm::vec4& inColor = glm::vec4(1.0f));
+	/// <summary>
+	/// Loads an OBJ file and bakes it into a VAO
+	/// </summary>
+	/// <param name="compression">How to store the vertices on the GPU, see VertexCompression</param>
+	static VertexArrayObject::sptr LoadFromFile(const std::string& filename, const glm::vec4& inColor = glm::vec4(1.0f), VertexCompression compression = VertexCompression::None);
+	/// <summary>
+	/// Reads an OBJ file into a mesh builder without touching OpenGL, so it can run on any thread.
+	/// Baking the result gives the same mesh LoadFromFile would
+	/// </summary>
+	/// <param name="optimize">Runs MeshBuilder::Optimize on the result, turn it off to get the faces in the file's order</param>
+	static MeshBuilder<VertexPosNormTexCol> ParseFile(const std::string& filename, const glm::vec4& inColor = glm::vec4(1.0f), bool optimize = true);
 
 protected:
 	ObjLoader() = default;
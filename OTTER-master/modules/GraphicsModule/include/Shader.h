@@ -4,6 +4,11 @@
 
 #include <string>               // for std::string
 #include <unordered_map>        // for std::unordered_map
+#include <map>                  // for std::map
+#include <vector>               // for std::vector
+#include <functional>           // for std::function
+#include <unordered_set>        // for std::unordered_set
+#include <cstdint>              // for uint64_t
 #include <GLM/glm.hpp>          // for our GLM types
 #include <GLM/gtc/type_ptr.hpp> // for glm::value_ptr
 #include "Logging.h"            // for the logging functions
@@ -18,6 +23,26 @@ public:
 	static inline sptr Create() {
 		return std::make_shared<Shader>(); 
 	}
+
+	/// <summary>
+	/// Counters for the program binary cache, useful for measuring startup time
+	/// </summary>
+	struct CacheStats {
+		// Programs that have been linked or loaded
+		int    Programs = 0;
+		// Programs loaded from a binary another shader in this run already produced
+		int    MemoryHits = 0;
+		// Programs loaded from a binary on disk
+		int    DiskHits = 0;
+		// Programs that were compiled and linked from source successfully
+		int    Compiled = 0;
+		// Stages that were shared with a shader that already compiled the same source
+		int    StagesShared = 0;
+		// Time spent compiling and linking from source, in milliseconds
+		double CompileMs = 0.0;
+		// Time spent loading program binaries, in milliseconds
+		double LoadMs = 0.0;
+	};
 	
 public:
 	// We'll disallow moving and copying, since we want to manually control when the destructor is called
@@ -38,25 +63,58 @@ public:
 
 	/// <summary>
 	/// Loads a single shader stage into this shader object (ex: Vertex Shader or Fragment Shader)
+	/// The stage isn't compiled until Link, so compile errors get reported there
 	/// </summary>
 	/// <param name="source">The source code of the shader to load</param>
-	/// <param name="type">The stage to load (GL_VERTEX_SHADER or GL_FRAGMENT_SHADER)</param>
-	/// <returns>True if the shader is loaded, false if there was an issue</returns>
+	/// <param name="type">The stage to load (GL_VERTEX_SHADER, GL_FRAGMENT_SHADER or GL_COMPUTE_SHADER)</param>
+	/// <returns>True if the shader is loaded, false if the stage isn't supported</returns>
 	bool LoadShaderPart(const char* source, GLenum type);
 	/// <summary>
 	/// Loads a single shader stage into this shader object (ex: Vertex Shader or Fragment Shader) from an external file (in res)
+	/// 
+	/// #include "file" lines are replaced with the contents of that file (relative to the including file), and every file
+	/// that gets pulled in is tracked so the shader can be reloaded when any of them change
 	/// </summary>
 	/// <param name="path">The relative path to the file containing the source</param>
 	/// <param name="type">The stage to load (GL_VERTEX_SHADER or GL_FRAGMENT_SHADER)</param>
 	/// <returns>True if the shader is loaded, false if there was an issue</returns>
 	bool LoadShaderPartFromFile(const char* path, GLenum type);
+	/// <summary>
+	/// Adds a #define to every stage of this shader, inserted right after the #version line. Must be called before Link
+	/// </summary>
+	/// <param name="name">The name of the macro to define</param>
+	/// <param name="value">The value of the macro (can be empty)</param>
+	void AddDefine(const std::string& name, const std::string& value = "");
 
 	/// <summary>
-	/// Links the vertex and fragment shader, and allows this shader program to be used
+	/// Links the vertex and fragment shader (or the compute shader on its own), and allows this shader program to be used
+	/// 
+	/// Stages are only compiled here, and only if the program binary cache doesn't already have a program
+	/// with the same sources, defines and driver
 	/// </summary>
 	/// <returns>True if the linking was sucessful, false if otherwise</returns>
 	bool Link();
 
+	/// <summary>
+	/// Reloads and relinks every stage that was loaded from a file, with the same defines. The new program replaces the
+	/// old one in place, so everything holding this shader picks it up. If anything fails the old program is kept.
+	/// Stages the old program used are deleted once no other shader uses them
+	/// </summary>
+	/// <returns>True if the shader was rebuilt, false if it kept the old program</returns>
+	bool Reload();
+	/// <summary>
+	/// Adds a function that gets called after every successful Reload, since the new program starts with default uniforms
+	/// </summary>
+	void AddReloadCallback(const std::function<void()>& callback);
+	/// <summary>
+	/// Gets every file this shader was built from, including the files it #includes
+	/// </summary>
+	const std::vector<std::string>& GetDependencies() const { return _dependencies; }
+	/// <summary>
+	/// Gets how many times this shader has been reloaded. Uniform locations from an older revision aren't valid anymore
+	/// </summary>
+	uint32_t GetRevision() const { return _revision; }
+
 	/// <summary>
 	/// Binds this shader for use
 	/// </summary>
@@ -70,6 +128,32 @@ public:
 	/// Gets the underlying OpenGL handle that this class is wrapping
 	/// </summary>
 	GLuint GetHandle() const { return _handle; }
+
+	/// <summary>
+	/// Enables or disables the program binary cache (on by default). Turning it off compiles every program from source
+	/// </summary>
+	static void SetCacheEnabled(bool enabled) { _cacheEnabled = enabled; }
+	/// <summary>
+	/// Sets the folder that program binaries are saved to and loaded from (relative to the working directory)
+	/// </summary>
+	static void SetCachePath(const std::string& path) { _cachePath = path; }
+	/// <summary>
+	/// Gets the counters for the program binary cache
+	/// </summary>
+	static const CacheStats& GetCacheStats() { return _cacheStats; }
+	/// <summary>
+	/// Frees the in memory binaries and shared stage objects. The disk cache is left alone
+	/// </summary>
+	static void ClearCache();
+
+	/// <summary>
+	/// Runs a function on every shader that currently exists
+	/// </summary>
+	static void ForEachShader(const std::function<void(Shader&)>& callback);
+	/// <summary>
+	/// Gets a counter that changes whenever a shader is created, destroyed or gets new dependencies
+	/// </summary>
+	static uint32_t GetRegistryRevision() { return _registryRevision; }
 	
 public:
 	int GetUniformLocation(const std::string& name);
@@ -117,11 +201,84 @@ public:
 	void SetUniform(int location, const glm::bvec4* value, int count = 1);
 	
 protected:
+	/// <summary>
+	/// A program binary as returned by glGetProgramBinary
+	/// </summary>
+	struct ProgramBinary {
+		GLenum            Format;
+		std::vector<char> Data;
+	};
+
+	/// <summary>
+	/// A compiled stage, shared between every program built from the same source and defines
+	/// </summary>
+	struct SharedStage {
+		GLuint Handle;
+		// How many programs are holding on to the stage, it gets deleted when this hits 0
+		int    Users;
+	};
+
+	/// <summary>
+	/// Compiles (or grabs the shared copy of) a single stage and takes a reference to it, returns 0 on failure
+	/// </summary>
+	/// <param name="keys">Gets the key of the stage, so the reference can be released</param>
+	GLuint _CompileStage(GLenum type, const std::string& source, std::vector<uint64_t>& keys);
+	/// <summary>
+	/// Drops a reference to each of the stages, deleting any that nothing else uses
+	/// </summary>
+	static void _ReleaseStages(std::vector<uint64_t>& keys);
+	/// <summary>
+	/// Hashes the stage sources, defines and driver into the key programs are cached under
+	/// </summary>
+	uint64_t _ComputeKey() const;
+	/// <summary>
+	/// Tries to load this program from the in memory or disk cache
+	/// </summary>
+	bool _LoadCachedBinary(uint64_t key);
+	/// <summary>
+	/// Stores the linked program's binary in memory and on disk
+	/// </summary>
+	void _SaveCachedBinary(uint64_t key);
+	/// <summary>
+	/// Logs the program's link error
+	/// </summary>
+	void _LogLinkError();
+	/// <summary>
+	/// Reads a shader file and expands its #includes, returns false if any of the files couldn't be opened
+	/// </summary>
+	static bool _ReadShaderFile(const std::string& path, std::string& result, std::vector<std::string>& dependencies, int depth = 0);
+
 	GLuint _vs;
 	GLuint _fs;
+	GLuint _cs;
 	
 	GLuint _handle;
 
+	// Sources for each stage, kept until Link so we can skip compiling them
+	std::map<GLenum, std::string> _sources;
+	// The #define lines added to every stage
+	std::string _defines;
+
+	// The files the stages came from (in load order), so we can reload them
+	std::vector<std::pair<GLenum, std::string>> _stagePaths;
+	// Every file read while loading the stages, including #includes
+	std::vector<std::string> _dependencies;
+	std::vector<std::function<void()>> _reloadCallbacks;
+	uint32_t _revision;
+	// The shared stages this program was linked from, released when it's replaced or destroyed
+	std::vector<uint64_t> _stageKeys;
+
 	std::unordered_map<std::string, int> _uniformLocs;
+
+	static bool        _cacheEnabled;
+	static std::string _cachePath;
+	static CacheStats  _cacheStats;
+	// Binaries for programs linked during this run, keyed by _ComputeKey
+	static std::unordered_map<uint64_t, ProgramBinary> _binaries;
+	// Compiled stages, keyed by the hash of their type and source
+	static std::unordered_map<uint64_t, SharedStage> _stages;
+	// Every shader that currently exists, for finding the ones to reload
+	static std::unordered_set<Shader*> _shaders;
+	static uint32_t _registryRevision;
 	
 };
\ No newline at end of file
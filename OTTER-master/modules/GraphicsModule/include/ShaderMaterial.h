@@ -1,13 +1,15 @@
 #pragma once
 #include <string>
 #include "Shader.h"
+#include "ShaderVariants.h"
 #include "ITexture.h"
 #include "Macros.h"
 #include <EnumToString.h>
 
 struct ShaderParamName {
 	std::string Name;
-	int         Location;
+	// Resolved against the material's current shader, so it can change without changing the key
+	mutable int Location;
 
 	ShaderParamName(const std::string& name) :
 		Name(name), Location(-1) {}
@@ -38,6 +40,9 @@ public:
 	virtual ~ShaderMaterial();
 
 	Shader::sptr Shader;
+	// If set, Shader is the variant of these that matches Keywords
+	ShaderVariants::sptr Variants;
+	uint32_t Keywords;
 	std::unordered_map<ShaderParamName, ITexture::sptr> Textures;
 	std::unordered_map<ShaderParamName, float> FloatParams;
 	std::unordered_map<ShaderParamName, glm::vec2> Vec2Params;
@@ -51,6 +56,19 @@ public:
 
 	void Apply();
 
+	/// <summary>
+	/// Makes this material use a variant of the given shader, picked by keyword mask
+	/// </summary>
+	void SetVariants(const ShaderVariants::sptr& variants, uint32_t keywords = 0);
+	/// <summary>
+	/// Switches to the variant for a different keyword mask
+	/// </summary>
+	void SetKeywords(uint32_t keywords);
+	/// <summary>
+	/// Turns a single keyword on or off by name
+	/// </summary>
+	void EnableKeyword(const std::string& name, bool enabled = true);
+
 	void Set(const std::string& name, const ITexture::sptr& texture);
 	void Set(const std::string& name, float value);
 	void Set(const std::string& name, const glm::vec2& value);
@@ -60,4 +78,9 @@ public:
 	void Set(const std::string& name, const glm::mat3& value);
 
 protected:
+	// The shader (and its revision) that the parameter locations were last looked up in
+	const ::Shader* _resolvedShader;
+	uint32_t _resolvedRevision;
+
+	void _ResolveLocations();
 };
@@ -0,0 +1,72 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include "Shader.h"
+#include "Macros.h"
+
+/// <summary>
+/// A set of shader programs built from the same sources, where each program (variant) is compiled with a different
+/// set of keywords #defined. Lets a shader compile out features it isn't using instead of branching on them at runtime
+/// </summary>
+class ShaderVariants final {
+	SMART_MEMORY_MANAGED(ShaderVariants)
+public:
+	ShaderVariants();
+	~ShaderVariants() = default;
+
+	/// <summary>
+	/// Loads a single stage from a file, all variants share the same stages
+	/// </summary>
+	/// <param name="path">The relative path to the file containing the source</param>
+	/// <param name="type">The stage to load (GL_VERTEX_SHADER, GL_FRAGMENT_SHADER or GL_COMPUTE_SHADER)</param>
+	void LoadShaderPartFromFile(const char* path, GLenum type);
+
+	/// <summary>
+	/// Declares a keyword, variants that have it in their mask are compiled with it #defined
+	/// </summary>
+	/// <param name="name">The name of the macro</param>
+	/// <returns>The bit for the keyword, to be combined into masks</returns>
+	uint32_t AddKeyword(const std::string& name);
+	/// <summary>
+	/// Gets the bit for a keyword by name, or 0 if it wasn't declared
+	/// </summary>
+	uint32_t GetKeyword(const std::string& name) const;
+
+	/// <summary>
+	/// Gets the variant for a keyword mask, compiling it the first time it gets asked for
+	/// </summary>
+	/// <param name="keywords">The keyword bits to enable</param>
+	Shader::sptr GetVariant(uint32_t keywords);
+	/// <summary>
+	/// Gets the keyword mask a variant was compiled with, or 0 if the shader isn't one of our variants
+	/// </summary>
+	uint32_t GetVariantKeywords(const Shader::sptr& shader) const;
+	/// <summary>
+	/// Gets how many variants have been compiled so far
+	/// </summary>
+	size_t GetVariantCount() const { return _variants.size(); }
+
+	/// <summary>
+	/// Sets a function that gets called on every variant when it's created or reloaded (ex: to set scene uniforms),
+	/// and runs it on the variants that already exist
+	/// </summary>
+	void SetVariantSetup(const std::function<void(const Shader::sptr&)>& setup);
+	/// <summary>
+	/// Runs a function on every variant compiled so far
+	/// </summary>
+	void ForEachVariant(const std::function<void(const Shader::sptr&)>& callback) const;
+
+protected:
+	struct StagePath {
+		std::string Path;
+		GLenum      Type;
+	};
+
+	std::vector<StagePath> _stages;
+	std::vector<std::string> _keywords;
+	std::unordered_map<uint32_t, Shader::sptr> _variants;
+	// Shared with the variants' reload callbacks, which can outlive us
+	std::shared_ptr<std::function<void(const Shader::sptr&)>> _setup;
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+
+/// <summary>
+/// Watches the files every shader was built from (including #includes) and reloads shaders when they change
+/// 
+/// Changes are picked up on a background thread (inotify on Linux, polling file times elsewhere), but the shaders are
+/// only rebuilt in Poll, so they never change in the middle of a frame
+/// </summary>
+class ShaderWatcher final {
+public:
+	/// <summary>
+	/// Starts watching for changes
+	/// </summary>
+	static void Init();
+	/// <summary>
+	/// Stops the background thread
+	/// </summary>
+	static void Shutdown();
+
+	/// <summary>
+	/// Reloads every shader that depends on a file that changed. Call this between frames
+	/// </summary>
+	static void Poll();
+
+	/// <summary>
+	/// Gets whether the watcher is running
+	/// </summary>
+	static bool IsRunning() { return _running; }
+	/// <summary>
+	/// Gets how many shaders have been reloaded
+	/// </summary>
+	static int GetReloadCount() { return _reloadCount; }
+	/// <summary>
+	/// Gets how many reloads failed (and kept the old program)
+	/// </summary>
+	static int GetFailedCount() { return _failedCount; }
+
+protected:
+	/// <summary>
+	/// Watches the directories (or files) of every shader's dependencies, if any shaders have changed
+	/// </summary>
+	static void _UpdateWatches();
+	/// <summary>
+	/// Runs on the background thread, queueing up files as they change
+	/// </summary>
+	static void _WatchThread();
+	/// <summary>
+	/// Queues a changed file, called from the background thread
+	/// </summary>
+	static void _QueueChange(const std::string& path);
+
+	static std::thread _thread;
+	static std::atomic_bool _running;
+	static std::mutex _mutex;
+
+	// Files that have changed since the last Poll, and when the most recent change happened
+	static std::unordered_set<std::string> _changed;
+	static std::chrono::steady_clock::time_point _lastChange;
+
+	// Every file any shader depends on, and the last write time we saw for it (only used when polling)
+	static std::unordered_map<std::string, std::filesystem::file_time_type> _files;
+	// inotify watch descriptors and the directories they're watching
+	static std::unordered_map<int, std::string> _directories;
+	static int _inotify;
+
+	static uint32_t _registryRevision;
+	static int _reloadCount;
+	static int _failedCount;
+};
@@ -11,13 +11,16 @@ struct TextureCubeDesc {
 	MinFilter      MinificationFilter;
 	MagFilter      MagnificationFilter;
 	bool           GenerateMipMaps;
+	// How many mip levels to allocate when GenerateMipMaps is off, filled in with LoadMipData
+	uint32_t       MipLevels;
 
 	TextureCubeDesc() :
 		Size(0),
 		Format(InternalFormat::Unknown),
 		MinificationFilter(MinFilter::Linear),
 		MagnificationFilter(MagFilter::Linear),
-		GenerateMipMaps(false)
+		GenerateMipMaps(false),
+		MipLevels(1)
 	{ }
 };
 
@@ -49,10 +52,17 @@ public:
 	/// </summary>
 	/// <param name="data">The texture data to upload into this texture</param>
 	void LoadData(const TextureCubeMapData::sptr& data);
+	/// <summary>
+	/// Uploads data to a single mip level of this texture, the data must be the size of that level
+	/// </summary>
+	/// <param name="data">The texture data to upload into the level</param>
+	/// <param name="level">The mip level to upload to, must be less than the texture's mip level count</param>
+	void LoadMipData(const TextureCubeMapData::sptr& data, uint32_t level);
 
 	static TextureCubeMap::sptr LoadFromImages(const std::string& path);
 
 	uint32_t GetSize() const { return _description.Size; }
+	uint32_t GetMipLevels() const { return _mipLevels; }
 	InternalFormat GetFormat() const { return _description.Format; }
 	MinFilter GetMinFilter() const { return _description.MinificationFilter; }
 	MagFilter GetMagFilter() const { return _description.MagnificationFilter; }
@@ -64,6 +74,7 @@ public:
 
 private:
 	TextureCubeDesc _description;
+	uint32_t _mipLevels;
 
 	void _RecreateTexture();
 };
@@ -18,7 +18,9 @@ ENUM(InternalFormat, GLint,
 	RGB10        = GL_RGB10,
 	RGB16        = GL_RGB16,
 	RGBA8        = GL_RGBA8,
-	RGBA16       = GL_RGBA16
+	RGBA16       = GL_RGBA16,
+	RGB16F       = GL_RGB16F,
+	RGBA16F      = GL_RGBA16F
 
 	// Note: There are sized internal formats but there is a LOT of them
 );
@@ -86,6 +88,7 @@ constexpr size_t GetTexelComponentSize(PixelType type)
 		return 2;
 	case PixelType::Int:
 	case PixelType::UInt:
+	case PixelType::Float:
 		return 4;
 	default:
 		LOG_ASSERT(false, "Unknown type: {}", type);
@@ -107,6 +110,7 @@ constexpr GLint GetTexelComponentCount(PixelFormat format)
 		case PixelFormat::RG:
 			return 2;
 		case PixelFormat::RGB:
+		case PixelFormat::SRGB:
 		case PixelFormat::BGR:
 			return 3;
 		case PixelFormat::RGBA:
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <vector>
 #include <memory>
+#include <GLM/glm.hpp>
 
 #include "VertexBuffer.h"
 #include "IndexBuffer.h"
@@ -45,11 +46,12 @@ struct BufferAttribute
 	/// </summary>
 	GLint   Size;
 	/// <summary>
-	/// The type of data to be passed (ex: GL_FLOAT for a vec3)
+	/// The type of data to be passed (ex: GL_FLOAT for a vec3, GL_SHORT or GL_UNSIGNED_BYTE for packed data)
 	/// </summary>
 	GLenum  Type;
 	/// <summary>
-	/// Whether or not the data should be normalized into the 0-1 range (usually this is false)
+	/// Whether or not integer data should be normalized into the 0-1 range (-1 to 1 for signed types) when it's
+	/// converted to floats, instead of being converted as is. Usually false, true for packed colors and normals
 	/// </summary>
 	bool    Normalized;
 	/// <summary>
@@ -66,8 +68,43 @@ struct BufferAttribute
 	/// </summary>
 	AttribUsage Usage;
 
-	BufferAttribute(uint32_t slot, uint32_t size, GLenum type, bool normalized, GLsizei stride, size_t offset, AttribUsage usage = AttribUsage::Unknown) :
-		Slot(slot), Size(size), Type(type), Normalized(normalized), Stride(stride), Offset(offset), Usage(usage) { }
+	/// <summary>
+	/// Whether integer data should reach the shader as integers (ivec, uvec) instead of being converted to floats,
+	/// Normalized is ignored when this is set
+	/// </summary>
+	bool    Integer;
+
+	BufferAttribute(uint32_t slot, uint32_t size, GLenum type, bool normalized, GLsizei stride, size_t offset, AttribUsage usage = AttribUsage::Unknown, bool integer = false) :
+		Slot(slot), Size(size), Type(type), Normalized(normalized), Stride(stride), Offset(offset), Usage(usage), Integer(integer) { }
+
+	/// <summary>
+	/// Returns the size in bytes of this attribute in a vertex
+	/// </summary>
+	size_t GetByteSize() const { return Size * GetTypeSize(Type); }
+
+	/// <summary>
+	/// Returns the size in bytes of a single component of the given type, or 0 for types we don't know
+	/// </summary>
+	/// <param name="type">The type of data (ex: GL_FLOAT, GL_HALF_FLOAT, GL_SHORT)</param>
+	static size_t GetTypeSize(GLenum type) {
+		switch (type) {
+			case GL_BYTE:
+			case GL_UNSIGNED_BYTE:
+				return 1;
+			case GL_SHORT:
+			case GL_UNSIGNED_SHORT:
+			case GL_HALF_FLOAT:
+				return 2;
+			case GL_INT:
+			case GL_UNSIGNED_INT:
+			case GL_FLOAT:
+				return 4;
+			case GL_DOUBLE:
+				return 8;
+			default:
+				return 0;
+		}
+	}
 };
 
 /// <summary>
@@ -87,6 +124,17 @@ public:
 	VertexArrayObject(VertexArrayObject&& other) = delete;
 	VertexArrayObject& operator=(const VertexArrayObject& other) = delete;
 	VertexArrayObject& operator=(VertexArrayObject&& other) = delete;
+
+	/// <summary>
+	/// A range of the index buffer drawn with its own base vertex, so a mesh with more vertices than its index
+	/// type can reach can still be drawn in one go (see IndexPacking::Split)
+	/// </summary>
+	struct SubMesh
+	{
+		GLsizei FirstIndex;
+		GLsizei IndexCount;
+		GLint   BaseVertex;
+	};
 	
 public:
 	/// <summary>
@@ -108,6 +156,17 @@ public:
 	/// <param name="ibo">The index buffer to bind to this VAO</param>
 	void SetIndexBuffer(const IndexBuffer::sptr& ibo);
 	/// <summary>
+	/// Returns the index buffer bound to this VAO, or nullptr if it draws without one
+	/// </summary>
+	const IndexBuffer::sptr& GetIndexBuffer() const { return _indexBuffer; }
+	/// <summary>
+	/// Splits the index buffer into sub-meshes that each add their base vertex to their indices, an empty list
+	/// draws the whole index buffer as is. The index buffer has to be set first
+	/// </summary>
+	/// <param name="subMeshes">The sub-meshes to draw, in order</param>
+	void SetSubMeshes(const std::vector<SubMesh>& subMeshes);
+	const std::vector<SubMesh>& GetSubMeshes() const { return _subMeshes; }
+	/// <summary>
 	/// Adds a vertex buffer to this VAO, with the specified attributes
 	/// </summary>
 	/// <param name="buffer">The buffer to add (note, does not take ownership, you will still need to delete later)</param>
@@ -128,6 +187,40 @@ public:
 	/// </summary>
 	GLuint GetHandle() const { return _handle; }
 
+	/// <summary>
+	/// Sets the axis aligned bounds of the mesh in its local space, used for culling
+	/// </summary>
+	/// <param name="min">The minimum corner of the bounds</param>
+	/// <param name="max">The maximum corner of the bounds</param>
+	void SetBounds(const glm::vec3& min, const glm::vec3& max) { _boundsMin = min; _boundsMax = max; _hasBounds = true; }
+	/// <summary>
+	/// Returns true if the bounds of this mesh are known
+	/// </summary>
+	bool HasBounds() const { return _hasBounds; }
+	const glm::vec3& GetBoundsMin() const { return _boundsMin; }
+	const glm::vec3& GetBoundsMax() const { return _boundsMax; }
+
+	/// <summary>
+	/// Sets the transform that takes the positions stored in the vertex buffer into the mesh's local space, for
+	/// meshes with quantized positions (see VertexPacking::Dequantization). Renderers apply it before the model matrix
+	/// </summary>
+	/// <param name="transform">The transform to apply to the positions</param>
+	void SetDequantization(const glm::mat4& transform) { _dequantization = transform; _hasDequantization = true; }
+	/// <summary>
+	/// Returns true if the positions need GetDequantization applied to them
+	/// </summary>
+	bool HasDequantization() const { return _hasDequantization; }
+	const glm::mat4& GetDequantization() const { return _dequantization; }
+	/// <summary>
+	/// Returns true if the normals are octahedral encoded into 2 components, which the shader needs to decode
+	/// (see VertexPacking::EncodeOctahedral)
+	/// </summary>
+	bool HasOctahedralNormals() const { return _octahedralNormals; }
+	/// <summary>
+	/// Returns the total size in bytes of a single vertex, across every vertex buffer
+	/// </summary>
+	size_t GetVertexSize() const;
+
 	void Render() const;
 	
 protected:
@@ -142,8 +235,23 @@ protected:
 	IndexBuffer::sptr _indexBuffer;
 	// The vertex buffers bound to this VAO
 	std::vector<VertexBufferBinding> _vertexBuffers;
+	// Ranges of the index buffer to draw with a base vertex, and the same laid out for glMultiDrawElementsBaseVertex
+	std::vector<SubMesh>     _subMeshes;
+	std::vector<GLsizei>     _subMeshCounts;
+	std::vector<const void*> _subMeshOffsets;
+	std::vector<GLint>       _subMeshBaseVertices;
 
 	GLsizei _vertexCount;
+
+	// Local space bounds of the mesh, if they're known
+	glm::vec3 _boundsMin;
+	glm::vec3 _boundsMax;
+	bool      _hasBounds;
+
+	// Turns quantized positions back into local space
+	glm::mat4 _dequantization;
+	bool      _hasDequantization;
+	bool      _octahedralNormals;
 	
 	// The underlying OpenGL handle that this class is wrapping around
 	GLuint _handle;
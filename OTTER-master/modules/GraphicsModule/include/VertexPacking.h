@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GLM/glm.hpp>
+#include <GLM/gtc/type_precision.hpp>
+
+/// <summary>
+/// How a mesh's vertices get stored on the GPU when it's baked (see MeshBuilder::Bake)
+/// </summary>
+enum class VertexCompression
+{
+	/// <summary>
+	/// Full floats for everything, 48 bytes per VertexPosNormTexCol
+	/// </summary>
+	None = 0,
+	/// <summary>
+	/// Float positions with octahedral normals, half float UVs and RGBA8 color, 24 bytes
+	/// </summary>
+	Packed,
+	/// <summary>
+	/// Packed, with positions quantized to 16 bits within the mesh's bounds as well, 20 bytes
+	/// </summary>
+	Quantized
+};
+
+/// <summary>
+/// Encodes vertex attributes into smaller formats the GPU can still read directly, and decodes them again
+///
+/// Normals are octahedral encoded (Cigolle et al, "A Survey of Efficient Representations for Independent Unit
+/// Vectors"): the sphere is folded onto an octahedron and flattened into a square, so two signed 16 bit numbers
+/// hold a unit vector to within a few thousandths of a degree. The vertex shader unfolds them again
+/// </summary>
+class VertexPacking
+{
+public:
+	/// <summary>
+	/// Encodes a normal into two snorm16s, picking whichever rounding decodes closest to it
+	/// </summary>
+	static glm::i16vec2 EncodeOctahedral(const glm::vec3& normal);
+	/// <summary>
+	/// Decodes a normal made with EncodeOctahedral, the same way the vertex shader does
+	/// </summary>
+	static glm::vec3 DecodeOctahedral(const glm::i16vec2& encoded);
+
+	/// <summary>
+	/// Converts UVs to half floats, which keep UVs outside of 0-1 unlike unorm16s
+	/// </summary>
+	static glm::u16vec2 EncodeHalf(const glm::vec2& value);
+	static glm::vec2 DecodeHalf(const glm::u16vec2& encoded);
+
+	/// <summary>
+	/// Converts a color to RGBA8, clamping it to 0-1 first
+	/// </summary>
+	static glm::u8vec4 EncodeColor(const glm::vec4& color);
+	static glm::vec4 DecodeColor(const glm::u8vec4& encoded);
+
+	/// <summary>
+	/// Stores a position as unorm16s relative to a box the mesh fits in
+	/// </summary>
+	/// <param name="position">The position to quantize, should be inside the box</param>
+	/// <param name="boundsMin">The minimum corner of the box</param>
+	/// <param name="boundsMax">The maximum corner of the box</param>
+	static glm::u16vec3 QuantizePosition(const glm::vec3& position, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	/// <summary>
+	/// Gets the transform that turns positions quantized within a box back into model space, once the GPU has
+	/// normalized them into 0-1
+	/// </summary>
+	/// <param name="boundsMin">The minimum corner of the box</param>
+	/// <param name="boundsMax">The maximum corner of the box</param>
+	static glm::mat4 Dequantization(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	/// <summary>
+	/// Packs and quantizes the vertices of the OBJ files given, checks how far every attribute moved and logs the
+	/// errors, timings and sizes
+	/// </summary>
+	static bool RunBenchmark(const std::vector<std::string>& files);
+
+protected:
+	VertexPacking() = default;
+	~VertexPacking() = default;
+};
@@ -2,6 +2,7 @@
 
 #include <GLM/glm.hpp>
 #include <VertexArrayObject.h>
+#include <VertexPacking.h>
 
 struct VertexPosCol {
 	glm::vec3 Position;
@@ -57,4 +58,48 @@ struct VertexPosNormTexCol {
 		Position({ x, y, z }), Normal({ nX, nY, nZ }), UV({ u, v }), Color({r, g, b, a}) {}
 
 	static const std::vector<BufferAttribute> V_DECL;
-};
\ No newline at end of file
+};
+
+/// <summary>
+/// VertexPosNormTexCol in 24 bytes instead of 48: an octahedral normal in two snorm16s, half float UVs and an RGBA8
+/// color. Normals come into the vertex shader as a vec2, VertexArrayObject::HasOctahedralNormals tells it to decode
+/// </summary>
+struct VertexPosNormTexColPacked {
+	glm::vec3    Position;
+	glm::i16vec2 Normal;
+	glm::u16vec2 UV;
+	glm::u8vec4  Color;
+
+	VertexPosNormTexColPacked() : Position(glm::vec3(0.0f)), Normal(glm::i16vec2(0)), UV(glm::u16vec2(0)), Color(glm::u8vec4(0, 0, 0, 255)) {}
+	VertexPosNormTexColPacked(const VertexPosNormTexCol& vertex) :
+		Position(vertex.Position),
+		Normal(VertexPacking::EncodeOctahedral(vertex.Normal)),
+		UV(VertexPacking::EncodeHalf(vertex.UV)),
+		Color(VertexPacking::EncodeColor(vertex.Color)) {}
+
+	static const std::vector<BufferAttribute> V_DECL;
+};
+
+/// <summary>
+/// VertexPosNormTexColPacked with the position quantized to unorm16s within the mesh's bounds as well, 20 bytes.
+/// The mesh needs the transform from VertexPacking::Dequantization to draw in the right place, which
+/// MeshBuilder::Bake puts on the VAO
+/// </summary>
+struct VertexPosNormTexColQuantized {
+	glm::u16vec3 Position;
+	// Keeps the attributes after the position 4 byte aligned
+	uint16_t     Padding;
+	glm::i16vec2 Normal;
+	glm::u16vec2 UV;
+	glm::u8vec4  Color;
+
+	VertexPosNormTexColQuantized() : Position(glm::u16vec3(0)), Padding(0), Normal(glm::i16vec2(0)), UV(glm::u16vec2(0)), Color(glm::u8vec4(0, 0, 0, 255)) {}
+	VertexPosNormTexColQuantized(const VertexPosNormTexCol& vertex, const glm::vec3& boundsMin, const glm::vec3& boundsMax) :
+		Position(VertexPacking::QuantizePosition(vertex.Position, boundsMin, boundsMax)),
+		Padding(0),
+		Normal(VertexPacking::EncodeOctahedral(vertex.Normal)),
+		UV(VertexPacking::EncodeHalf(vertex.UV)),
+		Color(VertexPacking::EncodeColor(vertex.Color)) {}
+
+	static const std::vector<BufferAttribute> V_DECL;
+};
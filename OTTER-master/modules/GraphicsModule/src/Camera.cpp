@@ -66,6 +66,12 @@ void Camera::SetFovDegrees(float value) {
 	SetFovRadians(glm::radians(value));
 }
 
+void Camera::SetClippingPlanes(float nearPlane, float farPlane) {
+	_nearPlane = nearPlane;
+	_farPlane = farPlane;
+	__CalculateProjection();
+}
+
 const glm::mat4& Camera::GetViewProjection() const {
 	if (_isDirty) {
 		_viewProjection = _projection * _view;
@@ -0,0 +1,918 @@
+#include "IBLBaker.h"
+#include "Logging.h"
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+
+// SSE is always there on x86/x64, anything else falls back to the scalar path
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define IBL_BAKER_SSE
+#endif
+
+IBLBaker::BakeStats IBLBaker::_lastStats;
+unsigned IBLBaker::_threadCount = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+bool IBLBaker::_cacheEnabled = true;
+std::string IBLBaker::_cachePath = "ibl_cache";
+
+// Header at the start of every cached bake
+struct IBLCacheHeader {
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t Key;
+	uint32_t SpecularSize;
+	uint32_t SpecularMips;
+};
+static const uint32_t CACHE_MAGIC = 0x4249544F; // "OTIB"
+static const uint32_t CACHE_VERSION = 1;
+
+static const float PI = 3.14159265358979f;
+
+// Real spherical harmonics basis constants for bands 0 to 2
+static const float SH_Y00 = 0.282095f;
+static const float SH_Y1  = 0.488603f;
+static const float SH_Y2  = 1.092548f;
+static const float SH_Y20 = 0.315392f;
+static const float SH_Y22 = 0.546274f;
+// Convolving with the cosine lobe scales each band by pi, 2pi/3 and pi/4, and we divide by pi up front
+static const float BAND_SCALE[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+// 64 bit FNV-1a, continuing from a previous hash
+static uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t ix = 0; ix < size; ix++) {
+		hash ^= bytes[ix];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Direction through a point on a face, with s and t going from -1 to 1 across it (matches OpenGL's cubemap layout)
+static glm::vec3 FaceDirection(int face, float s, float t) {
+	switch (face) {
+		case 0:  return glm::vec3( 1.0f, -t, -s);
+		case 1:  return glm::vec3(-1.0f, -t,  s);
+		case 2:  return glm::vec3( s,  1.0f,  t);
+		case 3:  return glm::vec3( s, -1.0f, -t);
+		case 4:  return glm::vec3( s, -t,  1.0f);
+		default: return glm::vec3(-s, -t, -1.0f);
+	}
+}
+
+// The face a direction lands on, and where on it (u and v go from 0 to 1)
+static int DirectionToFace(const glm::vec3& dir, float& u, float& v) {
+	glm::vec3 a = glm::abs(dir);
+	int face;
+	float sc, tc, ma;
+	if (a.x >= a.y && a.x >= a.z) {
+		ma = a.x;
+		face = dir.x > 0.0f ? 0 : 1;
+		sc = dir.x > 0.0f ? -dir.z : dir.z;
+		tc = -dir.y;
+	} else if (a.y >= a.z) {
+		ma = a.y;
+		face = dir.y > 0.0f ? 2 : 3;
+		sc = dir.x;
+		tc = dir.y > 0.0f ? dir.z : -dir.z;
+	} else {
+		ma = a.z;
+		face = dir.z > 0.0f ? 4 : 5;
+		sc = dir.z > 0.0f ? dir.x : -dir.x;
+		tc = -dir.y;
+	}
+	u = 0.5f * (sc / ma + 1.0f);
+	v = 0.5f * (tc / ma + 1.0f);
+	return face;
+}
+
+static void EvaluateBasis(const glm::vec3& d, float result[9]) {
+	result[0] = SH_Y00;
+	result[1] = SH_Y1 * d.y;
+	result[2] = SH_Y1 * d.z;
+	result[3] = SH_Y1 * d.x;
+	result[4] = SH_Y2 * d.x * d.y;
+	result[5] = SH_Y2 * d.y * d.z;
+	result[6] = SH_Y20 * (3.0f * d.z * d.z - 1.0f);
+	result[7] = SH_Y2 * d.x * d.z;
+	result[8] = SH_Y22 * (d.x * d.x - d.y * d.y);
+}
+
+// Van der Corput sequence, the second half of a Hammersley point
+static float RadicalInverse(uint32_t bits) {
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return float(bits) * 2.3283064365386963e-10f;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+IBLData::IBLData() :
+	Specular()
+{
+	for (int ix = 0; ix < 9; ix++) {
+		Irradiance[ix] = glm::vec3(0.0f);
+	}
+}
+
+glm::vec3 IBLData::EvaluateIrradiance(const glm::vec3& normal) const {
+	float basis[9];
+	EvaluateBasis(glm::normalize(normal), basis);
+	glm::vec3 result = glm::vec3(0.0f);
+	for (int ix = 0; ix < 9; ix++) {
+		result += Irradiance[ix] * basis[ix];
+	}
+	return glm::max(result, glm::vec3(0.0f));
+}
+
+TextureCubeMap::sptr IBLData::CreateSpecularMap() const {
+	if (Specular.empty()) {
+		return nullptr;
+	}
+
+	TextureCubeDesc desc;
+	desc.Size = Specular[0]->GetSize();
+	desc.Format = InternalFormat::RGB16F;
+	desc.MinificationFilter = MinFilter::LinearMipLinear;
+	desc.MipLevels = static_cast<uint32_t>(Specular.size());
+	TextureCubeMap::sptr result = TextureCubeMap::Create(desc);
+	for (size_t ix = 0; ix < Specular.size(); ix++) {
+		result->LoadMipData(Specular[ix], static_cast<uint32_t>(ix));
+	}
+	return result;
+}
+
+void IBLData::SetUniforms(const Shader::sptr& shader) const {
+	shader->SetUniform(shader->GetUniformLocation("u_IrradianceSH[0]"), Irradiance, 9);
+	shader->SetUniform("u_SpecularMaxLod", Specular.empty() ? 0.0f : float(Specular.size() - 1));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+IBLData::sptr IBLBaker::Bake(const TextureCubeMapData::sptr& environment, const IBLBakeSettings& settings) {
+	auto start = std::chrono::high_resolution_clock::now();
+	BakeStats stats;
+	stats.Threads = _threadCount;
+
+	// Can't have more mips than the environment has, or no samples
+	IBLBakeSettings clamped = settings;
+	clamped.SpecularSize = clamped.SpecularSize > 0 ? clamped.SpecularSize : 1;
+	uint32_t maxMips = 1;
+	for (uint32_t size = clamped.SpecularSize; size > 1; size /= 2) {
+		maxMips++;
+	}
+	clamped.SpecularMips = glm::clamp(clamped.SpecularMips, 1u, maxMips);
+	clamped.SampleCount = clamped.SampleCount > 0 ? clamped.SampleCount : 1;
+
+	uint64_t key = 0;
+	if (_cacheEnabled) {
+		auto hashStart = std::chrono::high_resolution_clock::now();
+		key = _ComputeKey(environment, clamped);
+		stats.HashMs = MillisecondsSince(hashStart);
+
+		IBLData::sptr cached = IBLData::Create();
+		if (_LoadCached(key, clamped, *cached)) {
+			stats.FromCache = true;
+			stats.TotalMs = MillisecondsSince(start);
+			_lastStats = stats;
+			LOG_INFO("Loaded image based lighting for \"{}\" from the cache in {:.2f} ms", environment->DebugName, stats.TotalMs);
+			return cached;
+		}
+	}
+
+	auto stepStart = std::chrono::high_resolution_clock::now();
+	FloatCube cube;
+	if (!_ConvertToFloat(environment, clamped.SrgbInput, cube)) {
+		return nullptr;
+	}
+	stats.ConvertMs = MillisecondsSince(stepStart);
+
+	IBLData::sptr result = IBLData::Create();
+	stepStart = std::chrono::high_resolution_clock::now();
+	_ProjectIrradiance(cube, result->Irradiance, true, _threadCount);
+	stats.IrradianceMs = MillisecondsSince(stepStart);
+
+	stepStart = std::chrono::high_resolution_clock::now();
+	_PrefilterSpecular(cube, clamped, result->Specular, true, _threadCount);
+	stats.SpecularMs = MillisecondsSince(stepStart);
+
+	if (_cacheEnabled) {
+		_SaveCached(key, clamped, *result);
+	}
+
+	stats.TotalMs = MillisecondsSince(start);
+	_lastStats = stats;
+	LOG_INFO("Baked image based lighting for \"{}\" in {:.1f} ms ({:.1f} ms irradiance, {:.1f} ms specular, {} threads)",
+		environment->DebugName, stats.TotalMs, stats.IrradianceMs, stats.SpecularMs, stats.Threads);
+	return result;
+}
+
+bool IBLBaker::ProjectIrradiance(const TextureCubeMapData::sptr& environment, bool srgbInput, glm::vec3 result[9], bool useSimd) {
+	FloatCube cube;
+	if (!_ConvertToFloat(environment, srgbInput, cube)) {
+		return false;
+	}
+	_ProjectIrradiance(cube, result, useSimd, _threadCount);
+	return true;
+}
+
+void IBLBaker::SetThreadCount(unsigned threads) {
+	if (threads == 0) {
+		threads = std::thread::hardware_concurrency();
+	}
+	_threadCount = threads > 0 ? threads : 1;
+}
+
+bool IBLBaker::_ConvertToFloat(const TextureCubeMapData::sptr& environment, bool srgbInput, FloatCube& result) {
+	int channels = 0;
+	bool swapRB = false;
+	switch (environment->GetFormat()) {
+		case PixelFormat::Red:  channels = 1; break;
+		case PixelFormat::RG:   channels = 2; break;
+		case PixelFormat::RGB:
+		case PixelFormat::SRGB: channels = 3; break;
+		case PixelFormat::BGR:  channels = 3; swapRB = true; break;
+		case PixelFormat::RGBA: channels = 4; break;
+		case PixelFormat::BGRA: channels = 4; swapRB = true; break;
+		default:
+			LOG_ERROR("Can't bake image based lighting from pixel format {}", environment->GetFormat());
+			return false;
+	}
+	bool isFloat = environment->GetPixelType() == PixelType::Float;
+	if (!isFloat && environment->GetPixelType() != PixelType::UByte) {
+		LOG_ERROR("Can't bake image based lighting from pixel type {}", environment->GetPixelType());
+		return false;
+	}
+
+	// 8 bit values only have 256 possible results, so look them up
+	bool toLinear = srgbInput || environment->GetFormat() == PixelFormat::SRGB;
+	float table[256];
+	for (int ix = 0; ix < 256; ix++) {
+		float value = ix / 255.0f;
+		table[ix] = !toLinear ? value : (value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f));
+	}
+
+	// Which source channel each output channel reads, a single channel is grey and a missing blue is black
+	int sourceChannel[3] = { 0, channels > 1 ? 1 : 0, channels > 2 ? 2 : (channels == 1 ? 0 : -1) };
+	if (swapRB) {
+		std::swap(sourceChannel[0], sourceChannel[2]);
+	}
+
+	result.Size = environment->GetSize();
+	size_t texels = (size_t)result.Size * result.Size;
+	for (int face = 0; face < 6; face++) {
+		const void* data = environment->GetFaceDataPtr((CubeMapFace)face);
+		for (int c = 0; c < 3; c++) {
+			std::vector<float>& plane = result.Planes[face][c];
+			plane.resize(texels);
+			if (sourceChannel[c] < 0) {
+				std::fill(plane.begin(), plane.end(), 0.0f);
+				continue;
+			}
+			for (size_t ix = 0; ix < texels; ix++) {
+				size_t index = ix * channels + sourceChannel[c];
+				plane[ix] = isFloat ? static_cast<const float*>(data)[index] : table[static_cast<const uint8_t*>(data)[index]];
+			}
+		}
+	}
+	return true;
+}
+
+// Adds up the basis functions weighted by radiance and solid angle for one row of a face
+// sums holds 9 coefficients * 3 channels, then the total weight
+static void ProjectRow(const float* r, const float* g, const float* b, int face, uint32_t y, uint32_t size, double sums[28], bool useSimd) {
+	const float texelScale = 2.0f / size;
+	const float t = (y + 0.5f) * texelScale - 1.0f;
+	// Solid angle of a texel is about its area over the distance cubed from the center of the cube
+	const float texelArea = texelScale * texelScale;
+	float rowSums[28] = { 0.0f };
+	uint32_t x = 0;
+
+#ifdef IBL_BAKER_SSE
+	if (useSimd) {
+		__m128 acc[28];
+		for (int ix = 0; ix < 28; ix++) {
+			acc[ix] = _mm_setzero_ps();
+		}
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 scale = _mm_set1_ps(texelScale);
+		const __m128 laneOffset = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+		const __m128 tv = _mm_set1_ps(t);
+		const __m128 area = _mm_set1_ps(texelArea);
+
+		for (; x + 4 <= size; x += 4) {
+			__m128 s = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)x), laneOffset), scale), one);
+
+			// Same layout as FaceDirection, 4 texels at a time
+			__m128 dx, dy, dz;
+			switch (face) {
+				case 0:  dx = one;                  dy = _mm_sub_ps(zero, tv); dz = _mm_sub_ps(zero, s);  break;
+				case 1:  dx = _mm_sub_ps(zero, one); dy = _mm_sub_ps(zero, tv); dz = s;                   break;
+				case 2:  dx = s;                    dy = one;                  dz = tv;                  break;
+				case 3:  dx = s;                    dy = _mm_sub_ps(zero, one); dz = _mm_sub_ps(zero, tv); break;
+				case 4:  dx = s;                    dy = _mm_sub_ps(zero, tv); dz = one;                 break;
+				default: dx = _mm_sub_ps(zero, s);  dy = _mm_sub_ps(zero, tv); dz = _mm_sub_ps(zero, one); break;
+			}
+
+			__m128 length2 = _mm_add_ps(one, _mm_add_ps(_mm_mul_ps(s, s), _mm_mul_ps(tv, tv)));
+			__m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(length2));
+			dx = _mm_mul_ps(dx, invLength);
+			dy = _mm_mul_ps(dy, invLength);
+			dz = _mm_mul_ps(dz, invLength);
+			__m128 weight = _mm_mul_ps(area, _mm_mul_ps(invLength, _mm_mul_ps(invLength, invLength)));
+
+			__m128 wr = _mm_mul_ps(_mm_loadu_ps(r + x), weight);
+			__m128 wg = _mm_mul_ps(_mm_loadu_ps(g + x), weight);
+			__m128 wb = _mm_mul_ps(_mm_loadu_ps(b + x), weight);
+
+			__m128 basis[9];
+			basis[0] = _mm_set1_ps(SH_Y00);
+			basis[1] = _mm_mul_ps(_mm_set1_ps(SH_Y1), dy);
+			basis[2] = _mm_mul_ps(_mm_set1_ps(SH_Y1), dz);
+			basis[3] = _mm_mul_ps(_mm_set1_ps(SH_Y1), dx);
+			basis[4] = _mm_mul_ps(_mm_set1_ps(SH_Y2), _mm_mul_ps(dx, dy));
+			basis[5] = _mm_mul_ps(_mm_set1_ps(SH_Y2), _mm_mul_ps(dy, dz));
+			basis[6] = _mm_mul_ps(_mm_set1_ps(SH_Y20), _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_mul_ps(dz, dz)), one));
+			basis[7] = _mm_mul_ps(_mm_set1_ps(SH_Y2), _mm_mul_ps(dx, dz));
+			basis[8] = _mm_mul_ps(_mm_set1_ps(SH_Y22), _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+
+			for (int ix = 0; ix < 9; ix++) {
+				acc[ix * 3 + 0] = _mm_add_ps(acc[ix * 3 + 0], _mm_mul_ps(basis[ix], wr));
+				acc[ix * 3 + 1] = _mm_add_ps(acc[ix * 3 + 1], _mm_mul_ps(basis[ix], wg));
+				acc[ix * 3 + 2] = _mm_add_ps(acc[ix * 3 + 2], _mm_mul_ps(basis[ix], wb));
+			}
+			acc[27] = _mm_add_ps(acc[27], weight);
+		}
+
+		for (int ix = 0; ix < 28; ix++) {
+			float lanes[4];
+			_mm_storeu_ps(lanes, acc[ix]);
+			rowSums[ix] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+		}
+	}
+#endif
+
+	// Scalar path, and whatever's left over at the end of the row
+	for (; x < size; x++) {
+		float s = (x + 0.5f) * texelScale - 1.0f;
+		glm::vec3 dir = FaceDirection(face, s, t);
+		float length2 = glm::dot(dir, dir);
+		float invLength = 1.0f / sqrtf(length2);
+		float weight = texelArea * invLength * invLength * invLength;
+
+		float basis[9];
+		EvaluateBasis(dir * invLength, basis);
+		for (int ix = 0; ix < 9; ix++) {
+			rowSums[ix * 3 + 0] += basis[ix] * r[x] * weight;
+			rowSums[ix * 3 + 1] += basis[ix] * g[x] * weight;
+			rowSums[ix * 3 + 2] += basis[ix] * b[x] * weight;
+		}
+		rowSums[27] += weight;
+	}
+
+	// Rows get added in double, so big environments don't lose precision
+	for (int ix = 0; ix < 28; ix++) {
+		sums[ix] += rowSums[ix];
+	}
+}
+
+void IBLBaker::_ProjectIrradiance(const FloatCube& cube, glm::vec3 result[9], bool useSimd, unsigned threads) {
+	uint32_t size = cube.Size;
+	uint32_t rows = size * 6;
+	threads = threads < rows ? threads : rows;
+	threads = threads > 0 ? threads : 1;
+	uint32_t chunk = (rows + threads - 1) / threads;
+
+	// Every thread sums its own run of rows, then they get added together
+	std::vector<std::vector<double>> threadSums(threads, std::vector<double>(28, 0.0));
+	auto projectRows = [&cube, &threadSums, size, rows, chunk, useSimd](unsigned thread) {
+		uint32_t first = thread * chunk;
+		uint32_t last = first + chunk < rows ? first + chunk : rows;
+		for (uint32_t row = first; row < last; row++) {
+			int face = row / size;
+			uint32_t y = row % size;
+			size_t offset = (size_t)y * size;
+			ProjectRow(cube.Planes[face][0].data() + offset, cube.Planes[face][1].data() + offset, cube.Planes[face][2].data() + offset,
+				face, y, size, threadSums[thread].data(), useSimd);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned t = 1; t < threads; t++) {
+		workers.emplace_back(projectRows, t);
+	}
+	projectRows(0);
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+
+	double sums[28] = { 0.0 };
+	for (unsigned t = 0; t < threads; t++) {
+		for (int ix = 0; ix < 28; ix++) {
+			sums[ix] += threadSums[t][ix];
+		}
+	}
+
+	// The texel weights are an approximation, scale them so they cover the sphere exactly
+	double normalize = sums[27] > 0.0 ? 4.0 * PI / sums[27] : 0.0;
+	for (int ix = 0; ix < 9; ix++) {
+		result[ix] = glm::vec3(
+			float(sums[ix * 3 + 0] * normalize),
+			float(sums[ix * 3 + 1] * normalize),
+			float(sums[ix * 3 + 2] * normalize)) * BAND_SCALE[ix];
+	}
+}
+
+// Bilinear sample within a single face, clamped at the edges
+static glm::vec3 SampleFace(const float* const planes[3], uint32_t size, float u, float v) {
+	float x = u * size - 0.5f;
+	float y = v * size - 0.5f;
+	int x0 = (int)floorf(x);
+	int y0 = (int)floorf(y);
+	float fx = x - x0;
+	float fy = y - y0;
+	int maxIndex = (int)size - 1;
+	int x1 = glm::clamp(x0 + 1, 0, maxIndex);
+	int y1 = glm::clamp(y0 + 1, 0, maxIndex);
+	x0 = glm::clamp(x0, 0, maxIndex);
+	y0 = glm::clamp(y0, 0, maxIndex);
+
+	size_t i00 = (size_t)y0 * size + x0;
+	size_t i10 = (size_t)y0 * size + x1;
+	size_t i01 = (size_t)y1 * size + x0;
+	size_t i11 = (size_t)y1 * size + x1;
+	glm::vec3 result;
+	for (int c = 0; c < 3; c++) {
+		const float* p = planes[c];
+		float top = p[i00] + (p[i10] - p[i00]) * fx;
+		float bottom = p[i01] + (p[i11] - p[i01]) * fx;
+		result[c] = top + (bottom - top) * fy;
+	}
+	return result;
+}
+
+void IBLBaker::_PrefilterSpecular(const FloatCube& cube, const IBLBakeSettings& settings, std::vector<TextureCubeMapData::sptr>& result, bool useSimd, unsigned threads) {
+	// Box filtered copies of the environment, so samples from wide lobes can read a blurrier level instead of aliasing
+	std::vector<FloatCube> levels(1);
+	levels[0] = cube;
+	while (levels.back().Size > 1) {
+		const FloatCube& source = levels.back();
+		FloatCube next;
+		next.Size = source.Size / 2;
+		for (int face = 0; face < 6; face++) {
+			for (int c = 0; c < 3; c++) {
+				const std::vector<float>& from = source.Planes[face][c];
+				std::vector<float>& to = next.Planes[face][c];
+				to.resize((size_t)next.Size * next.Size);
+				for (uint32_t y = 0; y < next.Size; y++) {
+					for (uint32_t x = 0; x < next.Size; x++) {
+						size_t index = (size_t)(y * 2) * source.Size + x * 2;
+						to[(size_t)y * next.Size + x] = 0.25f * (from[index] + from[index + 1] + from[index + source.Size] + from[index + source.Size + 1]);
+					}
+				}
+			}
+		}
+		levels.push_back(std::move(next));
+	}
+	int maxLevel = (int)levels.size() - 1;
+
+	// The sample directions (around +Z), weights and source levels for every output mip
+	struct SampleSet {
+		std::vector<float> X, Y, Z, Weight;
+		std::vector<int> Level;
+	};
+	std::vector<SampleSet> sampleSets(settings.SpecularMips);
+	for (uint32_t mip = 0; mip < settings.SpecularMips; mip++) {
+		SampleSet& set = sampleSets[mip];
+		uint32_t outputSize = glm::max(settings.SpecularSize >> mip, 1u);
+
+		if (mip == 0) {
+			// A perfect mirror only needs the one direction, read from the level closest to our size
+			int level = 0;
+			while (level < maxLevel && levels[level].Size > outputSize) {
+				level++;
+			}
+			set.X.push_back(0.0f);
+			set.Y.push_back(0.0f);
+			set.Z.push_back(1.0f);
+			set.Weight.push_back(1.0f);
+			set.Level.push_back(level);
+		}
+		else {
+			float roughness = float(mip) / float(settings.SpecularMips - 1);
+			float alpha = roughness * roughness;
+			float alpha2 = alpha * alpha;
+			float texelSolidAngle = 4.0f * PI / (6.0f * cube.Size * cube.Size);
+
+			for (uint32_t ix = 0; ix < settings.SampleCount; ix++) {
+				// GGX importance sampling, with N = V = R
+				float phi = 2.0f * PI * (float(ix) / float(settings.SampleCount));
+				float xi = RadicalInverse(ix);
+				float cosTheta = sqrtf((1.0f - xi) / (1.0f + (alpha2 - 1.0f) * xi));
+				float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+				glm::vec3 h = glm::vec3(sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta);
+				glm::vec3 l = 2.0f * cosTheta * h - glm::vec3(0.0f, 0.0f, 1.0f);
+				if (l.z <= 0.0f) {
+					continue;
+				}
+
+				// Pick the source level whose texels are about the size of the area this sample stands for
+				float d = (cosTheta * cosTheta * (alpha2 - 1.0f) + 1.0f);
+				float pdf = alpha2 / (PI * d * d) * 0.25f;
+				float sampleSolidAngle = 1.0f / (settings.SampleCount * pdf + 1e-6f);
+				float lod = 0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1.0f;
+
+				set.X.push_back(l.x);
+				set.Y.push_back(l.y);
+				set.Z.push_back(l.z);
+				set.Weight.push_back(l.z);
+				set.Level.push_back(glm::clamp((int)roundf(lod), 0, maxLevel));
+			}
+		}
+
+		// Pad to a multiple of 4 with samples that don't count
+		while (set.X.size() % 4 != 0) {
+			set.X.push_back(0.0f);
+			set.Y.push_back(0.0f);
+			set.Z.push_back(1.0f);
+			set.Weight.push_back(0.0f);
+			set.Level.push_back(0);
+		}
+	}
+
+	// Output is interleaved RGB so it can be uploaded directly
+	std::vector<std::vector<float>> outputs(settings.SpecularMips);
+	std::vector<uint32_t> firstRow(settings.SpecularMips + 1, 0);
+	for (uint32_t mip = 0; mip < settings.SpecularMips; mip++) {
+		uint32_t outputSize = glm::max(settings.SpecularSize >> mip, 1u);
+		outputs[mip].resize((size_t)outputSize * outputSize * 3 * 6);
+		firstRow[mip + 1] = firstRow[mip] + outputSize * 6;
+	}
+	uint32_t totalRows = firstRow[settings.SpecularMips];
+
+	// Rougher mips cost a lot more per texel, so threads grab rows as they go instead of splitting them up front
+	std::atomic<uint32_t> nextRow(0);
+	auto filterRows = [&]() {
+		float sx[4], sy[4], sz[4];
+		for (uint32_t row = nextRow++; row < totalRows; row = nextRow++) {
+			uint32_t mip = 0;
+			while (row >= firstRow[mip + 1]) {
+				mip++;
+			}
+			uint32_t outputSize = glm::max(settings.SpecularSize >> mip, 1u);
+			uint32_t localRow = row - firstRow[mip];
+			int face = localRow / outputSize;
+			uint32_t y = localRow % outputSize;
+			const SampleSet& set = sampleSets[mip];
+			float* out = outputs[mip].data() + ((size_t)face * outputSize * outputSize + (size_t)y * outputSize) * 3;
+
+			for (uint32_t x = 0; x < outputSize; x++) {
+				float s = (x + 0.5f) * 2.0f / outputSize - 1.0f;
+				float t = (y + 0.5f) * 2.0f / outputSize - 1.0f;
+				glm::vec3 n = glm::normalize(FaceDirection(face, s, t));
+				glm::vec3 up = fabsf(n.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+				glm::vec3 tangent = glm::normalize(glm::cross(up, n));
+				glm::vec3 bitangent = glm::cross(n, tangent);
+
+				glm::vec3 color = glm::vec3(0.0f);
+				float total = 0.0f;
+				for (size_t ix = 0; ix < set.X.size(); ix += 4) {
+					// Rotate 4 samples from around +Z to around the texel's direction
+#ifdef IBL_BAKER_SSE
+					if (useSimd) {
+						__m128 lx = _mm_loadu_ps(&set.X[ix]);
+						__m128 ly = _mm_loadu_ps(&set.Y[ix]);
+						__m128 lz = _mm_loadu_ps(&set.Z[ix]);
+						_mm_storeu_ps(sx, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(tangent.x), lx), _mm_mul_ps(_mm_set1_ps(bitangent.x), ly)), _mm_mul_ps(_mm_set1_ps(n.x), lz)));
+						_mm_storeu_ps(sy, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(tangent.y), lx), _mm_mul_ps(_mm_set1_ps(bitangent.y), ly)), _mm_mul_ps(_mm_set1_ps(n.y), lz)));
+						_mm_storeu_ps(sz, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(tangent.z), lx), _mm_mul_ps(_mm_set1_ps(bitangent.z), ly)), _mm_mul_ps(_mm_set1_ps(n.z), lz)));
+					} else
+#endif
+					{
+						for (int lane = 0; lane < 4; lane++) {
+							glm::vec3 dir = tangent * set.X[ix + lane] + bitangent * set.Y[ix + lane] + n * set.Z[ix + lane];
+							sx[lane] = dir.x;
+							sy[lane] = dir.y;
+							sz[lane] = dir.z;
+						}
+					}
+
+					for (int lane = 0; lane < 4; lane++) {
+						float weight = set.Weight[ix + lane];
+						if (weight <= 0.0f) {
+							continue;
+						}
+						float u, v;
+						int sampleFace = DirectionToFace(glm::vec3(sx[lane], sy[lane], sz[lane]), u, v);
+						const FloatCube& level = levels[set.Level[ix + lane]];
+						const float* planes[3] = { level.Planes[sampleFace][0].data(), level.Planes[sampleFace][1].data(), level.Planes[sampleFace][2].data() };
+						color += SampleFace(planes, level.Size, u, v) * weight;
+						total += weight;
+					}
+				}
+
+				color = total > 0.0f ? color / total : glm::vec3(0.0f);
+				out[x * 3 + 0] = color.r;
+				out[x * 3 + 1] = color.g;
+				out[x * 3 + 2] = color.b;
+			}
+		}
+	};
+
+	threads = threads > 0 ? threads : 1;
+	std::vector<std::thread> workers;
+	for (unsigned t = 1; t < threads; t++) {
+		workers.emplace_back(filterRows);
+	}
+	filterRows();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+
+	result.clear();
+	for (uint32_t mip = 0; mip < settings.SpecularMips; mip++) {
+		uint32_t outputSize = glm::max(settings.SpecularSize >> mip, 1u);
+		result.push_back(std::make_shared<TextureCubeMapData>(outputSize, PixelFormat::RGB, PixelType::Float, outputs[mip].data(), InternalFormat::RGB16F));
+	}
+}
+
+uint64_t IBLBaker::_ComputeKey(const TextureCubeMapData::sptr& environment, const IBLBakeSettings& settings) {
+	uint64_t key = HashBytes(&CACHE_VERSION, sizeof(uint32_t));
+	uint32_t size = environment->GetSize();
+	GLint format = *environment->GetFormat();
+	GLint type = *environment->GetPixelType();
+	key = HashBytes(&size, sizeof(uint32_t), key);
+	key = HashBytes(&format, sizeof(GLint), key);
+	key = HashBytes(&type, sizeof(GLint), key);
+	key = HashBytes(environment->GetDataPtr(), environment->GetDataSize(), key);
+	key = HashBytes(&settings.SpecularSize, sizeof(uint32_t), key);
+	key = HashBytes(&settings.SpecularMips, sizeof(uint32_t), key);
+	key = HashBytes(&settings.SampleCount, sizeof(uint32_t), key);
+	key = HashBytes(&settings.SrgbInput, sizeof(bool), key);
+	return key;
+}
+
+bool IBLBaker::_LoadCached(uint64_t key, const IBLBakeSettings& settings, IBLData& result) {
+	std::stringstream name;
+	name << _cachePath << "/" << std::hex << key << ".ibl";
+	std::ifstream file(name.str(), std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	IBLCacheHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(IBLCacheHeader)) ||
+		header.Magic != CACHE_MAGIC || header.Version != CACHE_VERSION || header.Key != key ||
+		header.SpecularSize != settings.SpecularSize || header.SpecularMips != settings.SpecularMips) {
+		LOG_WARN("Ignoring invalid lighting cache \"{}\"", name.str());
+		return false;
+	}
+
+	if (!file.read(reinterpret_cast<char*>(result.Irradiance), sizeof(glm::vec3) * 9)) {
+		LOG_WARN("Ignoring truncated lighting cache \"{}\"", name.str());
+		return false;
+	}
+
+	result.Specular.clear();
+	std::vector<float> data;
+	for (uint32_t mip = 0; mip < header.SpecularMips; mip++) {
+		uint32_t size = glm::max(header.SpecularSize >> mip, 1u);
+		data.resize((size_t)size * size * 3 * 6);
+		if (!file.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(float))) {
+			LOG_WARN("Ignoring truncated lighting cache \"{}\"", name.str());
+			result.Specular.clear();
+			return false;
+		}
+		result.Specular.push_back(std::make_shared<TextureCubeMapData>(size, PixelFormat::RGB, PixelType::Float, data.data(), InternalFormat::RGB16F));
+	}
+	return true;
+}
+
+void IBLBaker::_SaveCached(uint64_t key, const IBLBakeSettings& settings, const IBLData& data) {
+	std::error_code error;
+	std::filesystem::create_directories(_cachePath, error);
+	std::stringstream name;
+	name << _cachePath << "/" << std::hex << key << ".ibl";
+
+	// Write to a temporary file and move it over, so a crash mid write can't leave a broken cache behind
+	std::string tempName = name.str() + ".tmp";
+	std::ofstream file(tempName, std::ios::binary);
+	if (file.is_open()) {
+		IBLCacheHeader header = { CACHE_MAGIC, CACHE_VERSION, key, settings.SpecularSize, settings.SpecularMips };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(IBLCacheHeader));
+		file.write(reinterpret_cast<const char*>(data.Irradiance), sizeof(glm::vec3) * 9);
+		for (const TextureCubeMapData::sptr& mip : data.Specular) {
+			file.write(static_cast<const char*>(mip->GetDataPtr()), mip->GetDataSize());
+		}
+		file.close();
+		std::filesystem::rename(tempName, name.str(), error);
+	}
+	if (!file || error) {
+		LOG_WARN("Failed to write lighting cache \"{}\"", name.str());
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Makes a float cubemap where every texel's color comes from its direction
+static TextureCubeMapData::sptr MakeEnvironment(uint32_t size, const std::function<glm::vec3(const glm::vec3&)>& radiance) {
+	std::vector<float> data((size_t)size * size * 3 * 6);
+	for (int face = 0; face < 6; face++) {
+		for (uint32_t y = 0; y < size; y++) {
+			for (uint32_t x = 0; x < size; x++) {
+				glm::vec3 dir = glm::normalize(FaceDirection(face, (x + 0.5f) * 2.0f / size - 1.0f, (y + 0.5f) * 2.0f / size - 1.0f));
+				glm::vec3 color = radiance(dir);
+				size_t index = (((size_t)face * size + y) * size + x) * 3;
+				data[index + 0] = color.r;
+				data[index + 1] = color.g;
+				data[index + 2] = color.b;
+			}
+		}
+	}
+	TextureCubeMapData::sptr result = std::make_shared<TextureCubeMapData>(size, PixelFormat::RGB, PixelType::Float, data.data());
+	result->DebugName = "IBL Test Environment";
+	return result;
+}
+
+static float MaxDifference(const TextureCubeMapData::sptr& a, const TextureCubeMapData::sptr& b) {
+	const float* pa = static_cast<const float*>(a->GetDataPtr());
+	const float* pb = static_cast<const float*>(b->GetDataPtr());
+	size_t count = a->GetDataSize() / sizeof(float);
+	float result = 0.0f;
+	for (size_t ix = 0; ix < count; ix++) {
+		result = glm::max(result, fabsf(pa[ix] - pb[ix]));
+	}
+	return result;
+}
+
+bool IBLBaker::SelfTest() {
+	bool passed = true;
+	bool cacheEnabled = _cacheEnabled;
+	unsigned threadCount = _threadCount;
+	_cacheEnabled = false;
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> positive(0.0f, 1.0f);
+	auto randomNormal = [&]() {
+		glm::vec3 n = glm::vec3(unit(rng), unit(rng), unit(rng));
+		return glm::length(n) > 0.01f ? glm::normalize(n) : glm::vec3(0.0f, 0.0f, 1.0f);
+	};
+
+	// A linear environment L(d) = a + b.d is exactly represented, and its irradiance / pi is a + 2/3 b.n
+	const glm::vec3 a = glm::vec3(0.5f, 0.25f, 0.75f);
+	const glm::vec3 b = glm::vec3(0.2f, -0.1f, 0.3f);
+	TextureCubeMapData::sptr linear = MakeEnvironment(32, [&](const glm::vec3& d) { return a + glm::vec3(glm::dot(b, d)); });
+	IBLData irradiance;
+	ProjectIrradiance(linear, false, irradiance.Irradiance, true);
+	float linearError = 0.0f;
+	for (int ix = 0; ix < 64; ix++) {
+		glm::vec3 n = randomNormal();
+		glm::vec3 expected = a + glm::vec3(glm::dot(b, n) * 2.0f / 3.0f);
+		linearError = glm::max(linearError, glm::length(irradiance.EvaluateIrradiance(n) - expected));
+	}
+	if (linearError > 5e-3f) {
+		LOG_ERROR("IBL self test failed: irradiance of a linear environment is off by {}", linearError);
+		passed = false;
+	}
+
+	// SIMD and scalar paths should agree on a noisy environment (with a size that leaves a scalar tail)
+	std::vector<float> noiseData((size_t)37 * 37 * 3 * 6);
+	for (float& value : noiseData) {
+		value = positive(rng) * 4.0f;
+	}
+	TextureCubeMapData::sptr noise = std::make_shared<TextureCubeMapData>(37, PixelFormat::RGB, PixelType::Float, noiseData.data());
+	glm::vec3 simd[9], scalar[9];
+	ProjectIrradiance(noise, false, simd, true);
+	ProjectIrradiance(noise, false, scalar, false);
+	float simdError = 0.0f;
+	for (int ix = 0; ix < 9; ix++) {
+		simdError = glm::max(simdError, glm::length(simd[ix] - scalar[ix]));
+	}
+	if (simdError > 1e-4f) {
+		LOG_ERROR("IBL self test failed: SIMD irradiance differs from scalar by {}", simdError);
+		passed = false;
+	}
+
+	// A constant environment stays constant at every roughness
+	IBLBakeSettings settings;
+	settings.SpecularSize = 16;
+	settings.SpecularMips = 5;
+	settings.SampleCount = 64;
+	TextureCubeMapData::sptr constant = MakeEnvironment(32, [&](const glm::vec3&) { return a; });
+	IBLData::sptr constantBake = Bake(constant, settings);
+	for (size_t mip = 0; mip < constantBake->Specular.size(); mip++) {
+		const float* data = static_cast<const float*>(constantBake->Specular[mip]->GetDataPtr());
+		size_t count = constantBake->Specular[mip]->GetDataSize() / sizeof(float);
+		float error = 0.0f;
+		for (size_t ix = 0; ix < count; ix++) {
+			error = glm::max(error, fabsf(data[ix] - a[ix % 3]));
+		}
+		if (error > 1e-4f) {
+			LOG_ERROR("IBL self test failed: mip {} of a constant environment is off by {}", mip, error);
+			passed = false;
+		}
+	}
+
+	// Mip 0 at the source size is a straight copy, and the threaded and SIMD bake matches a single scalar thread exactly
+	settings.SpecularSize = 37;
+	settings.SpecularMips = 4;
+	IBLData::sptr threaded = Bake(noise, settings);
+	FloatCube noiseCube;
+	_ConvertToFloat(noise, false, noiseCube);
+	std::vector<TextureCubeMapData::sptr> reference;
+	_PrefilterSpecular(noiseCube, settings, reference, false, 1);
+
+	float copyError = MaxDifference(threaded->Specular[0], noise);
+	if (copyError > 1e-4f) {
+		LOG_ERROR("IBL self test failed: mip 0 differs from the environment by {}", copyError);
+		passed = false;
+	}
+	for (size_t mip = 0; mip < reference.size(); mip++) {
+		float error = MaxDifference(threaded->Specular[mip], reference[mip]);
+		if (error > 1e-5f) {
+			LOG_ERROR("IBL self test failed: threaded mip {} differs from the reference by {}", mip, error);
+			passed = false;
+		}
+	}
+
+	// What goes into the cache has to come back out the same, and the second bake should come from it
+	std::string cachePath = _cachePath;
+	_cachePath = (std::filesystem::temp_directory_path() / "ibl_cache_selftest").string();
+	_cacheEnabled = true;
+	IBLData::sptr stored = Bake(noise, settings);
+	IBLData::sptr loaded = Bake(noise, settings);
+	if (loaded == nullptr || !_lastStats.FromCache) {
+		LOG_ERROR("IBL self test failed: second bake didn't come from the cache");
+		passed = false;
+	}
+	else {
+		bool same = memcmp(stored->Irradiance, loaded->Irradiance, sizeof(glm::vec3) * 9) == 0 && stored->Specular.size() == loaded->Specular.size();
+		for (size_t mip = 0; same && mip < stored->Specular.size(); mip++) {
+			same = memcmp(stored->Specular[mip]->GetDataPtr(), loaded->Specular[mip]->GetDataPtr(), stored->Specular[mip]->GetDataSize()) == 0;
+		}
+		if (!same) {
+			LOG_ERROR("IBL self test failed: cached bake doesn't match the original");
+			passed = false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::remove_all(_cachePath, error);
+	_cachePath = cachePath;
+
+	_cacheEnabled = cacheEnabled;
+	_threadCount = threadCount;
+	if (passed) {
+		LOG_INFO("IBL self test passed (linear irradiance error {:.5f}, SIMD vs scalar {:.7f})", linearError, simdError);
+	}
+	return passed;
+}
+
+void IBLBaker::RunBenchmark(uint32_t environmentSize) {
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> positive(0.0f, 1.0f);
+	std::vector<float> data((size_t)environmentSize * environmentSize * 3 * 6);
+	for (float& value : data) {
+		value = positive(rng);
+	}
+	TextureCubeMapData::sptr environment = std::make_shared<TextureCubeMapData>(environmentSize, PixelFormat::RGB, PixelType::Float, data.data());
+
+	FloatCube cube;
+	_ConvertToFloat(environment, false, cube);
+	IBLBakeSettings settings;
+	glm::vec3 sh[9];
+	std::vector<TextureCubeMapData::sptr> specular;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	_ProjectIrradiance(cube, sh, false, 1);
+	double scalarIrradiance = MillisecondsSince(start);
+	start = std::chrono::high_resolution_clock::now();
+	_ProjectIrradiance(cube, sh, true, _threadCount);
+	double fastIrradiance = MillisecondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	_PrefilterSpecular(cube, settings, specular, false, 1);
+	double scalarSpecular = MillisecondsSince(start);
+	start = std::chrono::high_resolution_clock::now();
+	_PrefilterSpecular(cube, settings, specular, true, _threadCount);
+	double fastSpecular = MillisecondsSince(start);
+
+	LOG_INFO("IBL benchmark, {}x{} environment, {} threads:", environmentSize, environmentSize, _threadCount);
+	LOG_INFO("\tIrradiance: {:.2f} ms scalar, {:.2f} ms SIMD + threads ({:.1f}x)", scalarIrradiance, fastIrradiance, scalarIrradiance / fastIrradiance);
+	LOG_INFO("\tSpecular ({}x{}, {} mips, {} samples): {:.1f} ms scalar, {:.1f} ms SIMD + threads ({:.1f}x)", settings.SpecularSize, settings.SpecularSize,
+		settings.SpecularMips, settings.SampleCount, scalarSpecular, fastSpecular, scalarSpecular / fastSpecular);
+}
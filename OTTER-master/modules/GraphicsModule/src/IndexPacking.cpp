@@ -0,0 +1,184 @@
+#include "IndexPacking.h"
+#include <algorithm>
+
+#include "Logging.h"
+
+namespace {
+	// Small differences either way become small numbers: 0, -1, 1, -2, 2... go to 0, 1, 2, 3, 4...
+	uint64_t ZigZag(int64_t value) {
+		return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+	}
+
+	int64_t UnZigZag(uint64_t value) {
+		return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	}
+
+	// 7 bits a byte, the high bit set on every byte but the last
+	size_t VarIntSize(uint64_t value) {
+		size_t result = 1;
+		while (value >= 0x80) {
+			value >>= 7;
+			result++;
+		}
+		return result;
+	}
+
+	void WriteVarInt(std::vector<uint8_t>& out, uint64_t value) {
+		while (value >= 0x80) {
+			out.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	bool ReadVarInt(const uint8_t* data, size_t size, size_t& offset, uint64_t& value) {
+		value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (offset >= size) {
+				return false;
+			}
+			uint8_t byte = data[offset++];
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// What the encoder and decoder both know going into each index
+	struct CodecState {
+		// The index before this one
+		uint32_t Last = 0;
+		// One past the highest index so far, so the next new vertex in first-use order
+		uint32_t Next = 0;
+
+		uint64_t Code(uint32_t index) const {
+			return index == Next ? 0 : ZigZag(int64_t(index) - int64_t(Last)) + 1;
+		}
+
+		void Advance(uint32_t index) {
+			Last = index;
+			Next = std::max(Next, index + 1);
+		}
+	};
+}
+
+std::vector<uint16_t> IndexPacking::Narrow(const std::vector<uint32_t>& indices) {
+	std::vector<uint16_t> result(indices.size());
+	for (size_t ix = 0; ix < indices.size(); ix++) {
+		LOG_ASSERT(indices[ix] < MAX_16BIT_VERTICES, "Index {} doesn't fit in 16 bits!", indices[ix]);
+		result[ix] = static_cast<uint16_t>(indices[ix]);
+	}
+	return result;
+}
+
+void IndexPacking::Split(const std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& vertexSources,
+	std::vector<uint16_t>& localIndices, std::vector<VertexArrayObject::SubMesh>& subMeshes, size_t maxVertices) {
+	vertexSources.clear();
+	localIndices.clear();
+	subMeshes.clear();
+	localIndices.reserve(indices.size());
+	vertexSources.reserve(vertexCount);
+	maxVertices = std::max<size_t>(std::min(maxVertices, MAX_16BIT_VERTICES), 3);
+
+	// Where each source vertex sits in the current sub-mesh, stamped with the sub-mesh so starting a new one
+	// doesn't mean clearing the whole thing
+	std::vector<uint32_t> local(vertexCount, 0);
+	std::vector<uint32_t> stamp(vertexCount, UINT32_MAX);
+	VertexArrayObject::SubMesh current = { 0, 0, 0 };
+	uint32_t subMesh = 0;
+
+	const size_t triangleCount = indices.size() / 3;
+	for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+		const uint32_t* corners = &indices[triangle * 3];
+		size_t added = 0;
+		for (int k = 0; k < 3; k++) {
+			bool repeated = (k > 0 && corners[k] == corners[0]) || (k > 1 && corners[k] == corners[1]);
+			added += stamp[corners[k]] != subMesh && !repeated ? 1 : 0;
+		}
+		// Start a new sub-mesh once this triangle won't fit
+		size_t used = vertexSources.size() - current.BaseVertex;
+		if (used + added > maxVertices) {
+			subMeshes.push_back(current);
+			current.FirstIndex = static_cast<GLsizei>(localIndices.size());
+			current.IndexCount = 0;
+			current.BaseVertex = static_cast<GLint>(vertexSources.size());
+			subMesh++;
+		}
+		for (int k = 0; k < 3; k++) {
+			uint32_t vertex = corners[k];
+			if (stamp[vertex] != subMesh) {
+				stamp[vertex] = subMesh;
+				local[vertex] = static_cast<uint32_t>(vertexSources.size() - current.BaseVertex);
+				vertexSources.push_back(vertex);
+			}
+			localIndices.push_back(static_cast<uint16_t>(local[vertex]));
+		}
+		current.IndexCount += 3;
+	}
+	if (current.IndexCount > 0) {
+		subMeshes.push_back(current);
+	}
+}
+
+std::vector<uint8_t> IndexPacking::Encode(const uint32_t* indices, size_t count) {
+	std::vector<uint8_t> result;
+	result.reserve(count + count / 4);
+	CodecState state;
+
+	const size_t triangleCount = count / 3;
+	for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+		const uint32_t* corners = indices + triangle * 3;
+
+		// Try starting from each corner, keeping the winding, and go with the smallest
+		int best = 0;
+		size_t bestSize = SIZE_MAX;
+		for (int rotation = 0; rotation < 3; rotation++) {
+			CodecState trial = state;
+			size_t size = 0;
+			for (int k = 0; k < 3; k++) {
+				uint32_t index = corners[(rotation + k) % 3];
+				size += VarIntSize(trial.Code(index));
+				trial.Advance(index);
+			}
+			if (size < bestSize) {
+				best = rotation;
+				bestSize = size;
+			}
+		}
+
+		for (int k = 0; k < 3; k++) {
+			uint32_t index = corners[(best + k) % 3];
+			WriteVarInt(result, state.Code(index));
+			state.Advance(index);
+		}
+	}
+
+	// Anything that isn't a whole triangle goes as it is
+	for (size_t ix = triangleCount * 3; ix < count; ix++) {
+		WriteVarInt(result, state.Code(indices[ix]));
+		state.Advance(indices[ix]);
+	}
+	return result;
+}
+
+bool IndexPacking::Decode(const uint8_t* data, size_t size, size_t count, size_t vertexCount, std::vector<uint32_t>& indices) {
+	indices.clear();
+	indices.reserve(count);
+	CodecState state;
+	size_t offset = 0;
+	for (size_t ix = 0; ix < count; ix++) {
+		uint64_t code;
+		if (!ReadVarInt(data, size, offset, code)) {
+			return false;
+		}
+		int64_t index = code == 0 ? int64_t(state.Next) : int64_t(state.Last) + UnZigZag(code - 1);
+		if (index < 0 || index >= int64_t(vertexCount)) {
+			return false;
+		}
+		indices.push_back(static_cast<uint32_t>(index));
+		state.Advance(static_cast<uint32_t>(index));
+	}
+	return offset == size;
+}
@@ -0,0 +1,116 @@
+#include "MeshFile.h"
+#include <filesystem>
+#include <fstream>
+
+#include "IndexPacking.h"
+#include "Logging.h"
+
+namespace {
+	struct MeshFileHeader {
+		char     Magic[4];
+		uint32_t Version;
+		// MeshFile::LayoutId of the vertex type the file was saved from
+		uint32_t Layout;
+		uint32_t VertexSize;
+		uint32_t VertexCount;
+		uint32_t IndexCount;
+		// The size of the compressed indices, in bytes
+		uint32_t IndexDataSize;
+	};
+
+	const char MAGIC[4] = { 'O', 'M', 'S', 'H' };
+
+	// 32 bit FNV-1a, continuing from a previous hash
+	uint32_t HashBytes(const void* data, size_t size, uint32_t hash = 2166136261u) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t ix = 0; ix < size; ix++) {
+			hash ^= bytes[ix];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	template <typename T>
+	uint32_t HashValue(const T& value, uint32_t hash) {
+		return HashBytes(&value, sizeof(T), hash);
+	}
+}
+
+uint32_t MeshFile::LayoutId(const std::vector<BufferAttribute>& layout, size_t vertexSize) {
+	// Field by field, since the struct's padding isn't guaranteed to be zeroed
+	uint32_t hash = HashValue(static_cast<uint64_t>(vertexSize), 2166136261u);
+	for (const BufferAttribute& attribute : layout) {
+		hash = HashValue(attribute.Slot, hash);
+		hash = HashValue(attribute.Size, hash);
+		hash = HashValue(attribute.Type, hash);
+		hash = HashValue(attribute.Normalized, hash);
+		hash = HashValue(attribute.Stride, hash);
+		hash = HashValue(static_cast<uint64_t>(attribute.Offset), hash);
+		hash = HashValue(attribute.Usage, hash);
+		hash = HashValue(attribute.Integer, hash);
+	}
+	return hash;
+}
+
+bool MeshFile::Write(const std::string& path, uint32_t layout, const void* vertices, size_t vertexSize, size_t vertexCount, const uint32_t* indices, size_t indexCount) {
+	std::vector<uint8_t> indexData = IndexPacking::Encode(indices, indexCount);
+
+	MeshFileHeader header;
+	memcpy(header.Magic, MAGIC, sizeof(MAGIC));
+	header.Version = VERSION;
+	header.Layout = layout;
+	header.VertexSize = static_cast<uint32_t>(vertexSize);
+	header.VertexCount = static_cast<uint32_t>(vertexCount);
+	header.IndexCount = static_cast<uint32_t>(indexCount);
+	header.IndexDataSize = static_cast<uint32_t>(indexData.size());
+
+	// Write to a temporary file and move it over, so a crash mid write can't leave a truncated mesh behind
+	std::string tempPath = path + ".tmp";
+	std::ofstream file(tempPath, std::ios::binary);
+	if (!file) {
+		LOG_WARN("Could not write mesh file {}", path);
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(vertices), vertexSize * vertexCount);
+	file.write(reinterpret_cast<const char*>(indexData.data()), indexData.size());
+	file.close();
+
+	std::error_code error;
+	if (file) {
+		std::filesystem::rename(tempPath, path, error);
+	}
+	if (!file || error) {
+		LOG_WARN("Could not write mesh file {}", path);
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
+
+bool MeshFile::Read(const std::string& path, uint32_t layout, size_t vertexSize, std::vector<uint8_t>& vertices, std::vector<uint32_t>& indices) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	MeshFileHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || memcmp(header.Magic, MAGIC, sizeof(MAGIC)) != 0) {
+		LOG_WARN("{} isn't a mesh file", path);
+		return false;
+	}
+	if (header.Version != VERSION || header.Layout != layout || header.VertexSize != vertexSize) {
+		LOG_WARN("Mesh file {} is version {} with vertex layout {:08x}, expected version {} with vertex layout {:08x}", path, header.Version, header.Layout, VERSION, layout);
+		return false;
+	}
+
+	vertices.resize(size_t(header.VertexSize) * header.VertexCount);
+	std::vector<uint8_t> indexData(header.IndexDataSize);
+	if (!file.read(reinterpret_cast<char*>(vertices.data()), vertices.size()) ||
+		!file.read(reinterpret_cast<char*>(indexData.data()), indexData.size()) ||
+		!IndexPacking::Decode(indexData.data(), indexData.size(), header.IndexCount, header.VertexCount, indices)) {
+		LOG_WARN("Mesh file {} is cut short or broken", path);
+		return false;
+	}
+	return true;
+}
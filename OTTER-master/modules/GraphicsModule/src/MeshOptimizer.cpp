@@ -0,0 +1,384 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <tuple>
+
+#include "Logging.h"
+#include "ObjLoader.h"
+
+namespace {
+	// Positions are read out of interleaved vertices
+	const glm::vec3& PositionAt(const glm::vec3* positions, size_t stride, uint32_t vertex) {
+		return *reinterpret_cast<const glm::vec3*>(reinterpret_cast<const uint8_t*>(positions) + vertex * stride);
+	}
+
+	bool IndicesInRange(const std::vector<uint32_t>& indices, size_t vertexCount) {
+		return std::all_of(indices.begin(), indices.end(), [&](uint32_t index) { return index < vertexCount; });
+	}
+
+	// A FIFO cache kept as the time each vertex went in, a vertex is still cached until cacheSize more have gone in
+	// after it. Bumping the time past the cache size empties it without touching every vertex
+	struct CacheSimulator {
+		std::vector<uint32_t> Timestamps;
+		uint32_t Time;
+		uint32_t Size;
+
+		CacheSimulator(size_t vertexCount, uint32_t cacheSize) :
+			Timestamps(vertexCount, 0), Time(cacheSize + 1), Size(cacheSize) {}
+
+		// True if the vertex had to be transformed
+		bool Access(uint32_t vertex) {
+			if (Time - Timestamps[vertex] > Size) {
+				Timestamps[vertex] = Time++;
+				return true;
+			}
+			return false;
+		}
+
+		void Clear() {
+			Time += Size + 1;
+		}
+	};
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+	VertexCacheStats result;
+	CacheSimulator cache(vertexCount, cacheSize);
+	std::vector<bool> used(vertexCount, false);
+	size_t usedCount = 0;
+	for (size_t ix = 0; ix < indexCount; ix++) {
+		uint32_t vertex = indices[ix];
+		if (vertex >= vertexCount) {
+			continue;
+		}
+		if (!used[vertex]) {
+			used[vertex] = true;
+			usedCount++;
+		}
+		if (cache.Access(vertex)) {
+			result.Misses++;
+		}
+	}
+	result.ACMR = indexCount >= 3 ? float(result.Misses) / float(indexCount / 3) : 0.0f;
+	result.ATVR = usedCount > 0 ? float(result.Misses) / float(usedCount) : 0.0f;
+	return result;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>* clusters) {
+	const size_t triangleCount = indices.size() / 3;
+	if (clusters != nullptr) {
+		clusters->clear();
+	}
+	if (triangleCount == 0 || !IndicesInRange(indices, vertexCount)) {
+		return;
+	}
+
+	// Triangles around each vertex, packed into one array
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t ix = 0; ix < triangleCount * 3; ix++) {
+		offsets[indices[ix] + 1]++;
+	}
+	for (size_t ix = 0; ix < vertexCount; ix++) {
+		offsets[ix + 1] += offsets[ix];
+	}
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (uint32_t triangle = 0; triangle < triangleCount; triangle++) {
+		for (int k = 0; k < 3; k++) {
+			adjacency[fill[indices[triangle * 3 + k]]++] = triangle;
+		}
+	}
+
+	// Triangles each vertex has left to emit
+	std::vector<uint32_t> live(vertexCount);
+	for (size_t ix = 0; ix < vertexCount; ix++) {
+		live[ix] = offsets[ix + 1] - offsets[ix];
+	}
+	std::vector<bool> emitted(triangleCount, false);
+	// Vertices used recently, to go back to when a fan runs out
+	std::vector<uint32_t> deadEnds;
+	deadEnds.reserve(triangleCount * 3);
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> result;
+	result.reserve(triangleCount * 3);
+	CacheSimulator cache(vertexCount, cacheSize);
+	size_t cursor = 0;
+
+	int64_t fan = indices[0];
+	if (clusters != nullptr) {
+		clusters->push_back(0);
+	}
+	while (fan >= 0) {
+		// Emit every triangle left around the fanning vertex
+		candidates.clear();
+		for (uint32_t ix = offsets[fan]; ix < offsets[fan + 1]; ix++) {
+			uint32_t triangle = adjacency[ix];
+			if (emitted[triangle]) {
+				continue;
+			}
+			for (int k = 0; k < 3; k++) {
+				uint32_t vertex = indices[triangle * 3 + k];
+				result.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				live[vertex]--;
+				cache.Access(vertex);
+			}
+			emitted[triangle] = true;
+		}
+
+		// Fan around whichever vertex we just used will still be cached after all of its triangles are emitted,
+		// preferring the ones that went in the cache first (they'd be the first to fall out). Ones that won't
+		// stay cached get priority 0 and never win, so we fall back to the dead-end stack like Tipsify does
+		fan = -1;
+		int64_t best = 0;
+		for (uint32_t vertex : candidates) {
+			if (live[vertex] == 0) {
+				continue;
+			}
+			int64_t priority = 0;
+			uint32_t age = cache.Time - cache.Timestamps[vertex];
+			if (age + 2 * live[vertex] <= cacheSize) {
+				priority = age;
+			}
+			if (priority > best) {
+				best = priority;
+				fan = vertex;
+			}
+		}
+		if (fan >= 0) {
+			continue;
+		}
+
+		// Dead end, go back to the most recent vertex that still has triangles, or the next one in the mesh
+		while (!deadEnds.empty() && fan < 0) {
+			uint32_t vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (live[vertex] > 0) {
+				fan = vertex;
+			}
+		}
+		for (; cursor < vertexCount && fan < 0; cursor++) {
+			if (live[cursor] > 0) {
+				fan = cursor;
+			}
+		}
+		// Anything after a restart can be drawn in any order against what came before
+		if (fan >= 0 && clusters != nullptr) {
+			clusters->push_back(static_cast<uint32_t>(result.size() / 3));
+		}
+	}
+
+	indices.swap(result);
+}
+
+size_t MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, size_t vertexCount, const glm::vec3* positions, size_t stride, const std::vector<uint32_t>& clusters, float threshold, uint32_t cacheSize) {
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0 || clusters.empty() || !IndicesInRange(indices, vertexCount)) {
+		return 0;
+	}
+
+	// Split the clusters further wherever they're already about as cache friendly as the whole mesh, the cache
+	// starts empty at each split since the sort can put anything in front of them
+	const float target = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount, cacheSize).ACMR * threshold;
+	std::vector<uint32_t> starts;
+	CacheSimulator cache(vertexCount, cacheSize);
+	for (size_t ix = 0; ix < clusters.size(); ix++) {
+		size_t begin = clusters[ix];
+		size_t end = ix + 1 < clusters.size() ? clusters[ix + 1] : triangleCount;
+		size_t start = begin;
+		size_t misses = 0;
+		starts.push_back(static_cast<uint32_t>(begin));
+		cache.Clear();
+		for (size_t triangle = begin; triangle < end; triangle++) {
+			for (int k = 0; k < 3; k++) {
+				misses += cache.Access(indices[triangle * 3 + k]) ? 1 : 0;
+			}
+			if (triangle + 1 < end && float(misses) <= target * float(triangle - start + 1)) {
+				start = triangle + 1;
+				misses = 0;
+				starts.push_back(static_cast<uint32_t>(start));
+				cache.Clear();
+			}
+		}
+	}
+
+	// Where each cluster sits and faces, area weighted
+	auto triangleCross = [&](size_t triangle) {
+		const glm::vec3& p0 = PositionAt(positions, stride, indices[triangle * 3]);
+		return glm::cross(PositionAt(positions, stride, indices[triangle * 3 + 1]) - p0, PositionAt(positions, stride, indices[triangle * 3 + 2]) - p0);
+	};
+	auto triangleCenter = [&](size_t triangle) {
+		return (PositionAt(positions, stride, indices[triangle * 3]) + PositionAt(positions, stride, indices[triangle * 3 + 1]) + PositionAt(positions, stride, indices[triangle * 3 + 2])) / 3.0f;
+	};
+
+	struct Cluster {
+		uint32_t Start;
+		uint32_t End;
+		glm::vec3 Center;
+		glm::vec3 Normal;
+		float Sort;
+	};
+	std::vector<Cluster> sorted(starts.size());
+	glm::vec3 meshCenter = glm::vec3(0.0f);
+	float meshArea = 0.0f;
+	for (size_t ix = 0; ix < starts.size(); ix++) {
+		Cluster& cluster = sorted[ix];
+		cluster.Start = starts[ix];
+		cluster.End = ix + 1 < starts.size() ? starts[ix + 1] : static_cast<uint32_t>(triangleCount);
+		cluster.Center = glm::vec3(0.0f);
+		cluster.Normal = glm::vec3(0.0f);
+		float area = 0.0f;
+		for (uint32_t triangle = cluster.Start; triangle < cluster.End; triangle++) {
+			glm::vec3 cross = triangleCross(triangle);
+			float triangleArea = glm::length(cross);
+			cluster.Center += triangleCenter(triangle) * triangleArea;
+			cluster.Normal += cross;
+			area += triangleArea;
+		}
+		meshCenter += cluster.Center;
+		meshArea += area;
+		cluster.Center = area > 0.0f ? cluster.Center / area : triangleCenter(cluster.Start);
+	}
+	meshCenter = meshArea > 0.0f ? meshCenter / meshArea : glm::vec3(0.0f);
+
+	// Clusters out on the surface facing away from the center cover the most, so they go first
+	for (Cluster& cluster : sorted) {
+		float length = glm::length(cluster.Normal);
+		cluster.Sort = length > 0.0f ? glm::dot(cluster.Center - meshCenter, cluster.Normal / length) : 0.0f;
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.Sort > b.Sort; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (const Cluster& cluster : sorted) {
+		result.insert(result.end(), indices.begin() + cluster.Start * 3, indices.begin() + cluster.End * 3);
+	}
+	indices.swap(result);
+	return sorted.size();
+}
+
+std::vector<uint32_t> MeshOptimizer::OptimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount) {
+	std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	uint32_t next = 0;
+	for (uint32_t& index : indices) {
+		if (index >= vertexCount) {
+			continue;
+		}
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = next++;
+		}
+		index = remap[index];
+	}
+	for (uint32_t& target : remap) {
+		if (target == UINT32_MAX) {
+			target = next++;
+		}
+	}
+	return remap;
+}
+
+std::vector<uint32_t> MeshOptimizer::Optimize(std::vector<uint32_t>& indices, size_t vertexCount, const glm::vec3* positions, size_t stride, MeshOptimizeStats* stats) {
+	MeshOptimizeStats info;
+	info.Before = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+	std::vector<uint32_t> remap;
+	if (IndicesInRange(indices, vertexCount)) {
+		std::vector<uint32_t> clusters;
+		OptimizeVertexCache(indices, vertexCount, DEFAULT_CACHE_SIZE, &clusters);
+		info.Clusters = OptimizeOverdraw(indices, vertexCount, positions, stride, clusters);
+		remap = OptimizeVertexFetch(indices, vertexCount);
+	}
+	else {
+		// Left as it is, there's no telling what a broken index was meant to be
+		remap.resize(vertexCount);
+		for (size_t ix = 0; ix < vertexCount; ix++) {
+			remap[ix] = static_cast<uint32_t>(ix);
+		}
+	}
+
+	info.After = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+	if (stats != nullptr) {
+		*stats = info;
+	}
+	return remap;
+}
+
+bool MeshOptimizer::RunBenchmark(const std::vector<std::string>& files) {
+	bool passed = true;
+	typedef std::chrono::high_resolution_clock Clock;
+	auto millisecondsSince = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+	for (const std::string& file : files) {
+		MeshBuilder<VertexPosNormTexCol> mesh;
+		try {
+			mesh = ObjLoader::ParseFile(file, glm::vec4(1.0f), false);
+		}
+		catch (const std::exception&) {
+			LOG_WARN("Mesh optimizer benchmark: couldn't open {}", file);
+			continue;
+		}
+		const size_t vertexCount = mesh.GetVertexCount();
+		std::vector<uint32_t> original(mesh.GetIndexDataPtr(), mesh.GetIndexDataPtr() + mesh.GetIndexCount());
+		std::vector<uint32_t> indices = original;
+		const glm::vec3* positions = &mesh.GetVertexDataPtr()->Position;
+		const size_t stride = sizeof(VertexPosNormTexCol);
+
+		VertexCacheStats before = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+		Clock::time_point start = Clock::now();
+		std::vector<uint32_t> clusters;
+		OptimizeVertexCache(indices, vertexCount, DEFAULT_CACHE_SIZE, &clusters);
+		double cacheTime = millisecondsSince(start);
+		VertexCacheStats tipsify = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+		start = Clock::now();
+		size_t clusterCount = OptimizeOverdraw(indices, vertexCount, positions, stride, clusters);
+		double overdrawTime = millisecondsSince(start);
+		VertexCacheStats sorted = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+		start = Clock::now();
+		std::vector<uint32_t> remap = OptimizeVertexFetch(indices, vertexCount);
+		double fetchTime = millisecondsSince(start);
+
+		// Every triangle has to come out the same (same winding, any starting corner), just somewhere else
+		std::vector<uint32_t> unmap(vertexCount);
+		for (size_t ix = 0; ix < vertexCount; ix++) {
+			unmap[remap[ix]] = static_cast<uint32_t>(ix);
+		}
+		auto canonical = [](uint32_t a, uint32_t b, uint32_t c) {
+			if (b < a && b < c) return std::make_tuple(b, c, a);
+			if (c < a && c < b) return std::make_tuple(c, a, b);
+			return std::make_tuple(a, b, c);
+		};
+		std::vector<std::tuple<uint32_t, uint32_t, uint32_t>> expected, actual;
+		for (size_t ix = 0; ix + 2 < original.size(); ix += 3) {
+			expected.push_back(canonical(original[ix], original[ix + 1], original[ix + 2]));
+			actual.push_back(canonical(unmap[indices[ix]], unmap[indices[ix + 1]], unmap[indices[ix + 2]]));
+		}
+		std::sort(expected.begin(), expected.end());
+		std::sort(actual.begin(), actual.end());
+		if (expected != actual || indices.size() != original.size()) {
+			LOG_ERROR("Mesh optimizer benchmark failed: {} came out with different triangles", file);
+			passed = false;
+		}
+
+		// Vertices should be stored in the order they're first used
+		uint32_t highest = 0;
+		for (size_t ix = 0; ix < indices.size() && passed; ix++) {
+			if (indices[ix] > highest + 1 || (ix == 0 && indices[ix] != 0)) {
+				LOG_ERROR("Mesh optimizer benchmark failed: {} uses vertex {} before {}", file, indices[ix], highest + 1);
+				passed = false;
+			}
+			highest = std::max(highest, indices[ix]);
+		}
+
+		LOG_INFO("{}: {} triangles, {} vertices, {} clusters", file, original.size() / 3, vertexCount, clusterCount);
+		LOG_INFO("  ACMR {:.3f} -> {:.3f} (vertex cache, {:.1f} ms) -> {:.3f} (overdraw, {:.1f} ms)", before.ACMR, tipsify.ACMR, cacheTime, sorted.ACMR, overdrawTime);
+		LOG_INFO("  ATVR {:.3f} -> {:.3f} -> {:.3f}, vertex fetch {:.1f} ms", before.ATVR, tipsify.ATVR, sorted.ATVR, fetchTime);
+	}
+
+	if (passed) {
+		LOG_INFO("Mesh optimizer benchmark passed");
+	}
+	return passed;
+}
@@ -0,0 +1,372 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <queue>
+#include <unordered_map>
+
+namespace {
+	// How much more open edges and seams resist being pulled out of line than faces do
+	constexpr double BOUNDARY_WEIGHT = 10.0;
+	// Collapses that turn a face more than this far (cosine of the angle) count as flipping it
+	constexpr double MIN_NORMAL_DOT = 0.2;
+
+	// Sum of squared distances to a set of planes, as a symmetric 4x4 matrix (only the upper half is kept)
+	struct Quadric {
+		double A2 = 0.0, AB = 0.0, AC = 0.0, AD = 0.0;
+		double B2 = 0.0, BC = 0.0, BD = 0.0;
+		double C2 = 0.0, CD = 0.0;
+		double D2 = 0.0;
+		// Total weight of the planes, so the error can be turned back into a distance
+		double Weight = 0.0;
+
+		static Quadric FromPlane(const glm::dvec3& n, double d, double weight) {
+			Quadric q;
+			q.A2 = n.x * n.x * weight; q.AB = n.x * n.y * weight; q.AC = n.x * n.z * weight; q.AD = n.x * d * weight;
+			q.B2 = n.y * n.y * weight; q.BC = n.y * n.z * weight; q.BD = n.y * d * weight;
+			q.C2 = n.z * n.z * weight; q.CD = n.z * d * weight;
+			q.D2 = d * d * weight;
+			q.Weight = weight;
+			return q;
+		}
+
+		Quadric& operator+=(const Quadric& other) {
+			A2 += other.A2; AB += other.AB; AC += other.AC; AD += other.AD;
+			B2 += other.B2; BC += other.BC; BD += other.BD;
+			C2 += other.C2; CD += other.CD;
+			D2 += other.D2;
+			Weight += other.Weight;
+			return *this;
+		}
+
+		double Evaluate(const glm::dvec3& p) const {
+			double result =
+				A2 * p.x * p.x + 2.0 * AB * p.x * p.y + 2.0 * AC * p.x * p.z + 2.0 * AD * p.x +
+				B2 * p.y * p.y + 2.0 * BC * p.y * p.z + 2.0 * BD * p.y +
+				C2 * p.z * p.z + 2.0 * CD * p.z +
+				D2;
+			// Rounding can push it just under 0
+			return std::max(result, 0.0);
+		}
+	};
+
+	// Moving From onto To, only still valid while neither end has changed since it was queued
+	struct Collapse {
+		double Cost;
+		uint32_t From;
+		uint32_t To;
+		uint32_t FromVersion;
+		uint32_t ToVersion;
+
+		bool operator>(const Collapse& other) const { return Cost > other.Cost; }
+	};
+
+	uint64_t EdgeKey(uint32_t a, uint32_t b) {
+		if (a > b) {
+			std::swap(a, b);
+		}
+		return (static_cast<uint64_t>(a) << 32ul) | static_cast<uint64_t>(b);
+	}
+
+	// Both uses of an edge, stored by the first triangle to reach it
+	struct EdgeUse {
+		uint32_t Triangle;
+		// Render vertices at each end, in the winding order of Triangle
+		uint32_t From;
+		uint32_t To;
+		uint32_t Count;
+		// The faces on either side use different copies of the vertices (a UV or normal seam)
+		bool Seam;
+	};
+}
+
+MeshBuilder<VertexPosNormTexCol> MeshSimplifier::Simplify(const MeshBuilder<VertexPosNormTexCol>& mesh, size_t targetTriangles, SimplifyStats* stats) {
+	const VertexPosNormTexCol* vertices = mesh.GetVertexDataPtr();
+	const uint32_t* indices = mesh.GetIndexDataPtr();
+	const size_t vertexCount = mesh.GetVertexCount();
+	const size_t triangleCount = mesh.GetIndexCount() / 3;
+
+	SimplifyStats info;
+	info.TrianglesIn = triangleCount;
+	info.VerticesIn = vertexCount;
+
+	// Copies of a vertex at the same position (split for UVs or normals) get welded together, the simplifier works on
+	// the welded vertices while each copy keeps its own attributes
+	std::vector<uint32_t> order(vertexCount);
+	std::iota(order.begin(), order.end(), 0u);
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		const glm::vec3& pa = vertices[a].Position;
+		const glm::vec3& pb = vertices[b].Position;
+		if (pa.x != pb.x) return pa.x < pb.x;
+		if (pa.y != pb.y) return pa.y < pb.y;
+		return pa.z < pb.z;
+	});
+	std::vector<uint32_t> weld(vertexCount);
+	std::vector<glm::dvec3> positions;
+	for (size_t ix = 0; ix < vertexCount; ix++) {
+		if (ix == 0 || vertices[order[ix]].Position != vertices[order[ix - 1]].Position) {
+			positions.push_back(glm::dvec3(vertices[order[ix]].Position));
+		}
+		weld[order[ix]] = static_cast<uint32_t>(positions.size() - 1);
+	}
+	const size_t weldedCount = positions.size();
+
+	// Triangles as render vertices, anything that's already degenerate is dropped
+	std::vector<uint32_t> corners;
+	corners.reserve(triangleCount * 3);
+	for (size_t ix = 0; ix < triangleCount; ix++) {
+		uint32_t a = indices[ix * 3], b = indices[ix * 3 + 1], c = indices[ix * 3 + 2];
+		if (a >= vertexCount || b >= vertexCount || c >= vertexCount) {
+			continue;
+		}
+		if (weld[a] == weld[b] || weld[b] == weld[c] || weld[c] == weld[a]) {
+			continue;
+		}
+		corners.push_back(a);
+		corners.push_back(b);
+		corners.push_back(c);
+	}
+	const uint32_t faceCount = static_cast<uint32_t>(corners.size() / 3);
+	size_t aliveTriangles = faceCount;
+	std::vector<bool> dead(faceCount, false);
+
+	auto corner = [&](uint32_t face, int k) { return weld[corners[face * 3 + k]]; };
+	auto hasVertex = [&](uint32_t face, uint32_t vertex) {
+		return corner(face, 0) == vertex || corner(face, 1) == vertex || corner(face, 2) == vertex;
+	};
+	auto faceNormal = [&](uint32_t face) {
+		const glm::dvec3& p0 = positions[corner(face, 0)];
+		return glm::cross(positions[corner(face, 1)] - p0, positions[corner(face, 2)] - p0);
+	};
+
+	// The planes of the faces around each vertex, weighted by area so big faces count for more
+	std::vector<Quadric> quadrics(weldedCount);
+	for (uint32_t face = 0; face < faceCount; face++) {
+		glm::dvec3 cross = faceNormal(face);
+		double area = glm::length(cross);
+		if (area <= 0.0) {
+			continue;
+		}
+		glm::dvec3 normal = cross / area;
+		Quadric plane = Quadric::FromPlane(normal, -glm::dot(normal, positions[corner(face, 0)]), area * 0.5);
+		for (int k = 0; k < 3; k++) {
+			quadrics[corner(face, k)] += plane;
+		}
+	}
+
+	// Open edges and seams also get a plane standing up from the face along the edge, so collapses slide along
+	// them instead of pulling the outline (or the UV layout) in
+	std::unordered_map<uint64_t, EdgeUse> edges;
+	edges.reserve(corners.size());
+	for (uint32_t face = 0; face < faceCount; face++) {
+		for (int k = 0; k < 3; k++) {
+			uint32_t from = corners[face * 3 + k];
+			uint32_t to = corners[face * 3 + (k + 1) % 3];
+			auto [it, inserted] = edges.try_emplace(EdgeKey(weld[from], weld[to]), EdgeUse{ face, from, to, 0, false });
+			it->second.Count++;
+			// The face on the other side runs the edge the other way, with the same copies unless there's a seam
+			if (!inserted && (it->second.From != to || it->second.To != from)) {
+				it->second.Seam = true;
+			}
+		}
+	}
+	for (const auto& [key, edge] : edges) {
+		if (edge.Count == 2 && !edge.Seam) {
+			continue;
+		}
+		const glm::dvec3& p0 = positions[weld[edge.From]];
+		glm::dvec3 along = positions[weld[edge.To]] - p0;
+		glm::dvec3 normal = glm::cross(along, faceNormal(edge.Triangle));
+		double length = glm::length(normal);
+		if (length <= 0.0) {
+			continue;
+		}
+		normal /= length;
+		Quadric plane = Quadric::FromPlane(normal, -glm::dot(normal, p0), glm::dot(along, along) * BOUNDARY_WEIGHT);
+		quadrics[weld[edge.From]] += plane;
+		quadrics[weld[edge.To]] += plane;
+	}
+
+	// Faces around each vertex
+	std::vector<std::vector<uint32_t>> around(weldedCount);
+	for (uint32_t face = 0; face < faceCount; face++) {
+		for (int k = 0; k < 3; k++) {
+			around[corner(face, k)].push_back(face);
+		}
+	}
+
+	std::vector<uint32_t> versions(weldedCount, 0);
+	std::vector<bool> removed(weldedCount, false);
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+	// Queues whichever way round the edge is cheaper to collapse
+	auto queueEdge = [&](uint32_t a, uint32_t b) {
+		Quadric q = quadrics[a];
+		q += quadrics[b];
+		double toB = q.Evaluate(positions[b]);
+		double toA = q.Evaluate(positions[a]);
+		if (toB <= toA) {
+			queue.push({ toB, a, b, versions[a], versions[b] });
+		}
+		else {
+			queue.push({ toA, b, a, versions[b], versions[a] });
+		}
+	};
+	for (const auto& [key, edge] : edges) {
+		queueEdge(static_cast<uint32_t>(key >> 32ul), static_cast<uint32_t>(key & 0xFFFFFFFFul));
+	}
+
+	std::vector<uint32_t> fromNeighbours;
+	std::vector<uint32_t> toNeighbours;
+	std::vector<std::pair<uint32_t, uint32_t>> copies;
+	auto neighbours = [&](uint32_t vertex, std::vector<uint32_t>& result) {
+		result.clear();
+		for (uint32_t face : around[vertex]) {
+			if (dead[face]) {
+				continue;
+			}
+			for (int k = 0; k < 3; k++) {
+				if (corner(face, k) != vertex) {
+					result.push_back(corner(face, k));
+				}
+			}
+		}
+		std::sort(result.begin(), result.end());
+		result.erase(std::unique(result.begin(), result.end()), result.end());
+	};
+
+	while (aliveTriangles > targetTriangles && !queue.empty()) {
+		Collapse collapse = queue.top();
+		queue.pop();
+		const uint32_t from = collapse.From;
+		const uint32_t to = collapse.To;
+		if (removed[from] || removed[to] || versions[from] != collapse.FromVersion || versions[to] != collapse.ToVersion) {
+			continue;
+		}
+
+		// The ends can only have the vertices across the removed faces in common, anything else would pinch the
+		// surface into something non-manifold
+		size_t sharedFaces = 0;
+		for (uint32_t face : around[from]) {
+			if (!dead[face] && hasVertex(face, to)) {
+				sharedFaces++;
+			}
+		}
+		neighbours(from, fromNeighbours);
+		neighbours(to, toNeighbours);
+		size_t sharedVertices = 0;
+		for (auto a = fromNeighbours.begin(), b = toNeighbours.begin(); a != fromNeighbours.end() && b != toNeighbours.end();) {
+			if (*a < *b) a++;
+			else if (*b < *a) b++;
+			else { sharedVertices++; a++; b++; }
+		}
+		if (sharedFaces == 0 || sharedVertices != sharedFaces) {
+			continue;
+		}
+
+		// Skip it if a face that stays would flip over or get squashed flat
+		bool flips = false;
+		for (uint32_t face : around[from]) {
+			if (dead[face] || hasVertex(face, to)) {
+				continue;
+			}
+			glm::dvec3 before = faceNormal(face);
+			glm::dvec3 p[3];
+			for (int k = 0; k < 3; k++) {
+				p[k] = positions[corner(face, k) == from ? to : corner(face, k)];
+			}
+			glm::dvec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+			double lengths = glm::length(before) * glm::length(after);
+			if (lengths <= 0.0 || glm::dot(before, after) < lengths * MIN_NORMAL_DOT) {
+				flips = true;
+				break;
+			}
+		}
+		if (flips) {
+			continue;
+		}
+
+		// Faces on the edge go away, and tell us which copy of to each copy of from lines up with
+		copies.clear();
+		for (uint32_t face : around[from]) {
+			if (dead[face] || !hasVertex(face, to)) {
+				continue;
+			}
+			uint32_t fromCopy = 0, toCopy = 0;
+			for (int k = 0; k < 3; k++) {
+				if (corner(face, k) == from) fromCopy = corners[face * 3 + k];
+				if (corner(face, k) == to) toCopy = corners[face * 3 + k];
+			}
+			copies.push_back({ fromCopy, toCopy });
+			dead[face] = true;
+			aliveTriangles--;
+		}
+
+		// Copies that line up become that copy of to, so seams stay where they were. The rest keep their attributes and
+		// just move (they're only used by faces around from, so moving them doesn't touch anything else)
+		for (uint32_t face : around[from]) {
+			if (dead[face]) {
+				continue;
+			}
+			for (int k = 0; k < 3; k++) {
+				uint32_t& copy = corners[face * 3 + k];
+				if (weld[copy] != from) {
+					continue;
+				}
+				auto match = std::find_if(copies.begin(), copies.end(), [&](const auto& pair) { return pair.first == copy; });
+				if (match != copies.end()) {
+					copy = match->second;
+				}
+				else {
+					weld[copy] = to;
+				}
+			}
+			around[to].push_back(face);
+		}
+		around[from].clear();
+		around[from].shrink_to_fit();
+		around[to].erase(std::remove_if(around[to].begin(), around[to].end(), [&](uint32_t face) { return dead[face]; }), around[to].end());
+
+		quadrics[to] += quadrics[from];
+		removed[from] = true;
+		versions[to]++;
+		info.Collapses++;
+		if (quadrics[to].Weight > 0.0) {
+			info.MaxError = std::max(info.MaxError, static_cast<float>(std::sqrt(collapse.Cost / quadrics[to].Weight)));
+		}
+
+		// Every edge around to costs something different now
+		neighbours(to, toNeighbours);
+		for (uint32_t neighbour : toNeighbours) {
+			queueEdge(to, neighbour);
+		}
+	}
+
+	// Copy out the faces that are left, with only the vertices they use
+	MeshBuilder<VertexPosNormTexCol> result;
+	std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	result.ReserveIndexSpace(aliveTriangles * 3);
+	for (uint32_t face = 0; face < faceCount; face++) {
+		if (dead[face]) {
+			continue;
+		}
+		uint32_t ix[3];
+		for (int k = 0; k < 3; k++) {
+			uint32_t copy = corners[face * 3 + k];
+			if (remap[copy] == UINT32_MAX) {
+				VertexPosNormTexCol vertex = vertices[copy];
+				vertex.Position = glm::vec3(positions[weld[copy]]);
+				remap[copy] = result.AddVertex(vertex);
+			}
+			ix[k] = remap[copy];
+		}
+		result.AddIndexTri(ix[0], ix[1], ix[2]);
+	}
+
+	info.TrianglesOut = result.GetTriangleCount();
+	info.VerticesOut = result.GetVertexCount();
+	if (stats != nullptr) {
+		*stats = info;
+	}
+	return result;
+}
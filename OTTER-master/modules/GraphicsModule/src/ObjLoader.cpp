@@ -7,8 +7,14 @@
 #include <unordered_map>
 
 #include "StringUtils.h"
+#include "Logging.h"
 
-VertexArrayObject::sptr ObjLoader::LoadFromFile(const std::string& filename, const glm::vec4& inColor)
+VertexArrayObject::sptr ObjLoader::LoadFromFile(const std::string& filename, const glm::vec4& inColor, VertexCompression compression)
+{
+	return ParseFile(filename, inColor).Bake(compression);
+}
+
+MeshBuilder<VertexPosNormTexCol> ObjLoader::ParseFile(const std::string& filename, const glm::vec4& inColor, bool optimize)
 {	
 	// Open our file in binary mode
 	std::ifstream file;
@@ -125,5 +131,13 @@ VertexArrayObject::sptr ObjLoader::LoadFromFile(const std::string& filename, con
 	// You'll need to keep track of these and create vertex entries for each vertex in the face
 	// If you want to get fancy, you can track which vertices you've already added
 
-	return mesh.Bake();
+	// Faces come out of the file in whatever order they were modelled in, and vertices in the order the faces first
+	// used them, so reorder both for the GPU
+	if (optimize) {
+		MeshOptimizeStats stats;
+		mesh.Optimize(&stats);
+		LOG_INFO("Optimized {}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", filename, stats.Before.ACMR, stats.After.ACMR, stats.Before.ATVR, stats.After.ATVR);
+	}
+
+	return mesh;
 }
@@ -2,16 +2,98 @@
 #include "Logging.h"
 #include <fstream>
 #include <sstream>
+#include <chrono>
+#include <filesystem>
+
+bool Shader::_cacheEnabled = true;
+std::string Shader::_cachePath = "shader_cache";
+Shader::CacheStats Shader::_cacheStats;
+std::unordered_map<uint64_t, Shader::ProgramBinary> Shader::_binaries;
+std::unordered_map<uint64_t, Shader::SharedStage> Shader::_stages;
+std::unordered_set<Shader*> Shader::_shaders;
+uint32_t Shader::_registryRevision = 0;
+
+// Header at the start of every cached program binary file
+struct ProgramBinaryHeader {
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t Key;
+	uint32_t Format;
+	uint32_t Size;
+};
+static const uint32_t BINARY_MAGIC = 0x4250544F; // "OTPB"
+static const uint32_t BINARY_VERSION = 1;
+
+// 64 bit FNV-1a, continuing from a previous hash
+static uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t ix = 0; ix < size; ix++) {
+		hash ^= bytes[ix];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+static uint64_t HashString(const std::string& value, uint64_t hash = 14695981039346656037ull) {
+	// Hash the length too, so "ab"+"c" and "a"+"bc" don't collide
+	size_t size = value.size();
+	hash = HashBytes(&size, sizeof(size_t), hash);
+	return HashBytes(value.data(), value.size(), hash);
+}
+
+// Binaries are only valid for the exact driver that produced them
+static const std::string& GetDriverString() {
+	static std::string driver;
+	if (driver.empty()) {
+		const char* vendor = reinterpret_cast<const char*>(glGetString(GL_VENDOR));
+		const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+		const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+		driver = std::string(vendor ? vendor : "") + "|" + (renderer ? renderer : "") + "|" + (version ? version : "");
+	}
+	return driver;
+}
+
+// Some drivers don't support any binary formats, in which case we can only compile from source
+static bool SupportsProgramBinaries() {
+	static int formats = -1;
+	if (formats == -1) {
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	}
+	return formats > 0;
+}
+
+// Inserts the defines right after the #version line, which has to stay first
+static std::string InjectDefines(const std::string& source, const std::string& defines) {
+	if (defines.empty()) {
+		return source;
+	}
+	size_t version = source.find("#version");
+	if (version == std::string::npos) {
+		return defines + source;
+	}
+	size_t lineEnd = source.find('\n', version);
+	if (lineEnd == std::string::npos) {
+		return source + "\n" + defines;
+	}
+	return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
 
 Shader::Shader() :
 	_vs(0),
 	_fs(0),
-	_handle(0)
+	_cs(0),
+	_handle(0),
+	_revision(0)
 {
 	_handle = glCreateProgram();
+	_shaders.insert(this);
+	_registryRevision++;
 }
 
 Shader::~Shader() {
+	_shaders.erase(this);
+	_registryRevision++;
+	_ReleaseStages(_stageKeys);
+
 	if (_handle != 0) {
 		glDeleteProgram(_handle);
 		_handle = 0;
@@ -21,11 +103,256 @@ Shader::~Shader() {
 
 bool Shader::LoadShaderPart(const char* source, GLenum type)
 {
+	if (type != GL_VERTEX_SHADER && type != GL_FRAGMENT_SHADER && type != GL_COMPUTE_SHADER) {
+		LOG_WARN("Not implemented");
+		return false;
+	}
+
+	// We hold on to the source and only compile in Link, that way a cached program never gets compiled at all
+	_sources[type] = source;
+	return true;
+}
+
+bool Shader::LoadShaderPartFromFile(const char* path, GLenum type) {
+	std::string source;
+	if (!_ReadShaderFile(path, source, _dependencies)) {
+		throw std::runtime_error("File not found, see logs for more information");
+	}
+	_stagePaths.push_back({ type, path });
+	_registryRevision++;
+	return LoadShaderPart(source.c_str(), type);
+}
+
+bool Shader::_ReadShaderFile(const std::string& path, std::string& result, std::vector<std::string>& dependencies, int depth) {
+	if (depth > 16) {
+		LOG_ERROR("Shader includes nested too deep (is there a cycle?): {}", path);
+		return false;
+	}
+
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		LOG_ERROR("File not found: {}", path);
+		return false;
+	}
+
+	// Keep paths in one form so the file watcher can match them up
+	std::string normalized = std::filesystem::path(path).lexically_normal().generic_string();
+	if (std::find(dependencies.begin(), dependencies.end(), normalized) == dependencies.end()) {
+		dependencies.push_back(normalized);
+	}
+	std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+	std::string line;
+	while (std::getline(file, line)) {
+		// Look for #include "file", anything else gets copied over as is
+		size_t start = line.find_first_not_of(" \t");
+		if (start != std::string::npos && line.compare(start, 8, "#include") == 0) {
+			size_t open = line.find('"', start + 8);
+			size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+			if (close == std::string::npos) {
+				LOG_ERROR("Malformed #include in {}: {}", path, line);
+				return false;
+			}
+			std::string include = (directory / line.substr(open + 1, close - open - 1)).generic_string();
+			if (!_ReadShaderFile(include, result, dependencies, depth + 1)) {
+				return false;
+			}
+		}
+		else {
+			result += line;
+			result += '\n';
+		}
+	}
+	return true;
+}
+
+bool Shader::Reload() {
+	if (_stagePaths.empty()) {
+		return false;
+	}
+
+	// Read everything first, editors can leave a file missing for a moment while saving
+	std::map<GLenum, std::string> sources;
+	std::vector<std::string> dependencies;
+	for (const auto& [type, path] : _stagePaths) {
+		if (!_ReadShaderFile(path, sources[type], dependencies)) {
+			LOG_WARN("Keeping the old program, couldn't read {}", path);
+			return false;
+		}
+	}
+
+	// Build the new program off to the side, so a failure leaves the old one untouched. A successful Link swaps the old
+	// program's stages for the new ones, so edits that are never used again don't leave compiled stages behind
+	GLuint oldHandle = _handle;
+	_handle = glCreateProgram();
+	_sources = sources;
+
+	if (!Link()) {
+		glDeleteProgram(_handle);
+		_handle = oldHandle;
+		_sources.clear();
+		LOG_WARN("Keeping the old program for {}", _stagePaths.back().second);
+		return false;
+	}
+
+	glDeleteProgram(oldHandle);
+	_uniformLocs.clear();
+	_revision++;
+	if (dependencies != _dependencies) {
+		_dependencies = dependencies;
+		_registryRevision++;
+	}
+
+	for (const auto& callback : _reloadCallbacks) {
+		callback();
+	}
+	return true;
+}
+
+void Shader::AddReloadCallback(const std::function<void()>& callback) {
+	_reloadCallbacks.push_back(callback);
+}
+
+void Shader::ForEachShader(const std::function<void(Shader&)>& callback) {
+	for (Shader* shader : _shaders) {
+		callback(*shader);
+	}
+}
+
+void Shader::AddDefine(const std::string& name, const std::string& value) {
+	_defines += "#define " + name + " " + value + "\n";
+}
+
+bool Shader::Link()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	_cacheStats.Programs++;
+
+	bool useCache = _cacheEnabled && SupportsProgramBinaries();
+	uint64_t key = useCache ? _ComputeKey() : 0;
+
+	if (useCache && _LoadCachedBinary(key)) {
+		// The new program doesn't need any stages, so let go of the ones the program it replaces used
+		_ReleaseStages(_stageKeys);
+		_sources.clear();
+		_cacheStats.LoadMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return true;
+	}
+
+	// Cache miss, compile everything from source
+	bool compiled = true;
+	std::vector<uint64_t> stageKeys;
+	for (const auto& [type, source] : _sources) {
+		GLuint handle = _CompileStage(type, source, stageKeys);
+		compiled &= handle != 0;
+		switch (type) {
+			case GL_VERTEX_SHADER: _vs = handle; break;
+			case GL_FRAGMENT_SHADER: _fs = handle; break;
+			case GL_COMPUTE_SHADER: _cs = handle; break;
+			default: break;
+		}
+	}
+	_sources.clear();
+
+	// The errors have already been logged, bail out instead of asserting so a bad edit doesn't take the app down
+	if (!compiled) {
+		_ReleaseStages(stageKeys);
+		_vs = _fs = _cs = 0;
+		return false;
+	}
+
+	// We need to ask for the binary to be kept around before linking
+	if (useCache) {
+		glProgramParameteri(_handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	// Compute shaders can't be linked with any other stage
+	if (_cs != 0) {
+		LOG_ASSERT(_vs == 0 && _fs == 0, "Compute shaders can't be linked with a vertex or fragment shader!");
+
+		glAttachShader(_handle, _cs);
+		glLinkProgram(_handle);
+		glDetachShader(_handle, _cs);
+	}
+	else {
+		LOG_ASSERT(_vs != 0 && _fs != 0, "Must attach both a vertex and fragment shader!");
+
+		// Attach our two shaders
+		glAttachShader(_handle, _vs);
+		glAttachShader(_handle, _fs);
+
+		// Perform linking
+		glLinkProgram(_handle);
+
+		// Remove shader parts from the program, the stage objects themselves are shared and reference counted
+		glDetachShader(_handle, _vs);
+		glDetachShader(_handle, _fs);
+	}
+	_vs = _fs = _cs = 0;
+
+	GLint status = 0;
+	glGetProgramiv(_handle, GL_LINK_STATUS, &status);
+
+	if (status == GL_FALSE) {
+		_LogLinkError();
+		_ReleaseStages(stageKeys);
+	}
+	else {
+		if (useCache) {
+			_SaveCachedBinary(key);
+		}
+		// Holding on to the new stages before letting go of the old ones keeps any stage they share from being recompiled
+		_ReleaseStages(_stageKeys);
+		_stageKeys = std::move(stageKeys);
+		_cacheStats.Compiled++;
+	}
+
+	_cacheStats.CompileMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return status != GL_FALSE;
+}
+
+void Shader::ClearCache() {
+	for (auto& [hash, stage] : _stages) {
+		glDeleteShader(stage.Handle);
+	}
+	_stages.clear();
+	_binaries.clear();
+
+	// Linked programs don't need their stages anymore, they just have to stop pointing at them
+	for (Shader* shader : _shaders) {
+		shader->_stageKeys.clear();
+	}
+}
+
+void Shader::_ReleaseStages(std::vector<uint64_t>& keys) {
+	for (uint64_t key : keys) {
+		auto it = _stages.find(key);
+		if (it != _stages.end() && --it->second.Users <= 0) {
+			glDeleteShader(it->second.Handle);
+			_stages.erase(it);
+		}
+	}
+	keys.clear();
+}
+
+GLuint Shader::_CompileStage(GLenum type, const std::string& source, std::vector<uint64_t>& keys) {
+	// Identical stages (ex: the passthrough vertex shader every post effect uses) only get compiled once
+	uint64_t hash = HashString(_defines, HashString(source, HashBytes(&type, sizeof(GLenum))));
+	auto it = _stages.find(hash);
+	if (it != _stages.end()) {
+		_cacheStats.StagesShared++;
+		it->second.Users++;
+		keys.push_back(hash);
+		return it->second.Handle;
+	}
+
 	// Creates a new shader part (VS, FS, GS, etc...)
 	GLuint handle = glCreateShader(type);
 
 	// Load the GLSL source and compile it
-	glShaderSource(handle, 1, &source, nullptr);
+	std::string fullSource = InjectDefines(source, _defines);
+	const char* sourcePtr = fullSource.c_str();
+	glShaderSource(handle, 1, &sourcePtr, nullptr);
 	glCompileShader(handle);
 
 	// Get the compilation status for the shader part
@@ -51,69 +378,122 @@ bool Shader::LoadShaderPart(const char* source, GLenum type)
 
 		// Delete the broken shader result
 		glDeleteShader(handle);
-		handle = 0;
-	}
-
-	switch (type) {
-		case GL_VERTEX_SHADER: _vs = handle; break;
-		case GL_FRAGMENT_SHADER: _fs = handle; break;
-		default: LOG_WARN("Not implemented"); break;
+		return 0;
 	}
 
-	return status != GL_FALSE;
+	_stages[hash] = { handle, 1 };
+	keys.push_back(hash);
+	return handle;
 }
 
-bool Shader::LoadShaderPartFromFile(const char* path, GLenum type) {
-	std::ifstream file(path);
-	if (!file.is_open()) {
-		LOG_ERROR("File not found: {}", path);
-		throw std::runtime_error("File not found, see logs for more information");
+uint64_t Shader::_ComputeKey() const {
+	uint64_t key = HashString(GetDriverString());
+	key = HashString(_defines, key);
+	for (const auto& [type, source] : _sources) {
+		key = HashBytes(&type, sizeof(GLenum), key);
+		key = HashString(source, key);
 	}
-	std::stringstream stream;
-	stream << file.rdbuf();
-	bool result = LoadShaderPart(stream.str().c_str(), type);
-	file.close();
-	return result;
+	return key;
 }
 
-bool Shader::Link()
-{
-	LOG_ASSERT(_vs != 0 && _fs != 0, "Must attach both a vertex and fragment shader!");
+bool Shader::_LoadCachedBinary(uint64_t key) {
+	// Another shader in this run might have already linked the same program
+	auto it = _binaries.find(key);
+	bool fromMemory = it != _binaries.end();
+	ProgramBinary binary;
 
-	// Attach our two shaders
-	glAttachShader(_handle, _vs);
-	glAttachShader(_handle, _fs);
+	if (!fromMemory) {
+		std::stringstream name;
+		name << _cachePath << "/" << std::hex << key << ".bin";
+		std::ifstream file(name.str(), std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
 
-	// Perform linking
-	glLinkProgram(_handle);
+		ProgramBinaryHeader header;
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(ProgramBinaryHeader)) ||
+			header.Magic != BINARY_MAGIC || header.Version != BINARY_VERSION || header.Key != key) {
+			LOG_WARN("Ignoring invalid program binary \"{}\"", name.str());
+			return false;
+		}
 
-	// Remove shader parts to save space (we can do this since we only needed the shader parts to compile an actual shader program)
-	glDetachShader(_handle, _vs);
-	glDeleteShader(_vs);
-	glDetachShader(_handle, _fs);
-	glDeleteShader(_fs);
+		binary.Format = header.Format;
+		binary.Data.resize(header.Size);
+		if (!file.read(binary.Data.data(), header.Size)) {
+			LOG_WARN("Ignoring truncated program binary \"{}\"", name.str());
+			return false;
+		}
+	}
+	const ProgramBinary& source = fromMemory ? it->second : binary;
 
+	// The driver can still reject a binary (ex: after an update that didn't change the version string)
+	glProgramBinary(_handle, source.Format, source.Data.data(), static_cast<GLsizei>(source.Data.size()));
 	GLint status = 0;
 	glGetProgramiv(_handle, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE) {
+		LOG_WARN("Cached program binary was rejected by the driver, recompiling");
+		return false;
+	}
 
-	if (status == GL_FALSE)
-	{
-		// Get the length of the log
-		GLint length = 0;
-		glGetProgramiv(_handle, GL_INFO_LOG_LENGTH, &length);
-
-		if (length > 0) {
-			// Read the log from openGL
-			char* log = new char[length];
-			glGetProgramInfoLog(_handle, length, &length, log);
-			LOG_ERROR("Shader failed to link:\n{}", log);
-			delete[] log;
-		}
-		else {
-			LOG_ERROR("Shader failed to link for an unknown reason!");
-		}
+	if (fromMemory) {
+		_cacheStats.MemoryHits++;
+	}
+	else {
+		_cacheStats.DiskHits++;
+		_binaries[key] = std::move(binary);
+	}
+	return true;
+}
+
+void Shader::_SaveCachedBinary(uint64_t key) {
+	GLint size = 0;
+	glGetProgramiv(_handle, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (size <= 0) {
+		return;
+	}
+
+	ProgramBinary binary;
+	binary.Data.resize(size);
+	glGetProgramBinary(_handle, size, &size, &binary.Format, binary.Data.data());
+	binary.Data.resize(size);
+
+	std::error_code error;
+	std::filesystem::create_directories(_cachePath, error);
+	std::stringstream name;
+	name << _cachePath << "/" << std::hex << key << ".bin";
+
+	// Write to a temporary file and move it over, so a crash mid write can't leave a broken binary behind
+	std::string tempName = name.str() + ".tmp";
+	std::ofstream file(tempName, std::ios::binary);
+	if (file.is_open()) {
+		ProgramBinaryHeader header = { BINARY_MAGIC, BINARY_VERSION, key, binary.Format, static_cast<uint32_t>(binary.Data.size()) };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(ProgramBinaryHeader));
+		file.write(binary.Data.data(), binary.Data.size());
+		file.close();
+		std::filesystem::rename(tempName, name.str(), error);
+	}
+	if (!file || error) {
+		LOG_WARN("Failed to write program binary \"{}\"", name.str());
+	}
+
+	_binaries[key] = std::move(binary);
+}
+
+void Shader::_LogLinkError() {
+	// Get the length of the log
+	GLint length = 0;
+	glGetProgramiv(_handle, GL_INFO_LOG_LENGTH, &length);
+
+	if (length > 0) {
+		// Read the log from openGL
+		char* log = new char[length];
+		glGetProgramInfoLog(_handle, length, &length, log);
+		LOG_ERROR("Shader failed to link:\n{}", log);
+		delete[] log;
+	}
+	else {
+		LOG_ERROR("Shader failed to link for an unknown reason!");
 	}
-	return status != GL_FALSE;
 }
 
 void Shader::Bind() {
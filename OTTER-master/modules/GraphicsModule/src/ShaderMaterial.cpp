@@ -15,7 +15,7 @@ void SubmitUniformsMat(const Shader::sptr& shader, const std::unordered_map<Shad
 }
 
 ShaderMaterial::ShaderMaterial()
-	: Shader(nullptr),  RenderLayer(0)
+	: Shader(nullptr), Variants(nullptr), Keywords(0), RenderLayer(0), _resolvedShader(nullptr), _resolvedRevision(0)
 {
 }
 
@@ -25,6 +25,11 @@ ShaderMaterial::~ShaderMaterial() {
 
 void ShaderMaterial::Apply()
 {	
+	// The shader (or variant) may have been swapped or reloaded since the parameters were set
+	if (_resolvedShader != Shader.get() || _resolvedRevision != Shader->GetRevision()) {
+		_ResolveLocations();
+	}
+
 	int slot = 1;
 	for (auto& kvp : Textures) {
 		if (kvp.first.Location != -1 && kvp.second != nullptr) {
@@ -42,6 +47,46 @@ void ShaderMaterial::Apply()
 	SubmitUniformsMat(Shader, Mat3Params);
 }
 
+void ShaderMaterial::SetVariants(const ShaderVariants::sptr& variants, uint32_t keywords) {
+	Variants = variants;
+	SetKeywords(keywords);
+}
+
+void ShaderMaterial::SetKeywords(uint32_t keywords) {
+	LOG_ASSERT(Variants != nullptr, "Must set Material variants before setting keywords");
+	Keywords = keywords;
+	Shader = Variants->GetVariant(keywords);
+}
+
+void ShaderMaterial::EnableKeyword(const std::string& name, bool enabled) {
+	LOG_ASSERT(Variants != nullptr, "Must set Material variants before setting keywords");
+	uint32_t keyword = Variants->GetKeyword(name);
+	if (keyword == 0) {
+		LOG_WARN("Ignoring unknown keyword \"{}\"", name);
+		return;
+	}
+	SetKeywords(enabled ? (Keywords | keyword) : (Keywords & ~keyword));
+}
+
+template<typename T>
+void ResolveLocations(const Shader::sptr& shader, const std::unordered_map<ShaderParamName, T>& values) {
+	for (auto& kvp : values) {
+		kvp.first.Location = shader->GetUniformLocation(kvp.first.Name);
+	}
+}
+
+void ShaderMaterial::_ResolveLocations() {
+	ResolveLocations(Shader, Textures);
+	ResolveLocations(Shader, FloatParams);
+	ResolveLocations(Shader, Vec2Params);
+	ResolveLocations(Shader, Vec3Params);
+	ResolveLocations(Shader, Vec4Params);
+	ResolveLocations(Shader, Mat4Params);
+	ResolveLocations(Shader, Mat3Params);
+	_resolvedShader = Shader.get();
+	_resolvedRevision = Shader->GetRevision();
+}
+
 void ShaderMaterial::Set(const std::string& name, const ITexture::sptr& texture) {
 	LOG_ASSERT(Shader != nullptr, "Must set Material shader before setting params");
 	ShaderParamName pName = name;
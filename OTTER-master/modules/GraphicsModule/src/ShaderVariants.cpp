@@ -0,0 +1,94 @@
+#include "ShaderVariants.h"
+
+ShaderVariants::ShaderVariants() :
+	_stages(),
+	_keywords(),
+	_variants(),
+	_setup(std::make_shared<std::function<void(const Shader::sptr&)>>())
+{ }
+
+void ShaderVariants::LoadShaderPartFromFile(const char* path, GLenum type) {
+	LOG_ASSERT(_variants.empty(), "Stages must be loaded before any variants are created!");
+	_stages.push_back({ path, type });
+}
+
+uint32_t ShaderVariants::AddKeyword(const std::string& name) {
+	uint32_t existing = GetKeyword(name);
+	if (existing != 0) {
+		return existing;
+	}
+	LOG_ASSERT(_keywords.size() < 32, "Shaders can only have up to 32 keywords!");
+	_keywords.push_back(name);
+	return 1u << (_keywords.size() - 1);
+}
+
+uint32_t ShaderVariants::GetKeyword(const std::string& name) const {
+	for (size_t ix = 0; ix < _keywords.size(); ix++) {
+		if (_keywords[ix] == name) {
+			return 1u << ix;
+		}
+	}
+	return 0;
+}
+
+Shader::sptr ShaderVariants::GetVariant(uint32_t keywords) {
+	// Bits without a declared keyword would make duplicate variants, so drop them
+	uint32_t valid = _keywords.size() >= 32 ? 0xFFFFFFFFu : (1u << _keywords.size()) - 1;
+	keywords &= valid;
+
+	auto it = _variants.find(keywords);
+	if (it != _variants.end()) {
+		return it->second;
+	}
+
+	Shader::sptr result = Shader::Create();
+	for (const StagePath& stage : _stages) {
+		result->LoadShaderPartFromFile(stage.Path.c_str(), stage.Type);
+	}
+	// Defines always go in keyword order, so the same mask always makes the same source (and hits the program cache)
+	for (size_t ix = 0; ix < _keywords.size(); ix++) {
+		if (keywords & (1u << ix)) {
+			result->AddDefine(_keywords[ix]);
+		}
+	}
+	result->Link();
+
+	if (*_setup) {
+		(*_setup)(result);
+	}
+
+	// A reloaded program loses its uniforms, so set them up again
+	std::weak_ptr<Shader> weakResult = result;
+	std::shared_ptr<std::function<void(const Shader::sptr&)>> setup = _setup;
+	result->AddReloadCallback([weakResult, setup]() {
+		Shader::sptr shader = weakResult.lock();
+		if (shader && *setup) {
+			(*setup)(shader);
+		}
+	});
+
+	_variants[keywords] = result;
+	return result;
+}
+
+uint32_t ShaderVariants::GetVariantKeywords(const Shader::sptr& shader) const {
+	for (const auto& [keywords, variant] : _variants) {
+		if (variant == shader) {
+			return keywords;
+		}
+	}
+	return 0;
+}
+
+void ShaderVariants::SetVariantSetup(const std::function<void(const Shader::sptr&)>& setup) {
+	*_setup = setup;
+	if (setup) {
+		ForEachVariant(setup);
+	}
+}
+
+void ShaderVariants::ForEachVariant(const std::function<void(const Shader::sptr&)>& callback) const {
+	for (const auto& [keywords, variant] : _variants) {
+		callback(variant);
+	}
+}
@@ -0,0 +1,205 @@
+#include "ShaderWatcher.h"
+#include "Shader.h"
+#include "Logging.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+std::thread ShaderWatcher::_thread;
+std::atomic_bool ShaderWatcher::_running(false);
+std::mutex ShaderWatcher::_mutex;
+std::unordered_set<std::string> ShaderWatcher::_changed;
+std::chrono::steady_clock::time_point ShaderWatcher::_lastChange;
+std::unordered_map<std::string, std::filesystem::file_time_type> ShaderWatcher::_files;
+std::unordered_map<int, std::string> ShaderWatcher::_directories;
+int ShaderWatcher::_inotify = -1;
+uint32_t ShaderWatcher::_registryRevision = 0;
+int ShaderWatcher::_reloadCount = 0;
+int ShaderWatcher::_failedCount = 0;
+
+// Editors tend to write a file in a few steps, so wait for things to settle before reloading
+static const std::chrono::milliseconds SETTLE_TIME(100);
+// How often the polling fallback checks file times
+static const std::chrono::milliseconds POLL_INTERVAL(250);
+
+void ShaderWatcher::Init() {
+	if (_running) {
+		return;
+	}
+
+#ifdef __linux__
+	_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_inotify == -1) {
+		LOG_WARN("Couldn't start inotify, shader hot reload is disabled");
+		return;
+	}
+#endif
+
+	// Make sure the first Poll sets up the watches
+	_registryRevision = Shader::GetRegistryRevision() - 1;
+	_running = true;
+	_thread = std::thread(_WatchThread);
+	LOG_INFO("Watching shaders for changes");
+}
+
+void ShaderWatcher::Shutdown() {
+	if (!_running) {
+		return;
+	}
+
+	_running = false;
+	_thread.join();
+
+#ifdef __linux__
+	close(_inotify);
+	_inotify = -1;
+#endif
+
+	_directories.clear();
+	_files.clear();
+	_changed.clear();
+}
+
+void ShaderWatcher::Poll() {
+	if (!_running) {
+		return;
+	}
+
+	_UpdateWatches();
+
+	std::unordered_set<std::string> changed;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_changed.empty() || std::chrono::steady_clock::now() - _lastChange < SETTLE_TIME) {
+			return;
+		}
+		changed.swap(_changed);
+	}
+
+	// Find everything that depends on the changed files first, reloading can change the dependencies
+	std::vector<Shader*> toReload;
+	Shader::ForEachShader([&](Shader& shader) {
+		for (const std::string& dependency : shader.GetDependencies()) {
+			if (changed.count(dependency) > 0) {
+				toReload.push_back(&shader);
+				break;
+			}
+		}
+	});
+
+	for (Shader* shader : toReload) {
+		if (shader->Reload()) {
+			_reloadCount++;
+			LOG_INFO("Reloaded shader {}", shader->GetDependencies().front());
+		}
+		else {
+			_failedCount++;
+		}
+	}
+}
+
+void ShaderWatcher::_UpdateWatches() {
+	if (_registryRevision == Shader::GetRegistryRevision()) {
+		return;
+	}
+	_registryRevision = Shader::GetRegistryRevision();
+
+	std::unordered_set<std::string> files;
+	Shader::ForEachShader([&](Shader& shader) {
+		files.insert(shader.GetDependencies().begin(), shader.GetDependencies().end());
+	});
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+#ifdef __linux__
+	// Watch directories rather than files, editors often replace the file instead of writing to it
+	for (const std::string& file : files) {
+		std::string directory = std::filesystem::path(file).parent_path().generic_string();
+		if (directory.empty()) {
+			directory = ".";
+		}
+
+		bool watched = false;
+		for (const auto& [descriptor, path] : _directories) {
+			watched |= path == directory;
+		}
+		if (!watched) {
+			int descriptor = inotify_add_watch(_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+			if (descriptor == -1) {
+				LOG_WARN("Couldn't watch shader directory {}", directory);
+			}
+			else {
+				_directories[descriptor] = directory;
+			}
+		}
+	}
+#else
+	for (const std::string& file : files) {
+		if (_files.count(file) == 0) {
+			std::error_code error;
+			_files[file] = std::filesystem::last_write_time(file, error);
+		}
+	}
+#endif
+}
+
+void ShaderWatcher::_WatchThread() {
+#ifdef __linux__
+	// Big enough for plenty of events, they're variable length
+	alignas(inotify_event) char buffer[4096];
+
+	while (_running) {
+		pollfd descriptor = { _inotify, POLLIN, 0 };
+		// Time out every so often so we notice when we're being shut down
+		if (poll(&descriptor, 1, int(POLL_INTERVAL.count())) <= 0) {
+			continue;
+		}
+
+		ssize_t length;
+		while ((length = read(_inotify, buffer, sizeof(buffer))) > 0) {
+			for (char* ptr = buffer; ptr < buffer + length; ) {
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+				if (event->len > 0) {
+					std::string directory;
+					{
+						std::lock_guard<std::mutex> lock(_mutex);
+						auto it = _directories.find(event->wd);
+						if (it != _directories.end()) {
+							directory = it->second;
+						}
+					}
+					if (!directory.empty()) {
+						_QueueChange((std::filesystem::path(directory) / event->name).lexically_normal().generic_string());
+					}
+				}
+				ptr += sizeof(inotify_event) + event->len;
+			}
+		}
+	}
+#else
+	while (_running) {
+		std::this_thread::sleep_for(POLL_INTERVAL);
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (auto& [file, lastWrite] : _files) {
+			std::error_code error;
+			std::filesystem::file_time_type time = std::filesystem::last_write_time(file, error);
+			// Missing files (mid save) just get checked again next time
+			if (!error && time != lastWrite) {
+				lastWrite = time;
+				_changed.insert(file);
+				_lastChange = std::chrono::steady_clock::now();
+			}
+		}
+	}
+#endif
+}
+
+void ShaderWatcher::_QueueChange(const std::string& path) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_changed.insert(path);
+	_lastChange = std::chrono::steady_clock::now();
+}
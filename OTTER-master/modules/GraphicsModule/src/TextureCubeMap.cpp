@@ -1,7 +1,7 @@
 #include "TextureCubeMap.h"
 
 TextureCubeMap::TextureCubeMap(const TextureCubeDesc& description) :
-	ITexture(), _description(description)
+	ITexture(), _description(description), _mipLevels(1)
 {
 
 	_RecreateTexture();
@@ -17,7 +17,17 @@ void TextureCubeMap::_RecreateTexture() {
 
 	if (_description.Size > 0 && _description.Format != InternalFormat::Unknown)
 	{
-		glTextureStorage2D(_handle, 1, *_description.Format, _description.Size, _description.Size);
+		// A full chain goes down to 1x1
+		_mipLevels = 1;
+		if (_description.GenerateMipMaps) {
+			for (uint32_t size = _description.Size; size > 1; size /= 2) {
+				_mipLevels++;
+			}
+		} else if (_description.MipLevels > 1) {
+			_mipLevels = _description.MipLevels;
+		}
+
+		glTextureStorage2D(_handle, _mipLevels, *_description.Format, _description.Size, _description.Size);
 
 		glTextureParameteri(_handle, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTextureParameteri(_handle, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -56,6 +66,18 @@ void TextureCubeMap::LoadData(const TextureCubeMapData::sptr& data) {
 	}
 }
 
+void TextureCubeMap::LoadMipData(const TextureCubeMapData::sptr& data, uint32_t level) {
+	LOG_ASSERT(level < _mipLevels, "Mip level {} is out of range, texture only has {} levels", level, _mipLevels);
+	uint32_t size = _description.Size >> level;
+	size = size > 0 ? size : 1;
+	LOG_ASSERT(data->GetSize() == size, "Data does not match the size of mip level {}! {} vs {}", level, data->GetSize(), size);
+
+	int componentSize = (GLint)GetTexelComponentSize(data->GetPixelType());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, componentSize);
+
+	glTextureSubImage3D(_handle, level, 0, 0, 0, size, size, 6, *data->GetFormat(), *data->GetPixelType(), data->GetDataPtr());
+}
+
 TextureCubeMap::sptr TextureCubeMap::LoadFromImages(const std::string& path)
 {
 	TextureCubeMapData::sptr data = TextureCubeMapData::LoadFromImages(path);
@@ -156,6 +156,28 @@ void Transform::SetParent(entt::handle parent)
 	});
 }
 
+void Transform::SetParents(entt::registry& registry, const std::vector<std::pair<entt::entity, entt::entity>>& links)
+{
+	for (const auto& [child, parent] : links) {
+		LOG_ASSERT(registry.has<Transform>(child) && registry.has<Transform>(parent), "Parent and child entities must have a transform component");
+		registry.get<Transform>(child)._parent = parent;
+	}
+
+	// Depths can only be worked out once every link is in, since parents may come after their children
+	registry.view<Transform>().each([&](Transform& t) {
+		int depth = 0;
+		for (entt::entity current = t._parent; current != entt::null; current = registry.get<Transform>(current)._parent) {
+			depth++;
+			LOG_ASSERT(depth <= (int)registry.size<Transform>(), "Transform hierarchy has a cycle!");
+		}
+		t._hierarchyDepth = depth;
+	});
+
+	registry.sort<Transform>([](const Transform& l, const Transform& r) {
+		return l.GetHierarchyDepth() < r.GetHierarchyDepth();
+	});
+}
+
 void Transform::UpdateWorldMatrix() const {
 	if (_parent != entt::null) {
 		_worldTransform = _gameObject.registry().get<Transform>(_parent)._worldTransform * LocalTransform();
@@ -5,8 +5,14 @@
 
 VertexArrayObject::VertexArrayObject() :
 	_indexBuffer(nullptr),
-	_handle(0),
-	_vertexCount(0)
+	_vertexCount(0),
+	_boundsMin(glm::vec3(0.0f)),
+	_boundsMax(glm::vec3(0.0f)),
+	_hasBounds(false),
+	_dequantization(glm::mat4(1.0f)),
+	_hasDequantization(false),
+	_octahedralNormals(false),
+	_handle(0)
 {
 	glCreateVertexArrays(1, &_handle);
 }
@@ -31,6 +37,20 @@ void VertexArrayObject::SetIndexBuffer(const IndexBuffer::sptr& ibo) {
 	UnBind();
 }
 
+void VertexArrayObject::SetSubMeshes(const std::vector<SubMesh>& subMeshes) {
+	LOG_ASSERT(subMeshes.empty() || _indexBuffer != nullptr, "Sub-meshes need the index buffer set first!");
+	_subMeshes = subMeshes;
+	_subMeshCounts.clear();
+	_subMeshOffsets.clear();
+	_subMeshBaseVertices.clear();
+	for (const SubMesh& subMesh : _subMeshes) {
+		_subMeshCounts.push_back(subMesh.IndexCount);
+		// The offsets are in bytes, so they depend on the index type
+		_subMeshOffsets.push_back((const void*)(subMesh.FirstIndex * _indexBuffer->GetElementSize()));
+		_subMeshBaseVertices.push_back(subMesh.BaseVertex);
+	}
+}
+
 void VertexArrayObject::AddVertexBuffer(const VertexBuffer::sptr& buffer, const std::vector<BufferAttribute>& attributes)
 {
 	if (_vertexCount == 0) {
@@ -46,13 +66,30 @@ void VertexArrayObject::AddVertexBuffer(const VertexBuffer::sptr& buffer, const
 	Bind();
 	buffer->Bind();
 	for (const BufferAttribute& attrib : attributes) {
+		LOG_ASSERT(attrib.Stride == 0 || attrib.Offset + attrib.GetByteSize() <= static_cast<size_t>(attrib.Stride), "Attribute in slot {} reads past the end of its vertex!", attrib.Slot);
 		glEnableVertexArrayAttrib(_handle, attrib.Slot);
-		glVertexAttribPointer(attrib.Slot, attrib.Size, attrib.Type, attrib.Normalized, attrib.Stride, (void*)attrib.Offset);
+		if (attrib.Integer) {
+			glVertexAttribIPointer(attrib.Slot, attrib.Size, attrib.Type, attrib.Stride, (void*)attrib.Offset);
+		} else {
+			glVertexAttribPointer(attrib.Slot, attrib.Size, attrib.Type, attrib.Normalized, attrib.Stride, (void*)attrib.Offset);
+		}
+		// A normal with only 2 components has been folded into an octahedron
+		if (attrib.Usage == AttribUsage::Normal) {
+			_octahedralNormals = attrib.Size == 2;
+		}
 	}
 	UnBind();
 
 }
 
+size_t VertexArrayObject::GetVertexSize() const {
+	size_t result = 0;
+	for (const VertexBufferBinding& binding : _vertexBuffers) {
+		result += binding.Buffer->GetElementSize();
+	}
+	return result;
+}
+
 void VertexArrayObject::Bind() const {
 	glBindVertexArray(_handle);
 }
@@ -63,7 +100,9 @@ void VertexArrayObject::UnBind() {
 
 void VertexArrayObject::Render() const {
 	Bind();
-	if (_indexBuffer != nullptr) {
+	if (_indexBuffer != nullptr && !_subMeshes.empty()) {
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, _subMeshCounts.data(), _indexBuffer->GetElementType(), _subMeshOffsets.data(), static_cast<GLsizei>(_subMeshes.size()), _subMeshBaseVertices.data());
+	} else if (_indexBuffer != nullptr) {
 		glDrawElements(GL_TRIANGLES, _indexBuffer->GetElementCount(), _indexBuffer->GetElementType(), nullptr);
 	} else {
 		glDrawArrays(GL_TRIANGLES, 0, _vertexCount / 3);
@@ -0,0 +1,159 @@
+#include "VertexPacking.h"
+#include <chrono>
+#include <GLM/gtc/packing.hpp>
+#include <GLM/gtc/matrix_transform.hpp>
+
+#include "Logging.h"
+#include "ObjLoader.h"
+
+glm::i16vec2 VertexPacking::EncodeOctahedral(const glm::vec3& normal) {
+	float length = glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+	if (length <= 0.0f) {
+		return glm::i16vec2(0);
+	}
+
+	// Project onto the octahedron, then fold the bottom half out over the corners of the square
+	glm::vec2 folded = glm::vec2(normal.x, normal.y) / length;
+	if (normal.z < 0.0f) {
+		glm::vec2 sign = glm::vec2(folded.x >= 0.0f ? 1.0f : -1.0f, folded.y >= 0.0f ? 1.0f : -1.0f);
+		folded = (1.0f - glm::abs(glm::vec2(folded.y, folded.x))) * sign;
+	}
+
+	// Rounding each component to the nearest step isn't always nearest once it's unfolded, so try both ways
+	glm::vec3 unit = glm::normalize(normal);
+	glm::vec2 scaled = glm::clamp(folded, -1.0f, 1.0f) * 32767.0f;
+	glm::i16vec2 best = glm::i16vec2(glm::round(scaled));
+	float bestDot = glm::dot(DecodeOctahedral(best), unit);
+	for (int ix = 0; ix < 4; ix++) {
+		glm::vec2 rounded = glm::vec2(ix & 1 ? glm::ceil(scaled.x) : glm::floor(scaled.x), ix & 2 ? glm::ceil(scaled.y) : glm::floor(scaled.y));
+		glm::i16vec2 candidate = glm::i16vec2(glm::clamp(rounded, -32767.0f, 32767.0f));
+		float candidateDot = glm::dot(DecodeOctahedral(candidate), unit);
+		if (candidateDot > bestDot) {
+			best = candidate;
+			bestDot = candidateDot;
+		}
+	}
+	return best;
+}
+
+glm::vec3 VertexPacking::DecodeOctahedral(const glm::i16vec2& encoded) {
+	glm::vec2 folded = glm::max(glm::vec2(encoded) / 32767.0f, glm::vec2(-1.0f));
+	glm::vec3 normal = glm::vec3(folded.x, folded.y, 1.0f - glm::abs(folded.x) - glm::abs(folded.y));
+	float t = glm::max(-normal.z, 0.0f);
+	normal.x += normal.x >= 0.0f ? -t : t;
+	normal.y += normal.y >= 0.0f ? -t : t;
+	return glm::normalize(normal);
+}
+
+glm::u16vec2 VertexPacking::EncodeHalf(const glm::vec2& value) {
+	return glm::packHalf(value);
+}
+
+glm::vec2 VertexPacking::DecodeHalf(const glm::u16vec2& encoded) {
+	return glm::unpackHalf(encoded);
+}
+
+glm::u8vec4 VertexPacking::EncodeColor(const glm::vec4& color) {
+	return glm::packUnorm<uint8_t>(color);
+}
+
+glm::vec4 VertexPacking::DecodeColor(const glm::u8vec4& encoded) {
+	return glm::unpackUnorm<float>(encoded);
+}
+
+glm::u16vec3 VertexPacking::QuantizePosition(const glm::vec3& position, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+	glm::vec3 size = boundsMax - boundsMin;
+	glm::vec3 relative = glm::vec3(
+		size.x > 0.0f ? (position.x - boundsMin.x) / size.x : 0.0f,
+		size.y > 0.0f ? (position.y - boundsMin.y) / size.y : 0.0f,
+		size.z > 0.0f ? (position.z - boundsMin.z) / size.z : 0.0f);
+	return glm::packUnorm<uint16_t>(relative);
+}
+
+glm::mat4 VertexPacking::Dequantization(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+	return glm::scale(glm::translate(glm::mat4(1.0f), boundsMin), boundsMax - boundsMin);
+}
+
+bool VertexPacking::RunBenchmark(const std::vector<std::string>& files) {
+	bool passed = true;
+	typedef std::chrono::high_resolution_clock Clock;
+	auto millisecondsSince = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+	size_t totalVertices = 0;
+	for (const std::string& file : files) {
+		MeshBuilder<VertexPosNormTexCol> mesh;
+		try {
+			mesh = ObjLoader::ParseFile(file, glm::vec4(1.0f), false);
+		}
+		catch (const std::exception&) {
+			LOG_WARN("Vertex packing benchmark: couldn't open {}", file);
+			continue;
+		}
+		const size_t vertexCount = mesh.GetVertexCount();
+		const VertexPosNormTexCol* source = mesh.GetVertexDataPtr();
+		if (vertexCount == 0) {
+			continue;
+		}
+		totalVertices += vertexCount;
+
+		Clock::time_point start = Clock::now();
+		MeshBuilder<VertexPosNormTexColPacked> packed = mesh.Convert<VertexPosNormTexColPacked>();
+		double packTime = millisecondsSince(start);
+		start = Clock::now();
+		MeshBuilder<VertexPosNormTexColQuantized> quantized = mesh.Quantize();
+		double quantizeTime = millisecondsSince(start);
+
+		// The largest a step of the quantization can be, anything within half of that is as close as it gets
+		glm::vec3 min = source[0].Position, max = source[0].Position;
+		for (size_t ix = 0; ix < vertexCount; ix++) {
+			min = glm::min(min, source[ix].Position);
+			max = glm::max(max, source[ix].Position);
+		}
+		glm::mat4 dequantize = Dequantization(min, max);
+		float positionStep = glm::max(max.x - min.x, glm::max(max.y - min.y, max.z - min.z)) / 65535.0f;
+
+		bool matches = true;
+		float normalError = 0.0f, uvError = 0.0f, colorError = 0.0f, positionError = 0.0f;
+		for (size_t ix = 0; ix < vertexCount; ix++) {
+			const VertexPosNormTexCol& vertex = source[ix];
+			const VertexPosNormTexColPacked& pack = packed.GetVertexDataPtr()[ix];
+			const VertexPosNormTexColQuantized& quant = quantized.GetVertexDataPtr()[ix];
+
+			if (glm::dot(vertex.Normal, vertex.Normal) > 0.0f) {
+				// acos loses too much precision this close to 1
+				glm::vec3 normal = DecodeOctahedral(pack.Normal);
+				glm::vec3 expected = glm::normalize(vertex.Normal);
+				normalError = glm::max(normalError, glm::degrees(glm::atan(glm::length(glm::cross(normal, expected)), glm::dot(normal, expected))));
+			}
+			glm::vec2 uv = glm::abs(DecodeHalf(pack.UV) - vertex.UV) / glm::max(glm::abs(vertex.UV), glm::vec2(1.0f));
+			uvError = glm::max(uvError, glm::max(uv.x, uv.y));
+			glm::vec4 color = glm::abs(DecodeColor(pack.Color) - glm::clamp(vertex.Color, 0.0f, 1.0f));
+			colorError = glm::max(colorError, glm::max(glm::max(color.x, color.y), glm::max(color.z, color.w)));
+			glm::vec3 position = glm::vec3(dequantize * glm::vec4(glm::unpackUnorm<float>(quant.Position), 1.0f));
+			positionError = glm::max(positionError, glm::length(position - vertex.Position));
+
+			if (pack.Position != vertex.Position || quant.Normal != pack.Normal || quant.UV != pack.UV || quant.Color != pack.Color) {
+				matches = false;
+			}
+		}
+
+		// Octahedral snorm16s are good to about 0.005 degrees, half floats to 1 part in 2048, RGBA8 to half of 1/255
+		// and the quantized positions to half a step in each axis
+		if (!matches || normalError > 0.01f || uvError > 1.0f / 2048.0f || colorError > 0.5f / 255.0f + 1e-6f || positionError > positionStep + 1e-6f) {
+			LOG_ERROR("Vertex packing benchmark failed: {} came out too far from the source", file);
+			passed = false;
+		}
+
+		LOG_INFO("{}: {} vertices, {} -> {} -> {} bytes each, packed in {:.2f} ms, quantized in {:.2f} ms", file, vertexCount,
+			sizeof(VertexPosNormTexCol), sizeof(VertexPosNormTexColPacked), sizeof(VertexPosNormTexColQuantized), packTime, quantizeTime);
+		LOG_INFO("  Worst error: normal {:.4f} deg, UV {:.6f}, color {:.4f}, position {:.6f} (step {:.6f})",
+			normalError, uvError, colorError, positionError, positionStep);
+	}
+
+	LOG_INFO("Vertex memory for {} vertices: {} KB -> {} KB packed -> {} KB quantized", totalVertices,
+		totalVertices * sizeof(VertexPosNormTexCol) / 1024, totalVertices * sizeof(VertexPosNormTexColPacked) / 1024, totalVertices * sizeof(VertexPosNormTexColQuantized) / 1024);
+	if (passed) {
+		LOG_INFO("Vertex packing benchmark passed");
+	}
+	return passed;
+}
@@ -13,6 +13,8 @@
 //////////////////////////////////////////////////////////////////////////
 #pragma once
 
+#include <vector>
+#include <unordered_map>
 #include "GLM/glm.hpp"
 #include "glad/glad.h"
 #include "stb_truetype.h"
@@ -45,19 +47,37 @@ namespace  TTK
 
 	class FontRenderer;
 	
+	// A TrueType font whose glyphs get rasterized into the atlas the first time they're drawn. The atlas is a grid of
+	// cells sized to fit the font's biggest glyph, and when it's full the least recently drawn glyph gets evicted, so
+	// any codepoint in the font can be drawn (not just ASCII) without the atlas growing
 	class TrueTypeTextureFont {
 	public:
 		TrueTypeTextureFont(const char* fileName, uint32_t size);
 		~TrueTypeTextureFont();
+
+		// False if the font file couldn't be loaded, nothing gets drawn with an invalid font
+		bool IsValid() const { return myFontData != nullptr; }
 		
+		// Gets the quad for a codepoint, rasterizing it into the atlas if it isn't there yet. The UVs are only good until
+		// the glyph gets evicted, which never happens to a glyph used in the batch the FontRenderer hasn't drawn yet
 		GlyphInfo GetGlyph(int codePoint, float offsetX, float offsetY) const;
 		float  GetKerning(int char1, int char2) const;
 		float  GetLineHeight() const;
 
+		// Measures a UTF-8 string, this only needs the glyph metrics so it never touches the atlas
 		virtual glm::vec2 MeausureString(const char* text, const float scale = 1.0f);
 
 		virtual GLint GetTexture() const { return myTexture; }
 
+		struct AtlasStats {
+			size_t Cells      = 0; // How many glyphs fit in the atlas at once
+			size_t Resident   = 0; // Glyphs in the atlas right now
+			size_t Rasterized = 0; // Glyphs rasterized since the font was loaded
+			size_t Evictions  = 0; // Glyphs pushed out of the atlas to make room
+			size_t Flushes    = 0; // Times a batch had to be drawn early because every cell was in use
+		};
+		const AtlasStats& GetAtlasStats() const { return myStats; }
+
 	protected:
 		friend class FontRenderer;
 		GLuint   myTexture;
@@ -67,10 +87,47 @@ namespace  TTK
 		const uint32_t ATLAS_HEIGHT = 1024;
 		const uint32_t FONT_OVERSAMPLE_X = 2;
 		const uint32_t FONT_OVERSAMPLE_Y = 2;
+		// ASCII gets rasterized up front, since pretty much all text uses it
 		const uint32_t FIRST_CHAR = ' ';
-		const uint32_t CHAR_COUNT = '~' - ' ';
+		const uint32_t CHAR_COUNT = '~' - ' ' + 1;
+
+		// Metrics for a glyph, in pixels relative to the pen position
+		struct Glyph {
+			int   GlyphIndex;
+			float XOff, YOff, XOff2, YOff2;
+			float Advance;
+			int   Width, Height; // Size of the oversampled bitmap, 0 for glyphs with nothing to draw
+			int   Cell;          // Atlas cell holding the bitmap, -1 if it isn't in the atlas
+		};
+
+		// A slot in the atlas, the cells form a doubly linked list from most to least recently used
+		struct Cell {
+			int      GlyphId; // Index into myGlyphs, -1 if the cell is free
+			int      Prev, Next;
+			uint64_t Batch;   // The last batch a glyph in this cell was used in
+		};
 
-		stbtt_packedchar* myCharInfo;
+		GlyphInfo __GetGlyph(int codePoint, float offsetX, float offsetY, bool rasterize) const;
+		int  __FindGlyph(int codePoint) const;
+		void __Rasterize(Glyph& glyph, int glyphId) const;
+		void __Touch(int cell) const;
+		void __Unlink(int cell) const;
+		void __PushFront(int cell) const;
+
+		// The glyph caches fill in as text gets drawn, which doesn't change what the font draws
+		mutable std::vector<Glyph>              myGlyphs;
+		mutable std::unordered_map<int, int>    myGlyphLookup; // Codepoint to glyph, for everything past ASCII
+		mutable std::unordered_map<int, int>    myIndexLookup; // Font glyph index to glyph
+		mutable int                             myAsciiLookup[128];
+		mutable std::vector<Cell>               myCells;
+		mutable int                             myHead, myTail;
+		mutable uint64_t                        myBatch;
+		mutable std::vector<uint8_t>            myScratch;
+		mutable AtlasStats                      myStats;
+		int                                     myCellWidth, myCellHeight;
+		int                                     myCellsX;
+
+		unsigned char*    myFontData;
 		uint32_t          myFontSize;
 		stbtt_fontinfo    myFontInfo;
 		float             myPixelHeightScale;
@@ -80,6 +137,8 @@ namespace  TTK
 						  myLineGap;
 	};
 	
+	// Collects all the text drawn in a frame into one buffer, and draws it all at once when flushed. Only switching
+	// fonts (or a font running out of atlas space) splits the batch
 	class FontRenderer {
 	public:
 		static FontRenderer& Instance() {
@@ -87,12 +146,14 @@ namespace  TTK
 				m_Instance = new FontRenderer();
 			return *m_Instance;
 		}
+		static bool HasInstance() { return m_Instance != nullptr; }
 		static void DestroyContext() {
 			delete m_Instance;
 			m_Instance = nullptr;
 		}
 
 	private:
+		friend class TrueTypeTextureFont;
 		static FontRenderer* m_Instance;
 
 		struct Vert {
@@ -104,14 +165,39 @@ namespace  TTK
 	public:
 		~FontRenderer();
 
+		// Adds a UTF-8 string to the batch, it gets drawn on the next Flush
 		void Render(const TrueTypeTextureFont& font, const char* text, const glm::vec2& pos, const glm::vec4& color, float scale = 1.0f);
+		// Draws everything that's been rendered since the last flush, TTK::Context::Flush calls this after the primitives
+		void Flush();
+
+		struct BatchStats {
+			size_t DrawCalls = 0; // Draws issued since the last EndFrame
+			size_t Glyphs    = 0; // Glyphs drawn since the last EndFrame
+		};
+		const BatchStats& GetStats() const { return m_LastStats; }
+		// Stores the stats for the frame that just finished and starts counting again
+		void EndFrame();
+
+		// Renders random strings (ASCII, then a mix of Unicode that won't all fit in the atlas) and logs the throughput
+		// in glyphs per millisecond, batched and with a draw per string like text used to be drawn
+		void RunBenchmark(const TrueTypeTextureFont& font, size_t glyphCount = 1000000);
 		
 	private:
 		FontRenderer();
+		void __Discard(const TrueTypeTextureFont* font);
+		void __Reserve(size_t quads);
+		void __BuildIndices(size_t quads);
 				
 		GLuint   m_ShaderHandle;
 		GLuint   m_VAO, m_VBO, m_EBO;
-		Vert     m_MeshData[256 * 4];
-		GLuint   m_IndexData[256 * 6];
+		std::vector<Vert> m_MeshData;
+		const TrueTypeTextureFont* m_BatchFont;
+		size_t   m_Quads;         // Quads waiting in m_MeshData
+		size_t   m_VertCapacity;  // Quads the vertex buffer can hold
+		size_t   m_IndexCapacity; // Quads the index buffer has indices for
+		BatchStats m_Stats, m_LastStats;
+
+		// Starting size of the buffers in quads, they double whenever a batch needs more
+		static const size_t InitialQuads = 1024;
 	};
 }
\ No newline at end of file
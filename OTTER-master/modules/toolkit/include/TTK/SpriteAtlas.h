@@ -0,0 +1,98 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// This header is a part of the Tutorial Tool Kit (TTK) library. 
+// You may not use this header in your GDW games.
+// 
+// This class packs images (usually whole sprite sheets) into a few
+// shared atlas textures, so sprites from different sheets can be drawn
+// in one batch
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "glad/glad.h"
+#include "stb_rect_pack.h"
+
+namespace TTK {
+
+	class SpriteAtlas
+	{
+	public:
+		/*
+		 * Where an image ended up in the atlas
+		 */
+		struct Region {
+			GLuint Texture = 0; // The page texture the image is in
+			int    Page = -1;
+			int    X = 0, Y = 0, Width = 0, Height = 0; // in pixels, not including the padding
+			float  uMin = 0.0f, uMax = 0.0f, vMin = 0.0f, vMax = 0.0f;
+		};
+
+		/*
+		 * An RGBA8 image to pack, the pixels only need to stay valid until Add or AddMany returns
+		 */
+		struct Image {
+			const uint8_t* Pixels;
+			int Width, Height;
+		};
+
+		/*
+		 * Creates an empty atlas, pages get created as images are added
+		 * @param pageSize The width and height of each page texture, in pixels
+		 * @param padding The border around each image, filled with the image's edge pixels so filtering doesn't bleed
+		 */
+		SpriteAtlas(int pageSize = 2048, int padding = 2);
+		~SpriteAtlas();
+
+		SpriteAtlas(const SpriteAtlas& other) = delete;
+		SpriteAtlas& operator=(const SpriteAtlas& other) = delete;
+
+		/*
+		 * Packs a single image into the first page with room for it, adding a page if none have room
+		 * @returns False if the image is too big to fit on a page
+		 */
+		bool Add(const Image& image, Region& result);
+		/*
+		 * Loads an image file and packs it
+		 * @param filePath The path to the file relative to the current working directory
+		 */
+		bool AddFromFile(const std::string& filePath, Region& result);
+		/*
+		 * Packs a set of images at once, which packs tighter than adding them one at a time since the packer can
+		 * place the tallest images first
+		 * @returns False if any of the images were too big to fit on a page, those get a Page of -1
+		 */
+		bool AddMany(const std::vector<Image>& images, std::vector<Region>& results);
+
+		int    GetPageSize() const { return m_PageSize; }
+		size_t GetPageCount() const { return m_Pages.size(); }
+		GLuint GetPageTexture(size_t page) const { return m_Pages[page]->Texture; }
+		/*
+		 * Gets how much of the pages are covered by images (including their padding), from 0 to 1
+		 */
+		float  GetOccupancy() const;
+
+	private:
+		// A page keeps its packer around, so later images fill in the gaps the earlier ones left
+		struct Page {
+			GLuint                  Texture;
+			stbrp_context           Context;
+			std::vector<stbrp_node> Nodes;
+			size_t                  UsedArea;
+		};
+
+		Page* __AddPage();
+		// Copies an image into its spot on a page, extruding its edges out into the padding
+		void __Upload(Page& page, int pageIndex, const Image& image, const stbrp_rect& rect, Region& result);
+
+		int m_PageSize;
+		int m_Padding;
+		std::vector<Page*> m_Pages;
+		std::vector<uint8_t> m_Scratch;
+	};
+
+}
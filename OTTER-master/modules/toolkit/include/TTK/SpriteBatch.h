@@ -0,0 +1,109 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// This header is a part of the Tutorial Tool Kit (TTK) library. 
+// You may not use this header in your GDW games.
+// 
+// This class collects sprites and draws them together, with one draw
+// for every run of sprites that share a texture
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <GLM/glm.hpp>
+#include "glad/glad.h"
+
+namespace TTK {
+
+	struct SpriteCoordinates;
+
+	class SpriteBatch
+	{
+	public:
+		/*
+		 * The order sprites get drawn in
+		 */
+		enum class SortMode {
+			Deferred,   // The order they were added in, runs only merge when neighbouring sprites share a texture
+			Texture,    // Grouped by texture so each texture is one draw, the order within a texture is kept
+			BackToFront // Furthest first so overlapping transparent sprites blend properly, runs merge where they can
+		};
+
+		/*
+		 * Creates a new sprite batch
+		 * @param initialSprites How many sprites the streaming buffer starts out fitting, it doubles whenever a flush needs more
+		 */
+		SpriteBatch(size_t initialSprites = 1024);
+		~SpriteBatch();
+
+		SpriteBatch(const SpriteBatch& other) = delete;
+		SpriteBatch& operator=(const SpriteBatch& other) = delete;
+
+		void SetSortMode(SortMode mode) { m_SortMode = mode; }
+		SortMode GetSortMode() const { return m_SortMode; }
+
+		/*
+		 * Adds a sprite to the batch, it gets drawn on the next Flush
+		 * @param texture The texture to draw the sprite with
+		 * @param coords The part of the texture to draw
+		 * @param matrix Transforms the sprite's -1 to 1 quad directly into clip space, same as SpriteSheetQuad::Draw
+		 * @param color Multiplied with the texture
+		 */
+		void Draw(GLuint texture, const SpriteCoordinates& coords, const glm::mat4& matrix, const glm::vec4& color = glm::vec4(1.0f));
+
+		/*
+		 * Sorts and draws everything added since the last flush
+		 */
+		void Flush();
+
+		struct BatchStats {
+			size_t DrawCalls = 0; // Draws issued by the last flush
+			size_t Sprites = 0;   // Sprites drawn by the last flush
+			size_t Grows = 0;     // How many times the streaming buffer has had to grow
+			size_t Stalls = 0;    // How many times we had to wait for the GPU to finish with a region
+			double SortMs = 0.0;  // Time the last flush spent sorting
+			double WriteMs = 0.0; // Time the last flush spent writing vertices
+		};
+		const BatchStats& GetStats() const { return m_Stats; }
+
+		/*
+		 * Animates sprites from a few generated sprite sheets, and logs the CPU and GPU time for drawing them one at
+		 * a time (how SpriteSheetQuad draws), batched from separate textures, and batched from an atlas. Draws into
+		 * whatever framebuffer is bound
+		 */
+		static void RunBenchmark(size_t spriteCount = 100000);
+
+	private:
+		struct SpriteVert {
+			glm::vec4 Position; // Already in clip space
+			glm::vec2 UV;
+			uint32_t  Color;
+		};
+
+		// Every region of the streaming buffer gets written while the GPU could still be drawing the others
+		static const size_t RingRegions = 3;
+
+		void __Allocate(size_t capacity);
+		void __WaitForRegion();
+		void __DrawRun(GLuint texture, size_t first, size_t count);
+
+		SortMode m_SortMode;
+
+		// Sprites waiting for the next flush, 4 vertices each
+		std::vector<SpriteVert> m_Queued;
+		std::vector<GLuint>     m_Textures;
+		std::vector<float>      m_Depths;
+		std::vector<uint64_t>   m_Keys, m_KeyScratch;
+
+		GLuint   m_VAO, m_VBO, m_EBO, m_Shader;
+		uint8_t* m_Mapped;
+		size_t   m_Capacity; // Sprites each region can hold
+		size_t   m_Region;
+		GLsync   m_Fences[RingRegions];
+
+		BatchStats m_Stats;
+	};
+
+}
@@ -14,6 +14,7 @@
 
 #include <GLM/glm.hpp>
 #include "Texture2D.h"
+#include "SpriteAtlas.h"
 #include <vector>
 
 namespace TTK {
@@ -29,6 +30,8 @@ namespace TTK {
 		float uMin, uMax, vMin, vMax; // normalized texture coordinates
 	};
 
+	class SpriteBatch;
+
 	class SpriteSheetQuad
 	{
 	public:
@@ -57,6 +60,16 @@ namespace TTK {
 		 * @animTim The time it should take to complete one full cycle of the animation, if this is 0, then the sprite will default to 60 FPS
 		 */
 		void SliceSpriteSheet(const char* fileName, int numSpritesPerRow, int numRows, float animTime = 0.0f);
+		/*
+		 * Packs a sprite sheet into an atlas and calculates coordinates for each sprite in it, sheets that share an
+		 * atlas page can be drawn in the same batch run
+		 * @param atlas The atlas to pack the sheet into, it must outlive this sprite
+		 * @param fileName The path to the texture to load, relative to the current working directory
+		 * @param numSpritesPerRow The number of sprites in a single row
+		 * @param numRows The number of rows that make up the sheet
+		 * @animTim The time it should take to complete one full cycle of the animation, if this is 0, then the sprite will default to 60 FPS
+		 */
+		void SliceSpriteSheet(SpriteAtlas& atlas, const char* fileName, int numSpritesPerRow, int numRows, float animTime = 0.0f);
 
 		/*
 		 * Updates this sprite, and advances to the next frame if required
@@ -80,6 +93,12 @@ namespace TTK {
 		 * @param matrix The MVP matrix to render this sprite with
 		 */
 		void Draw(const glm::mat4& matrix);
+		/*
+		 * Adds this sprite to a batch, to be drawn when the batch is flushed
+		 * @param batch The batch to add the sprite to
+		 * @param matrix The MVP matrix to render this sprite with
+		 */
+		void Draw(SpriteBatch& batch, const glm::mat4& matrix) const;
 
 		/*
 		 * Sets a given frame to last for a given duration in seconds
@@ -111,6 +130,15 @@ namespace TTK {
 		 */
 		int GetNumberOfFrames() const;
 
+		/*
+		 * Gets the coordinates of the frame that's showing
+		 */
+		const SpriteCoordinates& GetCurrentCoordinates() const { return m_SpriteCoordinates[m_CurrentFrame]; }
+		/*
+		 * Gets the texture this sprite draws from, either its own texture or an atlas page
+		 */
+		uint32_t GetTextureID() const { return m_AtlasTexture != 0 ? m_AtlasTexture : m_Texture.GetID(); }
+
 	private:
 		struct QuadVert {
 			glm::vec3 Position;
@@ -124,6 +152,12 @@ namespace TTK {
 		glm::vec4 m_Color;
 		QuadVert  m_Vertices[4];
 		uint32_t m_VAO, m_VBO, m_EBO, m_Shader;
+		// The atlas page this sheet was packed into, 0 if it has its own texture
+		uint32_t m_AtlasTexture;
+
+		// Slices a sheet that sits at the given pixel offset in a texture
+		void __BuildFrames(float originX, float originY, float sheetWidth, float sheetHeight, float textureWidth, float textureHeight,
+			int numSpritesPerRow, int numRows, float animTime);
 
 		std::vector<SpriteCoordinates> m_SpriteCoordinates;
 
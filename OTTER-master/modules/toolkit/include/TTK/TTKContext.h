@@ -13,6 +13,7 @@
 //////////////////////////////////////////////////////////////////////////
 #pragma once
 
+#include <string>
 #include <GLM/glm.hpp>
 #include "FontRenderer.h"
 
@@ -65,6 +66,11 @@ namespace TTK
 		void SetViewport(int x, int y, int w, int h);
 
 		void RenderText(const char* text, const glm::vec2& position, const glm::vec4& color, float scale = 1.0f);
+
+		// Sets the font RenderText uses, this can be called before or after the context is created. With no font set,
+		// the TTK_FONT environment variable is checked, then a few common system monospace fonts
+		static void SetDefaultFont(const std::string& path, uint32_t size = 32);
+		TTK::TrueTypeTextureFont& GetDefaultFont() const { return *m_DefaultFont; }
 		
 		void DrawTeapot(const glm::mat4& mat, const glm::vec4& color = glm::vec4(1.0f)) const;
 		void DrawSphere(const glm::mat4& mat, const glm::vec4& color = glm::vec4(1.0f)) const;
@@ -75,10 +81,29 @@ namespace TTK
 		void AddQuad(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color = { 0, 0, 0, 1 });
 		void AddPoint(const glm::vec3& pos, float size, const glm::vec4& color = { 0, 0, 0, 1 });
 		
+		// Draws everything added since the last flush (one draw per primitive type) and then the batched text, and moves
+		// each streaming buffer on to its next region. Graphics::EndFrame calls this once a frame
 		void Flush();
 
+		struct StreamStats {
+			size_t DrawCalls = 0; // Draws issued by the last flush
+			size_t Vertices  = 0; // Vertices drawn by the last flush
+			size_t Grows     = 0; // How many times a buffer has had to grow
+			size_t Stalls    = 0; // How many times we had to wait for the GPU to finish with a region
+			double StallMs   = 0.0;
+		};
+		const StreamStats& GetStreamStats() const { return m_Stats; }
+
+		// Draws random lines through the streaming buffers and through the old fixed size batches, and logs the CPU and
+		// GPU time for each. Draws into whatever framebuffer is bound
+		void RunLineBenchmark(size_t lineCount = 1000000);
+
 	private:
 		Context();
+		static std::string __FindDefaultFont();
+		static std::string m_DefaultFontPath;
+		static uint32_t    m_DefaultFontSize;
+
 		glm::mat4				  m_Projection;
 		glm::mat4                 m_ViewMatrix;
 		glm::mat4                 m_ViewProjection;
@@ -87,29 +112,52 @@ namespace TTK
 
 		GLuint m_ShaderHandle;
 		GLuint m_PointShaderHandle;
+
+		// Every streaming buffer is split into this many regions, so the CPU can fill one while the GPU draws the others
+		static const size_t RingRegions = 3;
+
+		// A persistently mapped vertex buffer, vertices get written straight into the mapped region
 		struct GLBuff {
-			GLuint VBO, VAO;
-			size_t Count;
-			size_t ElemSize;
-			GLenum Mode;
-			void*  Data;
-			GLuint Shader;
+			GLuint   VBO, VAO;
+			size_t   Count;    // Vertices written into the current region
+			size_t   Capacity; // Vertices each region can hold
+			size_t   ElemSize;
+			GLenum   Mode;
+			uint8_t* Mapped;
+			size_t   Region;
+			GLsync   Fences[RingRegions]; // Signalled once the GPU is done drawing each region
+			GLuint   Shader;
 		};
 		GLBuff m_Tris, m_Lines, m_Points;
+		StreamStats m_Stats;
 
 		int m_WindowWidth, m_WindowHeight;
 		int m_viewportX, m_viewportY;
 
-		GLBuff __InitBuff(GLenum mode, GLuint shader, void* dataSource, size_t elemSize, size_t maxElems);
+		GLBuff __InitBuff(GLenum mode, GLuint shader, size_t elemSize, size_t capacity);
+		void __Allocate(GLBuff& buff, size_t capacity);
+		void __Grow(GLBuff& buff, size_t required);
+		// Reallocates the buffer with a new capacity, what's been written this frame has to fit in it
+		void __Resize(GLBuff& buff, size_t capacity);
+		void __WaitForRegion(GLBuff& buff);
 		void __Flush(GLBuff& buff);
+		void __DestroyBuff(GLBuff& buff);
 		GLuint __CompileShader(const char* vsSource, const char* fsSource);
 
-		static const size_t MaxPointVerts = 512;
-		static const size_t MaxLineVerts = 512 * 2;
-		static const size_t MaxTriVerts = 512 * 3;
+		// Makes room for count more vertices in the current region and returns where to write them
+		template <typename T>
+		T* __Reserve(GLBuff& buff, size_t count) {
+			if (buff.Count + count > buff.Capacity) {
+				__Grow(buff, buff.Count + count);
+			}
+			T* result = reinterpret_cast<T*>(buff.Mapped + (buff.Region * buff.Capacity + buff.Count) * buff.ElemSize);
+			buff.Count += count;
+			return result;
+		}
 
-		PointVert  m_PointVerts[MaxPointVerts];
-		SimpleVert m_LineVerts[MaxLineVerts];
-		SimpleVert m_TriVerts[MaxTriVerts];
+		// Starting sizes, the buffers double whenever a frame needs more
+		static const size_t InitialPointVerts = 512;
+		static const size_t InitialLineVerts = 512 * 2;
+		static const size_t InitialTriVerts = 512 * 3;
 	};
 }
@@ -12,6 +12,11 @@
 
 #include "TTK/FontRenderer.h"
 #include <fstream>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <string>
 #include "Logging.h"
 #include <GLM/gtc/matrix_transform.hpp>
 #include "TTK/TTKContext.h"
@@ -51,23 +56,78 @@ char* readFile(const char* filename) {
 	}
 }
 
+// Reads one codepoint from a UTF-8 string and moves past it, anything malformed comes back as U+FFFD
+static int decodeUtf8(const char*& text) {
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text);
+	int length;
+	int result;
+	if (bytes[0] < 0x80) { text++; return bytes[0]; }
+	else if ((bytes[0] & 0xE0) == 0xC0) { length = 2; result = bytes[0] & 0x1F; }
+	else if ((bytes[0] & 0xF0) == 0xE0) { length = 3; result = bytes[0] & 0x0F; }
+	else if ((bytes[0] & 0xF8) == 0xF0) { length = 4; result = bytes[0] & 0x07; }
+	else { text++; return 0xFFFD; }
+
+	for (int ix = 1; ix < length; ix++) {
+		// The null terminator isn't a continuation byte, so this never reads past the end
+		if ((bytes[ix] & 0xC0) != 0x80) {
+			text += ix;
+			return 0xFFFD;
+		}
+		result = (result << 6) | (bytes[ix] & 0x3F);
+	}
+	text += length;
+	return result;
+}
+
+// Appends a codepoint to a string as UTF-8
+static void encodeUtf8(std::string& result, int codePoint) {
+	if (codePoint < 0x80) {
+		result += static_cast<char>(codePoint);
+	} else if (codePoint < 0x800) {
+		result += static_cast<char>(0xC0 | (codePoint >> 6));
+		result += static_cast<char>(0x80 | (codePoint & 0x3F));
+	} else if (codePoint < 0x10000) {
+		result += static_cast<char>(0xE0 | (codePoint >> 12));
+		result += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+		result += static_cast<char>(0x80 | (codePoint & 0x3F));
+	} else {
+		result += static_cast<char>(0xF0 | (codePoint >> 18));
+		result += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+		result += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+		result += static_cast<char>(0x80 | (codePoint & 0x3F));
+	}
+}
+
 TTK::FontRenderer* TTK::FontRenderer::m_Instance = nullptr;
 
 TTK::TrueTypeTextureFont::TrueTypeTextureFont(const char* fileName, uint32_t size)
 {
 	myFontSize = size;
+	myFontData = nullptr;
+	myTexture = 0;
+	m_TexHandle = 0;
+	myHead = myTail = -1;
+	myBatch = 0;
+	myCellWidth = myCellHeight = myCellsX = 0;
+	myPixelHeightScale = myEmToPixel = 0.0f;
+	myAscent = myDescent = myLineGap = 0;
+	for (int ix = 0; ix < 128; ix++) {
+		myAsciiLookup[ix] = -1;
+	}
 
 	unsigned char* fontData = (unsigned char*)readFile(fileName);
-	uint8_t* atlasData = new uint8_t[static_cast<size_t>(ATLAS_WIDTH) * ATLAS_HEIGHT];
-
-	myCharInfo = new stbtt_packedchar[CHAR_COUNT];
+	if (fontData == nullptr) {
+		LOG_ERROR("Failed to open font \"{}\"", fileName);
+		return;
+	}
 
-	if (!stbtt_InitFont(&myFontInfo, fontData, 0)) {
+	if (!stbtt_InitFont(&myFontInfo, fontData, stbtt_GetFontOffsetForIndex(fontData, 0))) {
 		LOG_ERROR("Failed to initialize font");
-		delete[] atlasData;
 		delete[] fontData;
 		return;
 	}
+	// stb_truetype reads the font straight out of this whenever it rasterizes or kerns, so it lives as long as we do
+	myFontData = fontData;
 
 	// Gets the font metrics
 	stbtt_GetFontVMetrics(&myFontInfo, &myAscent, &myDescent, &myLineGap);
@@ -75,77 +135,247 @@ TTK::TrueTypeTextureFont::TrueTypeTextureFont(const char* fileName, uint32_t siz
 	myPixelHeightScale = stbtt_ScaleForPixelHeight(&myFontInfo, static_cast<float>(size));
 	myEmToPixel = stbtt_ScaleForMappingEmToPixels(&myFontInfo, 1.0f);
 
-	stbtt_pack_context context;
-	if (!stbtt_PackBegin(&context, atlasData, ATLAS_WIDTH, ATLAS_HEIGHT, 0, 1, nullptr)) {
-		LOG_ERROR("Failed to pack font texture");
-		delete[] atlasData;
-		delete[] fontData;
-		return;
+	// Every cell fits the font's bounding box, plus the room the oversampling filter spreads into and a pixel of padding
+	// so neighbouring glyphs don't bleed into each other. Some fonts have huge bounding boxes, so we always make sure
+	// there's at least 16 cells (anything bigger gets clipped)
+	int x0, y0, x1, y1;
+	stbtt_GetFontBoundingBox(&myFontInfo, &x0, &y0, &x1, &y1);
+	myCellWidth = static_cast<int>(std::ceil((x1 - x0) * myPixelHeightScale * FONT_OVERSAMPLE_X)) + FONT_OVERSAMPLE_X;
+	myCellHeight = static_cast<int>(std::ceil((y1 - y0) * myPixelHeightScale * FONT_OVERSAMPLE_Y)) + FONT_OVERSAMPLE_Y;
+	myCellWidth = glm::clamp(myCellWidth, 2, static_cast<int>(ATLAS_WIDTH / 4));
+	myCellHeight = glm::clamp(myCellHeight, 2, static_cast<int>(ATLAS_HEIGHT / 4));
+	myCellsX = ATLAS_WIDTH / myCellWidth;
+	int cellsY = ATLAS_HEIGHT / myCellHeight;
+
+	// All the cells start out free, and in the list so they get handed out before anything is evicted
+	myCells.resize(static_cast<size_t>(myCellsX) * cellsY);
+	for (int ix = 0; ix < static_cast<int>(myCells.size()); ix++) {
+		myCells[ix].GlyphId = -1;
+		myCells[ix].Batch = UINT64_MAX;
+		__PushFront(ix);
 	}
+	myStats.Cells = myCells.size();
+	myScratch.resize(static_cast<size_t>(myCellWidth) * myCellHeight);
 
-	stbtt_PackSetOversampling(&context, FONT_OVERSAMPLE_X, FONT_OVERSAMPLE_Y);
-	if (!stbtt_PackFontRange(&context, fontData, 0, static_cast<float>(size), FIRST_CHAR, CHAR_COUNT, myCharInfo)) {
-		LOG_ERROR("Failed to pack font range");
-		delete[] atlasData;
-		delete[] fontData;
-		return;
-	}
-	stbtt_PackEnd(&context);
-
-	for (uint32_t ix = FIRST_CHAR; ix < FIRST_CHAR + CHAR_COUNT; ix++) {
-		// TODO: Grab glyph data
-	}
-
-	// Create and upload the texture to store our font in
+	// Create the texture to store our font in, the glyphs get uploaded into it as they're needed
+	std::vector<uint8_t> atlasData(static_cast<size_t>(ATLAS_WIDTH) * ATLAS_HEIGHT, 0);
 	LOG_ASSERT(glGetError() == GL_NONE, "Some error has occured!");
 	glCreateTextures(GL_TEXTURE_2D, 1, &myTexture);
 	glTextureParameteri(myTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTextureParameteri(myTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTextureParameteri(myTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+	glTextureParameteri(myTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTextureParameteri(myTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	LOG_ASSERT(glGetError() == GL_NONE, "Some error has occured!");
 	glTextureStorage2D(myTexture, 1, GL_R8, ATLAS_WIDTH, ATLAS_HEIGHT);
 	LOG_ASSERT(glGetError() == GL_NONE, "Internal texture format not supported");
-	glTextureSubImage2D(myTexture, 0, 0, 0, ATLAS_WIDTH, ATLAS_HEIGHT, GL_RED, GL_UNSIGNED_BYTE, atlasData);
+	glTextureSubImage2D(myTexture, 0, 0, 0, ATLAS_WIDTH, ATLAS_HEIGHT, GL_RED, GL_UNSIGNED_BYTE, atlasData.data());
 	LOG_ASSERT(glGetError() == GL_NONE, "Texture transfer format not supported");
 	m_TexHandle = glGetTextureHandleARB(myTexture);
 	glMakeTextureHandleResidentARB(m_TexHandle);
 
-	delete[] atlasData;
-	delete[] fontData;
+	for (uint32_t ix = FIRST_CHAR; ix < FIRST_CHAR + CHAR_COUNT; ix++) {
+		GetGlyph(ix, 0.0f, 0.0f);
+	}
 }
 
 TTK::TrueTypeTextureFont::~TrueTypeTextureFont()
 {
-	delete[] myCharInfo;
+	// Don't leave the renderer holding quads that point into our atlas
+	if (FontRenderer::HasInstance()) {
+		FontRenderer::Instance().__Discard(this);
+	}
+	if (m_TexHandle != 0) {
+		glMakeTextureHandleNonResidentARB(m_TexHandle);
+	}
 	glDeleteTextures(1, &myTexture);
+	delete[] myFontData;
 }
 
 TTK::GlyphInfo TTK::TrueTypeTextureFont::GetGlyph(int codePoint, float offsetX, float offsetY) const {
-	stbtt_aligned_quad quad;
-
-	stbtt_GetPackedQuad(myCharInfo, ATLAS_WIDTH, ATLAS_HEIGHT, codePoint - FIRST_CHAR, &offsetX, &offsetY, &quad, 1);
-	auto xmin = quad.x0;
-	auto xmax = quad.x1;
-	auto ymin = -quad.y1;
-	auto ymax = -quad.y0;
+	return __GetGlyph(codePoint, offsetX, offsetY, true);
+}
 
+TTK::GlyphInfo TTK::TrueTypeTextureFont::__GetGlyph(int codePoint, float offsetX, float offsetY, bool rasterize) const {
 	GlyphInfo info = GlyphInfo();
-	info.OffsetX = offsetX;
+	if (!IsValid()) {
+		info.OffsetX = offsetX;
+		info.OffsetY = offsetY;
+		return info;
+	}
+
+	Glyph& glyph = myGlyphs[__FindGlyph(codePoint)];
+	if (rasterize && glyph.Width > 0) {
+		if (glyph.Cell < 0) {
+			__Rasterize(glyph, static_cast<int>(&glyph - myGlyphs.data()));
+		} else {
+			__Touch(glyph.Cell);
+		}
+	}
+
+	// Same as stbtt_GetPackedQuad, snapping the quad to whole pixels
+	float x0 = std::floor(offsetX + glyph.XOff + 0.5f);
+	float y0 = std::floor(offsetY + glyph.YOff + 0.5f);
+	float x1 = x0 + glyph.XOff2 - glyph.XOff;
+	float y1 = y0 + glyph.YOff2 - glyph.YOff;
+
+	float s0 = 0.0f, t0 = 0.0f, s1 = 0.0f, t1 = 0.0f;
+	if (glyph.Cell >= 0) {
+		int cellX = (glyph.Cell % myCellsX) * myCellWidth;
+		int cellY = (glyph.Cell / myCellsX) * myCellHeight;
+		s0 = cellX / static_cast<float>(ATLAS_WIDTH);
+		t0 = cellY / static_cast<float>(ATLAS_HEIGHT);
+		s1 = (cellX + glyph.Width) / static_cast<float>(ATLAS_WIDTH);
+		t1 = (cellY + glyph.Height) / static_cast<float>(ATLAS_HEIGHT);
+	}
+
+	info.OffsetX = offsetX + glyph.Advance;
 	info.OffsetY = offsetY;
-	info.Positions[0] = { xmax, -ymin };
-	info.Positions[1] = { xmax, -ymax };
-	info.Positions[2] = { xmin, -ymax };
-	info.Positions[3] = { xmin, -ymin };
-	info.UVs[0] = { quad.s1, quad.t1 };
-	info.UVs[1] = { quad.s1, quad.t0 };
-	info.UVs[2] = { quad.s0, quad.t0 };
-	info.UVs[3] = { quad.s0, quad.t1 };
+	info.Positions[0] = { x1, y1 };
+	info.Positions[1] = { x1, y0 };
+	info.Positions[2] = { x0, y0 };
+	info.Positions[3] = { x0, y1 };
+	info.UVs[0] = { s1, t1 };
+	info.UVs[1] = { s1, t0 };
+	info.UVs[2] = { s0, t0 };
+	info.UVs[3] = { s0, t1 };
 
 	return info;
 }
 
+int TTK::TrueTypeTextureFont::__FindGlyph(int codePoint) const {
+	int* asciiSlot = (codePoint >= 0 && codePoint < 128) ? &myAsciiLookup[codePoint] : nullptr;
+	if (asciiSlot != nullptr) {
+		if (*asciiSlot >= 0) {
+			return *asciiSlot;
+		}
+	} else {
+		auto it = myGlyphLookup.find(codePoint);
+		if (it != myGlyphLookup.end()) {
+			return it->second;
+		}
+	}
+
+	// Codepoints the font doesn't have all map to the missing glyph, so share one entry per glyph rather than per codepoint
+	int glyphIndex = stbtt_FindGlyphIndex(&myFontInfo, codePoint);
+	auto existing = myIndexLookup.find(glyphIndex);
+	if (existing != myIndexLookup.end()) {
+		if (asciiSlot != nullptr) {
+			*asciiSlot = existing->second;
+		} else {
+			myGlyphLookup[codePoint] = existing->second;
+		}
+		return existing->second;
+	}
+
+	// First time we've seen this glyph, work out its metrics the same way stbtt_PackFontRanges does
+	Glyph glyph;
+	glyph.GlyphIndex = glyphIndex;
+	glyph.Cell = -1;
+
+	int advance, leftBearing;
+	stbtt_GetGlyphHMetrics(&myFontInfo, glyph.GlyphIndex, &advance, &leftBearing);
+	glyph.Advance = advance * myPixelHeightScale;
+
+	int x0, y0, x1, y1;
+	stbtt_GetGlyphBitmapBox(&myFontInfo, glyph.GlyphIndex,
+		myPixelHeightScale * FONT_OVERSAMPLE_X, myPixelHeightScale * FONT_OVERSAMPLE_Y, &x0, &y0, &x1, &y1);
+	if (x1 > x0 && y1 > y0) {
+		// Leave the cell's last row and column empty as padding
+		glyph.Width = glm::min(x1 - x0 + static_cast<int>(FONT_OVERSAMPLE_X) - 1, myCellWidth - 1);
+		glyph.Height = glm::min(y1 - y0 + static_cast<int>(FONT_OVERSAMPLE_Y) - 1, myCellHeight - 1);
+	} else {
+		glyph.Width = glyph.Height = 0;
+	}
+
+	// The prefilter shifts the glyph by half the filter width
+	const float subX = -(FONT_OVERSAMPLE_X - 1.0f) / (2.0f * FONT_OVERSAMPLE_X);
+	const float subY = -(FONT_OVERSAMPLE_Y - 1.0f) / (2.0f * FONT_OVERSAMPLE_Y);
+	glyph.XOff = x0 / static_cast<float>(FONT_OVERSAMPLE_X) + subX;
+	glyph.YOff = y0 / static_cast<float>(FONT_OVERSAMPLE_Y) + subY;
+	glyph.XOff2 = (x0 + glyph.Width) / static_cast<float>(FONT_OVERSAMPLE_X) + subX;
+	glyph.YOff2 = (y0 + glyph.Height) / static_cast<float>(FONT_OVERSAMPLE_Y) + subY;
+
+	int result = static_cast<int>(myGlyphs.size());
+	myGlyphs.push_back(glyph);
+	myIndexLookup[glyphIndex] = result;
+	if (asciiSlot != nullptr) {
+		*asciiSlot = result;
+	} else {
+		myGlyphLookup[codePoint] = result;
+	}
+	return result;
+}
+
+void TTK::TrueTypeTextureFont::__Rasterize(Glyph& glyph, int glyphId) const {
+	int cell = myTail;
+	if (myCells[cell].Batch == myBatch) {
+		// Everything in the atlas is waiting to be drawn, so draw it before we reuse a cell
+		myStats.Flushes++;
+		if (FontRenderer::HasInstance()) {
+			FontRenderer::Instance().Flush();
+		}
+		// Glyphs grabbed with GetGlyph outside of the renderer can be stamped too, they just lose their cells
+		if (myCells[cell].Batch == myBatch) {
+			myBatch++;
+		}
+	}
+
+	if (myCells[cell].GlyphId >= 0) {
+		myGlyphs[myCells[cell].GlyphId].Cell = -1;
+		myStats.Evictions++;
+	} else {
+		myStats.Resident++;
+	}
+
+	// Clear the whole cell so nothing from the last glyph is left in the padding
+	memset(myScratch.data(), 0, myScratch.size());
+	float subX, subY;
+	stbtt_MakeGlyphBitmapSubpixelPrefilter(&myFontInfo, myScratch.data(), glyph.Width, glyph.Height, myCellWidth,
+		myPixelHeightScale * FONT_OVERSAMPLE_X, myPixelHeightScale * FONT_OVERSAMPLE_Y, 0.0f, 0.0f,
+		FONT_OVERSAMPLE_X, FONT_OVERSAMPLE_Y, &subX, &subY, glyph.GlyphIndex);
+
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(myTexture, 0, (cell % myCellsX) * myCellWidth, (cell / myCellsX) * myCellHeight,
+		myCellWidth, myCellHeight, GL_RED, GL_UNSIGNED_BYTE, myScratch.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+	myCells[cell].GlyphId = glyphId;
+	glyph.Cell = cell;
+	myStats.Rasterized++;
+	__Touch(cell);
+}
+
+void TTK::TrueTypeTextureFont::__Touch(int cell) const {
+	// Cells used this batch are all in front of the ones that weren't, so there's no need to move them again
+	if (myCells[cell].Batch == myBatch) {
+		return;
+	}
+	myCells[cell].Batch = myBatch;
+	if (myHead != cell) {
+		__Unlink(cell);
+		__PushFront(cell);
+	}
+}
+
+void TTK::TrueTypeTextureFont::__Unlink(int cell) const {
+	Cell& item = myCells[cell];
+	if (item.Prev >= 0) myCells[item.Prev].Next = item.Next; else myHead = item.Next;
+	if (item.Next >= 0) myCells[item.Next].Prev = item.Prev; else myTail = item.Prev;
+	item.Prev = item.Next = -1;
+}
+
+void TTK::TrueTypeTextureFont::__PushFront(int cell) const {
+	Cell& item = myCells[cell];
+	item.Prev = -1;
+	item.Next = myHead;
+	if (myHead >= 0) myCells[myHead].Prev = cell; else myTail = cell;
+	myHead = cell;
+}
+
 float TTK::TrueTypeTextureFont::GetKerning(int char1, int char2) const {
+	if (!IsValid()) return 0.0f;
 	return stbtt_GetCodepointKernAdvance(&myFontInfo, char1, char2) * myPixelHeightScale;
 }
 
@@ -156,64 +386,66 @@ float TTK::TrueTypeTextureFont::GetLineHeight() const {
 glm::vec2 TTK::TrueTypeTextureFont::MeausureString(const char* text, const float scale) {
 	float multiplier = scale;
 
-	glm::vec2 originPos = glm::vec2();
-
 	GlyphInfo glyph;
 
-	size_t length = strlen(text);
 	float xOff{ 0 }, yOff{ 0 };
 	float lineHeight = 0.0f;
 	float maxWidth = 0.0f;
 	float totalHeight = 0.0f;
 
-	for (size_t i = 0; i < length; i++) {
-		glyph = GetGlyph(text[i], xOff, yOff);
+	const char* cursor = text;
+	while (*cursor != '\0') {
+		int codePoint = decodeUtf8(cursor);
+		glyph = __GetGlyph(codePoint, xOff, yOff, false);
 		xOff = glyph.OffsetX;
 		yOff = glyph.OffsetY;
 
 		lineHeight = glm::max(lineHeight, -glyph.Positions[1].y);
 		maxWidth = glm::max(maxWidth, xOff);
 
-		if (text[i] == '\n')
+		if (codePoint == '\n')
 		{
 			yOff += GetLineHeight() * multiplier;
 			totalHeight += lineHeight;
 			lineHeight = 0.0f;
 			xOff = 0;
 		}
-		else if (text[i] == '\r') {
+		else if (codePoint == '\r') {
 			xOff = 0;
 		}
-		else if (text[i] == '\t') {
-			float xOffTemp{ 0 }, yOffTemp{ 0 };
-			glyph = GetGlyph(' ', xOffTemp, yOffTemp);
+		else if (codePoint == '\t') {
+			glyph = __GetGlyph(' ', 0.0f, 0.0f, false);
 			xOff += glyph.OffsetX * 4;
 		}
 	}
-	GlyphInfo space = GetGlyph('|', xOff, yOff);
+	GlyphInfo space = __GetGlyph('|', xOff, yOff, false);
 	yOff += -(space.Positions[1].y - space.Positions[0].y);
 	return glm::vec2(xOff, yOff);
 }
 
 TTK::FontRenderer::~FontRenderer()
 {
-	glDeleteShader(m_ShaderHandle);
+	glDeleteProgram(m_ShaderHandle);
+	glDeleteBuffers(1, &m_VBO);
+	glDeleteBuffers(1, &m_EBO);
 	glDeleteVertexArrays(1, &m_VAO);
 }
 
 void TTK::FontRenderer::Render(const TrueTypeTextureFont& font, const char* text, const glm::vec2& pos, const glm::vec4& color, float scale)
 {
-	size_t length = strlen(text);
-	
-	float multiplier = scale;
+	if (!font.IsValid()) {
+		return;
+	}
+	// Everything in a batch samples one atlas
+	if (m_BatchFont != &font) {
+		Flush();
+		m_BatchFont = &font;
+	}
 
-	// The number of quads ACTUALLY drawn Shit-For-Brains
-	int quads = 0;
+	float multiplier = scale;
 
 	glm::vec2 originPos = glm::vec2(pos.x, pos.y);
 
-	static GlyphInfo glyph;
-
 	Col8 gpuCol;
 	gpuCol.R = static_cast<char>(color.r * 255);
 	gpuCol.G = static_cast<char>(color.g * 255);
@@ -222,56 +454,74 @@ void TTK::FontRenderer::Render(const TrueTypeTextureFont& font, const char* text
 
 	float xOff{ 0 }, yOff{ 0 };
 
-	for (int i = 0; i < length; i++) {
-		glyph = font.GetGlyph(text[i], xOff, yOff);
-		xOff = glyph.OffsetX;
-		yOff = glyph.OffsetY;
+	const char* cursor = text;
+	while (*cursor != '\0') {
+		int codePoint = decodeUtf8(cursor);
 
-		if (text[i] == '\n')
+		if (codePoint == '\n')
 		{
-			yOff += font.GetLineHeight() * multiplier;
+			// The offsets get scaled along with the glyphs
+			yOff += font.GetLineHeight();
 			xOff = 0;
 		}
-		else if (text[i] == '\r') {
+		else if (codePoint == '\r') {
 			xOff = 0;
 		}
-		else if (text[i] == '\t') {
-			float xOffTemp{ 0 }, yOffTemp{ 0 };
-			glyph = font.GetGlyph(' ', xOffTemp, yOffTemp);
-			xOff += glyph.OffsetX * 4;
+		else if (codePoint == '\t') {
+			xOff += font.__GetGlyph(' ', 0.0f, 0.0f, false).OffsetX * 4;
 		}
-		else {
-			m_MeshData[quads * 4 + 0].Position = originPos + glyph.Positions[0] * multiplier;
-			m_MeshData[quads * 4 + 0].UV = glyph.UVs[0];
-			m_MeshData[quads * 4 + 0].Color = gpuCol;
-
-			m_MeshData[quads * 4 + 1].Position = originPos + glyph.Positions[1] * multiplier;
-			m_MeshData[quads * 4 + 1].UV = glyph.UVs[1];
-			m_MeshData[quads * 4 + 1].Color = gpuCol;
-
-			m_MeshData[quads * 4 + 2].Position = originPos + glyph.Positions[2] * multiplier;
-			m_MeshData[quads * 4 + 2].UV = glyph.UVs[2];
-			m_MeshData[quads * 4 + 2].Color = gpuCol;
-
-			m_MeshData[quads * 4 + 3].Position = originPos + glyph.Positions[3] * multiplier;
-			m_MeshData[quads * 4 + 3].UV = glyph.UVs[3];
-			m_MeshData[quads * 4 + 3].Color = gpuCol;
-
+		else if (codePoint >= ' ') {
+			// This can flush the batch if the atlas has to make room, so only reserve space after it
+			GlyphInfo glyph = font.GetGlyph(codePoint, xOff, yOff);
+			xOff = glyph.OffsetX;
+			yOff = glyph.OffsetY;
+
+			// Skip spaces and anything else with nothing to draw
+			if (glyph.Positions[0].x == glyph.Positions[2].x) {
+				continue;
+			}
+
+			__Reserve(1);
+			Vert* verts = &m_MeshData[m_Quads * 4];
+			for (int ix = 0; ix < 4; ix++) {
+				verts[ix].Position = originPos + glyph.Positions[ix] * multiplier;
+				verts[ix].UV = glyph.UVs[ix];
+				verts[ix].Color = gpuCol;
+			}
+			m_Quads++;
+		}
+	}
+}
 
-			m_IndexData[quads * 6 + 0] = quads * 4 + 0;
-			m_IndexData[quads * 6 + 1] = quads * 4 + 1;
-			m_IndexData[quads * 6 + 2] = quads * 4 + 2;
+void TTK::FontRenderer::__Reserve(size_t quads) {
+	size_t required = (m_Quads + quads) * 4;
+	if (required > m_MeshData.size()) {
+		m_MeshData.resize(glm::max(required, m_MeshData.size() * 2));
+	}
+}
 
-			m_IndexData[quads * 6 + 3] = quads * 4 + 0;
-			m_IndexData[quads * 6 + 4] = quads * 4 + 2;
-			m_IndexData[quads * 6 + 5] = quads * 4 + 3;
+void TTK::FontRenderer::Flush()
+{
+	if (m_Quads == 0 || m_BatchFont == nullptr) {
+		return;
+	}
 
-			quads++;
+	// Orphan the vertex buffer so we don't wait on the GPU to finish drawing the last batch
+	while (m_VertCapacity < m_Quads) {
+		m_VertCapacity *= 2;
+	}
+	glNamedBufferData(m_VBO, m_VertCapacity * 4 * sizeof(Vert), nullptr, GL_STREAM_DRAW);
+	glNamedBufferSubData(m_VBO, 0, m_Quads * 4 * sizeof(Vert), m_MeshData.data());
+
+	// The indices are the same for every batch, so they only change when we need more of them
+	if (m_Quads > m_IndexCapacity) {
+		size_t capacity = m_IndexCapacity;
+		while (capacity < m_Quads) {
+			capacity *= 2;
 		}
+		__BuildIndices(capacity);
 	}
 
-	length = quads;
-
 	// Update and render our meshes
 	bool blendState = glIsEnabled(GL_BLEND);
 	GLboolean depthMaskEnabled = false;
@@ -283,46 +533,165 @@ void TTK::FontRenderer::Render(const TrueTypeTextureFont& font, const char* text
 	glm::mat4 proj = TTK::Context::Instance().GetOrthoProjection();
 	glUseProgram(m_ShaderHandle);
 	glProgramUniformMatrix4fv(m_ShaderHandle, 0, 1, false, &proj[0][0]);
-	glProgramUniformHandleui64ARB(m_ShaderHandle, 1, font.m_TexHandle);	
+	glProgramUniformHandleui64ARB(m_ShaderHandle, 1, m_BatchFont->m_TexHandle);
 	glBindVertexArray(m_VAO);
-	glNamedBufferSubData(m_VBO, 0, length * 4 * sizeof(Vert), m_MeshData);
-	glNamedBufferSubData(m_EBO, 0, length * 6 * sizeof(GLuint), m_IndexData);
-	glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(length * 6), GL_UNSIGNED_INT, nullptr);
+	glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_Quads * 6), GL_UNSIGNED_INT, nullptr);
 	glBindVertexArray(0);
 	LOG_ASSERT(glGetError() == GL_NONE, "Failed to draw our text mesh!");
 	if (!blendState) glDisable(GL_BLEND);
 	glDepthMask(depthMaskEnabled);
+
+	m_Stats.DrawCalls++;
+	m_Stats.Glyphs += m_Quads;
+	m_Quads = 0;
+	// The glyphs in this batch are drawn, so the atlas is free to evict them now
+	m_BatchFont->myBatch++;
+}
+
+void TTK::FontRenderer::__BuildIndices(size_t quads) {
+	std::vector<GLuint> indices(quads * 6);
+	for (size_t ix = 0; ix < quads; ix++) {
+		GLuint base = static_cast<GLuint>(ix * 4);
+		indices[ix * 6 + 0] = base + 0;
+		indices[ix * 6 + 1] = base + 1;
+		indices[ix * 6 + 2] = base + 2;
+		indices[ix * 6 + 3] = base + 0;
+		indices[ix * 6 + 4] = base + 2;
+		indices[ix * 6 + 5] = base + 3;
+	}
+	glNamedBufferData(m_EBO, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+	m_IndexCapacity = quads;
+}
+
+void TTK::FontRenderer::EndFrame() {
+	m_LastStats = m_Stats;
+	m_Stats = BatchStats();
+}
+
+void TTK::FontRenderer::__Discard(const TrueTypeTextureFont* font) {
+	if (m_BatchFont == font) {
+		m_Quads = 0;
+		m_BatchFont = nullptr;
+	}
+}
+
+void TTK::FontRenderer::RunBenchmark(const TrueTypeTextureFont& font, size_t glyphCount) {
+	if (!font.IsValid()) {
+		LOG_WARN("Can't run the text benchmark without a font");
+		return;
+	}
+	Flush();
+
+	const size_t stringLength = 32;
+	size_t stringCount = glm::max<size_t>(glyphCount / stringLength, 1);
+	std::mt19937 rng(1234);
+	glm::mat4 ortho = TTK::Context::Instance().GetOrthoProjection();
+	// Undo the projection to get the size of the screen
+	float width = 2.0f / ortho[0][0];
+	float height = 2.0f / -ortho[1][1];
+	std::uniform_real_distribution<float> xRange(0.0f, glm::max(width - 200.0f, 1.0f));
+	std::uniform_real_distribution<float> yRange(0.0f, glm::max(height, 1.0f));
+	std::vector<glm::vec2> positions(stringCount);
+	for (glm::vec2& position : positions) {
+		position = glm::vec2(xRange(rng), yRange(rng));
+	}
+
+	// ASCII, which is all in the atlas already
+	std::uniform_int_distribution<int> ascii('!', '~');
+	std::vector<std::string> asciiStrings(stringCount);
+	for (std::string& text : asciiStrings) {
+		for (size_t ix = 0; ix < stringLength; ix++) {
+			encodeUtf8(text, ascii(rng));
+		}
+	}
+
+	// Latin, IPA, Greek and Cyrillic, which is more glyphs than the atlas holds for most fonts that have them
+	std::vector<int> codePoints;
+	for (int ix = 0xA1; ix <= 0x2AF; ix++) codePoints.push_back(ix);
+	for (int ix = 0x370; ix <= 0x4FF; ix++) codePoints.push_back(ix);
+	std::uniform_int_distribution<size_t> unicode(0, codePoints.size() - 1);
+	std::vector<std::string> unicodeStrings(stringCount);
+	for (std::string& text : unicodeStrings) {
+		for (size_t ix = 0; ix < stringLength; ix++) {
+			encodeUtf8(text, codePoints[unicode(rng)]);
+		}
+	}
+
+	GLuint query;
+	glGenQueries(1, &query);
+	const glm::vec4 color = glm::vec4(1.0f, 1.0f, 1.0f, 0.5f);
+	const float scale = 0.5f;
+
+	auto run = [&](const char* name, const std::vector<std::string>& strings, bool drawEach) {
+		TrueTypeTextureFont::AtlasStats atlas = font.GetAtlasStats();
+		BatchStats stats = m_Stats;
+
+		glFinish();
+		auto start = std::chrono::high_resolution_clock::now();
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		for (size_t ix = 0; ix < strings.size(); ix++) {
+			Render(font, strings[ix].c_str(), positions[ix], color, scale);
+			if (drawEach) {
+				Flush();
+			}
+		}
+		Flush();
+		glEndQuery(GL_TIME_ELAPSED);
+		double cpu = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		GLuint64 gpuTime = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpuTime);
+		double gpu = gpuTime / 1000000.0;
+
+		size_t glyphs = m_Stats.Glyphs - stats.Glyphs;
+		const TrueTypeTextureFont::AtlasStats& after = font.GetAtlasStats();
+		LOG_INFO("\t{}: {:.2f} ms CPU, {:.2f} ms GPU, {:.0f} glyphs/ms, {} draw(s), {} rasterized, {} evicted, {} early flush(es)",
+			name, cpu, gpu, cpu > 0.0 ? glyphs / cpu : 0.0, m_Stats.DrawCalls - stats.DrawCalls,
+			after.Rasterized - atlas.Rasterized, after.Evictions - atlas.Evictions, after.Flushes - atlas.Flushes);
+	};
+
+	// The first batch grows the vertex buffers, don't count that against either path
+	for (size_t ix = 0; ix < asciiStrings.size(); ix++) {
+		Render(font, asciiStrings[ix].c_str(), positions[ix], color, scale);
+	}
+	Flush();
+
+	LOG_INFO("Text benchmark, {} strings of {} glyphs, atlas holds {} glyphs:", stringCount, stringLength, font.GetAtlasStats().Cells);
+	run("ASCII, batched", asciiStrings, false);
+	run("ASCII, draw per string", asciiStrings, true);
+	run("Unicode, batched", unicodeStrings, false);
+	run("Unicode, draw per string", unicodeStrings, true);
+
+	glDeleteQueries(1, &query);
 }
 
 TTK::FontRenderer::FontRenderer() {
 	LOG_INFO("Initializing font renderer");
 
-	memset(m_MeshData, 0, sizeof(m_MeshData));
-	memset(m_IndexData, 0, sizeof(m_IndexData));
+	m_BatchFont = nullptr;
+	m_Quads = 0;
+	m_VertCapacity = InitialQuads;
+	m_IndexCapacity = 0;
+	m_MeshData.resize(InitialQuads * 4);
 
 	glCreateVertexArrays(1, &m_VAO);
-	glBindVertexArray(m_VAO);
 	GLuint buffers[2];
 	glCreateBuffers(2, buffers);
-	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
-	glNamedBufferData(buffers[0], 256 * 4 * sizeof(Vert), m_MeshData, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
-	glNamedBufferData(buffers[1], 256 * 6 * sizeof(GLuint), m_IndexData, GL_DYNAMIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-	#pragma warning(push)
-	#pragma warning(disable: 6011)
-	Vert* v = nullptr;
-	glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(Vert), &v->Position);
-	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, false, sizeof(Vert), &v->Color);
-	glVertexAttribPointer(2, 2, GL_FLOAT, false, sizeof(Vert), &v->UV);
-	#pragma warning(pop)
-	
-	glBindVertexArray(0);
-
 	m_VBO = buffers[0];
 	m_EBO = buffers[1];
+	glNamedBufferData(m_VBO, m_VertCapacity * 4 * sizeof(Vert), nullptr, GL_STREAM_DRAW);
+	glVertexArrayVertexBuffer(m_VAO, 0, m_VBO, 0, sizeof(Vert));
+	glVertexArrayElementBuffer(m_VAO, m_EBO);
+	glEnableVertexArrayAttrib(m_VAO, 0);
+	glEnableVertexArrayAttrib(m_VAO, 1);
+	glEnableVertexArrayAttrib(m_VAO, 2);
+	glVertexArrayAttribFormat(m_VAO, 0, 2, GL_FLOAT, false, offsetof(Vert, Position));
+	glVertexArrayAttribFormat(m_VAO, 1, 4, GL_UNSIGNED_BYTE, true, offsetof(Vert, Color));
+	glVertexArrayAttribFormat(m_VAO, 2, 2, GL_FLOAT, false, offsetof(Vert, UV));
+	glVertexArrayAttribBinding(m_VAO, 0, 0);
+	glVertexArrayAttribBinding(m_VAO, 1, 0);
+	glVertexArrayAttribBinding(m_VAO, 2, 0);
+
+	__BuildIndices(InitialQuads);
 
 	const char* vsSource = R"LIT(#version 430
             layout (location = 0) in vec2 vertexPosition;
@@ -345,7 +714,7 @@ TTK::FontRenderer::FontRenderer() {
             out vec4 frag_color;            	
             void main() {
                 frag_color = fragColor;
-				frag_color.a = texture2D(xSampler, fragUv).r;
+				frag_color.a *= texture2D(xSampler, fragUv).r;
             })LIT";
 
 	m_ShaderHandle = glCreateProgram();
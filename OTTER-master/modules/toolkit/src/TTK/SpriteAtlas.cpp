@@ -0,0 +1,169 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the Tutorial Tool Kit (TTK) library. 
+// You may not use this file in your GDW games.
+//
+// This file implements the TTK sprite atlas packer
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TTK/SpriteAtlas.h"
+#include "stb_image.h"
+#include <cstring>
+#include "Logging.h"
+
+TTK::SpriteAtlas::SpriteAtlas(int pageSize, int padding) :
+	m_PageSize(pageSize),
+	m_Padding(padding),
+	m_Pages(),
+	m_Scratch()
+{ }
+
+TTK::SpriteAtlas::~SpriteAtlas() {
+	for (Page* page : m_Pages) {
+		glDeleteTextures(1, &page->Texture);
+		delete page;
+	}
+}
+
+bool TTK::SpriteAtlas::Add(const Image& image, Region& result) {
+	stbrp_rect rect;
+	rect.id = 0;
+	rect.w = static_cast<stbrp_coord>(image.Width + m_Padding * 2);
+	rect.h = static_cast<stbrp_coord>(image.Height + m_Padding * 2);
+	if (rect.w > m_PageSize || rect.h > m_PageSize) {
+		LOG_ERROR("A {}x{} image won't fit in a {}x{} atlas page", image.Width, image.Height, m_PageSize, m_PageSize);
+		result = Region();
+		return false;
+	}
+
+	// The skyline packer picks up where it left off, so a page can keep taking images until it's full
+	for (size_t ix = 0; ix <= m_Pages.size(); ix++) {
+		Page* page = ix < m_Pages.size() ? m_Pages[ix] : __AddPage();
+		stbrp_pack_rects(&page->Context, &rect, 1);
+		if (rect.was_packed) {
+			__Upload(*page, static_cast<int>(ix), image, rect, result);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool TTK::SpriteAtlas::AddFromFile(const std::string& filePath, Region& result) {
+	int width, height, numChannels;
+	// Everything in the atlas is RGBA, whatever the file has
+	uint8_t* pixels = stbi_load(filePath.c_str(), &width, &height, &numChannels, 4);
+	if (pixels == nullptr) {
+		LOG_ERROR("Failed to load texture from \"{}\"", filePath);
+		result = Region();
+		return false;
+	}
+	bool success = Add({ pixels, width, height }, result);
+	stbi_image_free(pixels);
+	return success;
+}
+
+bool TTK::SpriteAtlas::AddMany(const std::vector<Image>& images, std::vector<Region>& results) {
+	results.assign(images.size(), Region());
+	bool success = true;
+
+	std::vector<stbrp_rect> rects;
+	rects.reserve(images.size());
+	for (size_t ix = 0; ix < images.size(); ix++) {
+		stbrp_rect rect;
+		rect.id = static_cast<int>(ix);
+		rect.w = static_cast<stbrp_coord>(images[ix].Width + m_Padding * 2);
+		rect.h = static_cast<stbrp_coord>(images[ix].Height + m_Padding * 2);
+		rect.was_packed = 0;
+		if (rect.w > m_PageSize || rect.h > m_PageSize) {
+			LOG_ERROR("A {}x{} image won't fit in a {}x{} atlas page", images[ix].Width, images[ix].Height, m_PageSize, m_PageSize);
+			success = false;
+			continue;
+		}
+		rects.push_back(rect);
+	}
+
+	// Give every page a go at whatever's left, starting a new page once the existing ones are full
+	for (size_t ix = 0; !rects.empty(); ix++) {
+		Page* page = ix < m_Pages.size() ? m_Pages[ix] : __AddPage();
+		stbrp_pack_rects(&page->Context, rects.data(), static_cast<int>(rects.size()));
+
+		size_t remaining = 0;
+		for (size_t rx = 0; rx < rects.size(); rx++) {
+			if (rects[rx].was_packed) {
+				__Upload(*page, static_cast<int>(ix), images[rects[rx].id], rects[rx], results[rects[rx].id]);
+			} else {
+				rects[remaining++] = rects[rx];
+			}
+		}
+		// A fresh page can fit anything that passed the size check, so this always finishes
+		rects.resize(remaining);
+	}
+	return success;
+}
+
+float TTK::SpriteAtlas::GetOccupancy() const {
+	if (m_Pages.empty()) {
+		return 0.0f;
+	}
+	size_t used = 0;
+	for (const Page* page : m_Pages) {
+		used += page->UsedArea;
+	}
+	return static_cast<float>(used) / (static_cast<float>(m_PageSize) * m_PageSize * m_Pages.size());
+}
+
+TTK::SpriteAtlas::Page* TTK::SpriteAtlas::__AddPage() {
+	Page* page = new Page();
+	page->UsedArea = 0;
+	// The packer works best with a node for every column
+	page->Nodes.resize(m_PageSize);
+	stbrp_init_target(&page->Context, m_PageSize, m_PageSize, page->Nodes.data(), static_cast<int>(page->Nodes.size()));
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &page->Texture);
+	glTextureParameteri(page->Texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(page->Texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(page->Texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(page->Texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureStorage2D(page->Texture, 1, GL_RGBA8, m_PageSize, m_PageSize);
+	const uint8_t clear[4] = { 0, 0, 0, 0 };
+	glClearTexImage(page->Texture, 0, GL_RGBA, GL_UNSIGNED_BYTE, clear);
+	LOG_ASSERT(glGetError() == GL_NONE, "Failed to create an atlas page!");
+
+	m_Pages.push_back(page);
+	return page;
+}
+
+void TTK::SpriteAtlas::__Upload(Page& page, int pageIndex, const Image& image, const stbrp_rect& rect, Region& result) {
+	const int width = rect.w;
+	const int height = rect.h;
+	m_Scratch.resize(static_cast<size_t>(width) * height * 4);
+
+	// Every padded pixel takes the colour of the closest pixel in the image
+	for (int y = 0; y < height; y++) {
+		int sourceY = y - m_Padding;
+		sourceY = sourceY < 0 ? 0 : (sourceY >= image.Height ? image.Height - 1 : sourceY);
+		const uint8_t* sourceRow = image.Pixels + static_cast<size_t>(sourceY) * image.Width * 4;
+		uint8_t* row = m_Scratch.data() + static_cast<size_t>(y) * width * 4;
+
+		for (int x = 0; x < m_Padding; x++) {
+			memcpy(row + x * 4, sourceRow, 4);
+			memcpy(row + (m_Padding + image.Width + x) * 4, sourceRow + (image.Width - 1) * 4, 4);
+		}
+		memcpy(row + m_Padding * 4, sourceRow, static_cast<size_t>(image.Width) * 4);
+	}
+
+	glTextureSubImage2D(page.Texture, 0, rect.x, rect.y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, m_Scratch.data());
+	page.UsedArea += static_cast<size_t>(width) * height;
+
+	result.Texture = page.Texture;
+	result.Page = pageIndex;
+	result.X = rect.x + m_Padding;
+	result.Y = rect.y + m_Padding;
+	result.Width = image.Width;
+	result.Height = image.Height;
+	result.uMin = result.X / static_cast<float>(m_PageSize);
+	result.vMin = result.Y / static_cast<float>(m_PageSize);
+	result.uMax = (result.X + result.Width) / static_cast<float>(m_PageSize);
+	result.vMax = (result.Y + result.Height) / static_cast<float>(m_PageSize);
+}
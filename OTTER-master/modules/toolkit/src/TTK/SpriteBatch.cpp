@@ -0,0 +1,537 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the Tutorial Tool Kit (TTK) library. 
+// You may not use this file in your GDW games.
+//
+// This file implements the TTK sprite batcher
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "TTK/SpriteBatch.h"
+#include "TTK/SpriteSheetQuad.h"
+#include "TTK/SpriteAtlas.h"
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <memory>
+#include <functional>
+#include <GLM/gtc/matrix_transform.hpp>
+#include "Logging.h"
+
+// Sorts keys with an LSD radix sort, a byte at a time. Bytes that are the same in every key (like the top bytes of
+// small texture IDs) get skipped, so sorting by texture is usually only a pass or two
+static void radixSort(std::vector<uint64_t>& keys, std::vector<uint64_t>& scratch) {
+	const size_t count = keys.size();
+	scratch.resize(count);
+
+	size_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (uint64_t key : keys) {
+		for (int pass = 0; pass < 8; pass++) {
+			histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+		}
+	}
+
+	uint64_t* source = keys.data();
+	uint64_t* dest = scratch.data();
+	for (int pass = 0; pass < 8; pass++) {
+		size_t* histogram = histograms[pass];
+		if (histogram[(source[0] >> (pass * 8)) & 0xFF] == count) {
+			continue;
+		}
+
+		size_t offset = 0;
+		for (int ix = 0; ix < 256; ix++) {
+			size_t bucket = histogram[ix];
+			histogram[ix] = offset;
+			offset += bucket;
+		}
+		for (size_t ix = 0; ix < count; ix++) {
+			uint64_t key = source[ix];
+			dest[histogram[(key >> (pass * 8)) & 0xFF]++] = key;
+		}
+		std::swap(source, dest);
+	}
+
+	if (source != keys.data()) {
+		keys.swap(scratch);
+	}
+}
+
+static uint32_t packColor(const glm::vec4& color) {
+	glm::vec4 clamped = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+	return static_cast<uint32_t>(clamped.r) | (static_cast<uint32_t>(clamped.g) << 8) |
+		(static_cast<uint32_t>(clamped.b) << 16) | (static_cast<uint32_t>(clamped.a) << 24);
+}
+
+TTK::SpriteBatch::SpriteBatch(size_t initialSprites)
+{
+	m_SortMode = SortMode::Texture;
+	m_VBO = 0;
+	m_EBO = 0;
+	m_Mapped = nullptr;
+	m_Capacity = 0;
+	m_Region = 0;
+	for (size_t ix = 0; ix < RingRegions; ix++) {
+		m_Fences[ix] = nullptr;
+	}
+
+	glCreateVertexArrays(1, &m_VAO);
+	glEnableVertexArrayAttrib(m_VAO, 0);
+	glEnableVertexArrayAttrib(m_VAO, 1);
+	glEnableVertexArrayAttrib(m_VAO, 2);
+	glVertexArrayAttribFormat(m_VAO, 0, 4, GL_FLOAT, false, offsetof(SpriteVert, Position));
+	glVertexArrayAttribFormat(m_VAO, 1, 2, GL_FLOAT, false, offsetof(SpriteVert, UV));
+	glVertexArrayAttribFormat(m_VAO, 2, 4, GL_UNSIGNED_BYTE, true, offsetof(SpriteVert, Color));
+	glVertexArrayAttribBinding(m_VAO, 0, 0);
+	glVertexArrayAttribBinding(m_VAO, 1, 0);
+	glVertexArrayAttribBinding(m_VAO, 2, 0);
+	__Allocate(initialSprites > 0 ? initialSprites : 1);
+
+	const char* vsSource = R"LIT(#version 440
+            layout (location = 0) in vec4 vertexPosition;
+            layout (location = 1) in vec2 vertexTexture;
+            layout (location = 2) in vec4 vertexColor;
+            layout (location = 0) out vec2 fragmentTexture;
+            layout (location = 1) out vec4 fragmentColor;
+            void main() {
+                gl_Position = vertexPosition;
+                fragmentTexture = vertexTexture;
+                fragmentColor = vertexColor;
+            })LIT";
+
+	const char* fsSource = R"LIT(#version 440
+            layout(binding = 0) uniform sampler2D xSampler;
+            layout (location = 0) in vec2 fragUv;
+            layout (location = 1) in vec4 fragColor;
+            out vec4 frag_color;            	
+            void main() {
+				frag_color = texture(xSampler, fragUv) * fragColor;
+            })LIT";
+
+	m_Shader = glCreateProgram();
+
+	GLuint programs[2];
+	programs[0] = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(programs[0], 1, &vsSource, NULL);
+	glCompileShader(programs[0]);
+	programs[1] = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(programs[1], 1, &fsSource, NULL);
+	glCompileShader(programs[1]);
+
+	// Attach our two shaders
+	glAttachShader(m_Shader, programs[0]);
+	glAttachShader(m_Shader, programs[1]);
+
+	// Perform linking
+	glLinkProgram(m_Shader);
+
+	// Remove shader parts to save space
+	glDetachShader(m_Shader, programs[0]);
+	glDeleteShader(programs[0]);
+	glDetachShader(m_Shader, programs[1]);
+	glDeleteShader(programs[1]);
+}
+
+TTK::SpriteBatch::~SpriteBatch()
+{
+	for (size_t ix = 0; ix < RingRegions; ix++) {
+		if (m_Fences[ix] != nullptr) {
+			glDeleteSync(m_Fences[ix]);
+		}
+	}
+	glUnmapNamedBuffer(m_VBO);
+	glDeleteBuffers(1, &m_VBO);
+	glDeleteBuffers(1, &m_EBO);
+	glDeleteVertexArrays(1, &m_VAO);
+	glDeleteProgram(m_Shader);
+}
+
+void TTK::SpriteBatch::Draw(GLuint texture, const SpriteCoordinates& coords, const glm::mat4& matrix, const glm::vec4& color)
+{
+	// The quad is flat, so each corner is just the centre plus or minus the matrix's first two columns
+	const glm::vec4 center = matrix[3];
+	const glm::vec4 right = matrix[0];
+	const glm::vec4 up = matrix[1];
+	const uint32_t packed = packColor(color);
+
+	size_t first = m_Queued.size();
+	m_Queued.resize(first + 4);
+	SpriteVert* verts = &m_Queued[first];
+	// Same corners and UVs as SpriteSheetQuad
+	verts[0] = { center - right + up, { coords.uMin, coords.vMin }, packed };
+	verts[1] = { center + right + up, { coords.uMax, coords.vMin }, packed };
+	verts[2] = { center - right - up, { coords.uMin, coords.vMax }, packed };
+	verts[3] = { center + right - up, { coords.uMax, coords.vMax }, packed };
+
+	m_Textures.push_back(texture);
+	// Kept for every sprite, so the sort mode can change before the flush
+	m_Depths.push_back(center.w != 0.0f ? center.z / center.w : center.z);
+}
+
+void TTK::SpriteBatch::Flush()
+{
+	const size_t count = m_Textures.size();
+	m_Stats.DrawCalls = 0;
+	m_Stats.Sprites = count;
+	m_Stats.SortMs = 0.0;
+	m_Stats.WriteMs = 0.0;
+	if (count == 0) {
+		return;
+	}
+
+	// Build the draw order, the sprite's index is always in the bottom 32 bits so sorting keeps the order they were added in
+	auto start = std::chrono::high_resolution_clock::now();
+	bool sorted = m_SortMode != SortMode::Deferred;
+	if (sorted) {
+		m_Keys.resize(count);
+		for (size_t ix = 0; ix < count; ix++) {
+			uint64_t top;
+			if (m_SortMode == SortMode::Texture) {
+				top = m_Textures[ix];
+			} else {
+				// Flip the float's bits so they sort as unsigned ints, and then flip again so the furthest comes first
+				uint32_t bits;
+				memcpy(&bits, &m_Depths[ix], sizeof(float));
+				bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+				top = ~bits;
+			}
+			m_Keys[ix] = (top << 32) | ix;
+		}
+		radixSort(m_Keys, m_KeyScratch);
+	}
+	auto sortEnd = std::chrono::high_resolution_clock::now();
+	m_Stats.SortMs = std::chrono::duration<double, std::milli>(sortEnd - start).count();
+
+	// Everything has to fit in one region, since the runs get drawn straight out of it
+	if (count > m_Capacity) {
+		size_t capacity = m_Capacity * 2;
+		while (capacity < count) {
+			capacity *= 2;
+		}
+		__Allocate(capacity);
+	}
+	__WaitForRegion();
+
+	// The mapped memory is write only, so just write the vertices in order and keep track of where the texture changes
+	SpriteVert* region = reinterpret_cast<SpriteVert*>(m_Mapped) + m_Region * m_Capacity * 4;
+	struct Run { GLuint Texture; size_t First, Count; };
+	std::vector<Run> runs;
+	for (size_t ix = 0; ix < count; ix++) {
+		size_t sprite = sorted ? static_cast<size_t>(m_Keys[ix] & 0xFFFFFFFFu) : ix;
+		memcpy(region + ix * 4, &m_Queued[sprite * 4], sizeof(SpriteVert) * 4);
+
+		GLuint texture = m_Textures[sprite];
+		if (runs.empty() || runs.back().Texture != texture) {
+			runs.push_back({ texture, ix, 0 });
+		}
+		runs.back().Count++;
+	}
+	m_Stats.WriteMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - sortEnd).count();
+
+	// Sprites are usually transparent, so blend them without writing depth
+	bool blendState = glIsEnabled(GL_BLEND);
+	GLboolean depthMaskEnabled = false;
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMaskEnabled);
+	int currentProgram, currentVAO;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &currentVAO);
+	glDepthMask(GL_FALSE);
+	glEnable(GL_BLEND);
+	glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	glUseProgram(m_Shader);
+	glBindVertexArray(m_VAO);
+
+	for (const Run& run : runs) {
+		__DrawRun(run.Texture, run.First, run.Count);
+	}
+
+	glBindTextureUnit(0, 0);
+	glBindVertexArray(currentVAO);
+	glUseProgram(currentProgram);
+	if (!blendState) glDisable(GL_BLEND);
+	glDepthMask(depthMaskEnabled);
+
+	// Move on to the next region, it can't be written until the GPU is done with what we just drew from it
+	m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_Region = (m_Region + 1) % RingRegions;
+
+	m_Queued.clear();
+	m_Textures.clear();
+	m_Depths.clear();
+}
+
+void TTK::SpriteBatch::__DrawRun(GLuint texture, size_t first, size_t count)
+{
+	glBindTextureUnit(0, texture);
+	// The index buffer is the same quad pattern over and over, so every run can use it from the start
+	GLint baseVertex = static_cast<GLint>((m_Region * m_Capacity + first) * 4);
+	glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(count * 6), GL_UNSIGNED_INT, nullptr, baseVertex);
+	m_Stats.DrawCalls++;
+}
+
+void TTK::SpriteBatch::__Allocate(size_t capacity)
+{
+	if (m_VBO != 0) {
+		// OpenGL keeps the old buffer alive until the draws using it are done, and its fences mean nothing for the new one
+		for (size_t ix = 0; ix < RingRegions; ix++) {
+			if (m_Fences[ix] != nullptr) {
+				glDeleteSync(m_Fences[ix]);
+				m_Fences[ix] = nullptr;
+			}
+		}
+		glUnmapNamedBuffer(m_VBO);
+		glDeleteBuffers(1, &m_VBO);
+		glDeleteBuffers(1, &m_EBO);
+		m_Stats.Grows++;
+	}
+
+	// Coherent, so anything we write is visible to the next draw without flushing ranges
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLsizeiptr size = static_cast<GLsizeiptr>(capacity * 4 * sizeof(SpriteVert) * RingRegions);
+	glCreateBuffers(1, &m_VBO);
+	glNamedBufferStorage(m_VBO, size, nullptr, flags);
+	m_Mapped = static_cast<uint8_t*>(glMapNamedBufferRange(m_VBO, 0, size, flags));
+	m_Capacity = capacity;
+	m_Region = 0;
+	glVertexArrayVertexBuffer(m_VAO, 0, m_VBO, 0, sizeof(SpriteVert));
+
+	std::vector<GLuint> indices(capacity * 6);
+	for (size_t ix = 0; ix < capacity; ix++) {
+		GLuint base = static_cast<GLuint>(ix * 4);
+		indices[ix * 6 + 0] = base + 0;
+		indices[ix * 6 + 1] = base + 1;
+		indices[ix * 6 + 2] = base + 2;
+		indices[ix * 6 + 3] = base + 2;
+		indices[ix * 6 + 4] = base + 1;
+		indices[ix * 6 + 5] = base + 3;
+	}
+	glCreateBuffers(1, &m_EBO);
+	glNamedBufferStorage(m_EBO, indices.size() * sizeof(GLuint), indices.data(), 0);
+	glVertexArrayElementBuffer(m_VAO, m_EBO);
+}
+
+void TTK::SpriteBatch::__WaitForRegion()
+{
+	GLsync& fence = m_Fences[m_Region];
+	if (fence == nullptr) {
+		return;
+	}
+
+	// Usually the GPU finished with this region a couple of flushes ago
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED) {
+		do {
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (result == GL_TIMEOUT_EXPIRED);
+		m_Stats.Stalls++;
+	}
+	if (result == GL_WAIT_FAILED) {
+		LOG_WARN("Failed waiting on a sprite batch fence");
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void TTK::SpriteBatch::RunBenchmark(size_t spriteCount)
+{
+	// A few 4x4 sheets of 32x32 frames, each frame a ring that grows through the animation
+	const int sheetCount = 8;
+	const int frameSize = 32;
+	const int framesPerRow = 4;
+	const int sheetSize = frameSize * framesPerRow;
+	const int frameCount = framesPerRow * framesPerRow;
+
+	std::vector<std::vector<uint8_t>> sheetPixels(sheetCount);
+	for (int sheet = 0; sheet < sheetCount; sheet++) {
+		std::vector<uint8_t>& pixels = sheetPixels[sheet];
+		pixels.resize(static_cast<size_t>(sheetSize) * sheetSize * 4);
+		glm::vec3 tint = glm::vec3((sheet & 1) ? 1.0f : 0.3f, (sheet & 2) ? 1.0f : 0.3f, (sheet & 4) ? 1.0f : 0.3f);
+		for (int y = 0; y < sheetSize; y++) {
+			for (int x = 0; x < sheetSize; x++) {
+				int frame = (y / frameSize) * framesPerRow + (x / frameSize);
+				glm::vec2 offset = glm::vec2(x % frameSize, y % frameSize) - glm::vec2(frameSize / 2.0f - 0.5f);
+				float radius = 2.0f + 13.0f * frame / (frameCount - 1);
+				float alpha = glm::clamp(1.5f - glm::abs(glm::length(offset) - radius), 0.0f, 1.0f);
+				uint8_t* pixel = &pixels[(static_cast<size_t>(y) * sheetSize + x) * 4];
+				pixel[0] = static_cast<uint8_t>(tint.r * 255);
+				pixel[1] = static_cast<uint8_t>(tint.g * 255);
+				pixel[2] = static_cast<uint8_t>(tint.b * 255);
+				pixel[3] = static_cast<uint8_t>(alpha * 255);
+			}
+		}
+	}
+
+	// Every sheet as its own texture, and every sheet packed into an atlas
+	std::vector<GLuint> sheetTextures(sheetCount);
+	glCreateTextures(GL_TEXTURE_2D, sheetCount, sheetTextures.data());
+	std::vector<SpriteAtlas::Image> images;
+	for (int sheet = 0; sheet < sheetCount; sheet++) {
+		glTextureParameteri(sheetTextures[sheet], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(sheetTextures[sheet], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(sheetTextures[sheet], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(sheetTextures[sheet], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTextureStorage2D(sheetTextures[sheet], 1, GL_RGBA8, sheetSize, sheetSize);
+		glTextureSubImage2D(sheetTextures[sheet], 0, 0, 0, sheetSize, sheetSize, GL_RGBA, GL_UNSIGNED_BYTE, sheetPixels[sheet].data());
+		images.push_back({ sheetPixels[sheet].data(), sheetSize, sheetSize });
+	}
+	SpriteAtlas atlas(1024);
+	std::vector<SpriteAtlas::Region> regions;
+	atlas.AddMany(images, regions);
+
+	// Frame coordinates for both, the same way SpriteSheetQuad slices a sheet
+	std::vector<SpriteCoordinates> sheetFrames(frameCount), atlasFrames(static_cast<size_t>(sheetCount) * frameCount);
+	for (int frame = 0; frame < frameCount; frame++) {
+		float x = static_cast<float>((frame % framesPerRow) * frameSize);
+		float y = static_cast<float>((frame / framesPerRow) * frameSize);
+		SpriteCoordinates& sc = sheetFrames[frame];
+		sc.xMin = x; sc.xMax = x + frameSize;
+		sc.yMin = y; sc.yMax = y + frameSize;
+		sc.uMin = sc.xMin / sheetSize; sc.uMax = sc.xMax / sheetSize;
+		sc.vMin = sc.yMin / sheetSize; sc.vMax = sc.yMax / sheetSize;
+		for (int sheet = 0; sheet < sheetCount; sheet++) {
+			const SpriteAtlas::Region& region = regions[sheet];
+			SpriteCoordinates& ac = atlasFrames[static_cast<size_t>(sheet) * frameCount + frame];
+			ac = sc;
+			ac.uMin = (region.X + sc.xMin) / atlas.GetPageSize(); ac.uMax = (region.X + sc.xMax) / atlas.GetPageSize();
+			ac.vMin = (region.Y + sc.yMin) / atlas.GetPageSize(); ac.vMax = (region.Y + sc.yMax) / atlas.GetPageSize();
+		}
+	}
+
+	// Scattered sprites, each on its own sheet, frame and animation speed
+	struct BenchSprite {
+		glm::mat4 Transform;
+		glm::vec4 Color;
+		int   Sheet;
+		float FrameTime, FrameLength;
+		int   Frame;
+	};
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<BenchSprite> sprites(spriteCount);
+	for (BenchSprite& sprite : sprites) {
+		glm::vec2 position = glm::vec2(unit(rng), unit(rng)) * 2.0f - 1.0f;
+		float size = 0.01f + unit(rng) * 0.02f;
+		sprite.Transform = glm::translate(glm::mat4(1.0f), glm::vec3(position, unit(rng)));
+		sprite.Transform = glm::rotate(sprite.Transform, unit(rng) * 6.2831853f, glm::vec3(0, 0, 1));
+		sprite.Transform = glm::scale(sprite.Transform, glm::vec3(size));
+		sprite.Color = glm::vec4(1.0f, 1.0f, 1.0f, 0.5f + unit(rng) * 0.5f);
+		sprite.Sheet = static_cast<int>(unit(rng) * sheetCount) % sheetCount;
+		sprite.FrameLength = 1.0f / (10.0f + unit(rng) * 20.0f);
+		sprite.FrameTime = unit(rng) * sprite.FrameLength;
+		sprite.Frame = static_cast<int>(unit(rng) * frameCount) % frameCount;
+	}
+	// Steps every sprite's animation the way SpriteSheetQuad::Update does
+	auto animate = [&](float deltaTime) {
+		for (BenchSprite& sprite : sprites) {
+			sprite.FrameTime += deltaTime;
+			if (sprite.FrameTime > sprite.FrameLength) {
+				sprite.FrameTime -= sprite.FrameLength;
+				sprite.Frame = (sprite.Frame + 1) % frameCount;
+			}
+		}
+	};
+
+	GLuint query;
+	glGenQueries(1, &query);
+	SpriteBatch batch(1024);
+
+	struct Timing { double Cpu, Gpu; size_t Draws; };
+	auto timeRun = [&](const std::function<size_t()>& run) {
+		glFinish();
+		auto start = std::chrono::high_resolution_clock::now();
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		size_t draws = run();
+		glEndQuery(GL_TIME_ELAPSED);
+		Timing result;
+		result.Cpu = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		GLuint64 gpuTime = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpuTime);
+		result.Gpu = gpuTime / 1000000.0;
+		result.Draws = draws;
+		return result;
+	};
+
+	// The way SpriteSheetQuad::Draw works, a texture bind, a 4 vertex upload and a draw for every sprite
+	GLuint singleVAO, singleVBO;
+	glCreateVertexArrays(1, &singleVAO);
+	glCreateBuffers(1, &singleVBO);
+	glNamedBufferData(singleVBO, sizeof(SpriteVert) * 4, nullptr, GL_STREAM_DRAW);
+	glVertexArrayVertexBuffer(singleVAO, 0, singleVBO, 0, sizeof(SpriteVert));
+	glVertexArrayElementBuffer(singleVAO, batch.m_EBO);
+	for (GLuint attrib = 0; attrib < 3; attrib++) {
+		glEnableVertexArrayAttrib(singleVAO, attrib);
+		glVertexArrayAttribBinding(singleVAO, attrib, 0);
+	}
+	glVertexArrayAttribFormat(singleVAO, 0, 4, GL_FLOAT, false, offsetof(SpriteVert, Position));
+	glVertexArrayAttribFormat(singleVAO, 1, 2, GL_FLOAT, false, offsetof(SpriteVert, UV));
+	glVertexArrayAttribFormat(singleVAO, 2, 4, GL_UNSIGNED_BYTE, true, offsetof(SpriteVert, Color));
+	Timing single = timeRun([&]() {
+		bool blendState = glIsEnabled(GL_BLEND);
+		glEnable(GL_BLEND);
+		glUseProgram(batch.m_Shader);
+		glBindVertexArray(singleVAO);
+		for (const BenchSprite& sprite : sprites) {
+			const SpriteCoordinates& sc = sheetFrames[sprite.Frame];
+			const glm::mat4& m = sprite.Transform;
+			uint32_t color = packColor(sprite.Color);
+			SpriteVert verts[4] = {
+				{ m[3] - m[0] + m[1], { sc.uMin, sc.vMin }, color },
+				{ m[3] + m[0] + m[1], { sc.uMax, sc.vMin }, color },
+				{ m[3] - m[0] - m[1], { sc.uMin, sc.vMax }, color },
+				{ m[3] + m[0] - m[1], { sc.uMax, sc.vMax }, color }
+			};
+			glBindTextureUnit(0, sheetTextures[sprite.Sheet]);
+			glNamedBufferData(singleVBO, sizeof(verts), verts, GL_STREAM_DRAW);
+			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+		}
+		glBindVertexArray(0);
+		if (!blendState) glDisable(GL_BLEND);
+		return sprites.size();
+	});
+	glDeleteBuffers(1, &singleVBO);
+	glDeleteVertexArrays(1, &singleVAO);
+
+	// Runs each batched path twice, the first one grows the buffers and the second is the one that gets logged
+	double submitMs = 0.0;
+	auto batched = [&](SortMode mode, bool useAtlas) {
+		Timing result;
+		for (int pass = 0; pass < 2; pass++) {
+			animate(1.0f / 60.0f);
+			batch.SetSortMode(mode);
+			result = timeRun([&]() {
+				auto start = std::chrono::high_resolution_clock::now();
+				for (const BenchSprite& sprite : sprites) {
+					if (useAtlas) {
+						batch.Draw(regions[sprite.Sheet].Texture, atlasFrames[static_cast<size_t>(sprite.Sheet) * frameCount + sprite.Frame],
+							sprite.Transform, sprite.Color);
+					} else {
+						batch.Draw(sheetTextures[sprite.Sheet], sheetFrames[sprite.Frame], sprite.Transform, sprite.Color);
+					}
+				}
+				submitMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				batch.Flush();
+				return batch.GetStats().DrawCalls;
+			});
+		}
+		return result;
+	};
+
+	LOG_INFO("Sprite benchmark, {} animated sprites from {} sheets ({} atlas page(s), {:.0f}% used):", spriteCount, sheetCount,
+		atlas.GetPageCount(), atlas.GetOccupancy() * 100.0f);
+	LOG_INFO("\tDraw per sprite: {:.2f} ms CPU, {:.2f} ms GPU, {} draws", single.Cpu, single.Gpu, single.Draws);
+	const struct { const char* Name; SortMode Mode; bool Atlas; } runs[] = {
+		{ "Batched, unsorted", SortMode::Deferred, false },
+		{ "Batched, sorted by texture", SortMode::Texture, false },
+		{ "Batched, back to front", SortMode::BackToFront, false },
+		{ "Batched from atlas", SortMode::Texture, true }
+	};
+	for (const auto& run : runs) {
+		Timing timing = batched(run.Mode, run.Atlas);
+		LOG_INFO("\t{}: {:.2f} ms CPU ({:.2f} submit, {:.2f} sort, {:.2f} write), {:.2f} ms GPU, {} draw(s)", run.Name, timing.Cpu,
+			submitMs, batch.GetStats().SortMs, batch.GetStats().WriteMs, timing.Gpu, timing.Draws);
+	}
+
+	glDeleteQueries(1, &query);
+	glDeleteTextures(sheetCount, sheetTextures.data());
+}
@@ -1,6 +1,7 @@
 // PUT YOUR NAME AND STUDENT NUMBER HERE //
 
 #include "TTK/SpriteSheetQuad.h"
+#include "TTK/SpriteBatch.h"
 #include <iostream>
 
 #include <glad/glad.h>
@@ -17,6 +18,7 @@ TTK::SpriteSheetQuad::SpriteSheetQuad()
 	m_CurrentFrame = 0;
 	m_FrameTime = 0;
 	m_Color = glm::vec4(1.0f);
+	m_AtlasTexture = 0;
 	m_FrameLength = std::vector<float>();
 	m_SpriteCoordinates = std::vector<SpriteCoordinates>();
 	m_Texture = TTK::Texture2D();
@@ -97,9 +99,35 @@ void TTK::SpriteSheetQuad::SliceSpriteSheet(const char* fileName, float spriteSi
 void TTK::SpriteSheetQuad::SliceSpriteSheet(const char* fileName, int numSpritesPerRow, int numRows, float animTime)
 {
 	m_Texture.LoadTextureFromFile(fileName);
+	m_AtlasTexture = 0;
 
-	float spriteWidth = static_cast<float>(m_Texture.GetWidth()) / numSpritesPerRow;
-	float spriteHeight = static_cast<float>(m_Texture.GetHeight()) / numRows;
+	float width = static_cast<float>(m_Texture.GetWidth());
+	float height = static_cast<float>(m_Texture.GetHeight());
+	__BuildFrames(0.0f, 0.0f, width, height, width, height, numSpritesPerRow, numRows, animTime);
+}
+
+void TTK::SpriteSheetQuad::SliceSpriteSheet(SpriteAtlas& atlas, const char* fileName, int numSpritesPerRow, int numRows, float animTime)
+{
+	SpriteAtlas::Region region;
+	if (!atlas.AddFromFile(fileName, region)) {
+		return;
+	}
+	m_AtlasTexture = region.Texture;
+
+	float pageSize = static_cast<float>(atlas.GetPageSize());
+	__BuildFrames(static_cast<float>(region.X), static_cast<float>(region.Y), static_cast<float>(region.Width), static_cast<float>(region.Height),
+		pageSize, pageSize, numSpritesPerRow, numRows, animTime);
+}
+
+void TTK::SpriteSheetQuad::__BuildFrames(float originX, float originY, float sheetWidth, float sheetHeight, float textureWidth, float textureHeight,
+	int numSpritesPerRow, int numRows, float animTime)
+{
+	m_SpriteCoordinates.clear();
+	m_FrameLength.clear();
+	ResetAnimation();
+
+	float spriteWidth = sheetWidth / numSpritesPerRow;
+	float spriteHeight = sheetHeight / numRows;
 
 	float frameTime = animTime / (numSpritesPerRow * numRows);
 
@@ -120,11 +148,11 @@ void TTK::SpriteSheetQuad::SliceSpriteSheet(const char* fileName, int numSprites
 			sc.yMax = sc.yMin + spriteHeight;
 
 			// calculate the normalized coordinates
-			sc.uMin = sc.xMin / m_Texture.GetWidth();
-			sc.uMax = sc.xMax / m_Texture.GetWidth();
+			sc.uMin = (originX + sc.xMin) / textureWidth;
+			sc.uMax = (originX + sc.xMax) / textureWidth;
 
-			sc.vMin = sc.yMin / m_Texture.GetHeight();
-			sc.vMax = sc.yMax / m_Texture.GetHeight();
+			sc.vMin = (originY + sc.yMin) / textureHeight;
+			sc.vMax = (originY + sc.yMax) / textureHeight;
 
 			m_SpriteCoordinates.push_back(sc);
 			m_FrameLength.push_back(frameTime);
@@ -173,15 +201,20 @@ void TTK::SpriteSheetQuad::Draw(const glm::mat4& matrix)
 	glUseProgram(m_Shader);
 	glProgramUniform4fv(m_Shader, 2, 1, &m_Color.x);
 	glProgramUniformMatrix4fv(m_Shader, 0, 1, false, &matrix[0][0]);
-	m_Texture.Bind();
+	glBindTextureUnit(0, GetTextureID());
 	glBindVertexArray(m_VAO);
 	glNamedBufferData(m_VBO, sizeof(QuadVert) * 4, m_Vertices, GL_STREAM_DRAW);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
-	m_Texture.Unbind();
+	glBindTextureUnit(0, 0);
 	glBindVertexArray(currentVAO);
 	glUseProgram(currentProgram);
 }
 
+void TTK::SpriteSheetQuad::Draw(SpriteBatch& batch, const glm::mat4& matrix) const
+{
+	batch.Draw(GetTextureID(), m_SpriteCoordinates[m_CurrentFrame], matrix, m_Color);
+}
+
 void TTK::SpriteSheetQuad::SetFrameLength(int frameNumber, float time)
 {
 	if (frameNumber >= 0 && frameNumber < m_FrameLength.size()) {
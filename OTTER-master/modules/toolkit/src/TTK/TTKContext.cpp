@@ -13,21 +13,27 @@
 #include "TTK/TTKContext.h"
 #include <GLM/gtc/matrix_transform.hpp>
 #include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
 #include "Logging.h"
 #include "TTK/MeshHelper.h"
 
 TTK::Context* TTK::Context::m_Instance = nullptr;
+std::string TTK::Context::m_DefaultFontPath = "";
+uint32_t TTK::Context::m_DefaultFontSize = 32;
 
 TTK::Context::~Context() {
 	delete m_MeshHelper;
 	delete m_DefaultFont;
-	glDeleteBuffers(1, &m_Tris.VBO);
-	glDeleteBuffers(1, &m_Lines.VBO);
-	glDeleteBuffers(1, &m_Points.VBO);
-	glDeleteVertexArrays(1, &m_Tris.VAO);
-	glDeleteVertexArrays(1, &m_Lines.VAO);
-	glDeleteVertexArrays(1, &m_Points.VAO);
+	__DestroyBuff(m_Tris);
+	__DestroyBuff(m_Lines);
+	__DestroyBuff(m_Points);
 	glDeleteProgram(m_ShaderHandle);
+	glDeleteProgram(m_PointShaderHandle);
 }
 
 glm::mat4 TTK::Context::GetOrthoProjection() const {
@@ -56,6 +62,38 @@ void TTK::Context::RenderText(const char* text, const glm::vec2& position, const
 	TTK::FontRenderer::Instance().Render(*m_DefaultFont, text, position, color, scale);
 }
 
+void TTK::Context::SetDefaultFont(const std::string& path, uint32_t size) {
+	m_DefaultFontPath = path;
+	m_DefaultFontSize = size;
+	if (m_Instance != nullptr) {
+		delete m_Instance->m_DefaultFont;
+		m_Instance->m_DefaultFont = new TrueTypeTextureFont(path.c_str(), size);
+	}
+}
+
+std::string TTK::Context::__FindDefaultFont() {
+	const char* fromEnv = std::getenv("TTK_FONT");
+	if (fromEnv != nullptr && fromEnv[0] != '\0') {
+		return fromEnv;
+	}
+
+	static const char* const candidates[] = {
+		"C:\\Windows\\Fonts\\consola.ttf",
+		"/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf",
+		"/usr/share/fonts/TTF/DejaVuSansMono.ttf",
+		"/usr/share/fonts/dejavu/DejaVuSansMono.ttf",
+		"/usr/share/fonts/truetype/liberation/LiberationMono-Regular.ttf",
+		"/System/Library/Fonts/Supplemental/Courier New.ttf"
+	};
+	for (const char* candidate : candidates) {
+		if (std::ifstream(candidate, std::ios::binary).good()) {
+			return candidate;
+		}
+	}
+	LOG_WARN("Couldn't find a font for TTK, use TTK::Context::SetDefaultFont or set TTK_FONT to draw text");
+	return candidates[0];
+}
+
 void TTK::Context::DrawTeapot(const glm::mat4& mat, const glm::vec4& color) const {
 	m_MeshHelper->RenderTeapot(mat, color);
 }
@@ -69,27 +107,22 @@ void TTK::Context::DrawCube(const glm::mat4& mat, const glm::vec4& color) const
 }
 
 void TTK::Context::AddLine(const glm::vec3& a, const glm::vec3& b, const glm::vec4& color) {
-	m_LineVerts[m_Lines.Count + 0].Position = a;
-	m_LineVerts[m_Lines.Count + 0].Color = color;
-	m_LineVerts[m_Lines.Count + 1].Position = b;
-	m_LineVerts[m_Lines.Count + 1].Color = color;
-	m_Lines.Count += 2;
-	if (m_Lines.Count == MaxLineVerts) {
-		__Flush(m_Lines);
-	}
+	// The mapped memory is write only (and likely uncached), so only ever write to it
+	SimpleVert* verts = __Reserve<SimpleVert>(m_Lines, 2);
+	verts[0].Position = a;
+	verts[0].Color = color;
+	verts[1].Position = b;
+	verts[1].Color = color;
 }
 
 void TTK::Context::AddTri(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec4& color) {
-	m_TriVerts[m_Tris.Count + 0].Position = a;
-	m_TriVerts[m_Tris.Count + 0].Color = color;
-	m_TriVerts[m_Tris.Count + 1].Position = b;
-	m_TriVerts[m_Tris.Count + 1].Color = color;
-	m_TriVerts[m_Tris.Count + 2].Position = c;
-	m_TriVerts[m_Tris.Count + 2].Color = color;
-	m_Tris.Count += 3;
-	if (m_Tris.Count == MaxTriVerts) {
-		__Flush(m_Tris);
-	}
+	SimpleVert* verts = __Reserve<SimpleVert>(m_Tris, 3);
+	verts[0].Position = a;
+	verts[0].Color = color;
+	verts[1].Position = b;
+	verts[1].Color = color;
+	verts[2].Position = c;
+	verts[2].Color = color;
 }
 
 void TTK::Context::AddQuad(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color) {
@@ -101,25 +134,33 @@ void TTK::Context::AddQuad(const glm::vec3& min, const glm::vec3& max, const glm
 
 void TTK::Context::AddPoint(const glm::vec3& pos, float size, const glm::vec4& color)
 {
-	m_PointVerts[m_Points.Count].Position = pos;
-	m_PointVerts[m_Points.Count].Color = color;
-	m_PointVerts[m_Points.Count].Size = size;
-	m_Points.Count += 1;
-	if (m_Points.Count == MaxPointVerts) {
-		__Flush(m_Points);
-	}
+	PointVert* vert = __Reserve<PointVert>(m_Points, 1);
+	vert->Position = pos;
+	vert->Color = color;
+	vert->Size = size;
 }
 
 void TTK::Context::Flush() {
+	m_Stats.DrawCalls = 0;
+	m_Stats.Vertices = 0;
 	__Flush(m_Tris);
 	__Flush(m_Lines);
 	__Flush(m_Points);
+
+	// Text goes over top of everything else
+	if (FontRenderer::HasInstance()) {
+		FontRenderer::Instance().Flush();
+		FontRenderer::Instance().EndFrame();
+	}
 }
 
 TTK::Context::Context() {
 	m_Projection = glm::ortho(0.0f, 800.0f, 0.0f, 600.0f);
 	m_ViewMatrix = glm::mat4(1.0f);
-	m_DefaultFont = new TrueTypeTextureFont("C:\\\\Windows\\Fonts\\consola.ttf", 32);
+	if (m_DefaultFontPath.empty()) {
+		m_DefaultFontPath = __FindDefaultFont();
+	}
+	m_DefaultFont = new TrueTypeTextureFont(m_DefaultFontPath.c_str(), m_DefaultFontSize);
 	
 	const char* vsSource = R"LIT(#version 430
             layout (location = 0) uniform mat4 xTransform;
@@ -159,27 +200,28 @@ TTK::Context::Context() {
 	m_PointShaderHandle = __CompileShader(vsSourcePoint, fsSource);
 
 
-	m_Tris = __InitBuff(GL_TRIANGLES, m_ShaderHandle, m_TriVerts, sizeof(SimpleVert), MaxTriVerts);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(SimpleVert), (void*)offsetof(SimpleVert, Position));
-	glVertexAttribPointer(1, 4, GL_FLOAT, false, sizeof(SimpleVert), (void*)offsetof(SimpleVert, Color));
-
-	m_Lines = __InitBuff(GL_LINES, m_ShaderHandle, m_LineVerts, sizeof(SimpleVert), MaxLineVerts);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(SimpleVert), (void*)offsetof(SimpleVert, Position));
-	glVertexAttribPointer(1, 4, GL_FLOAT, false, sizeof(SimpleVert), (void*)offsetof(SimpleVert, Color));
-
-	m_Points = __InitBuff(GL_POINTS, m_PointShaderHandle, m_PointVerts, sizeof(PointVert), MaxLineVerts);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(PointVert), (void*)offsetof(PointVert, Position));
-	glVertexAttribPointer(1, 4, GL_FLOAT, false, sizeof(PointVert), (void*)offsetof(PointVert, Color));
-	glVertexAttribPointer(2, 1, GL_FLOAT, false, sizeof(PointVert), (void*)offsetof(PointVert, Size));
+	// The layouts live in the VAOs, so growing a buffer only has to swap the buffer binding
+	m_Tris = __InitBuff(GL_TRIANGLES, m_ShaderHandle, sizeof(SimpleVert), InitialTriVerts);
+	m_Lines = __InitBuff(GL_LINES, m_ShaderHandle, sizeof(SimpleVert), InitialLineVerts);
+	for (GLuint vao : { m_Tris.VAO, m_Lines.VAO }) {
+		glEnableVertexArrayAttrib(vao, 0);
+		glEnableVertexArrayAttrib(vao, 1);
+		glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, false, offsetof(SimpleVert, Position));
+		glVertexArrayAttribFormat(vao, 1, 4, GL_FLOAT, false, offsetof(SimpleVert, Color));
+		glVertexArrayAttribBinding(vao, 0, 0);
+		glVertexArrayAttribBinding(vao, 1, 0);
+	}
 
-	glBindVertexArray(0);
+	m_Points = __InitBuff(GL_POINTS, m_PointShaderHandle, sizeof(PointVert), InitialPointVerts);
+	glEnableVertexArrayAttrib(m_Points.VAO, 0);
+	glEnableVertexArrayAttrib(m_Points.VAO, 1);
+	glEnableVertexArrayAttrib(m_Points.VAO, 2);
+	glVertexArrayAttribFormat(m_Points.VAO, 0, 3, GL_FLOAT, false, offsetof(PointVert, Position));
+	glVertexArrayAttribFormat(m_Points.VAO, 1, 4, GL_FLOAT, false, offsetof(PointVert, Color));
+	glVertexArrayAttribFormat(m_Points.VAO, 2, 1, GL_FLOAT, false, offsetof(PointVert, Size));
+	glVertexArrayAttribBinding(m_Points.VAO, 0, 0);
+	glVertexArrayAttribBinding(m_Points.VAO, 1, 0);
+	glVertexArrayAttribBinding(m_Points.VAO, 2, 0);
 
 	// Make sure that the mesh helper has a context
 	m_MeshHelper = new Impl::MeshHelper();
@@ -188,35 +230,210 @@ TTK::Context::Context() {
 	glEnable(GL_PROGRAM_POINT_SIZE);
 }
 
-TTK::Context::GLBuff TTK::Context::__InitBuff(GLenum mode, GLuint shader, void* dataSource, size_t elemSize, size_t maxElems)
+TTK::Context::GLBuff TTK::Context::__InitBuff(GLenum mode, GLuint shader, size_t elemSize, size_t capacity)
 {
 	GLBuff result;
 	result.Mode = mode;
 	result.Count = 0;
-	result.Data = dataSource;
 	result.ElemSize = elemSize;
 	result.Shader = shader;
+	result.VBO = 0;
+	result.Mapped = nullptr;
+	result.Region = 0;
+	for (size_t ix = 0; ix < RingRegions; ix++) {
+		result.Fences[ix] = nullptr;
+	}
 
 	glCreateVertexArrays(1, &result.VAO);
-	glBindVertexArray(result.VAO);
-	glCreateBuffers(1, &result.VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, result.VBO);
-	glNamedBufferData(result.VBO, elemSize * maxElems, nullptr, GL_STREAM_DRAW);
+	__Allocate(result, capacity);
 
 	return result;
 }
 
+void TTK::Context::__Allocate(GLBuff& buff, size_t capacity) {
+	// Coherent, so anything we write is visible to the next draw without flushing ranges
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLsizeiptr size = static_cast<GLsizeiptr>(capacity * buff.ElemSize * RingRegions);
+
+	glCreateBuffers(1, &buff.VBO);
+	glNamedBufferStorage(buff.VBO, size, nullptr, flags);
+	buff.Mapped = static_cast<uint8_t*>(glMapNamedBufferRange(buff.VBO, 0, size, flags));
+	buff.Capacity = capacity;
+	glVertexArrayVertexBuffer(buff.VAO, 0, buff.VBO, 0, static_cast<GLsizei>(buff.ElemSize));
+}
+
+void TTK::Context::__Grow(GLBuff& buff, size_t required) {
+	size_t capacity = buff.Capacity * 2;
+	while (capacity < required) {
+		capacity *= 2;
+	}
+
+	__Resize(buff, capacity);
+	m_Stats.Grows++;
+}
+
+void TTK::Context::__Resize(GLBuff& buff, size_t capacity) {
+	GLuint oldVBO = buff.VBO;
+	size_t oldOffset = buff.Region * buff.Capacity * buff.ElemSize;
+	__Allocate(buff, capacity);
+
+	// Carry over what's been written this frame, copying on the GPU since the old mapping is write only
+	if (buff.Count > 0) {
+		glCopyNamedBufferSubData(oldVBO, buff.VBO, oldOffset, 0, buff.Count * buff.ElemSize);
+	}
+
+	// The old regions' fences don't mean anything for the new buffer, and OpenGL keeps the old one alive until the
+	// draws using it are done
+	for (size_t ix = 0; ix < RingRegions; ix++) {
+		if (buff.Fences[ix] != nullptr) {
+			glDeleteSync(buff.Fences[ix]);
+			buff.Fences[ix] = nullptr;
+		}
+	}
+	glUnmapNamedBuffer(oldVBO);
+	glDeleteBuffers(1, &oldVBO);
+	buff.Region = 0;
+}
+
+void TTK::Context::__WaitForRegion(GLBuff& buff) {
+	GLsync& fence = buff.Fences[buff.Region];
+	if (fence == nullptr) {
+		return;
+	}
+
+	// Usually the GPU finished with this region a couple of frames ago
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED) {
+		auto start = std::chrono::high_resolution_clock::now();
+		do {
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (result == GL_TIMEOUT_EXPIRED);
+		m_Stats.Stalls++;
+		m_Stats.StallMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+	if (result == GL_WAIT_FAILED) {
+		LOG_WARN("Failed waiting on a streaming buffer fence");
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
 void TTK::Context::__Flush(GLBuff& buff) {
 	if (buff.Count > 0) {
 		glUseProgram(buff.Shader);
 		glUniformMatrix4fv(0, 1, false, &m_ViewProjection[0][0]);
-		glNamedBufferSubData(buff.VBO, 0, buff.Count * buff.ElemSize, buff.Data);
 		glBindVertexArray(buff.VAO);
-		glDrawArrays(buff.Mode, 0, static_cast<GLsizei>(buff.Count));
+		glDrawArrays(buff.Mode, static_cast<GLint>(buff.Region * buff.Capacity), static_cast<GLsizei>(buff.Count));
+		m_Stats.DrawCalls++;
+		m_Stats.Vertices += buff.Count;
+
+		// Move on to the next region, it can't be written until the GPU is done with what we last drew from it
+		buff.Fences[buff.Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		buff.Region = (buff.Region + 1) % RingRegions;
 		buff.Count = 0;
+		__WaitForRegion(buff);
 	}
 }
 
+void TTK::Context::__DestroyBuff(GLBuff& buff) {
+	for (size_t ix = 0; ix < RingRegions; ix++) {
+		if (buff.Fences[ix] != nullptr) {
+			glDeleteSync(buff.Fences[ix]);
+		}
+	}
+	glUnmapNamedBuffer(buff.VBO);
+	glDeleteBuffers(1, &buff.VBO);
+	glDeleteVertexArrays(1, &buff.VAO);
+}
+
+void TTK::Context::RunLineBenchmark(size_t lineCount) {
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> range(-10.0f, 10.0f);
+	std::vector<glm::vec3> points(lineCount * 2);
+	for (glm::vec3& point : points) {
+		point = glm::vec3(range(rng), range(rng), range(rng));
+	}
+	const glm::vec4 color = glm::vec4(0.2f, 1.0f, 0.4f, 1.0f);
+
+	GLuint query;
+	glGenQueries(1, &query);
+	GLuint64 gpuTime = 0;
+
+	// Run the streaming path twice, the first run grows the buffers to fit
+	const size_t lineCapacity = m_Lines.Capacity;
+	double streamCpu = 0.0;
+	size_t grows = m_Stats.Grows;
+	size_t stalls = m_Stats.Stalls;
+	for (int run = 0; run < 2; run++) {
+		glFinish();
+		auto start = std::chrono::high_resolution_clock::now();
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		for (size_t ix = 0; ix < lineCount; ix++) {
+			AddLine(points[ix * 2], points[ix * 2 + 1], color);
+		}
+		Flush();
+		glEndQuery(GL_TIME_ELAPSED);
+		streamCpu = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpuTime);
+	}
+	double streamGpu = gpuTime / 1000000.0;
+	size_t streamDraws = m_Stats.DrawCalls;
+
+	// Put the line buffer back to the size it was, otherwise it stays big enough for every benchmark line for good
+	if (m_Lines.Capacity != lineCapacity) {
+		__Resize(m_Lines, lineCapacity);
+	}
+
+	// The way AddLine used to work, a sub data upload and a draw for every 512 lines
+	const size_t batchVerts = 512 * 2;
+	std::vector<SimpleVert> batch(batchVerts);
+	GLuint legacyVAO, legacyVBO;
+	glCreateVertexArrays(1, &legacyVAO);
+	glCreateBuffers(1, &legacyVBO);
+	glNamedBufferData(legacyVBO, batchVerts * sizeof(SimpleVert), nullptr, GL_STREAM_DRAW);
+	glVertexArrayVertexBuffer(legacyVAO, 0, legacyVBO, 0, sizeof(SimpleVert));
+	glEnableVertexArrayAttrib(legacyVAO, 0);
+	glEnableVertexArrayAttrib(legacyVAO, 1);
+	glVertexArrayAttribFormat(legacyVAO, 0, 3, GL_FLOAT, false, offsetof(SimpleVert, Position));
+	glVertexArrayAttribFormat(legacyVAO, 1, 4, GL_FLOAT, false, offsetof(SimpleVert, Color));
+	glVertexArrayAttribBinding(legacyVAO, 0, 0);
+	glVertexArrayAttribBinding(legacyVAO, 1, 0);
+
+	glFinish();
+	auto start = std::chrono::high_resolution_clock::now();
+	glBeginQuery(GL_TIME_ELAPSED, query);
+	glUseProgram(m_ShaderHandle);
+	glUniformMatrix4fv(0, 1, false, &m_ViewProjection[0][0]);
+	glBindVertexArray(legacyVAO);
+	size_t count = 0;
+	size_t legacyDraws = 0;
+	for (size_t ix = 0; ix < lineCount * 2; ix++) {
+		batch[count].Position = points[ix];
+		batch[count].Color = color;
+		count++;
+		if (count == batchVerts || ix == lineCount * 2 - 1) {
+			glNamedBufferSubData(legacyVBO, 0, count * sizeof(SimpleVert), batch.data());
+			glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(count));
+			legacyDraws++;
+			count = 0;
+		}
+	}
+	glEndQuery(GL_TIME_ELAPSED);
+	double legacyCpu = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpuTime);
+	double legacyGpu = gpuTime / 1000000.0;
+
+	glBindVertexArray(0);
+	glDeleteBuffers(1, &legacyVBO);
+	glDeleteVertexArrays(1, &legacyVAO);
+	glDeleteQueries(1, &query);
+
+	LOG_INFO("Debug draw benchmark, {} lines:", lineCount);
+	LOG_INFO("\tStreaming: {:.2f} ms CPU, {:.2f} ms GPU, {} draw(s), {} grow(s), {} stall(s)", streamCpu, streamGpu, streamDraws,
+		m_Stats.Grows - grows, m_Stats.Stalls - stalls);
+	LOG_INFO("\tBatches of 512: {:.2f} ms CPU, {:.2f} ms GPU, {} draws", legacyCpu, legacyGpu, legacyDraws);
+}
+
 GLuint TTK::Context::__CompileShader(const char* vsSource, const char* fsSource)
 {
 	GLuint result = glCreateProgram();
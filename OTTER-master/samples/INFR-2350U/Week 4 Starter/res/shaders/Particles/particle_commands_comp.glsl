@@ -0,0 +1,34 @@
+#version 430
+
+layout(local_size_x = 1) in;
+
+layout(std430, binding = 4) buffer Commands
+{
+	uint DrawCount;
+	uint InstanceCount;
+	uint First;
+	uint BaseInstance;
+	uint GroupsX;
+	uint GroupsY;
+	uint GroupsZ;
+	int DeadCount;
+	uint AliveCount;
+};
+
+//0 sets up the simulate dispatch, 1 runs after it
+uniform int u_Stage;
+
+void main()
+{
+	if (u_Stage == 0)
+	{
+		//One thread per live particle, the simulate pass counts survivors into the draw command
+		GroupsX = (AliveCount + 255u) / 256u;
+		InstanceCount = 0u;
+	}
+	else
+	{
+		//The survivors are next frame's live particles
+		AliveCount = InstanceCount;
+	}
+}
@@ -0,0 +1,101 @@
+#version 430
+
+layout(local_size_x = 256) in;
+
+struct Particle
+{
+	//xyz is the position, w is the age
+	vec4 PositionAge;
+	//xyz is the velocity, w is the lifetime
+	vec4 VelocityLife;
+};
+
+layout(std430, binding = 0) buffer Particles
+{
+	Particle particles[];
+};
+
+layout(std430, binding = 1) buffer AliveIn
+{
+	uint aliveIn[];
+};
+
+layout(std430, binding = 3) buffer DeadList
+{
+	uint dead[];
+};
+
+layout(std430, binding = 4) buffer Commands
+{
+	uint DrawCount;
+	uint InstanceCount;
+	uint First;
+	uint BaseInstance;
+	uint GroupsX;
+	uint GroupsY;
+	uint GroupsZ;
+	int DeadCount;
+	uint AliveCount;
+};
+
+uniform int u_EmitCount;
+uniform int u_Seed;
+
+uniform mat4 u_World;
+//Launch direction in the emitter's space
+uniform vec3 u_Direction;
+uniform float u_Spread;
+uniform float u_EmitRadius;
+//Min and max
+uniform vec2 u_Lifetime;
+uniform vec2 u_Speed;
+
+//PCG hash, good enough randomness from just an index
+uint Hash(uint value)
+{
+	uint state = value * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+float Random(inout uint state)
+{
+	state = Hash(state);
+	return float(state >> 8) / 16777216.0;
+}
+
+void main()
+{
+	uint id = gl_GlobalInvocationID.x;
+	if (id >= uint(u_EmitCount))
+	{
+		return;
+	}
+
+	//Take a free particle, giving the slot back if there weren't any left
+	int slot = atomicAdd(DeadCount, -1) - 1;
+	if (slot < 0)
+	{
+		atomicAdd(DeadCount, 1);
+		return;
+	}
+	uint index = dead[slot];
+
+	uint state = Hash(id ^ Hash(uint(u_Seed)));
+	vec3 offset = vec3(Random(state), Random(state), Random(state)) * 2.0 - 1.0;
+	vec3 jitter = vec3(Random(state), Random(state), Random(state)) * 2.0 - 1.0;
+	if (dot(jitter, jitter) > 0.0)
+	{
+		jitter = normalize(jitter);
+	}
+
+	vec3 position = (u_World * vec4(offset * u_EmitRadius, 1.0)).xyz;
+	vec3 launch = u_Direction + jitter * u_Spread;
+	launch = dot(launch, launch) > 0.0 ? normalize(mat3(u_World) * launch) : mat3(u_World) * u_Direction;
+	vec3 velocity = launch * mix(u_Speed.x, u_Speed.y, Random(state));
+
+	particles[index].PositionAge = vec4(position, 0.0);
+	particles[index].VelocityLife = vec4(velocity, mix(u_Lifetime.x, u_Lifetime.y, Random(state)));
+
+	aliveIn[atomicAdd(AliveCount, 1)] = index;
+}
@@ -0,0 +1,17 @@
+#version 430
+
+layout(location = 0) in vec4 inColor;
+layout(location = 1) in vec2 inUV;
+
+out vec4 frag_color;
+
+void main()
+{
+	//Soft round falloff from the middle of the quad
+	float falloff = 1.0 - dot(inUV, inUV);
+	if (falloff <= 0.0)
+	{
+		discard;
+	}
+	frag_color = vec4(inColor.rgb, inColor.a * falloff);
+}
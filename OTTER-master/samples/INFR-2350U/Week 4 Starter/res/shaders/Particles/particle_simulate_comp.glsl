@@ -0,0 +1,77 @@
+#version 430
+
+layout(local_size_x = 256) in;
+
+struct Particle
+{
+	//xyz is the position, w is the age
+	vec4 PositionAge;
+	//xyz is the velocity, w is the lifetime
+	vec4 VelocityLife;
+};
+
+layout(std430, binding = 0) buffer Particles
+{
+	Particle particles[];
+};
+
+layout(std430, binding = 1) readonly buffer AliveIn
+{
+	uint aliveIn[];
+};
+
+layout(std430, binding = 2) writeonly buffer AliveOut
+{
+	uint aliveOut[];
+};
+
+layout(std430, binding = 3) buffer DeadList
+{
+	uint dead[];
+};
+
+layout(std430, binding = 4) buffer Commands
+{
+	uint DrawCount;
+	uint InstanceCount;
+	uint First;
+	uint BaseInstance;
+	uint GroupsX;
+	uint GroupsY;
+	uint GroupsZ;
+	int DeadCount;
+	uint AliveCount;
+};
+
+uniform float u_DeltaTime;
+//1 / (1 + drag * dt)
+uniform float u_Damping;
+//Gravity * dt
+uniform vec3 u_GravityStep;
+
+void main()
+{
+	uint id = gl_GlobalInvocationID.x;
+	if (id >= AliveCount)
+	{
+		return;
+	}
+
+	uint index = aliveIn[id];
+	Particle particle = particles[index];
+
+	//Same semi-implicit Euler step as the CPU pools
+	particle.VelocityLife.xyz = (particle.VelocityLife.xyz + u_GravityStep) * u_Damping;
+	particle.PositionAge.xyz = particle.PositionAge.xyz + particle.VelocityLife.xyz * u_DeltaTime;
+	particle.PositionAge.w = particle.PositionAge.w + u_DeltaTime;
+	particles[index] = particle;
+
+	if (particle.PositionAge.w >= particle.VelocityLife.w)
+	{
+		dead[atomicAdd(DeadCount, 1)] = index;
+	}
+	else
+	{
+		aliveOut[atomicAdd(InstanceCount, 1u)] = index;
+	}
+}
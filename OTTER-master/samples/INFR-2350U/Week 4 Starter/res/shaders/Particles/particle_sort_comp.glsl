@@ -0,0 +1,92 @@
+#version 430
+
+layout(local_size_x = 256) in;
+
+struct Particle
+{
+	//xyz is the position, w is the age
+	vec4 PositionAge;
+	//xyz is the velocity, w is the lifetime
+	vec4 VelocityLife;
+};
+
+layout(std430, binding = 0) readonly buffer Particles
+{
+	Particle particles[];
+};
+
+layout(std430, binding = 1) buffer AliveList
+{
+	uint alive[];
+};
+
+layout(std430, binding = 4) readonly buffer Commands
+{
+	uint DrawCount;
+	uint InstanceCount;
+	uint First;
+	uint BaseInstance;
+	uint GroupsX;
+	uint GroupsY;
+	uint GroupsZ;
+	int DeadCount;
+	uint AliveCount;
+};
+
+//x is the depth key, y is the particle index
+layout(std430, binding = 5) buffer SortKeys
+{
+	uvec2 keys[];
+};
+
+//0 builds the keys, 1 is one bitonic step, 2 writes the sorted indices back
+uniform int u_Stage;
+//Power of 2 the keys are padded to
+uniform int u_SortSize;
+//Bitonic block size (k) and compare distance (j)
+uniform ivec2 u_Step;
+uniform mat4 u_View;
+
+void main()
+{
+	uint id = gl_GlobalInvocationID.x;
+	if (id >= uint(u_SortSize))
+	{
+		return;
+	}
+
+	if (u_Stage == 0)
+	{
+		//Positive floats sort the same as their bits, +1 keeps every live key above the padding's 0
+		if (id < InstanceCount)
+		{
+			uint index = alive[id];
+			float depth = max(-(u_View * vec4(particles[index].PositionAge.xyz, 1.0)).z, 0.0);
+			keys[id] = uvec2(floatBitsToUint(depth) + 1u, index);
+		}
+		else
+		{
+			keys[id] = uvec2(0u, 0u);
+		}
+	}
+	else if (u_Stage == 1)
+	{
+		uint partner = id ^ uint(u_Step.y);
+		if (partner > id)
+		{
+			uvec2 a = keys[id];
+			uvec2 b = keys[partner];
+			//Blocks alternate direction, the whole list ends up largest (farthest) first
+			bool descending = (id & uint(u_Step.x)) == 0u;
+			if (descending ? a.x < b.x : a.x > b.x)
+			{
+				keys[id] = b;
+				keys[partner] = a;
+			}
+		}
+	}
+	else if (id < InstanceCount)
+	{
+		alive[id] = keys[id].y;
+	}
+}
@@ -0,0 +1,45 @@
+#version 430
+
+struct Particle
+{
+	//xyz is the position, w is the age
+	vec4 PositionAge;
+	//xyz is the velocity, w is the lifetime
+	vec4 VelocityLife;
+};
+
+layout(std430, binding = 0) readonly buffer Particles
+{
+	Particle particles[];
+};
+
+//Which particle each instance draws, in draw order
+layout(std430, binding = 1) readonly buffer DrawOrder
+{
+	uint order[];
+};
+
+layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec2 outUV;
+
+uniform mat4 u_View;
+uniform mat4 u_Projection;
+uniform vec4 u_StartColor;
+uniform vec4 u_EndColor;
+//Size at birth and death
+uniform vec2 u_Size;
+
+void main()
+{
+	Particle particle = particles[order[gl_InstanceID]];
+	float life = clamp(particle.PositionAge.w / particle.VelocityLife.w, 0.0, 1.0);
+
+	//Triangle strip corners, expanded in view space so the quad always faces the camera
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+	vec4 viewPosition = u_View * vec4(particle.PositionAge.xyz, 1.0);
+	viewPosition.xy += corner * mix(u_Size.x, u_Size.y, life) * 0.5;
+
+	outColor = mix(u_StartColor, u_EndColor, life);
+	outUV = corner;
+	gl_Position = u_Projection * viewPosition;
+}
@@ -12,5 +12,6 @@ void main()
 	vec4 colorA = texture(s_Scene, inUV);
 	vec4 colorB = texture(s_Bloom, inUV);
 
-	frag_color = 1.0 - (1.0 - colorA) * (1.0 - colorB);
+	//Additive since the scene is HDR (a screen blend breaks once colors go over 1)
+	frag_color = vec4(colorA.rgb + colorB.rgb, colorA.a);
 }
\ No newline at end of file
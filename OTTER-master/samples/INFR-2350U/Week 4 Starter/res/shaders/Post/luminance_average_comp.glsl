@@ -0,0 +1,68 @@
+#version 430
+
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 0) buffer Histogram
+{
+	uint Bins[256];
+};
+
+layout(std430, binding = 1) buffer Exposure
+{
+	float AdaptedLuminance;
+	float AutoExposure;
+};
+
+uniform int u_PixelCount;
+
+uniform float u_MinLogLuminance;
+uniform float u_LogLuminanceRange;
+
+uniform float u_DeltaTime;
+uniform float u_AdaptationSpeed;
+uniform float u_KeyValue;
+
+shared float weightedBins[256];
+shared uint darkPixels;
+
+void main()
+{
+	uint index = gl_LocalInvocationIndex;
+	uint count = Bins[index];
+
+	//Weight each bin's count by its index, and clear it for next frame
+	weightedBins[index] = float(count) * float(index);
+	Bins[index] = 0;
+
+	if (index == 0)
+	{
+		darkPixels = count;
+	}
+	barrier();
+
+	//Parallel sum of the weighted bins
+	for (uint stride = 128; stride > 0; stride >>= 1)
+	{
+		if (index < stride)
+		{
+			weightedBins[index] += weightedBins[index + stride];
+		}
+		barrier();
+	}
+
+	if (index == 0)
+	{
+		//Pixels in bin 0 don't count toward the average
+		float litPixels = max(float(u_PixelCount) - float(darkPixels), 1.0);
+		float averageBin = weightedBins[0] / litPixels - 1.0;
+
+		//Back from a bin to a luminance
+		float averageLogLuminance = (averageBin / 254.0) * u_LogLuminanceRange + u_MinLogLuminance;
+		float luminance = exp2(averageLogLuminance);
+
+		//Ease toward the new luminance, framerate independent
+		float blend = 1.0 - exp(-u_DeltaTime * u_AdaptationSpeed);
+		AdaptedLuminance = AdaptedLuminance + (luminance - AdaptedLuminance) * blend;
+		AutoExposure = u_KeyValue / max(AdaptedLuminance, 0.0001);
+	}
+}
@@ -0,0 +1,50 @@
+#version 430
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+layout(binding = 0) uniform sampler2D s_Scene;
+
+layout(std430, binding = 0) buffer Histogram
+{
+	uint Bins[256];
+};
+
+//Part of the scene texture in use
+uniform ivec2 u_Size;
+
+uniform float u_MinLogLuminance;
+uniform float u_InvLogLuminanceRange;
+
+shared uint localBins[256];
+
+//Bin 0 is for pixels too dark to count, the rest cover the log luminance range
+uint GetBin(vec3 color)
+{
+	float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+
+	if (luminance < 0.0001)
+	{
+		return 0;
+	}
+
+	float logLuminance = clamp((log2(luminance) - u_MinLogLuminance) * u_InvLogLuminanceRange, 0.0, 1.0);
+	return uint(logLuminance * 254.0 + 1.0);
+}
+
+void main()
+{
+	//One invocation per bin clears the shared histogram
+	localBins[gl_LocalInvocationIndex] = 0;
+	barrier();
+
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	if (pixel.x < u_Size.x && pixel.y < u_Size.y)
+	{
+		vec3 color = texelFetch(s_Scene, pixel, 0).rgb;
+		atomicAdd(localBins[GetBin(color)], 1);
+	}
+	barrier();
+
+	//Shared atomics are cheap, so only 256 global ones per group
+	atomicAdd(Bins[gl_LocalInvocationIndex], localBins[gl_LocalInvocationIndex]);
+}
@@ -0,0 +1,42 @@
+#version 430
+
+layout(location = 0) in vec2 inUV;
+
+out vec4 frag_color;
+
+layout(binding = 0) uniform sampler2D s_Tex;
+
+layout(std430, binding = 1) readonly buffer Exposure
+{
+	float AdaptedLuminance;
+	float AutoExposure;
+};
+
+//Exposure, or compensation on top of the auto exposure
+uniform float u_Exposure;
+uniform int u_AutoExposure;
+
+//Fitted ACES curve (Krzysztof Narkowicz)
+vec3 ACESFilm(vec3 x)
+{
+	const float a = 2.51;
+	const float b = 0.03;
+	const float c = 2.43;
+	const float d = 0.59;
+	const float e = 0.14;
+	return clamp((x * (a * x + b)) / (x * (c * x + d) + e), 0.0, 1.0);
+}
+
+void main()
+{
+	vec4 source = texture(s_Tex, inUV);
+
+	float exposure = u_Exposure;
+	if (u_AutoExposure != 0)
+	{
+		exposure *= AutoExposure;
+	}
+
+	frag_color.rgb = ACESFilm(source.rgb * exposure);
+	frag_color.a = 1.0;
+}
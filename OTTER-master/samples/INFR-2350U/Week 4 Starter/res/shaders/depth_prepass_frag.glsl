@@ -0,0 +1,8 @@
+#version 410
+
+#include "lod_dither.glsl"
+
+// Depth only, color writes are masked off during the prepass so there's nothing to output
+void main() {
+	LodDither();
+}
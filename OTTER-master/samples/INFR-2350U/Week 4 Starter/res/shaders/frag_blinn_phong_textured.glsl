@@ -1,4 +1,14 @@
-#version 410
+#version 430
+
+// Keywords, each variant of this shader is compiled with some of these defined (see ShaderVariants)
+// AMBIENT        - ambient lighting
+// DIFFUSE        - diffuse lighting
+// SPECULAR       - specular lighting
+// SPECULAR_MAP   - scales the specular by s_Specular
+// SECOND_DIFFUSE - blends s_Diffuse2 over s_Diffuse by u_TextureMix
+// CLUSTERED      - adds the point lights from the light clusters (see LightClusters)
+// SHADOWS        - adds a sun with cascaded shadows (see CascadedShadows)
+// IBL            - ambient and reflections come from the environment instead of u_AmbientCol (see IBLBaker)
 
 layout(location = 0) in vec3 inPos;
 layout(location = 1) in vec3 inColor;
@@ -6,8 +16,13 @@ layout(location = 2) in vec3 inNormal;
 layout(location = 3) in vec2 inUV;
 
 uniform sampler2D s_Diffuse;
+#ifdef SECOND_DIFFUSE
 uniform sampler2D s_Diffuse2;
+uniform float u_TextureMix;
+#endif
+#ifdef SPECULAR_MAP
 uniform sampler2D s_Specular;
+#endif
 
 uniform vec3  u_AmbientCol;
 uniform float u_AmbientStrength;
@@ -23,25 +38,153 @@ uniform float u_LightAttenuationConstant;
 uniform float u_LightAttenuationLinear;
 uniform float u_LightAttenuationQuadratic;
 
-uniform float u_TextureMix;
-
 uniform vec3  u_CamPos;
 
-uniform int u_Condition;
+#if defined(CLUSTERED) || defined(SHADOWS)
+uniform mat4  u_View;
+#endif
+
+#ifdef CLUSTERED
+struct PointLight {
+	vec4 PositionRadius; // xyz world position, w radius
+	vec4 ColorIntensity; // rgb color, a intensity
+};
+
+layout(std430, binding = 2) readonly buffer PointLights {
+	PointLight Lights[];
+};
+
+// Offset into LightIndices and light count for every cluster
+layout(std430, binding = 3) readonly buffer ClusterLights {
+	uvec2 Clusters[];
+};
+
+layout(std430, binding = 4) readonly buffer LightIndexList {
+	uint LightIndices[];
+};
+
+uniform ivec3 u_ClusterGrid;
+uniform float u_ClusterDepthScale;
+uniform float u_ClusterDepthBias;
+uniform int   u_ClusterLogDepth;
+uniform vec2  u_ViewportSize;
+#endif
+
+#ifdef IBL
+// Irradiance from the environment as L2 spherical harmonics, already divided by pi
+uniform vec3  u_IrradianceSH[9];
+// Specular prefiltered for increasing roughness down the mips
+uniform samplerCube s_SpecularEnvironment;
+uniform float u_SpecularMaxLod;
+uniform mat3  u_EnvironmentRotation;
+uniform float u_IBLStrength;
+#endif
+
+#ifdef SHADOWS
+#define MAX_CASCADES 4
+
+uniform vec3  u_SunDirection;
+uniform vec3  u_SunColor;
+
+uniform sampler2DArrayShadow s_ShadowMap;
+uniform mat4  u_ShadowMatrices[MAX_CASCADES];
+// View space depth each cascade ends at
+uniform float u_CascadeSplits[MAX_CASCADES];
+// World size of a shadow map texel in each cascade, used to scale the normal offset
+uniform float u_CascadeTexelSizes[MAX_CASCADES];
+uniform int   u_CascadeCount;
+uniform float u_ShadowBias;
+#endif
 
 out vec4 frag_color;
 
+#include "lod_dither.glsl"
+
+#if defined(AMBIENT) || defined(DIFFUSE) || defined(SPECULAR)
+#define LIT
+#endif
+
+// Diffuse and specular for a single light, without attenuation
+vec3 BlinnPhong(vec3 N, vec3 viewDir, vec3 lightDir, vec3 color, float texSpec) {
+	vec3 result = vec3(0.0);
+#ifdef DIFFUSE
+	result += max(dot(N, lightDir), 0.0) * color;
+#endif
+#ifdef SPECULAR
+	vec3 h = normalize(lightDir + viewDir);
+	float spec = pow(max(dot(N, h), 0.0), u_Shininess); // Shininess coefficient (can be a uniform)
+	result += u_SpecularLightStrength * texSpec * spec * color; // Can also use a specular color
+#endif
+	return result;
+}
+
+#ifdef IBL
+vec3 EvaluateIrradiance(vec3 n) {
+	vec3 result =
+		u_IrradianceSH[0] * 0.282095 +
+		u_IrradianceSH[1] * 0.488603 * n.y +
+		u_IrradianceSH[2] * 0.488603 * n.z +
+		u_IrradianceSH[3] * 0.488603 * n.x +
+		u_IrradianceSH[4] * 1.092548 * n.x * n.y +
+		u_IrradianceSH[5] * 1.092548 * n.y * n.z +
+		u_IrradianceSH[6] * 0.315392 * (3.0 * n.z * n.z - 1.0) +
+		u_IrradianceSH[7] * 1.092548 * n.x * n.z +
+		u_IrradianceSH[8] * 0.546274 * (n.x * n.x - n.y * n.y);
+	return max(result, vec3(0.0));
+}
+#endif
+
+#ifdef SHADOWS
+// How lit a point is by the sun, from 0 (fully shadowed) to 1
+float SunShadow(vec3 N, vec3 lightDir) {
+	float depth = -(u_View * vec4(inPos, 1.0)).z;
+	int cascade = 0;
+	while (cascade < u_CascadeCount - 1 && depth > u_CascadeSplits[cascade]) {
+		cascade++;
+	}
+	// Past the last cascade there's no shadow map to read
+	if (depth > u_CascadeSplits[u_CascadeCount - 1]) {
+		return 1.0;
+	}
+
+	// Push the lookup out along the normal, more at grazing angles, to keep surfaces from shadowing themselves
+	float grazing = 1.0 - clamp(dot(N, lightDir), 0.0, 1.0);
+	vec3 offsetPos = inPos + N * u_CascadeTexelSizes[cascade] * (0.5 + grazing * 1.5);
+	vec3 coords = (u_ShadowMatrices[cascade] * vec4(offsetPos, 1.0)).xyz * 0.5 + 0.5;
+
+	// 3x3 taps, each one is already a bilinear 2x2 compare
+	vec2 texelSize = 1.0 / vec2(textureSize(s_ShadowMap, 0).xy);
+	float lit = 0.0;
+	for (int x = -1; x <= 1; x++) {
+		for (int y = -1; y <= 1; y++) {
+			lit += texture(s_ShadowMap, vec4(coords.xy + vec2(x, y) * texelSize, cascade, coords.z - u_ShadowBias));
+		}
+	}
+	return lit / 9.0;
+}
+#endif
+
 // https://learnopengl.com/Advanced-Lighting/Advanced-Lighting
 void main() {
-	// Lecture 5
-	vec3 ambient = u_AmbientLightStrength * u_LightCol;
+	LodDither();
 
-	// Diffuse
+	// Get the albedo from the diffuse / albedo map
+	vec4 textureColor = texture(s_Diffuse, inUV);
+#ifdef SECOND_DIFFUSE
+	textureColor = mix(textureColor, texture(s_Diffuse2, inUV), u_TextureMix);
+#endif
+
+#ifdef LIT
 	vec3 N = normalize(inNormal);
+	vec3 viewDir = normalize(u_CamPos - inPos);
 	vec3 lightDir = normalize(u_LightPos - inPos);
 
-	float dif = max(dot(N, lightDir), 0.0);
-	vec3 diffuse = dif * u_LightCol;// add diffuse intensity
+	// Get the specular power from the specular map
+#ifdef SPECULAR_MAP
+	float texSpec = texture(s_Specular, inUV).r;
+#else
+	float texSpec = 1.0f;
+#endif
 
 	//Attenuation
 	float dist = length(u_LightPos - inPos);
@@ -50,60 +193,59 @@ void main() {
 		u_LightAttenuationLinear * dist +
 		u_LightAttenuationQuadratic * dist * dist);
 
-	// Specular
-	vec3 viewDir  = normalize(u_CamPos - inPos);
-	vec3 h        = normalize(lightDir + viewDir);
-
-	// Get the specular power from the specular map
-	float texSpec = 1.0f;
-	float spec = pow(max(dot(N, h), 0.0), u_Shininess); // Shininess coefficient (can be a uniform)
-	vec3 specular = u_SpecularLightStrength * texSpec * spec * u_LightCol; // Can also use a specular color
-
-	// Get the albedo from the diffuse / albedo map
-	vec4 textureColor1 = texture(s_Diffuse, inUV);
-	vec4 textureColor2 = texture(s_Diffuse2, inUV);
-	vec4 textureColor = mix(textureColor1, textureColor2, u_TextureMix);
-
-	vec3 result;
-
-	switch(u_Condition)
-	{
-		//No Lighting
-		case 0:
-			result = inColor * textureColor.rgb;
-			break;
-
-		//Ambient Lighting Only
-		case 1:
-			result = (
-			(u_AmbientCol * u_AmbientLightStrength) + 
-			(ambient) * attenuation
-			) * inColor * textureColor.rgb;
-			break;
-
-		//Specular Lighting Only
-		case 2:
-			result = (
-			(specular) * attenuation
-			) * inColor * textureColor.rgb;
-			break;
-
-		//Ambient + Specular + Diffuse Lighting
-		case 3:
-			result = (
-			(u_AmbientCol * u_AmbientLightStrength) + 
-			(ambient + diffuse + specular) * attenuation
-			) * inColor * textureColor.rgb;
-			break;
-
-		//Ambient + Specular + Diffuse Lighting + Bloom
-		case 4:
-			result = (
-			(u_AmbientCol * u_AmbientLightStrength) + 
-			(ambient + diffuse + specular) * attenuation
-			) * inColor * textureColor.rgb;
-			break;
+	vec3 lighting = BlinnPhong(N, viewDir, lightDir, u_LightCol, texSpec) * attenuation;
+#ifdef AMBIENT
+#ifdef IBL
+	lighting += EvaluateIrradiance(u_EnvironmentRotation * N) * u_IBLStrength + u_AmbientLightStrength * u_LightCol * attenuation;
+#else
+	// Lecture 5
+	lighting += u_AmbientCol * u_AmbientLightStrength + u_AmbientLightStrength * u_LightCol * attenuation;
+#endif
+#endif
+
+#if defined(IBL) && defined(SPECULAR)
+	// Blinn-Phong shininess to a GGX roughness, which picks the mip
+	float roughness = sqrt(2.0 / (u_Shininess + 2.0));
+	vec3 reflected = reflect(-viewDir, N);
+	vec3 environment = textureLod(s_SpecularEnvironment, u_EnvironmentRotation * reflected, roughness * u_SpecularMaxLod).rgb;
+	// Schlick fresnel for a dielectric
+	float fresnel = 0.04 + 0.96 * pow(1.0 - max(dot(N, viewDir), 0.0), 5.0);
+	lighting += environment * fresnel * texSpec * u_IBLStrength;
+#endif
+
+#ifdef SHADOWS
+	vec3 sunDir = normalize(-u_SunDirection);
+	lighting += BlinnPhong(N, viewDir, sunDir, u_SunColor, texSpec) * SunShadow(N, sunDir);
+#endif
+
+#ifdef CLUSTERED
+	// Find our cluster from the screen position and view space depth
+	float depth = -(u_View * vec4(inPos, 1.0)).z;
+	float sliceDepth = u_ClusterLogDepth != 0 ? log(max(depth, 1e-4)) : depth;
+	int slice = int(floor(sliceDepth * u_ClusterDepthScale - u_ClusterDepthBias));
+	ivec2 tile = ivec2(gl_FragCoord.xy / u_ViewportSize * vec2(u_ClusterGrid.xy));
+	ivec3 cluster = clamp(ivec3(tile, slice), ivec3(0), u_ClusterGrid - 1);
+	uvec2 list = Clusters[cluster.x + cluster.y * u_ClusterGrid.x + cluster.z * u_ClusterGrid.x * u_ClusterGrid.y];
+
+	// Only the lights that reach this cluster
+	for (uint i = 0; i < list.y; i++) {
+		PointLight light = Lights[LightIndices[list.x + i]];
+		vec3 toLight = light.PositionRadius.xyz - inPos;
+		float lightDist = length(toLight);
+
+		// Inverse square with a window so it reaches exactly 0 at the radius
+		float falloff = clamp(1.0 - pow(lightDist / light.PositionRadius.w, 4.0), 0.0, 1.0);
+		float lightAttenuation = falloff * falloff / (lightDist * lightDist + 1.0);
+
+		lighting += BlinnPhong(N, viewDir, toLight / max(lightDist, 1e-4), light.ColorIntensity.rgb * light.ColorIntensity.a, texSpec) * lightAttenuation;
 	}
+#endif
+
+	vec3 result = lighting * inColor * textureColor.rgb;
+#else
+	// No Lighting
+	vec3 result = inColor * textureColor.rgb;
+#endif
 
 	frag_color = vec4(result, textureColor.a);
-}
\ No newline at end of file
+}
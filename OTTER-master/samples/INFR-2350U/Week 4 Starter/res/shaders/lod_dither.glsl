@@ -0,0 +1,22 @@
+// Dithered crossfade between two levels of detail (see LODSystem), included by anything that draws LOD groups
+// While fading, the new level is drawn with u_LodFade = fade and the old one with -fade. A positive fade keeps the
+// pixels under it in a 4x4 ordered dither and a negative one keeps the rest, so every pixel comes from exactly one level
+uniform float u_LodFade = 1.0;
+
+const float LOD_DITHER[16] = float[16](
+	 0.0,  8.0,  2.0, 10.0,
+	12.0,  4.0, 14.0,  6.0,
+	 3.0, 11.0,  1.0,  9.0,
+	15.0,  7.0, 13.0,  5.0
+);
+
+void LodDither() {
+	if (u_LodFade >= 1.0) {
+		return;
+	}
+	ivec2 cell = ivec2(gl_FragCoord.xy) & 3;
+	float threshold = (LOD_DITHER[cell.x + cell.y * 4] + 0.5) / 16.0;
+	if (u_LodFade >= 0.0 ? threshold >= u_LodFade : threshold < -u_LodFade) {
+		discard;
+	}
+}
@@ -0,0 +1,14 @@
+#version 410
+
+out vec4 frag_color;
+
+// Added up for every fragment that passes the depth test (additive blending)
+// Red fills up first, then green, then blue, so more layers go black -> red -> yellow -> white
+uniform vec3 u_Increment = vec3(1.0 / 8.0, 1.0 / 16.0, 1.0 / 32.0);
+
+#include "lod_dither.glsl"
+
+void main() {
+	LodDither();
+	frag_color = vec4(u_Increment, 1.0);
+}
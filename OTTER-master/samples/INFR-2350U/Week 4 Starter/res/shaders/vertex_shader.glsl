@@ -2,6 +2,7 @@
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
+// Packed meshes only fill in xy, with the normal folded into an octahedron (see VertexPacking in the graphics module)
 layout(location = 2) in vec3 inNormal;
 layout(location = 3) in vec2 inUV;
 
@@ -15,7 +16,19 @@ uniform mat4 u_View;
 uniform mat4 u_Model;
 uniform mat3 u_NormalMatrix;
 uniform vec3 u_LightPos;
-
+// Set for meshes whose normals are octahedral encoded
+uniform int u_OctahedralNormals;
+
+// The depth prepass runs this shader in a different program, the main pass needs the exact same depth to pass GL_EQUAL
+invariant gl_Position;
+
+vec3 DecodeOctahedral(vec2 folded) {
+	vec3 normal = vec3(folded, 1.0 - abs(folded.x) - abs(folded.y));
+	float t = max(-normal.z, 0.0);
+	normal.x += normal.x >= 0.0 ? -t : t;
+	normal.y += normal.y >= 0.0 ? -t : t;
+	return normalize(normal);
+}
 
 void main() {
 
@@ -26,7 +39,7 @@ void main() {
 	outPos = (u_Model * vec4(inPosition, 1.0)).xyz;
 
 	// Normals
-	outNormal = u_NormalMatrix * inNormal;
+	outNormal = u_NormalMatrix * (u_OctahedralNormals != 0 ? DecodeOctahedral(inNormal.xy) : inNormal);
 
 	// Pass our UV coords to the fragment shader
 	outUV = inUV;
@@ -0,0 +1,393 @@
+#include "CascadedShadows.h"
+
+#include <cmath>
+#include <random>
+#include <Logging.h>
+#include <GLM/gtc/matrix_transform.hpp>
+
+const int CascadedShadows::_textureSlot;
+
+//Corners of the part of the camera frustum between two view space depths
+//*Depth is linear along each corner ray, so we can slide between the near and far corners
+static void GetSliceCorners(const glm::mat4& inverseViewProjection, float nearPlane, float farPlane, float sliceNear, float sliceFar, glm::vec3 corners[8])
+{
+	for (int i = 0; i < 4; i++)
+	{
+		glm::vec2 ndc = glm::vec2((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f);
+		glm::vec4 nearCorner = inverseViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+		glm::vec4 farCorner = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+		glm::vec3 rayStart = glm::vec3(nearCorner) / nearCorner.w;
+		glm::vec3 rayEnd = glm::vec3(farCorner) / farCorner.w;
+
+		corners[i] = glm::mix(rayStart, rayEnd, (sliceNear - nearPlane) / (farPlane - nearPlane));
+		corners[i + 4] = glm::mix(rayStart, rayEnd, (sliceFar - nearPlane) / (farPlane - nearPlane));
+	}
+}
+
+CascadedShadows::CascadedShadows(int cascadeCount, int resolution)
+{
+	SetCascadeCount(cascadeCount);
+	_resolution = resolution;
+}
+
+CascadedShadows::~CascadedShadows()
+{
+	Unload();
+}
+
+void CascadedShadows::Init()
+{
+	//One layer per cascade, always allocated for the most cascades so the count can change freely
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &_depthArray);
+	glTextureStorage3D(_depthArray, 1, GL_DEPTH_COMPONENT32F, _resolution, _resolution, MaxCascades);
+	glTextureParameteri(_depthArray, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(_depthArray, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(_depthArray, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTextureParameteri(_depthArray, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	//Outside the map counts as lit
+	float border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTextureParameterfv(_depthArray, GL_TEXTURE_BORDER_COLOR, border);
+	//Hardware depth comparison, each tap is already a bilinear 2x2 PCF
+	glTextureParameteri(_depthArray, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTextureParameteri(_depthArray, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	glCreateFramebuffers(1, &_fbo);
+	glNamedFramebufferDrawBuffer(_fbo, GL_NONE);
+	glNamedFramebufferReadBuffer(_fbo, GL_NONE);
+
+	_isInit = true;
+}
+
+void CascadedShadows::Unload()
+{
+	if (!_isInit)
+		return;
+
+	glDeleteFramebuffers(1, &_fbo);
+	glDeleteTextures(1, &_depthArray);
+	_fbo = GL_NONE;
+	_depthArray = GL_NONE;
+	_isInit = false;
+}
+
+void CascadedShadows::Update(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane, const glm::vec3& lightDirection)
+{
+	std::vector<float> splits = ComputeSplits(nearPlane, glm::min(farPlane, _shadowDistance), _cascadeCount, _splitLambda);
+	glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+	glm::vec3 direction = glm::normalize(lightDirection);
+
+	float sliceNear = nearPlane;
+	for (int i = 0; i < _cascadeCount; i++)
+	{
+		glm::vec3 corners[8];
+		GetSliceCorners(inverseViewProjection, nearPlane, farPlane, sliceNear, splits[i], corners);
+
+		_cascades[i].SplitNear = sliceNear;
+		_cascades[i].SplitFar = splits[i];
+		FitCascade(_cascades[i], corners, direction);
+
+		sliceNear = splits[i];
+	}
+}
+
+void CascadedShadows::FitCascade(ShadowCascade& cascade, const glm::vec3 corners[8], const glm::vec3& lightDirection) const
+{
+	glm::vec3 center = glm::vec3(0.0f);
+	for (int i = 0; i < 8; i++)
+	{
+		center += corners[i];
+	}
+	center /= 8.0f;
+
+	//A sphere doesn't change size as the camera turns, so the texel size stays the same
+	float radius = 0.0f;
+	for (int i = 0; i < 8; i++)
+	{
+		radius = glm::max(radius, glm::length(corners[i] - center));
+	}
+	//Round up so tiny float differences don't change it either
+	radius = ceilf(radius * 16.0f) / 16.0f;
+
+	//Any up vector works as long as it isn't parallel to the light
+	glm::vec3 up = fabsf(lightDirection.z) > 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f);
+	float depth = radius * 2.0f + _casterDistance;
+
+	cascade.Center = center;
+	cascade.Radius = radius;
+	cascade.Depth = depth;
+	cascade.View = glm::lookAt(center - lightDirection * (radius + _casterDistance), center, up);
+	cascade.Projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, depth);
+	cascade.TexelSize = radius * 2.0f / _resolution;
+
+	//Snap the projection so world space lines up with whole texels, otherwise edges crawl as the camera moves
+	glm::mat4 viewProjection = cascade.Projection * cascade.View;
+	glm::vec2 origin = glm::vec2(viewProjection * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)) * (_resolution * 0.5f);
+	glm::vec2 offset = (glm::round(origin) - origin) * (2.0f / _resolution);
+	cascade.Projection[3][0] += offset.x;
+	cascade.Projection[3][1] += offset.y;
+	cascade.ViewProjection = cascade.Projection * cascade.View;
+}
+
+bool CascadedShadows::IsVisible(int cascade, const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+	const ShadowCascade& fit = _cascades[cascade];
+	glm::mat4 toLight = fit.View * model;
+
+	//Transform the box into light space and take the box around that
+	glm::vec3 center = glm::vec3(toLight * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+	glm::vec3 extents = (boundsMax - boundsMin) * 0.5f;
+	glm::vec3 lightExtents = glm::vec3(0.0f);
+	for (int i = 0; i < 3; i++)
+	{
+		lightExtents += glm::abs(glm::vec3(toLight[i])) * extents[i];
+	}
+
+	//The snapping can move the projection by up to a texel
+	float reach = fit.Radius + fit.TexelSize;
+	if (center.x - lightExtents.x > reach || center.x + lightExtents.x < -reach)
+		return false;
+	if (center.y - lightExtents.y > reach || center.y + lightExtents.y < -reach)
+		return false;
+
+	//The light looks down -z, so the far end is at -Depth
+	return center.z + lightExtents.z >= -fit.Depth;
+}
+
+void CascadedShadows::BeginCascade(int cascade)
+{
+	glGetIntegerv(GL_VIEWPORT, _previousViewport);
+
+	glNamedFramebufferTextureLayer(_fbo, GL_DEPTH_ATTACHMENT, _depthArray, 0, cascade);
+	glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+	glViewport(0, 0, _resolution, _resolution);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	//Casters in front of the near plane get flattened onto it instead of clipped
+	glEnable(GL_DEPTH_CLAMP);
+	//Slope scaled bias, the shader adds a normal offset on top of this
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(1.5f, 2.0f);
+}
+
+void CascadedShadows::EndCascade()
+{
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glDisable(GL_DEPTH_CLAMP);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
+	glViewport(_previousViewport[0], _previousViewport[1], _previousViewport[2], _previousViewport[3]);
+}
+
+void CascadedShadows::Apply(const Shader::sptr& shader) const
+{
+	glm::mat4 matrices[MaxCascades];
+	float splits[MaxCascades];
+	float texelSizes[MaxCascades];
+	for (int i = 0; i < _cascadeCount; i++)
+	{
+		matrices[i] = _cascades[i].ViewProjection;
+		splits[i] = _cascades[i].SplitFar;
+		texelSizes[i] = _cascades[i].TexelSize;
+	}
+
+	glBindTextureUnit(_textureSlot, _depthArray);
+	shader->SetUniform("s_ShadowMap", _textureSlot);
+	shader->SetUniformMatrix(shader->GetUniformLocation("u_ShadowMatrices[0]"), matrices, _cascadeCount, false);
+	shader->SetUniform(shader->GetUniformLocation("u_CascadeSplits[0]"), splits, _cascadeCount);
+	shader->SetUniform(shader->GetUniformLocation("u_CascadeTexelSizes[0]"), texelSizes, _cascadeCount);
+	shader->SetUniform("u_CascadeCount", _cascadeCount);
+	shader->SetUniform("u_ShadowBias", _depthBias);
+}
+
+int CascadedShadows::GetCascadeCount() const
+{
+	return _cascadeCount;
+}
+
+int CascadedShadows::GetResolution() const
+{
+	return _resolution;
+}
+
+const ShadowCascade& CascadedShadows::GetCascade(int cascade) const
+{
+	return _cascades[cascade];
+}
+
+float CascadedShadows::GetSplitLambda() const
+{
+	return _splitLambda;
+}
+
+float CascadedShadows::GetShadowDistance() const
+{
+	return _shadowDistance;
+}
+
+float CascadedShadows::GetDepthBias() const
+{
+	return _depthBias;
+}
+
+void CascadedShadows::SetCascadeCount(int count)
+{
+	_cascadeCount = glm::clamp(count, 1, MaxCascades);
+}
+
+void CascadedShadows::SetSplitLambda(float lambda)
+{
+	_splitLambda = glm::clamp(lambda, 0.0f, 1.0f);
+}
+
+void CascadedShadows::SetShadowDistance(float distance)
+{
+	_shadowDistance = distance > 1.0f ? distance : 1.0f;
+}
+
+void CascadedShadows::SetDepthBias(float bias)
+{
+	_depthBias = bias;
+}
+
+std::vector<float> CascadedShadows::ComputeSplits(float nearPlane, float farPlane, int count, float lambda)
+{
+	//Logarithmic splits match how perspective spreads texels out, uniform ones don't waste everything up close
+	std::vector<float> splits(count);
+	for (int i = 1; i <= count; i++)
+	{
+		float t = float(i) / float(count);
+		float logSplit = nearPlane * powf(farPlane / nearPlane, t);
+		float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+		splits[i - 1] = glm::mix(uniformSplit, logSplit, lambda);
+	}
+	//Make sure rounding can't leave a gap at the end
+	splits[count - 1] = farPlane;
+	return splits;
+}
+
+bool CascadedShadows::SelfTest()
+{
+	const float nearPlane = 0.1f;
+	const float farPlane = 1000.0f;
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, nearPlane, farPlane);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 3.0f, 3.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::vec3 lightDirection = glm::normalize(glm::vec3(-0.4f, -0.6f, -1.0f));
+	bool passed = true;
+
+	CascadedShadows shadows(4, 2048);
+
+	//Splits have to cover the shadow distance in order
+	std::vector<float> splits = ComputeSplits(nearPlane, shadows.GetShadowDistance(), 4, shadows.GetSplitLambda());
+	for (int i = 0; i < 4; i++)
+	{
+		if (splits[i] <= (i > 0 ? splits[i - 1] : nearPlane))
+		{
+			LOG_ERROR("Shadow self test failed: split {} ({}) isn't past the one before it", i, splits[i]);
+			passed = false;
+		}
+	}
+
+	//Every corner of every slice has to land inside its cascade's projection
+	shadows.Update(view, projection, nearPlane, farPlane, lightDirection);
+	glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+	for (int i = 0; i < 4; i++)
+	{
+		const ShadowCascade& cascade = shadows.GetCascade(i);
+		glm::vec3 corners[8];
+		GetSliceCorners(inverseViewProjection, nearPlane, farPlane, cascade.SplitNear, cascade.SplitFar, corners);
+		for (int c = 0; c < 8; c++)
+		{
+			glm::vec4 clip = cascade.ViewProjection * glm::vec4(corners[c], 1.0f);
+			if (glm::any(glm::greaterThan(glm::abs(glm::vec3(clip)), glm::vec3(1.0001f))))
+			{
+				LOG_ERROR("Shadow self test failed: corner {} of cascade {} is outside its projection", c, i);
+				passed = false;
+			}
+		}
+	}
+
+	//Moving and turning the camera should keep the cascade sizes and only shift them by whole texels
+	ShadowCascade before[4];
+	for (int i = 0; i < 4; i++)
+	{
+		before[i] = shadows.GetCascade(i);
+	}
+	glm::mat4 movedView = glm::rotate(glm::mat4(1.0f), 0.3f, glm::vec3(0.0f, 0.0f, 1.0f)) * glm::translate(view, glm::vec3(0.37f, -1.21f, 0.05f));
+	shadows.Update(movedView, projection, nearPlane, farPlane, lightDirection);
+	for (int i = 0; i < 4; i++)
+	{
+		const ShadowCascade& after = shadows.GetCascade(i);
+		if (fabsf(after.Radius - before[i].Radius) > 1.0f / 16.0f + 1e-4f)
+		{
+			LOG_ERROR("Shadow self test failed: cascade {} changed size from {} to {}", i, before[i].Radius, after.Radius);
+			passed = false;
+		}
+		if (after.Radius != before[i].Radius)
+			continue;
+
+		//Any world point should move by a whole number of texels between the two projections
+		glm::vec3 point = glm::vec3(1.3f, -2.7f, 0.4f);
+		glm::vec2 shift = (glm::vec2(after.ViewProjection * glm::vec4(point, 1.0f)) - glm::vec2(before[i].ViewProjection * glm::vec4(point, 1.0f))) * (2048.0f * 0.5f);
+		glm::vec2 error = glm::abs(shift - glm::round(shift));
+		if (error.x > 0.01f || error.y > 0.01f)
+		{
+			LOG_ERROR("Shadow self test failed: cascade {} moved by a fraction of a texel ({}, {})", i, shift.x, shift.y);
+			passed = false;
+		}
+	}
+
+	//Culling must never drop a box that overlaps the cascade, checked by sampling points through each box
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-80.0f, 80.0f);
+	std::uniform_real_distribution<float> size(0.1f, 6.0f);
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	int tested = 0, culled = 0, wronglyCulled = 0;
+
+	shadows.Update(view, projection, nearPlane, farPlane, lightDirection);
+	for (int b = 0; b < 2000; b++)
+	{
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(position(rng), position(rng), position(rng) * 0.25f));
+		model = glm::rotate(model, angle(rng), glm::vec3(0.0f, 0.0f, 1.0f));
+		glm::vec3 boundsMin = -glm::vec3(size(rng), size(rng), size(rng));
+		glm::vec3 boundsMax = glm::vec3(size(rng), size(rng), size(rng));
+
+		for (int i = 0; i < 4; i++)
+		{
+			const ShadowCascade& cascade = shadows.GetCascade(i);
+			bool visible = shadows.IsVisible(i, model, boundsMin, boundsMax);
+			tested++;
+			culled += visible ? 0 : 1;
+			if (visible)
+				continue;
+
+			for (int s = 0; s < 125; s++)
+			{
+				glm::vec3 t = glm::vec3(s % 5, (s / 5) % 5, s / 25) / 4.0f;
+				glm::vec4 clip = cascade.ViewProjection * model * glm::vec4(glm::mix(boundsMin, boundsMax, t), 1.0f);
+				//Inside the sides and not past the far end, anything toward the light still casts
+				if (fabsf(clip.x) <= 1.0f && fabsf(clip.y) <= 1.0f && clip.z <= 1.0f)
+				{
+					wronglyCulled++;
+					break;
+				}
+			}
+		}
+	}
+
+	if (wronglyCulled > 0)
+	{
+		LOG_ERROR("Shadow self test failed: {} casters were culled from cascades they touch", wronglyCulled);
+		passed = false;
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		const ShadowCascade& cascade = shadows.GetCascade(i);
+		LOG_INFO("Cascade {}: {:.2f} to {:.2f}, radius {:.2f}, {:.4f} units per texel", i, cascade.SplitNear, cascade.SplitFar, cascade.Radius, cascade.TexelSize);
+	}
+	if (passed)
+	{
+		LOG_INFO("Shadow self test passed: culled {} of {} caster tests with no misses", culled, tested);
+	}
+	return passed;
+}
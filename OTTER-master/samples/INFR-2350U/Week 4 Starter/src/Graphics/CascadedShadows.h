@@ -0,0 +1,101 @@
+#pragma once
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLM/glm.hpp>
+#include <Shader.h>
+
+//A single slice of the camera frustum and the light projection that covers it
+struct ShadowCascade
+{
+	//View space depths the cascade covers
+	float SplitNear = 0.0f;
+	float SplitFar = 0.0f;
+	//Bounding sphere of the slice in world space, the light projection is fit to it
+	glm::vec3 Center = glm::vec3(0.0f);
+	float Radius = 0.0f;
+	//How far past the sphere (toward the light) the projection reaches
+	float Depth = 0.0f;
+
+	glm::mat4 View = glm::mat4(1.0f);
+	glm::mat4 Projection = glm::mat4(1.0f);
+	glm::mat4 ViewProjection = glm::mat4(1.0f);
+	//Size of a shadow map texel in world units
+	float TexelSize = 0.0f;
+};
+
+//Directional light shadows, split into cascades over the camera's view distance
+//*Fitting and culling is all CPU side, so it works without an OpenGL context (Init/Begin/End/Apply need one)
+class CascadedShadows
+{
+public:
+	static const int MaxCascades = 4;
+
+	CascadedShadows(int cascadeCount = 4, int resolution = 2048);
+	~CascadedShadows();
+
+	//Creates the depth texture array and framebuffer
+	void Init();
+	//Deletes the depth texture array and framebuffer
+	void Unload();
+
+	//Splits the camera frustum into cascades and fits a light projection to each one
+	//*Projections are fit to bounding spheres and snapped to whole texels, so they don't shimmer as the camera moves
+	void Update(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane, const glm::vec3& lightDirection);
+
+	//Checks whether a mesh's bounds (in model space) can cast a shadow into a cascade
+	//*Anything between the light and the cascade can cast into it, so only the sides and far end are culled
+	bool IsVisible(int cascade, const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+	//Binds the framebuffer to render a cascade's depth into
+	void BeginCascade(int cascade);
+	//Unbinds the framebuffer
+	void EndCascade();
+	//Binds the shadow map and sets the uniforms the lit shader uses for shadows
+	void Apply(const Shader::sptr& shader) const;
+
+	//Getters
+	int GetCascadeCount() const;
+	int GetResolution() const;
+	const ShadowCascade& GetCascade(int cascade) const;
+	float GetSplitLambda() const;
+	float GetShadowDistance() const;
+	float GetDepthBias() const;
+
+	//Setters
+	void SetCascadeCount(int count);
+	//Blend between uniform (0) and logarithmic (1) splits
+	void SetSplitLambda(float lambda);
+	//How far from the camera shadows reach, the cascades never go past the far plane
+	void SetShadowDistance(float distance);
+	void SetDepthBias(float bias);
+
+	//Computes the view space depth each cascade ends at, using the practical split scheme
+	static std::vector<float> ComputeSplits(float nearPlane, float farPlane, int count, float lambda);
+
+	//Checks cascade fitting, texel snapping and culling against brute force and logs the results
+	//*Doesn't need an OpenGL context
+	static bool SelfTest();
+
+private:
+	//Fits a light projection to one slice of the frustum
+	void FitCascade(ShadowCascade& cascade, const glm::vec3 corners[8], const glm::vec3& lightDirection) const;
+
+	int _cascadeCount;
+	int _resolution;
+	float _splitLambda = 0.75f;
+	float _shadowDistance = 60.0f;
+	float _depthBias = 0.001f;
+	//Extra distance toward the light that casters can be in, on top of the cascade's bounding sphere
+	float _casterDistance = 50.0f;
+
+	ShadowCascade _cascades[MaxCascades];
+
+	GLuint _depthArray = GL_NONE;
+	GLuint _fbo = GL_NONE;
+	GLint _previousViewport[4] = { 0, 0, 0, 0 };
+	bool _isInit = false;
+
+	//Texture unit the shadow map is bound to, well past what materials use
+	static const int _textureSlot = 10;
+};
@@ -0,0 +1,371 @@
+#include "FrameCapture.h"
+
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <stb_image_write.h>
+
+FrameCapture::FrameCapture()
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+	Unload();
+}
+
+void FrameCapture::Init(unsigned width, unsigned height, unsigned ringSize)
+{
+	//Need at least two slots or every read would stall
+	_ringSize = ringSize < 2 ? 2 : ringSize;
+	_width = width;
+	_height = height;
+
+	CreateBuffers();
+
+	//Start the encoder
+	_stopWorker = false;
+	_worker = std::thread(&FrameCapture::EncodeLoop, this);
+
+	_isInit = true;
+}
+
+void FrameCapture::Unload()
+{
+	if (!_isInit)
+		return;
+
+	//Anything still on the GPU gets handed to the encoder so we don't lose the tail of a recording
+	Flush();
+
+	//Let the encoder finish what's queued then stop it
+	{
+		std::lock_guard<std::mutex> lock(_jobLock);
+		_stopWorker = true;
+	}
+	_jobSignal.notify_all();
+	if (_worker.joinable())
+		_worker.join();
+
+	DeleteBuffers();
+
+	_isInit = false;
+}
+
+void FrameCapture::Reshape(unsigned width, unsigned height)
+{
+	_width = width;
+	_height = height;
+
+	//In flight frames are the old size, just drop them
+	DeleteBuffers();
+	CreateBuffers();
+}
+
+void FrameCapture::Capture(const Framebuffer* buffer, unsigned colorBuffer)
+{
+	if (!_isInit)
+		return;
+
+	//Nothing to do unless someone wants the frame
+	if (!_recording && _screenshotPath.empty() && !_callback)
+		return;
+
+	//Follow the framebuffer if it got resized
+	if (buffer->_width != _width || buffer->_height != _height)
+	{
+		Reshape(buffer->_width, buffer->_height);
+	}
+
+	//Retire whatever has finished, oldest first, without waiting on the GPU
+	for (unsigned i = 1; i <= _ringSize; i++)
+	{
+		PixelBuffer& slot = _ring[(_writeIndex + i) % _ringSize];
+		if (slot._pending && !Retire(slot, false))
+			break;
+	}
+
+	//If the slot we want is still in use the ring is too small, so we have to wait on it
+	PixelBuffer& slot = _ring[_writeIndex];
+	if (slot._pending)
+	{
+		Retire(slot, true);
+	}
+
+	//Read into the pixel buffer, this returns right away since the destination is a buffer object
+	buffer->BindForRead(colorBuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot._handle);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, _width, _height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, GL_NONE);
+	buffer->UnbindRead();
+
+	//Fence so we know when the copy is done
+	slot._fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot._frame = _frameCount++;
+	slot._pending = true;
+
+	//Work out where this frame is going
+	slot._path.clear();
+	if (!_screenshotPath.empty())
+	{
+		slot._path = _screenshotPath;
+		_screenshotPath.clear();
+	}
+	else if (_recording)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "frame_%06llu", (unsigned long long)slot._frame);
+		slot._path = (std::filesystem::path(_recordDirectory) / name).string();
+		slot._path += _format == CaptureFormat::PNG ? ".png" : ".rgba";
+	}
+
+	_writeIndex = (_writeIndex + 1) % _ringSize;
+}
+
+void FrameCapture::Flush()
+{
+	//Oldest first so frames reach the encoder in order
+	for (unsigned i = 0; i < _ringSize; i++)
+	{
+		PixelBuffer& slot = _ring[(_writeIndex + i) % _ringSize];
+		if (slot._pending)
+			Retire(slot, true);
+	}
+}
+
+void FrameCapture::Screenshot(const std::string& path)
+{
+	_screenshotPath = path;
+}
+
+void FrameCapture::StartRecording(const std::string& directory, CaptureFormat format)
+{
+	std::filesystem::create_directories(directory);
+	_recordDirectory = directory;
+	_format = format;
+	_recording = true;
+}
+
+void FrameCapture::StopRecording()
+{
+	_recording = false;
+}
+
+bool FrameCapture::IsRecording() const
+{
+	return _recording;
+}
+
+uint64_t FrameCapture::GetFramesCaptured() const
+{
+	return _frameCount;
+}
+
+uint64_t FrameCapture::GetFramesWritten() const
+{
+	return _framesWritten;
+}
+
+uint64_t FrameCapture::GetFramesDropped() const
+{
+	return _framesDropped;
+}
+
+void FrameCapture::SetFrameCallback(FrameCallback callback)
+{
+	std::lock_guard<std::mutex> lock(_jobLock);
+	_callback = callback;
+}
+
+bool FrameCapture::Retire(PixelBuffer& buffer, bool wait)
+{
+	//Check the fence, only flushing and blocking if we were asked to wait
+	GLenum status = glClientWaitSync(buffer._fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+		return false;
+
+	glDeleteSync(buffer._fence);
+	buffer._fence = nullptr;
+	buffer._pending = false;
+
+	//The pixels can't be trusted if the wait itself failed
+	if (status == GL_WAIT_FAILED)
+	{
+		LOG_ERROR("Frame capture: waiting on frame {} failed (0x{:x}), dropping it", buffer._frame, glGetError());
+		_framesDropped++;
+		return true;
+	}
+
+	//Only the callback or a file needs the pixels, and a slow disk shouldn't eat all our memory
+	bool wanted, full;
+	{
+		std::lock_guard<std::mutex> lock(_jobLock);
+		wanted = !buffer._path.empty() || _callback;
+		full = _jobs.size() >= _maxQueuedJobs;
+	}
+	if (!wanted)
+		return true;
+	if (full)
+	{
+		_framesDropped++;
+		return true;
+	}
+
+	EncodeJob job;
+	job._width = _width;
+	job._height = _height;
+	job._frame = buffer._frame;
+	job._path = buffer._path;
+
+	//Copy out of the mapped buffer, the copy is the only CPU cost on this thread
+	//*It happens outside the lock so the encoder can keep taking jobs in the meantime
+	void* data = glMapNamedBufferRange(buffer._handle, 0, _frameSize, GL_MAP_READ_BIT);
+	if (data == nullptr)
+	{
+		LOG_ERROR("Frame capture: couldn't map the pixels of frame {} (0x{:x}), dropping it", buffer._frame, glGetError());
+		_framesDropped++;
+		return true;
+	}
+	job._pixels.resize(_frameSize);
+	memcpy(job._pixels.data(), data, _frameSize);
+	glUnmapNamedBuffer(buffer._handle);
+
+	{
+		std::lock_guard<std::mutex> lock(_jobLock);
+		_jobs.push_back(std::move(job));
+	}
+	_jobSignal.notify_one();
+
+	return true;
+}
+
+void FrameCapture::CreateBuffers()
+{
+	//RGBA8
+	_frameSize = size_t(_width) * _height * 4;
+
+	_ring.resize(_ringSize);
+	for (unsigned i = 0; i < _ringSize; i++)
+	{
+		glCreateBuffers(1, &_ring[i]._handle);
+		glNamedBufferStorage(_ring[i]._handle, _frameSize, nullptr, GL_MAP_READ_BIT);
+		_ring[i]._pending = false;
+		_ring[i]._fence = nullptr;
+	}
+	_writeIndex = 0;
+}
+
+void FrameCapture::DeleteBuffers()
+{
+	for (unsigned i = 0; i < _ring.size(); i++)
+	{
+		if (_ring[i]._fence != nullptr)
+		{
+			glDeleteSync(_ring[i]._fence);
+		}
+		glDeleteBuffers(1, &_ring[i]._handle);
+	}
+	_ring.clear();
+}
+
+void FrameCapture::EncodeLoop()
+{
+	while (true)
+	{
+		EncodeJob job;
+		FrameCallback callback;
+		{
+			std::unique_lock<std::mutex> lock(_jobLock);
+			_jobSignal.wait(lock, [this]() { return _stopWorker || !_jobs.empty(); });
+
+			//Only stop once the queue is empty
+			if (_jobs.empty())
+				return;
+
+			job = std::move(_jobs.front());
+			_jobs.pop_front();
+			callback = _callback;
+		}
+
+		if (callback)
+		{
+			callback(job._pixels, job._width, job._height, job._frame);
+		}
+
+		if (!job._path.empty())
+		{
+			if (Encode(job))
+				_framesWritten++;
+		}
+	}
+}
+
+bool FrameCapture::Encode(const EncodeJob& job) const
+{
+	std::filesystem::path path(job._path);
+
+	bool written;
+	if (path.extension() == ".png")
+	{
+		//OpenGL's origin is the bottom left, images want the top left
+		//*Starting at the last row with a negative stride flips it without touching stb's global flip flag
+		int stride = int(job._width) * 4;
+		const uint8_t* lastRow = job._pixels.data() + size_t(job._height - 1) * stride;
+		written = stbi_write_png(job._path.c_str(), job._width, job._height, 4, lastRow, -stride) != 0;
+	}
+	else
+	{
+		std::ofstream file(job._path, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(job._pixels.data()), job._pixels.size());
+		file.close();
+		written = !file.fail();
+	}
+
+	if (!written)
+	{
+		LOG_WARN("Failed to write frame to \"{}\"", job._path);
+	}
+	return written;
+}
+
+void FrameCapture::RunBenchmark(unsigned frames)
+{
+	const unsigned sizes[2][2] = { { 1920, 1080 }, { 3840, 2160 } };
+
+	for (int i = 0; i < 2; i++)
+	{
+		unsigned width = sizes[i][0];
+		unsigned height = sizes[i][1];
+
+		Framebuffer target;
+		target.AddColorTarget(GL_RGBA8);
+		target.Init(width, height);
+
+		//Run once with a callback that touches every frame so the copy out of the ring is counted too
+		FrameCapture capture;
+		capture.Init(width, height);
+		capture.SetFrameCallback([](const std::vector<uint8_t>&, unsigned, unsigned, uint64_t) {});
+
+		glFinish();
+		auto start = std::chrono::high_resolution_clock::now();
+
+		for (unsigned f = 0; f < frames; f++)
+		{
+			//Clear to a changing color so the driver can't skip any work
+			glClearColor(float(f % 255) / 255.0f, 0.5f, 0.25f, 1.0f);
+			target.Clear();
+			capture.Capture(&target);
+		}
+		capture.Flush();
+
+		auto end = std::chrono::high_resolution_clock::now();
+		double seconds = std::chrono::duration<double>(end - start).count();
+		double megabytes = double(capture.GetFramesCaptured()) * width * height * 4 / (1024.0 * 1024.0);
+
+		LOG_INFO("Readback {}x{}: {} frames in {:.3f}s ({:.1f} fps, {:.1f} MB/s, {} dropped)",
+			width, height, frames, seconds, frames / seconds, megabytes / seconds, capture.GetFramesDropped());
+
+		capture.Unload();
+	}
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+#include "Graphics/Framebuffer.h"
+
+//The file format captured frames are written out as
+enum class CaptureFormat
+{
+	PNG,
+	Raw
+};
+
+class FrameCapture
+{
+public:
+	//Callback for captured frames
+	//*Runs on the worker thread, pixels are tightly packed RGBA8 with the bottom row first
+	typedef std::function<void(const std::vector<uint8_t>& pixels, unsigned width, unsigned height, uint64_t frame)> FrameCallback;
+
+	FrameCapture();
+	~FrameCapture();
+
+	//Initializes the pixel buffer ring and starts the encoder thread
+	//*ringSize is how many frames are in flight, a frame is read back ringSize - 1 frames after it was captured
+	void Init(unsigned width, unsigned height, unsigned ringSize = 3);
+	//Stops the encoder thread and deletes the pixel buffers
+	void Unload();
+	//Recreates the pixel buffers with a new size (in flight frames are dropped)
+	void Reshape(unsigned width, unsigned height);
+
+	//Queues an asynchronous read of a color buffer in the framebuffer
+	//*Hands any frames that have finished reading back to the encoder thread
+	void Capture(const Framebuffer* buffer, unsigned colorBuffer = 0);
+	//Waits for every in flight read to finish and hands them to the encoder thread
+	void Flush();
+
+	//Saves the next captured frame to the given path
+	//*.png paths get PNG encoded, anything else is written raw
+	void Screenshot(const std::string& path);
+	//Starts saving every captured frame into the given directory
+	void StartRecording(const std::string& directory, CaptureFormat format = CaptureFormat::PNG);
+	//Stops saving captured frames
+	void StopRecording();
+
+	//Getters
+	bool IsRecording() const;
+	uint64_t GetFramesCaptured() const;
+	uint64_t GetFramesWritten() const;
+	uint64_t GetFramesDropped() const;
+
+	//Setters
+	void SetFrameCallback(FrameCallback callback);
+
+	//Measures readback throughput at 1080p and 4K and logs the results
+	//*Needs a current OpenGL context
+	static void RunBenchmark(unsigned frames = 240);
+
+private:
+	//One slot in the pixel buffer ring
+	struct PixelBuffer
+	{
+		GLuint _handle = GL_NONE;
+		GLsync _fence = nullptr;
+		uint64_t _frame = 0;
+		std::string _path;
+		bool _pending = false;
+	};
+
+	//A retired frame waiting to be encoded
+	struct EncodeJob
+	{
+		std::vector<uint8_t> _pixels;
+		unsigned _width = 0;
+		unsigned _height = 0;
+		uint64_t _frame = 0;
+		std::string _path;
+	};
+
+	//Maps a finished pixel buffer and hands it to the encoder, returns false if the GPU isn't done with it yet
+	bool Retire(PixelBuffer& buffer, bool wait);
+	//Allocates and frees the pixel buffer ring
+	void CreateBuffers();
+	void DeleteBuffers();
+	//Encoder thread loop
+	void EncodeLoop();
+	//Writes a single job out to disk, returns false (and logs) if the file couldn't be written
+	bool Encode(const EncodeJob& job) const;
+
+	std::vector<PixelBuffer> _ring;
+	unsigned _writeIndex = 0;
+	unsigned _ringSize = 3;
+
+	//Size of the pixel buffers
+	unsigned _width = 0;
+	unsigned _height = 0;
+	size_t _frameSize = 0;
+
+	//Where captured frames go
+	std::string _screenshotPath;
+	std::string _recordDirectory;
+	CaptureFormat _format = CaptureFormat::PNG;
+	bool _recording = false;
+	FrameCallback _callback;
+
+	//Encoder thread state
+	std::thread _worker;
+	std::mutex _jobLock;
+	std::condition_variable _jobSignal;
+	std::deque<EncodeJob> _jobs;
+	bool _stopWorker = false;
+
+	//Stats
+	uint64_t _frameCount = 0;
+	std::atomic<uint64_t> _framesWritten = 0;
+	std::atomic<uint64_t> _framesDropped = 0;
+
+	//Is the capture initialized
+	bool _isInit = false;
+
+	//The most jobs we let pile up before frames are dropped
+	static const size_t _maxQueuedJobs = 8;
+};
@@ -42,6 +42,24 @@ void Framebuffer::Unload()
 {
 	//Deletes the framebuffer
 	glDeleteFramebuffers(1, &_FBO);
+
+	//Deletes the multisampled framebuffer and its attachments
+	if (_msaaFBO != GL_NONE)
+	{
+		glDeleteFramebuffers(1, &_msaaFBO);
+		_msaaFBO = GL_NONE;
+	}
+	if (_msaaDepth != GL_NONE)
+	{
+		glDeleteRenderbuffers(1, &_msaaDepth);
+		_msaaDepth = GL_NONE;
+	}
+	if (!_msaaColor.empty())
+	{
+		glDeleteRenderbuffers(GLsizei(_msaaColor.size()), _msaaColor.data());
+		_msaaColor.clear();
+	}
+
 	//Sets init to false
 	_isInit = false;
 }
@@ -57,6 +75,10 @@ void Framebuffer::Init(unsigned width, unsigned height)
 
 void Framebuffer::Init()
 {
+	//Attachments always have room for the whole framebuffer
+	_allocWidth = _width > _allocWidth ? _width : _allocWidth;
+	_allocHeight = _height > _allocHeight ? _height : _allocHeight;
+
 	//Generates the FBO
 	glGenFramebuffers(1, &_FBO);
 	//Bind it
@@ -72,7 +94,7 @@ void Framebuffer::Init()
 		//Binds the texture
 		glBindTexture(GL_TEXTURE_2D, _depth._texture.GetHandle());
 		//Sets the texture data
-		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, _width, _height);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, _allocWidth, _allocHeight);
 
 		//Set texture parameters
 		glTextureParameteri(_depth._texture.GetHandle(), GL_TEXTURE_MIN_FILTER, _filter);
@@ -105,7 +127,7 @@ void Framebuffer::Init()
 			//Binds the texture
 			glBindTexture(GL_TEXTURE_2D, _color._textures[i].GetHandle());
 			//Sets the texture storage
-			glTexStorage2D(GL_TEXTURE_2D, 1, _color._formats[i], _width, _height);
+			glTexStorage2D(GL_TEXTURE_2D, 1, _color._formats[i], _allocWidth, _allocHeight);
 
 			//Set texture parameters
 			glTextureParameteri(_color._textures[i].GetHandle(), GL_TEXTURE_MIN_FILTER, _filter);
@@ -120,6 +142,38 @@ void Framebuffer::Init()
 		delete[] textureHandles;
 	}
 
+	//Multisampled attachments get rendered into, the textures above become the resolve targets
+	if (_samples > 1)
+	{
+		glCreateFramebuffers(1, &_msaaFBO);
+
+		if (_depthActive)
+		{
+			glCreateRenderbuffers(1, &_msaaDepth);
+			glNamedRenderbufferStorageMultisample(_msaaDepth, _samples, GL_DEPTH_COMPONENT24, _allocWidth, _allocHeight);
+			glNamedFramebufferRenderbuffer(_msaaFBO, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _msaaDepth);
+		}
+
+		if (_color._numAttachments)
+		{
+			_msaaColor.resize(_color._numAttachments);
+			glCreateRenderbuffers(_color._numAttachments, _msaaColor.data());
+
+			for (unsigned i = 0; i < _color._numAttachments; i++)
+			{
+				glNamedRenderbufferStorageMultisample(_msaaColor[i], _samples, _color._formats[i], _allocWidth, _allocHeight);
+				glNamedFramebufferRenderbuffer(_msaaFBO, GL_COLOR_ATTACHMENT0 + i, GL_RENDERBUFFER, _msaaColor[i]);
+			}
+			glNamedFramebufferDrawBuffers(_msaaFBO, _color._numAttachments, &_color._buffers[0]);
+		}
+
+		GLenum status = glCheckNamedFramebufferStatus(_msaaFBO, GL_FRAMEBUFFER);
+		if (status != GL_FRAMEBUFFER_COMPLETE)
+		{
+			LOG_ERROR("Multisampled framebuffer ({}x, {}x{}) is incomplete, status 0x{:x}", _samples, _allocWidth, _allocHeight, status);
+		}
+	}
+
 	//Make sure it's set up right
 	CheckFBO();
 	//Unbind buffer
@@ -172,6 +226,33 @@ void Framebuffer::Reshape(unsigned width, unsigned height)
 {
 	//Set size
 	SetSize(width, height);
+
+	//If it still fits we just render into a smaller part of the attachments
+	if (_isInit && width <= _allocWidth && height <= _allocHeight)
+		return;
+
+	//Otherwise grow them (Init makes them at least as big as the new size)
+	Reallocate();
+}
+
+void Framebuffer::Reserve(unsigned maxWidth, unsigned maxHeight)
+{
+	//Never shrink the attachments, we'd just need the space again later
+	if (maxWidth <= _allocWidth && maxHeight <= _allocHeight)
+		return;
+
+	_allocWidth = maxWidth > _allocWidth ? maxWidth : _allocWidth;
+	_allocHeight = maxHeight > _allocHeight ? maxHeight : _allocHeight;
+
+	//Only have to do anything now if the attachments already exist
+	if (_isInit)
+	{
+		Reallocate();
+	}
+}
+
+void Framebuffer::Reallocate()
+{
 	//Unloads the framebuffer
 	Unload();
 	//Unload the depth target
@@ -196,7 +277,7 @@ void Framebuffer::SetViewport() const
 
 void Framebuffer::Bind() const
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, _FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, _msaaFBO != GL_NONE ? _msaaFBO : _FBO);
 
 	if (_color._numAttachments)
 	{
@@ -206,9 +287,54 @@ void Framebuffer::Bind() const
 
 void Framebuffer::Unbind() const
 {
+	//Nothing can sample the multisampled attachments, so resolve them now
+	if (_msaaFBO != GL_NONE)
+	{
+		Resolve();
+	}
+
 	glBindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
 }
 
+void Framebuffer::Resolve() const
+{
+	if (_msaaFBO == GL_NONE)
+		return;
+
+	//Blit each color attachment across, depth goes with the first one
+	GLbitfield depthBit = _depthActive ? GL_DEPTH_BUFFER_BIT : 0;
+	for (unsigned i = 0; i < _color._numAttachments; i++)
+	{
+		glNamedFramebufferReadBuffer(_msaaFBO, GL_COLOR_ATTACHMENT0 + i);
+		glNamedFramebufferDrawBuffer(_FBO, GL_COLOR_ATTACHMENT0 + i);
+		glBlitNamedFramebuffer(_msaaFBO, _FBO, 0, 0, _width, _height, 0, 0, _width, _height, GL_COLOR_BUFFER_BIT | depthBit, GL_NEAREST);
+		depthBit = 0;
+	}
+
+	//Depth only framebuffers
+	if (depthBit)
+	{
+		glBlitNamedFramebuffer(_msaaFBO, _FBO, 0, 0, _width, _height, 0, 0, _width, _height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	}
+
+	//Put the draw buffers back the way Bind expects them
+	if (_color._numAttachments)
+	{
+		glNamedFramebufferDrawBuffers(_FBO, _color._numAttachments, &_color._buffers[0]);
+	}
+}
+
+void Framebuffer::BindForRead(unsigned colorBuffer) const
+{
+	glNamedFramebufferReadBuffer(_FBO, GL_COLOR_ATTACHMENT0 + colorBuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, _FBO);
+}
+
+void Framebuffer::UnbindRead() const
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, GL_NONE);
+}
+
 void Framebuffer::RenderToFSQ() const
 {
 	//Sets viewport
@@ -235,6 +361,11 @@ void Framebuffer::Clear()
 {
 	glBindFramebuffer(GL_FRAMEBUFFER, _FBO);
 	glClear(_clearFlag);
+	if (_msaaFBO != GL_NONE)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, _msaaFBO);
+		glClear(_clearFlag);
+	}
 	glBindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
 }
 
@@ -251,6 +382,61 @@ bool Framebuffer::CheckFBO()
 	return true;
 }
 
+glm::vec2 Framebuffer::GetUVScale() const
+{
+	if (_allocWidth == 0 || _allocHeight == 0)
+		return glm::vec2(1.0f);
+
+	return glm::vec2(float(_width) / float(_allocWidth), float(_height) / float(_allocHeight));
+}
+
+unsigned Framebuffer::GetAllocatedWidth() const
+{
+	return _allocWidth;
+}
+
+unsigned Framebuffer::GetAllocatedHeight() const
+{
+	return _allocHeight;
+}
+
+unsigned Framebuffer::GetSamples() const
+{
+	return _samples;
+}
+
+void Framebuffer::SetSamples(unsigned samples)
+{
+	//Can't go over what the driver supports
+	GLint maxSamples = 1;
+	glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+	samples = samples < 1 ? 1 : samples;
+	samples = samples > unsigned(maxSamples) ? unsigned(maxSamples) : samples;
+
+	if (samples == _samples)
+		return;
+
+	_samples = samples;
+
+	if (_isInit)
+	{
+		Reallocate();
+	}
+}
+
+void Framebuffer::SetColorFormat(unsigned colorBuffer, GLenum format)
+{
+	if (_color._formats[colorBuffer] == format)
+		return;
+
+	_color._formats[colorBuffer] = format;
+
+	if (_isInit)
+	{
+		Reallocate();
+	}
+}
+
 void Framebuffer::InitFullscreenQuad()
 {
 	//A vbo with Uvs and verts from
@@ -60,7 +60,10 @@ public:
 	void UnbindTexture(int textureSlot) const;
 
 	//Reshapes the framebuffer
+	//*If the new size fits in the allocated attachments only the viewport changes, otherwise they grow
 	void Reshape(unsigned width, unsigned height);
+	//Reserves space in the attachments so the framebuffer can grow up to this size without reallocating
+	void Reserve(unsigned maxWidth, unsigned maxHeight);
 	//Sets the size of the framebuffer
 	void SetSize(unsigned width, unsigned height);
 
@@ -68,9 +71,18 @@ public:
 	void SetViewport() const;
 	
 	//Binds the framebuffer
+	//*Multisampled framebuffers bind the multisampled attachments
 	void Bind() const;
 	//Unbind the framebuffer
+	//*Multisampled framebuffers get resolved into the textures first
 	void Unbind() const;
+	//Copies the multisampled attachments into the textures so they can be sampled
+	void Resolve() const;
+
+	//Binds the framebuffer as the read framebuffer, reading from the specified color buffer
+	void BindForRead(unsigned colorBuffer) const;
+	//Unbinds the read framebuffer
+	void UnbindRead() const;
 
 	//Renders the framebuffer to our FullScreenQuad
 	void RenderToFSQ() const;
@@ -83,6 +95,19 @@ public:
 	//Checks to make sure the framebuffer is... OK
 	bool CheckFBO();
 
+	//Getters
+	//The part of the attachments in use, multiply UVs by this when sampling the framebuffer
+	glm::vec2 GetUVScale() const;
+	unsigned GetAllocatedWidth() const;
+	unsigned GetAllocatedHeight() const;
+	unsigned GetSamples() const;
+
+	//Setters
+	//Sets the number of MSAA samples (1 turns it off), recreates the attachments if it's already initialized
+	void SetSamples(unsigned samples);
+	//Changes the format of a color target, recreates the attachments if it's already initialized
+	void SetColorFormat(unsigned colorBuffer, GLenum format);
+
 	//Initializes fullscreen quad
 	//*Creates VAO for full screen quad
 	//*covers -1 to 1 range
@@ -114,6 +139,21 @@ protected:
 	//Depth attachment?
 	bool _depthActive = false;
 
+	//Size the attachments are actually allocated at (never smaller than width and height)
+	unsigned int _allocWidth = 0;
+	unsigned int _allocHeight = 0;
+
+	//Deletes the attachments and creates them again at the allocated size
+	void Reallocate();
+
+	//Number of MSAA samples, 1 means we render straight into the textures
+	unsigned int _samples = 1;
+	//Multisampled framebuffer we render into, resolved into _FBO on unbind
+	GLuint _msaaFBO = GL_NONE;
+	//Multisampled attachments (renderbuffers since they're never sampled)
+	GLuint _msaaDepth = GL_NONE;
+	std::vector<GLuint> _msaaColor;
+
 	//Full screen quad VBO handle
 	static GLuint _fullscreenQuadVBO;
 	//Full screen quad VAO handle
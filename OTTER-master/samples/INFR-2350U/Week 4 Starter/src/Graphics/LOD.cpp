@@ -0,0 +1,394 @@
+#include "LOD.h"
+
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <limits>
+#include <Logging.h>
+#include <MeshFactory.h>
+#include <MeshSimplifier.h>
+#include <ObjLoader.h>
+#include <RendererComponent.h>
+#include <GLM/gtc/matrix_transform.hpp>
+
+#include "Utilities/BackendHandler.h"
+#include "Utilities/SceneSerializer.h"
+
+typedef MeshBuilder<VertexPosNormTexCol> Builder;
+
+static size_t TrianglesOf(const VertexArrayObject::sptr& mesh)
+{
+	return mesh != nullptr && mesh->GetIndexBuffer() != nullptr ? mesh->GetIndexBuffer()->GetElementCount() / 3 : 0;
+}
+
+//Name a level goes in the mesh cache under, the path and how many thousandths of the triangles it keeps
+//*The full detail level is just the path, so it's the same mesh LoadMesh gives
+static std::string LevelName(const std::string& path, float ratio)
+{
+	if (ratio >= 1.0f)
+		return path;
+	return path + "#" + std::to_string(int(std::round(ratio * 1000.0f)));
+}
+
+//Simplifies each level from the one before it (so later levels get cheaper to make) and uploads them
+//*With a path, levels that are still in the mesh cache get used instead of uploading new ones, and new ones get added
+static std::vector<LODLevel> BuildLevels(const Builder& mesh, const std::vector<LODSettings>& settings, const std::string& path)
+{
+	std::vector<LODLevel> levels;
+	levels.reserve(settings.size());
+	Builder previous = mesh;
+	for (const LODSettings& level : settings)
+	{
+		size_t target = std::max<size_t>(size_t(double(mesh.GetTriangleCount()) * level.TriangleRatio), 1);
+		if (target < previous.GetTriangleCount())
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			SimplifyStats stats;
+			previous = MeshSimplifier::Simplify(previous, target, &stats);
+			//The simplifier keeps the source's face order, which is scattered once faces start disappearing
+			previous.Optimize();
+			double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			LOG_INFO("LOD {}: {} triangles ({:.1f}% of {}), {:.1f} ms, error {:.4f}", levels.size(), stats.TrianglesOut,
+				100.0 * stats.TrianglesOut / std::max<size_t>(mesh.GetTriangleCount(), 1), mesh.GetTriangleCount(), time, stats.MaxError);
+		}
+
+		LODLevel result;
+		result.ScreenSize = level.ScreenSize;
+		if (path.empty())
+			result.Mesh = previous.Bake(SceneSerializer::GetMeshCompression());
+		else
+			result.Mesh = SceneSerializer::GetMeshCache().GetOrLoad(LevelName(path, level.TriangleRatio), [&]() { return previous.Bake(SceneSerializer::GetMeshCompression()); });
+		result.Triangles = TrianglesOf(result.Mesh);
+		levels.push_back(result);
+	}
+	return levels;
+}
+
+void LODSystem::Update(entt::registry& registry, const glm::mat4& view, const glm::mat4& projection, float deltaTime)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	_stats.Groups = 0;
+	_stats.Culled = 0;
+	_stats.Fading = 0;
+	_stats.LevelCounts.clear();
+	_stats.TrianglesDrawn = 0;
+	_stats.TrianglesFull = 0;
+
+	registry.view<LODGroup, RendererComponent, Transform>().each([&](LODGroup& group, RendererComponent&, Transform& transform) {
+		if (group.Levels.empty())
+			return;
+		const int levelCount = int(group.Levels.size());
+		group.Level = glm::clamp(group.Level, 0, levelCount - 1);
+		if (group.FadingFrom >= levelCount)
+			group.FadingFrom = -1;
+
+		group.ScreenSize = ScreenSize(group.Levels[0].Mesh, transform.WorldTransform(), view, projection);
+		int level = _enabled ? Select(group) : 0;
+		bool culled = _enabled && group.ScreenSize < group.CullScreenSize;
+
+		if (level != group.Level)
+		{
+			//Nothing to fade from if it wasn't visible, and turning LOD off snaps straight back
+			bool fade = _enabled && group.FadeTime > 0.0f && !group.Culled && !culled;
+			group.FadingFrom = fade ? group.Level : -1;
+			group.Fade = fade ? 0.0f : 1.0f;
+			group.Level = level;
+		}
+		else if (group.FadingFrom >= 0)
+		{
+			group.Fade += group.FadeTime > 0.0f ? deltaTime / group.FadeTime : 1.0f;
+			if (group.Fade >= 1.0f || !_enabled)
+			{
+				group.Fade = 1.0f;
+				group.FadingFrom = -1;
+			}
+		}
+		group.Culled = culled;
+
+		_stats.Groups++;
+		if (_stats.LevelCounts.size() < group.Levels.size())
+			_stats.LevelCounts.resize(group.Levels.size(), 0);
+		_stats.LevelCounts[group.Level]++;
+		_stats.TrianglesFull += group.Levels[0].Triangles;
+		if (group.Culled)
+		{
+			_stats.Culled++;
+			return;
+		}
+		_stats.TrianglesDrawn += group.Levels[group.Level].Triangles;
+		if (group.FadingFrom >= 0)
+		{
+			_stats.Fading++;
+			_stats.TrianglesDrawn += group.Levels[group.FadingFrom].Triangles;
+		}
+	});
+
+	_stats.CpuTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int LODSystem::Select(const LODGroup& group) const
+{
+	const int levelCount = int(group.Levels.size());
+	for (int i = 0; i < levelCount - 1; i++)
+	{
+		float threshold = group.Levels[i].ScreenSize;
+		if (i == group.Level)
+			threshold *= 1.0f - _hysteresis;
+		if (group.ScreenSize >= threshold)
+			return i;
+	}
+	return levelCount - 1;
+}
+
+const LODStats& LODSystem::GetStats() const
+{
+	return _stats;
+}
+
+bool LODSystem::IsEnabled() const
+{
+	return _enabled;
+}
+
+float LODSystem::GetHysteresis() const
+{
+	return _hysteresis;
+}
+
+void LODSystem::SetEnabled(bool enabled)
+{
+	_enabled = enabled;
+}
+
+void LODSystem::SetHysteresis(float hysteresis)
+{
+	_hysteresis = glm::clamp(hysteresis, 0.0f, 0.9f);
+}
+
+void LODSystem::Render(const Shader::sptr& shader, const VertexArrayObject::sptr& mesh, const LODGroup* group, const glm::mat4& viewProjection, const Transform& transform)
+{
+	if (group == nullptr || group->Levels.empty())
+	{
+		BackendHandler::RenderVAO(shader, mesh, viewProjection, transform);
+		return;
+	}
+	if (group->Culled)
+		return;
+	const VertexArrayObject::sptr& level = group->Levels[glm::clamp(group->Level, 0, int(group->Levels.size()) - 1)].Mesh;
+	if (group->FadingFrom < 0 || group->FadingFrom >= int(group->Levels.size()))
+	{
+		BackendHandler::RenderVAO(shader, level, viewProjection, transform);
+		return;
+	}
+
+	//The two levels keep opposite halves of the dither pattern (see lod_dither.glsl), so each pixel comes from one of them
+	shader->SetUniform("u_LodFade", group->Fade);
+	BackendHandler::RenderVAO(shader, level, viewProjection, transform);
+	shader->SetUniform("u_LodFade", -group->Fade);
+	BackendHandler::RenderVAO(shader, group->Levels[group->FadingFrom].Mesh, viewProjection, transform);
+	shader->SetUniform("u_LodFade", 1.0f);
+}
+
+float LODSystem::ScreenSize(const VertexArrayObject::sptr& mesh, const glm::mat4& world, const glm::mat4& view, const glm::mat4& projection)
+{
+	if (mesh == nullptr || !mesh->HasBounds())
+		return std::numeric_limits<float>::max();
+
+	glm::vec3 center = (mesh->GetBoundsMin() + mesh->GetBoundsMax()) * 0.5f;
+	float scale = glm::max(glm::length(glm::vec3(world[0])), glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+	float radius = glm::length(mesh->GetBoundsMax() - mesh->GetBoundsMin()) * 0.5f * scale;
+	float distance = glm::length(glm::vec3(view * world * glm::vec4(center, 1.0f)));
+
+	//Inside the sphere it fills the screen
+	if (distance <= radius)
+		return std::numeric_limits<float>::max();
+	//projection[1][1] is 1 / tan(fov / 2), so this is the sphere's size over the view's height at that distance
+	return radius * projection[1][1] / distance;
+}
+
+std::vector<LODLevel> LODSystem::BuildChain(const MeshBuilder<VertexPosNormTexCol>& mesh, const std::vector<LODSettings>& settings)
+{
+	return BuildLevels(mesh, settings, std::string());
+}
+
+std::vector<LODLevel> LODSystem::LoadChain(const std::string& path, const std::vector<LODSettings>& settings)
+{
+	//Every level still loaded means there's nothing to build
+	std::vector<LODLevel> levels;
+	for (const LODSettings& level : settings)
+	{
+		VertexArrayObject::sptr mesh = SceneSerializer::GetMeshCache().Find(LevelName(path, level.TriangleRatio));
+		if (mesh == nullptr)
+			break;
+		levels.push_back({ mesh, level.ScreenSize, TrianglesOf(mesh) });
+	}
+	if (levels.size() == settings.size())
+		return levels;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	levels = BuildLevels(SceneSerializer::ParseMesh(path), settings, path);
+	double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	LOG_INFO("Built {} levels of detail for {} in {:.1f} ms", levels.size(), path, time);
+	return levels;
+}
+
+std::vector<LODSettings> LODSystem::DefaultChain()
+{
+	return {
+		{ 1.0f, 0.35f },
+		{ 0.25f, 0.15f },
+		{ 0.06f, 0.0f }
+	};
+}
+
+bool LODSystem::RunBenchmark(size_t groupCount)
+{
+	bool passed = true;
+
+	//The simplifier on its own, the horse if it's there since that's what it's for
+	const std::string path = "models/horse.obj";
+	Builder source;
+	if (std::filesystem::exists(path))
+	{
+		source = ObjLoader::ParseFile(path);
+	}
+	else
+	{
+		LOG_WARN("LOD benchmark: {} is missing, using a sphere instead", path);
+		MeshFactory::AddIcoSphere(source, glm::vec3(0.0f), 1.0f, 5);
+	}
+
+	for (float ratio : { 0.5f, 0.25f, 0.1f, 0.03f })
+	{
+		size_t target = size_t(double(source.GetTriangleCount()) * ratio);
+		auto start = std::chrono::high_resolution_clock::now();
+		SimplifyStats stats;
+		Builder result = MeshSimplifier::Simplify(source, target, &stats);
+		double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		//Every index has to point at a vertex, and no triangle can be collapsed down to a line
+		const uint32_t* indices = result.GetIndexDataPtr();
+		const VertexPosNormTexCol* vertices = result.GetVertexDataPtr();
+		size_t broken = 0;
+		for (size_t i = 0; i + 2 < result.GetIndexCount(); i += 3)
+		{
+			if (indices[i] >= result.GetVertexCount() || indices[i + 1] >= result.GetVertexCount() || indices[i + 2] >= result.GetVertexCount())
+			{
+				broken++;
+				continue;
+			}
+			const glm::vec3& a = vertices[indices[i]].Position;
+			const glm::vec3& b = vertices[indices[i + 1]].Position;
+			const glm::vec3& c = vertices[indices[i + 2]].Position;
+			if (a == b || b == c || c == a)
+				broken++;
+		}
+		if (broken > 0)
+		{
+			LOG_ERROR("LOD benchmark failed: {} broken triangles at {:.0f}%", broken, ratio * 100.0f);
+			passed = false;
+		}
+		//It can stop short when nothing else collapses cleanly, but it shouldn't be far off
+		if (stats.TrianglesOut > target + target / 10 + 2)
+		{
+			LOG_ERROR("LOD benchmark failed: only got down to {} triangles, wanted {}", stats.TrianglesOut, target);
+			passed = false;
+		}
+		LOG_INFO("LOD benchmark: {} -> {} triangles, {} -> {} vertices in {:.1f} ms, error {:.4f}",
+			stats.TrianglesIn, stats.TrianglesOut, stats.VerticesIn, stats.VerticesOut, time, stats.MaxError);
+	}
+
+	//Level picking for a line of groups going away from the camera
+	std::vector<LODLevel> levels = BuildChain(source);
+	glm::vec3 size = levels[0].Mesh->GetBoundsMax() - levels[0].Mesh->GetBoundsMin();
+	float scale = 2.0f / glm::max(glm::length(size), 0.0001f);
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.01f, 1000.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+	entt::registry registry;
+	std::vector<entt::entity> entities(groupCount);
+	for (size_t i = 0; i < groupCount; i++)
+	{
+		entities[i] = registry.create();
+		Transform& transform = registry.emplace<Transform>(entities[i], entt::handle(registry, entities[i]));
+		transform.SetLocalPosition(0.0f, 2.0f + 200.0f * float(i) / float(groupCount), 0.0f);
+		transform.SetLocalScale(glm::vec3(scale));
+		transform.UpdateWorldMatrix();
+		registry.emplace<RendererComponent>(entities[i]);
+		LODGroup& group = registry.emplace<LODGroup>(entities[i]);
+		group.Levels = levels;
+		group.FadeTime = 0.0f;
+		group.CullScreenSize = 0.01f;
+	}
+
+	LODSystem system;
+	const int frames = 20;
+	double time = 0.0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		system.Update(registry, view, projection, 1.0f / 60.0f);
+		time += system.GetStats().CpuTime;
+	}
+	LODStats stats = system.GetStats();
+
+	//Further away can never be more detailed, and the renderer has to keep its own mesh so scenes still save it
+	int lastLevel = 0;
+	bool lastCulled = false;
+	for (entt::entity entity : entities)
+	{
+		const LODGroup& group = registry.get<LODGroup>(entity);
+		if (group.Level < lastLevel || (lastCulled && !group.Culled))
+		{
+			LOG_ERROR("LOD benchmark failed: a group at screen size {} is more detailed than one closer to the camera", group.ScreenSize);
+			passed = false;
+			break;
+		}
+		if (registry.get<RendererComponent>(entity).Mesh != nullptr)
+		{
+			LOG_ERROR("LOD benchmark failed: picking a level changed a renderer's mesh");
+			passed = false;
+			break;
+		}
+		lastLevel = group.Level;
+		lastCulled = group.Culled;
+	}
+
+	std::string counts;
+	for (size_t i = 0; i < stats.LevelCounts.size(); i++)
+	{
+		counts += (i > 0 ? ", " : "") + std::to_string(stats.LevelCounts[i]);
+	}
+	LOG_INFO("LOD benchmark: picked levels for {} groups in {:.3f} ms a frame, levels [{}], {} culled", stats.Groups, time / frames, counts, stats.Culled);
+	LOG_INFO("LOD benchmark: {} triangles drawn instead of {} ({:.1f}%)", stats.TrianglesDrawn, stats.TrianglesFull,
+		100.0 * stats.TrianglesDrawn / std::max<size_t>(stats.TrianglesFull, 1));
+
+	//Turned off, everything goes back to full detail
+	system.SetEnabled(false);
+	system.Update(registry, view, projection, 1.0f / 60.0f);
+	if (system.GetStats().TrianglesDrawn != system.GetStats().TrianglesFull)
+	{
+		LOG_ERROR("LOD benchmark failed: turning LOD off didn't go back to full detail");
+		passed = false;
+	}
+
+	//A crossfade draws both levels until it's done, then just the new one
+	system.SetEnabled(true);
+	LODGroup& group = registry.get<LODGroup>(entities[0]);
+	group.FadeTime = 0.25f;
+	registry.get<Transform>(entities[0]).SetLocalPosition(0.0f, 150.0f, 0.0f).UpdateWorldMatrix();
+	system.Update(registry, view, projection, 0.1f);
+	bool fading = group.FadingFrom == 0 && group.Level > 0;
+	for (int frame = 0; frame < 3; frame++)
+	{
+		system.Update(registry, view, projection, 0.1f);
+	}
+	if (!fading || group.FadingFrom != -1)
+	{
+		LOG_ERROR("LOD benchmark failed: the crossfade didn't start and finish");
+		passed = false;
+	}
+
+	if (passed)
+		LOG_INFO("LOD benchmark passed");
+	return passed;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include <GLM/glm.hpp>
+#include <entt.hpp>
+#include <MeshBuilder.h>
+#include <Shader.h>
+#include <Transform.h>
+#include <VertexArrayObject.h>
+#include <VertexTypes.h>
+
+//One level of an LODGroup
+struct LODLevel
+{
+	VertexArrayObject::sptr Mesh;
+	//Used while the object covers at least this much of the screen's height (the last level is used below that)
+	float ScreenSize = 0.0f;
+	size_t Triangles = 0;
+};
+
+//One level of a chain to build from a mesh
+struct LODSettings
+{
+	//How much of the source's triangles to keep
+	float TriangleRatio = 1.0f;
+	float ScreenSize = 0.0f;
+};
+
+//Component that draws simpler meshes in place of an entity's RendererComponent mesh as it gets smaller on screen
+//*The renderer keeps its own mesh, so saved scenes still point at the asset. Levels go from most to least detailed, switching crossfades the two levels with a dither over FadeTime seconds
+struct LODGroup
+{
+	std::vector<LODLevel> Levels;
+	//Nothing gets drawn below this screen size, 0 never culls
+	float CullScreenSize = 0.0f;
+	//Seconds a crossfade takes, 0 switches straight away
+	float FadeTime = 0.25f;
+
+	//Set by LODSystem
+	int Level = 0;
+	//The level being faded out, -1 when there's no crossfade going
+	int FadingFrom = -1;
+	//How far the crossfade has got, from 0 to 1
+	float Fade = 1.0f;
+	bool Culled = false;
+	//Last screen size the level was picked from
+	float ScreenSize = 0.0f;
+};
+
+//Per frame numbers for every LOD group together
+struct LODStats
+{
+	size_t Groups = 0;
+	size_t Culled = 0;
+	size_t Fading = 0;
+	//How many groups are on each level
+	std::vector<size_t> LevelCounts;
+	//Triangles drawn for the groups (both levels while fading), and what they'd be at full detail
+	size_t TrianglesDrawn = 0;
+	size_t TrianglesFull = 0;
+	//CPU time spent picking levels, in milliseconds
+	double CpuTime = 0.0;
+};
+
+//Picks every LODGroup's level from how big it is on screen, Render then draws that level instead of the renderer's mesh
+//*Screen size is the bounding sphere of the first level's mesh over the camera's view height, so it's the same
+//*for every resolution and only changes with distance, scale and field of view
+class LODSystem
+{
+public:
+	//Picks levels and moves crossfades along, call once a frame before anything is drawn
+	void Update(entt::registry& registry, const glm::mat4& view, const glm::mat4& projection, float deltaTime);
+
+	//Getters
+	const LODStats& GetStats() const;
+	bool IsEnabled() const;
+	float GetHysteresis() const;
+
+	//Setters
+	//Turning it off puts everything back on its first level, for comparing against full detail
+	void SetEnabled(bool enabled);
+	//The level in use only gives way once the object is this much (as a fraction) past its threshold, so objects
+	//sitting on a threshold don't keep switching
+	void SetHysteresis(float hysteresis);
+
+	//Draws the group's current level with a shader, along with the level it's fading out of if the group is crossfading
+	//*Groups that are culled draw nothing, a null or empty group just draws the mesh
+	static void Render(const Shader::sptr& shader, const VertexArrayObject::sptr& mesh, const LODGroup* group, const glm::mat4& viewProjection, const Transform& transform);
+
+	//How much of the screen's height a mesh's bounding sphere covers, meshes without bounds always count as huge
+	static float ScreenSize(const VertexArrayObject::sptr& mesh, const glm::mat4& world, const glm::mat4& view, const glm::mat4& projection);
+	//Simplifies a mesh into a chain of levels and uploads them
+	static std::vector<LODLevel> BuildChain(const MeshBuilder<VertexPosNormTexCol>& mesh, const std::vector<LODSettings>& settings = DefaultChain());
+	//Loads an .obj and builds a chain from it, levels that are still loaded are shared instead of built again
+	//*The first level goes in the scene serializer's mesh cache under the path, so LoadMesh shares it too
+	static std::vector<LODLevel> LoadChain(const std::string& path, const std::vector<LODSettings>& settings = DefaultChain());
+	//Full detail up close, then a quarter, then under a tenth of the triangles
+	static std::vector<LODSettings> DefaultChain();
+
+	//Simplifies horse.obj (or a sphere if it's missing) and picks levels for thousands of groups, checks the results and
+	//logs the timings and triangle counts. Needs an OpenGL context
+	static bool RunBenchmark(size_t groupCount = 10000);
+
+private:
+	//The level a group should be on at its current screen size
+	int Select(const LODGroup& group) const;
+
+	bool _enabled = true;
+	float _hysteresis = 0.1f;
+	LODStats _stats;
+};
@@ -0,0 +1,564 @@
+#include "LightClusters.h"
+
+#include <cfloat>
+#include <chrono>
+#include <random>
+#include <Logging.h>
+#include <GLM/gtc/matrix_transform.hpp>
+
+//SSE is always there on x86/x64, anything else falls back to the scalar test
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define LIGHT_CLUSTERS_SSE
+#endif
+
+LightClusters::LightClusters(unsigned gridX, unsigned gridY, unsigned gridZ)
+{
+	_gridSize = glm::uvec3(gridX, gridY, gridZ);
+
+	unsigned threads = std::thread::hardware_concurrency();
+	_threadCount = threads > 0 ? threads : 1;
+}
+
+LightClusters::~LightClusters()
+{
+	Unload();
+	StopWorkers();
+}
+
+void LightClusters::Init()
+{
+	glCreateBuffers(1, &_lightBuffer);
+	glCreateBuffers(1, &_clusterBuffer);
+	glCreateBuffers(1, &_indexBuffer);
+	_isInit = true;
+}
+
+void LightClusters::Unload()
+{
+	if (!_isInit)
+		return;
+
+	glDeleteBuffers(1, &_lightBuffer);
+	glDeleteBuffers(1, &_clusterBuffer);
+	glDeleteBuffers(1, &_indexBuffer);
+	_lightBuffer = _clusterBuffer = _indexBuffer = GL_NONE;
+	_isInit = false;
+}
+
+void LightClusters::BuildGrid(const glm::mat4& projection, float nearPlane, float farPlane)
+{
+	if (!_bounds.empty() && projection == _projection && nearPlane == _nearPlane && farPlane == _farPlane)
+		return;
+
+	_projection = projection;
+	_nearPlane = nearPlane;
+	_farPlane = farPlane;
+
+	//Perspective projections put -1 in the w row, orthographic ones leave it at 0
+	_isOrtho = projection[2][3] == 0.0f;
+
+	if (_isOrtho)
+	{
+		_depthScale = float(_gridSize.z) / (farPlane - nearPlane);
+		_depthBias = nearPlane * _depthScale;
+	}
+	else
+	{
+		//Exponential slices keep clusters roughly cube shaped as they get further away
+		_depthScale = float(_gridSize.z) / logf(farPlane / nearPlane);
+		_depthBias = logf(nearPlane) * _depthScale;
+	}
+
+	//Where a point at a normalized device x/y and a view space depth ends up in view space
+	auto unproject = [&](float ndcX, float ndcY, float depth) {
+		if (_isOrtho)
+		{
+			return glm::vec3((ndcX - projection[3][0]) / projection[0][0], (ndcY - projection[3][1]) / projection[1][1], -depth);
+		}
+		return glm::vec3(depth * (ndcX + projection[2][0]) / projection[0][0], depth * (ndcY + projection[2][1]) / projection[1][1], -depth);
+	};
+
+	_bounds.resize(GetClusterCount());
+
+	for (unsigned z = 0; z < _gridSize.z; z++)
+	{
+		float depths[2];
+		for (unsigned i = 0; i < 2; i++)
+		{
+			float t = float(z + i) / float(_gridSize.z);
+			depths[i] = _isOrtho ? nearPlane + (farPlane - nearPlane) * t : nearPlane * powf(farPlane / nearPlane, t);
+		}
+
+		for (unsigned y = 0; y < _gridSize.y; y++)
+		{
+			float ndcY[2] = { -1.0f + 2.0f * y / _gridSize.y, -1.0f + 2.0f * (y + 1) / _gridSize.y };
+
+			for (unsigned x = 0; x < _gridSize.x; x++)
+			{
+				float ndcX[2] = { -1.0f + 2.0f * x / _gridSize.x, -1.0f + 2.0f * (x + 1) / _gridSize.x };
+
+				//Bounds of all 8 corners
+				ClusterBounds& bounds = _bounds[x + y * _gridSize.x + z * _gridSize.x * _gridSize.y];
+				bounds.Min = glm::vec3(FLT_MAX);
+				bounds.Max = glm::vec3(-FLT_MAX);
+
+				for (int c = 0; c < 8; c++)
+				{
+					glm::vec3 corner = unproject(ndcX[c & 1], ndcY[(c >> 1) & 1], depths[(c >> 2) & 1]);
+					bounds.Min = glm::min(bounds.Min, corner);
+					bounds.Max = glm::max(bounds.Max, corner);
+				}
+			}
+		}
+	}
+}
+
+void LightClusters::Bin(const std::vector<PointLight>& lights, const glm::mat4& view)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	PrepareLights(lights, view);
+
+	unsigned clusterCount = GetClusterCount();
+	unsigned threads = _threadCount < clusterCount ? _threadCount : clusterCount;
+	if (lights.size() < MinThreadedLights)
+		threads = 1;
+	unsigned chunk = (clusterCount + threads - 1) / threads;
+
+	//Every thread fills its own lists for a run of clusters, then they get stitched together
+	if (_threadIndices.size() < threads)
+	{
+		_threadIndices.resize(threads);
+		_threadClusters.resize(threads);
+	}
+
+	//Hand the other runs to the workers
+	if (threads > 1)
+	{
+		StartWorkers(threads);
+		{
+			std::lock_guard<std::mutex> lock(_workLock);
+			_workThreads = threads;
+			_workChunk = chunk;
+			_workPending = threads - 1;
+			_workPass++;
+		}
+		_workSignal.notify_all();
+	}
+
+	//This thread does the first run
+	BinRange(0, chunk < clusterCount ? chunk : clusterCount, _threadIndices[0], _threadClusters[0]);
+
+	if (threads > 1)
+	{
+		std::unique_lock<std::mutex> lock(_workLock);
+		_doneSignal.wait(lock, [this]() { return _workPending == 0; });
+	}
+
+	_clusterLights.resize(clusterCount);
+	_lightIndices.clear();
+	_maxLightsPerCluster = 0;
+
+	for (unsigned t = 0; t < threads; t++)
+	{
+		GLuint base = GLuint(_lightIndices.size());
+		_lightIndices.insert(_lightIndices.end(), _threadIndices[t].begin(), _threadIndices[t].end());
+
+		for (size_t i = 0; i < _threadClusters[t].size(); i++)
+		{
+			glm::uvec2 cluster = _threadClusters[t][i];
+			_clusterLights[t * chunk + i] = glm::uvec2(cluster.x + base, cluster.y);
+			_maxLightsPerCluster = cluster.y > _maxLightsPerCluster ? cluster.y : _maxLightsPerCluster;
+		}
+	}
+
+	_binTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightClusters::BinReference(const std::vector<PointLight>& lights, const glm::mat4& view)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<glm::vec4> viewLights(lights.size());
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		glm::vec4 position = view * glm::vec4(glm::vec3(lights[i].PositionRadius), 1.0f);
+		viewLights[i] = glm::vec4(glm::vec3(position), lights[i].PositionRadius.w * lights[i].PositionRadius.w);
+	}
+
+	unsigned clusterCount = GetClusterCount();
+	_clusterLights.resize(clusterCount);
+	_lightIndices.clear();
+	_maxLightsPerCluster = 0;
+
+	for (unsigned c = 0; c < clusterCount; c++)
+	{
+		const ClusterBounds& bounds = _bounds[c];
+		GLuint offset = GLuint(_lightIndices.size());
+
+		for (size_t i = 0; i < viewLights.size(); i++)
+		{
+			//Distance from the sphere's center to the closest point on the box, same order of operations as the SIMD test
+			glm::vec3 p = glm::vec3(viewLights[i]);
+			glm::vec3 d = glm::max(bounds.Min - p, glm::vec3(0.0f)) + glm::max(p - bounds.Max, glm::vec3(0.0f));
+			float distanceSq = d.x * d.x + d.y * d.y + d.z * d.z;
+
+			if (distanceSq <= viewLights[i].w)
+			{
+				_lightIndices.push_back(GLuint(i));
+			}
+		}
+
+		GLuint count = GLuint(_lightIndices.size()) - offset;
+		_clusterLights[c] = glm::uvec2(offset, count);
+		_maxLightsPerCluster = count > _maxLightsPerCluster ? count : _maxLightsPerCluster;
+	}
+
+	_binTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightClusters::Upload(const std::vector<PointLight>& lights)
+{
+	if (!_isInit)
+		return;
+
+	//Orphan and refill every frame, sizes change with the light count and camera
+	auto upload = [](GLuint buffer, size_t size, const void* data) {
+		glNamedBufferData(buffer, size > 0 ? size : 16, size > 0 ? data : nullptr, GL_STREAM_DRAW);
+	};
+
+	upload(_lightBuffer, lights.size() * sizeof(PointLight), lights.data());
+	upload(_clusterBuffer, _clusterLights.size() * sizeof(glm::uvec2), _clusterLights.data());
+	upload(_indexBuffer, _lightIndices.size() * sizeof(GLuint), _lightIndices.data());
+}
+
+void LightClusters::Apply(const Shader::sptr& shader, const glm::vec2& viewportSize) const
+{
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, _clusterBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, _indexBuffer);
+
+	shader->SetUniform("u_ClusterGrid", glm::ivec3(_gridSize));
+	shader->SetUniform("u_ClusterDepthScale", _depthScale);
+	shader->SetUniform("u_ClusterDepthBias", _depthBias);
+	shader->SetUniform("u_ClusterLogDepth", _isOrtho ? 0 : 1);
+	shader->SetUniform("u_ViewportSize", viewportSize);
+}
+
+glm::uvec3 LightClusters::GetGridSize() const
+{
+	return _gridSize;
+}
+
+unsigned LightClusters::GetClusterCount() const
+{
+	return _gridSize.x * _gridSize.y * _gridSize.z;
+}
+
+const std::vector<glm::uvec2>& LightClusters::GetClusterLights() const
+{
+	return _clusterLights;
+}
+
+const std::vector<GLuint>& LightClusters::GetLightIndices() const
+{
+	return _lightIndices;
+}
+
+const std::vector<ClusterBounds>& LightClusters::GetClusterBounds() const
+{
+	return _bounds;
+}
+
+unsigned LightClusters::GetMaxLightsPerCluster() const
+{
+	return _maxLightsPerCluster;
+}
+
+double LightClusters::GetBinTime() const
+{
+	return _binTime;
+}
+
+void LightClusters::SetThreadCount(unsigned threads)
+{
+	_threadCount = threads > 0 ? threads : 1;
+}
+
+void LightClusters::StartWorkers(unsigned threads)
+{
+	//Worker 0 is the thread calling Bin
+	while (_workers.size() + 1 < threads)
+	{
+		unsigned worker = unsigned(_workers.size()) + 1;
+		_workers.emplace_back(&LightClusters::WorkerLoop, this, worker, _workPass);
+	}
+}
+
+void LightClusters::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(_workLock);
+		_stopWorkers = true;
+	}
+	_workSignal.notify_all();
+
+	for (std::thread& worker : _workers)
+	{
+		worker.join();
+	}
+	_workers.clear();
+	_stopWorkers = false;
+}
+
+void LightClusters::WorkerLoop(unsigned worker, uint64_t pass)
+{
+	while (true)
+	{
+		unsigned first, last;
+		{
+			std::unique_lock<std::mutex> lock(_workLock);
+			_workSignal.wait(lock, [this, pass]() { return _stopWorkers || _workPass != pass; });
+
+			if (_stopWorkers)
+				return;
+
+			pass = _workPass;
+
+			//Sit this pass out if Bin is using fewer threads than there are workers
+			if (worker >= _workThreads)
+				continue;
+
+			unsigned clusterCount = GetClusterCount();
+			first = worker * _workChunk < clusterCount ? worker * _workChunk : clusterCount;
+			last = first + _workChunk < clusterCount ? first + _workChunk : clusterCount;
+		}
+
+		BinRange(first, last, _threadIndices[worker], _threadClusters[worker]);
+
+		{
+			std::lock_guard<std::mutex> lock(_workLock);
+			_workPending--;
+		}
+		_doneSignal.notify_one();
+	}
+}
+
+void LightClusters::BinRange(unsigned start, unsigned end, std::vector<GLuint>& indices, std::vector<glm::uvec2>& clusters) const
+{
+	indices.clear();
+	clusters.resize(end - start);
+
+	unsigned sliceSize = _gridSize.x * _gridSize.y;
+
+	for (unsigned c = start; c < end; c++)
+	{
+		const SliceLights& slice = _slices[c / sliceSize];
+		const ClusterBounds& bounds = _bounds[c];
+		GLuint offset = GLuint(indices.size());
+
+#ifdef LIGHT_CLUSTERS_SSE
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 minX = _mm_set1_ps(bounds.Min.x);
+		const __m128 minY = _mm_set1_ps(bounds.Min.y);
+		const __m128 minZ = _mm_set1_ps(bounds.Min.z);
+		const __m128 maxX = _mm_set1_ps(bounds.Max.x);
+		const __m128 maxY = _mm_set1_ps(bounds.Max.y);
+		const __m128 maxZ = _mm_set1_ps(bounds.Max.z);
+
+		//The slice lists are padded to a multiple of 4 with lights that can never pass
+		for (size_t i = 0; i < slice.X.size(); i += 4)
+		{
+			__m128 x = _mm_loadu_ps(&slice.X[i]);
+			__m128 y = _mm_loadu_ps(&slice.Y[i]);
+			__m128 z = _mm_loadu_ps(&slice.Z[i]);
+
+			//Distance from each center to the closest point on the box
+			__m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minX, x), zero), _mm_max_ps(_mm_sub_ps(x, maxX), zero));
+			__m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minY, y), zero), _mm_max_ps(_mm_sub_ps(y, maxY), zero));
+			__m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minZ, z), zero), _mm_max_ps(_mm_sub_ps(z, maxZ), zero));
+			__m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+			int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSq, _mm_loadu_ps(&slice.RadiusSq[i])));
+			for (int b = 0; mask != 0; b++, mask >>= 1)
+			{
+				if (mask & 1)
+					indices.push_back(slice.Indices[i + b]);
+			}
+		}
+#else
+		for (size_t i = 0; i < slice.X.size(); i++)
+		{
+			glm::vec3 p = glm::vec3(slice.X[i], slice.Y[i], slice.Z[i]);
+			glm::vec3 d = glm::max(bounds.Min - p, glm::vec3(0.0f)) + glm::max(p - bounds.Max, glm::vec3(0.0f));
+			float distanceSq = d.x * d.x + d.y * d.y + d.z * d.z;
+
+			if (distanceSq <= slice.RadiusSq[i])
+				indices.push_back(slice.Indices[i]);
+		}
+#endif
+
+		clusters[c - start] = glm::uvec2(offset, GLuint(indices.size()) - offset);
+	}
+}
+
+void LightClusters::PrepareLights(const std::vector<PointLight>& lights, const glm::mat4& view)
+{
+	_slices.resize(_gridSize.z);
+	for (SliceLights& slice : _slices)
+	{
+		slice.Indices.clear();
+		slice.X.clear();
+		slice.Y.clear();
+		slice.Z.clear();
+		slice.RadiusSq.clear();
+	}
+
+	int lastSlice = int(_gridSize.z) - 1;
+
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		glm::vec4 position = view * glm::vec4(glm::vec3(lights[i].PositionRadius), 1.0f);
+		float radius = lights[i].PositionRadius.w;
+		float depth = -position.z;
+
+		//Entirely in front of the near plane or past the far plane
+		if (depth + radius < _nearPlane || depth - radius > _farPlane)
+			continue;
+
+		//A slice of slack on each side so rounding at slice boundaries can't drop a light, the box test is exact
+		int first = GetSlice(depth - radius > _nearPlane ? depth - radius : _nearPlane) - 1;
+		int last = GetSlice(depth + radius) + 1;
+		first = first < 0 ? 0 : first;
+		last = last > lastSlice ? lastSlice : last;
+
+		for (int s = first; s <= last; s++)
+		{
+			SliceLights& slice = _slices[s];
+			slice.Indices.push_back(GLuint(i));
+			slice.X.push_back(position.x);
+			slice.Y.push_back(position.y);
+			slice.Z.push_back(position.z);
+			slice.RadiusSq.push_back(radius * radius);
+		}
+	}
+
+	//Pad with lights that are infinitely far away and have a negative radius, so they always fail
+	for (SliceLights& slice : _slices)
+	{
+		while (slice.X.size() % 4 != 0)
+		{
+			slice.Indices.push_back(0);
+			slice.X.push_back(1e30f);
+			slice.Y.push_back(1e30f);
+			slice.Z.push_back(1e30f);
+			slice.RadiusSq.push_back(-1.0f);
+		}
+	}
+}
+
+int LightClusters::GetSlice(float depth) const
+{
+	if (_isOrtho)
+		return int(floorf(depth * _depthScale - _depthBias));
+
+	return int(floorf(logf(depth) * _depthScale - _depthBias));
+}
+
+//Random lights spread over a 40x40 area in front of a camera like the one in the sample scene
+static void MakeTestScene(unsigned lightCount, unsigned seed, std::vector<PointLight>& lights, glm::mat4& view, glm::mat4& projection)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+	std::uniform_real_distribution<float> height(0.0f, 5.0f);
+	std::uniform_real_distribution<float> radius(0.5f, 5.0f);
+	std::uniform_real_distribution<float> color(0.0f, 1.0f);
+
+	lights.resize(lightCount);
+	for (PointLight& light : lights)
+	{
+		light.PositionRadius = glm::vec4(position(rng), position(rng), height(rng), radius(rng));
+		light.ColorIntensity = glm::vec4(color(rng), color(rng), color(rng), 1.0f);
+	}
+
+	view = glm::lookAt(glm::vec3(0.0f, 3.0f, 3.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	projection = glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+}
+
+bool LightClusters::SelfTest(unsigned lightCount, unsigned seed)
+{
+	std::vector<PointLight> lights;
+	glm::mat4 view, projection;
+	MakeTestScene(lightCount, seed, lights, view, projection);
+
+	LightClusters clusters;
+	clusters.BuildGrid(projection, 0.1f, 1000.0f);
+
+	clusters.Bin(lights, view);
+	std::vector<glm::uvec2> binned = clusters.GetClusterLights();
+	std::vector<GLuint> binnedIndices = clusters.GetLightIndices();
+
+	clusters.BinReference(lights, view);
+	const std::vector<glm::uvec2>& reference = clusters.GetClusterLights();
+	const std::vector<GLuint>& referenceIndices = clusters.GetLightIndices();
+
+	//Both go through lights in index order, so the lists should match exactly
+	for (unsigned c = 0; c < clusters.GetClusterCount(); c++)
+	{
+		bool match = binned[c].y == reference[c].y;
+		for (GLuint i = 0; match && i < binned[c].y; i++)
+		{
+			match = binnedIndices[binned[c].x + i] == referenceIndices[reference[c].x + i];
+		}
+
+		if (!match)
+		{
+			LOG_ERROR("Light cluster self test failed: cluster {} has {} lights, expected {}", c, binned[c].y, reference[c].y);
+			return false;
+		}
+	}
+
+	LOG_INFO("Light cluster self test passed: {} lights, {} clusters, {} light indices", lightCount, clusters.GetClusterCount(), referenceIndices.size());
+	return true;
+}
+
+void LightClusters::RunBenchmark(unsigned iterations)
+{
+	const unsigned counts[2] = { 1000, 10000 };
+
+	for (unsigned count : counts)
+	{
+		std::vector<PointLight> lights;
+		glm::mat4 view, projection;
+		MakeTestScene(count, 42, lights, view, projection);
+
+		LightClusters clusters;
+		clusters.BuildGrid(projection, 0.1f, 1000.0f);
+
+		//Warm up so the allocations are out of the way
+		clusters.Bin(lights, view);
+
+		double threaded = 0.0;
+		for (unsigned i = 0; i < iterations; i++)
+		{
+			clusters.Bin(lights, view);
+			threaded += clusters.GetBinTime();
+		}
+
+		clusters.SetThreadCount(1);
+		double single = 0.0;
+		for (unsigned i = 0; i < iterations; i++)
+		{
+			clusters.Bin(lights, view);
+			single += clusters.GetBinTime();
+		}
+
+		clusters.BinReference(lights, view);
+		double reference = clusters.GetBinTime();
+
+		LOG_INFO("Light binning {} lights: {:.3f} ms threaded ({} threads), {:.3f} ms single thread, {:.3f} ms brute force, {} indices, max {} per cluster",
+			count, threaded / iterations, std::thread::hardware_concurrency(), single / iterations, reference,
+			clusters.GetLightIndices().size(), clusters.GetMaxLightsPerCluster());
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <glad/glad.h>
+#include <GLM/glm.hpp>
+#include <Shader.h>
+
+//A point light laid out the way the clustered shader reads it (std430)
+struct PointLight
+{
+	//xyz is the world position, w is how far the light reaches
+	glm::vec4 PositionRadius;
+	//rgb is the color, a is the intensity
+	glm::vec4 ColorIntensity;
+};
+
+//View space bounds of a single cluster
+struct ClusterBounds
+{
+	glm::vec3 Min;
+	glm::vec3 Max;
+};
+
+//Splits the view frustum into a grid of clusters and works out which lights touch each one
+//*Binning is all CPU side, so it works without an OpenGL context (Init/Upload/Apply need one)
+class LightClusters
+{
+public:
+	LightClusters(unsigned gridX = 16, unsigned gridY = 9, unsigned gridZ = 24);
+	~LightClusters();
+
+	//Creates the storage buffers the lights and clusters get uploaded to
+	void Init();
+	//Deletes the storage buffers
+	void Unload();
+
+	//Builds the cluster bounds for a projection, does nothing if the projection hasn't changed
+	//*Depth slices are exponential for perspective projections and linear for orthographic ones
+	void BuildGrid(const glm::mat4& projection, float nearPlane, float farPlane);
+	//Works out which lights touch each cluster
+	//*Lights are tested against clusters 4 at a time with SSE, and the clusters are split across threads once there are enough lights
+	void Bin(const std::vector<PointLight>& lights, const glm::mat4& view);
+	//Bins with a plain loop over every cluster and light, used to check Bin
+	void BinReference(const std::vector<PointLight>& lights, const glm::mat4& view);
+
+	//Uploads the lights and the cluster light lists
+	void Upload(const std::vector<PointLight>& lights);
+	//Binds the storage buffers and sets the uniforms the clustered shader needs
+	void Apply(const Shader::sptr& shader, const glm::vec2& viewportSize) const;
+
+	//Getters
+	glm::uvec3 GetGridSize() const;
+	unsigned GetClusterCount() const;
+	//Offset into the index list and light count for every cluster
+	const std::vector<glm::uvec2>& GetClusterLights() const;
+	const std::vector<GLuint>& GetLightIndices() const;
+	const std::vector<ClusterBounds>& GetClusterBounds() const;
+	unsigned GetMaxLightsPerCluster() const;
+	//How long the last Bin took in milliseconds
+	double GetBinTime() const;
+
+	//Setters
+	void SetThreadCount(unsigned threads);
+
+	//Bins random lights with Bin and BinReference and checks that every cluster matches
+	//*Doesn't need an OpenGL context
+	static bool SelfTest(unsigned lightCount = 1000, unsigned seed = 1234);
+	//Times binning 1k and 10k lights and logs the results
+	//*Doesn't need an OpenGL context
+	static void RunBenchmark(unsigned iterations = 20);
+
+private:
+	//Bins the clusters in [start, end) into a thread's own lists
+	void BinRange(unsigned start, unsigned end, std::vector<GLuint>& indices, std::vector<glm::uvec2>& clusters) const;
+	//Starts worker threads until there are enough for the given thread count (the calling thread counts as one)
+	void StartWorkers(unsigned threads);
+	//Stops and joins every worker thread
+	void StopWorkers();
+	//Worker thread loop, bins the worker's run of clusters every time Bin starts a new pass
+	void WorkerLoop(unsigned worker, uint64_t pass);
+	//Transforms the lights to view space and sorts them into the depth slices they touch
+	void PrepareLights(const std::vector<PointLight>& lights, const glm::mat4& view);
+	//Which depth slice a view space depth lands in (can be out of range)
+	int GetSlice(float depth) const;
+
+	glm::uvec3 _gridSize;
+	std::vector<ClusterBounds> _bounds;
+
+	//Projection the grid was built for
+	glm::mat4 _projection = glm::mat4(0.0f);
+	float _nearPlane = 0.0f;
+	float _farPlane = 0.0f;
+	bool _isOrtho = false;
+	//Maps depth to a slice, slice = log(depth) * scale - bias (or linear depth for ortho)
+	float _depthScale = 0.0f;
+	float _depthBias = 0.0f;
+
+	//Lights in each depth slice, stored as padded structures of arrays for the SIMD test
+	struct SliceLights
+	{
+		std::vector<GLuint> Indices;
+		std::vector<float> X;
+		std::vector<float> Y;
+		std::vector<float> Z;
+		std::vector<float> RadiusSq;
+	};
+	std::vector<SliceLights> _slices;
+
+	//Output of binning
+	std::vector<glm::uvec2> _clusterLights;
+	std::vector<GLuint> _lightIndices;
+	unsigned _maxLightsPerCluster = 0;
+	double _binTime = 0.0;
+
+	unsigned _threadCount = 1;
+
+	//Fewer lights than this get binned on the calling thread, waking the workers costs more than it saves
+	static const size_t MinThreadedLights = 64;
+
+	//Worker threads, started the first time Bin needs them and kept until the clusters are destroyed
+	std::vector<std::thread> _workers;
+	std::mutex _workLock;
+	std::condition_variable _workSignal;
+	std::condition_variable _doneSignal;
+	//Bumped by every threaded Bin so the workers know there's new work
+	uint64_t _workPass = 0;
+	unsigned _workThreads = 0;
+	unsigned _workChunk = 0;
+	unsigned _workPending = 0;
+	bool _stopWorkers = false;
+	//Each thread's lists from the last Bin, kept around so they aren't reallocated every frame
+	std::vector<std::vector<GLuint>> _threadIndices;
+	std::vector<std::vector<glm::uvec2>> _threadClusters;
+
+	//Storage buffers
+	GLuint _lightBuffer = GL_NONE;
+	GLuint _clusterBuffer = GL_NONE;
+	GLuint _indexBuffer = GL_NONE;
+	bool _isInit = false;
+};
@@ -0,0 +1,867 @@
+#include "ParticleSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <Logging.h>
+#include <Transform.h>
+#include <GLM/gtc/matrix_transform.hpp>
+
+//SSE is always there on x86/x64, anything else falls back to the scalar update
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define PARTICLES_SSE
+#endif
+
+namespace
+{
+	//Layout of the commands buffer, the draw and dispatch commands have to be where the indirect calls read them
+	struct ParticleCommands
+	{
+		//DrawArraysIndirectCommand, InstanceCount is the live particle count after simulating
+		GLuint DrawCount;
+		GLuint InstanceCount;
+		GLuint First;
+		GLuint BaseInstance;
+		//DispatchIndirectCommand for the simulate pass
+		GLuint GroupsX;
+		GLuint GroupsY;
+		GLuint GroupsZ;
+		//Free particles left in the dead list
+		GLint DeadCount;
+		//Live particles going into the simulate pass
+		GLuint AliveCount;
+	};
+
+	//Storage buffer bindings the particle shaders share
+	const GLuint ParticleBinding = 0;
+	const GLuint AliveInBinding = 1;
+	const GLuint AliveOutBinding = 2;
+	const GLuint DeadBinding = 3;
+	const GLuint CommandBinding = 4;
+	const GLuint SortBinding = 5;
+
+	double ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//Sorts indices by 32 bit keys, 8 bits a pass
+	void RadixSort(std::vector<uint32_t>& keys, std::vector<GLuint>& values)
+	{
+		size_t count = keys.size();
+		std::vector<uint32_t> tempKeys(count);
+		std::vector<GLuint> tempValues(count);
+
+		for (int shift = 0; shift < 32; shift += 8)
+		{
+			size_t offsets[256] = { 0 };
+			for (size_t i = 0; i < count; i++)
+			{
+				offsets[(keys[i] >> shift) & 0xFF]++;
+			}
+			//Every key has the same byte, so this pass wouldn't move anything
+			if (offsets[(keys[0] >> shift) & 0xFF] == count)
+				continue;
+
+			size_t total = 0;
+			for (size_t& offset : offsets)
+			{
+				size_t bucket = offset;
+				offset = total;
+				total += bucket;
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				size_t slot = offsets[(keys[i] >> shift) & 0xFF]++;
+				tempKeys[slot] = keys[i];
+				tempValues[slot] = values[i];
+			}
+			keys.swap(tempKeys);
+			values.swap(tempValues);
+		}
+	}
+}
+
+ParticlePool::ParticlePool(uint32_t capacity, uint32_t seed)
+{
+	//xorshift gets stuck at 0
+	_random = seed != 0 ? seed : 1;
+	Resize(capacity);
+}
+
+void ParticlePool::Resize(uint32_t capacity)
+{
+	//Padded so the SIMD loop can always load whole groups of 4
+	size_t padded = (size_t(capacity) + 3) & ~size_t(3);
+	for (std::vector<float>* array : { &PosX, &PosY, &PosZ, &VelX, &VelY, &VelZ, &Age, &Life })
+	{
+		array->resize(padded, 0.0f);
+	}
+	_capacity = capacity;
+	_count = std::min(_count, capacity);
+}
+
+void ParticlePool::Clear()
+{
+	_count = 0;
+}
+
+void ParticlePool::Emit(const ParticleEmitter& emitter, const glm::mat4& world, uint32_t count)
+{
+	count = std::min(count, _capacity - _count);
+
+	auto random = [this]() {
+		_random ^= _random << 13;
+		_random ^= _random >> 17;
+		_random ^= _random << 5;
+		return float(_random >> 8) * (1.0f / 16777216.0f);
+	};
+
+	glm::mat3 rotation = glm::mat3(world);
+	glm::vec3 direction = glm::length(emitter.Direction) > 0.0f ? glm::normalize(emitter.Direction) : glm::vec3(0.0f, 0.0f, 1.0f);
+
+	for (uint32_t i = _count; i < _count + count; i++)
+	{
+		//Random points in a cube, pushed out onto the sphere, are close enough to uniform for a spawn volume
+		glm::vec3 offset = glm::vec3(random(), random(), random()) * 2.0f - 1.0f;
+		glm::vec3 jitter = glm::vec3(random(), random(), random()) * 2.0f - 1.0f;
+		if (glm::dot(jitter, jitter) > 0.0f)
+			jitter = glm::normalize(jitter);
+
+		glm::vec3 position = glm::vec3(world * glm::vec4(offset * emitter.EmitRadius, 1.0f));
+		glm::vec3 launch = direction + jitter * emitter.Spread;
+		launch = glm::dot(launch, launch) > 0.0f ? glm::normalize(rotation * launch) : rotation * direction;
+		glm::vec3 velocity = launch * glm::mix(emitter.Speed.x, emitter.Speed.y, random());
+
+		PosX[i] = position.x;
+		PosY[i] = position.y;
+		PosZ[i] = position.z;
+		VelX[i] = velocity.x;
+		VelY[i] = velocity.y;
+		VelZ[i] = velocity.z;
+		Age[i] = 0.0f;
+		Life[i] = glm::mix(emitter.Lifetime.x, emitter.Lifetime.y, random());
+	}
+	_count += count;
+}
+
+void ParticlePool::Update(const glm::vec3& gravity, float drag, float deltaTime)
+{
+#ifdef PARTICLES_SSE
+	//Semi-implicit Euler, drag is applied as v / (1 + drag * dt) so it stays stable at any step
+	const __m128 dt = _mm_set1_ps(deltaTime);
+	const __m128 damping = _mm_set1_ps(1.0f / (1.0f + drag * deltaTime));
+	const __m128 stepX = _mm_set1_ps(gravity.x * deltaTime);
+	const __m128 stepY = _mm_set1_ps(gravity.y * deltaTime);
+	const __m128 stepZ = _mm_set1_ps(gravity.z * deltaTime);
+
+	for (uint32_t i = 0; i < _count; i += 4)
+	{
+		__m128 vx = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&VelX[i]), stepX), damping);
+		__m128 vy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&VelY[i]), stepY), damping);
+		__m128 vz = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&VelZ[i]), stepZ), damping);
+		_mm_storeu_ps(&VelX[i], vx);
+		_mm_storeu_ps(&VelY[i], vy);
+		_mm_storeu_ps(&VelZ[i], vz);
+
+		_mm_storeu_ps(&PosX[i], _mm_add_ps(_mm_loadu_ps(&PosX[i]), _mm_mul_ps(vx, dt)));
+		_mm_storeu_ps(&PosY[i], _mm_add_ps(_mm_loadu_ps(&PosY[i]), _mm_mul_ps(vy, dt)));
+		_mm_storeu_ps(&PosZ[i], _mm_add_ps(_mm_loadu_ps(&PosZ[i]), _mm_mul_ps(vz, dt)));
+		_mm_storeu_ps(&Age[i], _mm_add_ps(_mm_loadu_ps(&Age[i]), dt));
+	}
+
+	Compact();
+#else
+	UpdateReference(gravity, drag, deltaTime);
+#endif
+}
+
+void ParticlePool::UpdateReference(const glm::vec3& gravity, float drag, float deltaTime)
+{
+	const float damping = 1.0f / (1.0f + drag * deltaTime);
+	const glm::vec3 step = gravity * deltaTime;
+
+	for (uint32_t i = 0; i < _count; i++)
+	{
+		VelX[i] = (VelX[i] + step.x) * damping;
+		VelY[i] = (VelY[i] + step.y) * damping;
+		VelZ[i] = (VelZ[i] + step.z) * damping;
+		PosX[i] = PosX[i] + VelX[i] * deltaTime;
+		PosY[i] = PosY[i] + VelY[i] * deltaTime;
+		PosZ[i] = PosZ[i] + VelZ[i] * deltaTime;
+		Age[i] = Age[i] + deltaTime;
+	}
+
+	Compact();
+}
+
+void ParticlePool::Compact()
+{
+	uint32_t i = 0;
+	while (i < _count)
+	{
+		if (Age[i] < Life[i])
+		{
+			i++;
+			continue;
+		}
+
+		//Move the last live particle into the hole, and check it next
+		_count--;
+		PosX[i] = PosX[_count];
+		PosY[i] = PosY[_count];
+		PosZ[i] = PosZ[_count];
+		VelX[i] = VelX[_count];
+		VelY[i] = VelY[_count];
+		VelZ[i] = VelZ[_count];
+		Age[i] = Age[_count];
+		Life[i] = Life[_count];
+	}
+}
+
+uint32_t ParticlePool::GetCount() const
+{
+	return _count;
+}
+
+uint32_t ParticlePool::GetCapacity() const
+{
+	return _capacity;
+}
+
+ParticleSystem::ParticleSystem()
+{
+}
+
+ParticleSystem::~ParticleSystem()
+{
+	Unload();
+}
+
+void ParticleSystem::Init()
+{
+	_emitShader = Shader::Create();
+	_emitShader->LoadShaderPartFromFile("shaders/Particles/particle_emit_comp.glsl", GL_COMPUTE_SHADER);
+	_emitShader->Link();
+
+	_simulateShader = Shader::Create();
+	_simulateShader->LoadShaderPartFromFile("shaders/Particles/particle_simulate_comp.glsl", GL_COMPUTE_SHADER);
+	_simulateShader->Link();
+
+	_commandShader = Shader::Create();
+	_commandShader->LoadShaderPartFromFile("shaders/Particles/particle_commands_comp.glsl", GL_COMPUTE_SHADER);
+	_commandShader->Link();
+
+	_sortShader = Shader::Create();
+	_sortShader->LoadShaderPartFromFile("shaders/Particles/particle_sort_comp.glsl", GL_COMPUTE_SHADER);
+	_sortShader->Link();
+
+	_renderShader = Shader::Create();
+	_renderShader->LoadShaderPartFromFile("shaders/Particles/particle_vert.glsl", GL_VERTEX_SHADER);
+	_renderShader->LoadShaderPartFromFile("shaders/Particles/particle_frag.glsl", GL_FRAGMENT_SHADER);
+	_renderShader->Link();
+
+	glCreateVertexArrays(1, &_emptyVao);
+	glCreateBuffers(1, &_uploadParticles);
+	glCreateBuffers(1, &_uploadIndices);
+	_isInit = true;
+}
+
+void ParticleSystem::Unload()
+{
+	if (!_isInit)
+		return;
+
+	for (auto& [entity, state] : _emitters)
+	{
+		DeleteGpuPool(state->Gpu);
+	}
+	_emitters.clear();
+
+	glDeleteVertexArrays(1, &_emptyVao);
+	glDeleteBuffers(1, &_uploadParticles);
+	glDeleteBuffers(1, &_uploadIndices);
+	_emptyVao = _uploadParticles = _uploadIndices = GL_NONE;
+
+	_emitShader = nullptr;
+	_simulateShader = nullptr;
+	_commandShader = nullptr;
+	_sortShader = nullptr;
+	_renderShader = nullptr;
+	_isInit = false;
+}
+
+void ParticleSystem::Update(entt::registry& registry, float deltaTime)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	_stats = ParticleStats();
+
+	for (auto& [entity, state] : _emitters)
+	{
+		state->Seen = false;
+	}
+
+	registry.view<ParticleEmitter, Transform>().each([&](entt::entity entity, ParticleEmitter& emitter, Transform& transform) {
+		std::unique_ptr<EmitterState>& state = _emitters[entity];
+		if (state == nullptr)
+		{
+			state = std::make_unique<EmitterState>();
+			state->Seed = uint32_t(entity) * 2654435761u + 1u;
+			state->Cpu = ParticlePool(0, state->Seed);
+		}
+		state->Seen = true;
+		_stats.Emitters++;
+
+		//Only one side keeps a pool, switching frees the other one
+		if (emitter.UseGPU)
+		{
+			state->Cpu.Resize(0);
+			if (state->Gpu.Capacity != emitter.MaxParticles)
+			{
+				DeleteGpuPool(state->Gpu);
+				CreateGpuPool(state->Gpu, emitter.MaxParticles);
+			}
+			_stats.GpuCapacity += emitter.MaxParticles;
+		}
+		else
+		{
+			DeleteGpuPool(state->Gpu);
+			if (state->Cpu.GetCapacity() != emitter.MaxParticles)
+			{
+				state->Cpu.Resize(emitter.MaxParticles);
+			}
+		}
+
+		if (!emitter.Enabled)
+			return;
+
+		//Carry the fraction over, so low rates still emit at the right average
+		state->EmitAccumulator += emitter.EmitRate * deltaTime;
+		uint32_t emitCount = uint32_t(std::min(state->EmitAccumulator, float(emitter.MaxParticles)));
+		state->EmitAccumulator = std::min(state->EmitAccumulator - float(emitCount), 1.0f);
+
+		if (emitter.UseGPU)
+		{
+			SimulateGpu(*state, emitter, transform.WorldTransform(), emitCount, deltaTime);
+		}
+		else
+		{
+			state->Cpu.Emit(emitter, transform.WorldTransform(), emitCount);
+			state->Cpu.Update(emitter.Gravity, emitter.Drag, deltaTime);
+			_stats.CpuParticles += state->Cpu.GetCount();
+		}
+		state->Frame++;
+	});
+
+	//Drop the pools of anything that lost its emitter
+	for (auto it = _emitters.begin(); it != _emitters.end();)
+	{
+		if (it->second->Seen)
+		{
+			++it;
+			continue;
+		}
+		DeleteGpuPool(it->second->Gpu);
+		it = _emitters.erase(it);
+	}
+
+	_stats.CpuTime = ElapsedMs(start);
+}
+
+void ParticleSystem::Render(entt::registry& registry, const glm::mat4& view, const glm::mat4& projection)
+{
+	if (_emitters.empty())
+		return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//Particles test against the scene's depth but never write it
+	glEnable(GL_BLEND);
+	glDepthMask(GL_FALSE);
+	glBindVertexArray(_emptyVao);
+	_renderShader->Bind();
+	_renderShader->SetUniformMatrix("u_View", view);
+	_renderShader->SetUniformMatrix("u_Projection", projection);
+
+	//Additive emitters first, they don't care what's under them
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+	registry.view<ParticleEmitter>().each([&](entt::entity entity, ParticleEmitter& emitter) {
+		auto it = _emitters.find(entity);
+		if (it != _emitters.end() && emitter.Blend == ParticleBlend::Additive)
+		{
+			Draw(*it->second, emitter, view);
+		}
+	});
+
+	//Alpha emitters get their particles sorted, emitters themselves get drawn far to near
+	std::vector<std::pair<float, entt::entity>> alphaEmitters;
+	registry.view<ParticleEmitter, Transform>().each([&](entt::entity entity, ParticleEmitter& emitter, Transform& transform) {
+		if (emitter.Blend == ParticleBlend::Alpha && _emitters.count(entity) > 0)
+		{
+			glm::vec4 viewPosition = view * transform.WorldTransform()[3];
+			alphaEmitters.push_back({ viewPosition.z, entity });
+		}
+	});
+	std::sort(alphaEmitters.begin(), alphaEmitters.end(), [](const auto& l, const auto& r) { return l.first < r.first; });
+
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	for (const auto& [depth, entity] : alphaEmitters)
+	{
+		Draw(*_emitters[entity], registry.get<ParticleEmitter>(entity), view);
+	}
+
+	glBindVertexArray(GL_NONE);
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	_stats.CpuTime += ElapsedMs(start);
+}
+
+const ParticleStats& ParticleSystem::GetStats() const
+{
+	return _stats;
+}
+
+void ParticleSystem::CreateGpuPool(GpuPool& pool, uint32_t capacity)
+{
+	pool.Capacity = capacity;
+	pool.SortSize = 1;
+	while (pool.SortSize < capacity)
+	{
+		pool.SortSize <<= 1;
+	}
+	pool.Current = 0;
+
+	//Every particle starts out free
+	std::vector<GLuint> dead(capacity);
+	std::iota(dead.begin(), dead.end(), 0u);
+
+	ParticleCommands commands = { 4, 0, 0, 0, 0, 1, 1, GLint(capacity), 0 };
+
+	glCreateBuffers(1, &pool.Particles);
+	glCreateBuffers(2, pool.Alive);
+	glCreateBuffers(1, &pool.Dead);
+	glCreateBuffers(1, &pool.Commands);
+	glNamedBufferStorage(pool.Particles, sizeof(glm::vec4) * 2 * std::max(capacity, 1u), nullptr, 0);
+	glNamedBufferStorage(pool.Alive[0], sizeof(GLuint) * std::max(capacity, 1u), nullptr, 0);
+	glNamedBufferStorage(pool.Alive[1], sizeof(GLuint) * std::max(capacity, 1u), nullptr, 0);
+	glNamedBufferStorage(pool.Dead, sizeof(GLuint) * std::max(capacity, 1u), capacity > 0 ? dead.data() : nullptr, 0);
+	glNamedBufferStorage(pool.Commands, sizeof(ParticleCommands), &commands, 0);
+}
+
+void ParticleSystem::DeleteGpuPool(GpuPool& pool)
+{
+	if (pool.Particles == GL_NONE)
+		return;
+
+	glDeleteBuffers(1, &pool.Particles);
+	glDeleteBuffers(2, pool.Alive);
+	glDeleteBuffers(1, &pool.Dead);
+	glDeleteBuffers(1, &pool.Commands);
+	if (pool.SortKeys != GL_NONE)
+	{
+		glDeleteBuffers(1, &pool.SortKeys);
+	}
+	pool = GpuPool();
+}
+
+void ParticleSystem::SimulateGpu(EmitterState& state, const ParticleEmitter& emitter, const glm::mat4& world, uint32_t emitCount, float deltaTime)
+{
+	GpuPool& pool = state.Gpu;
+	if (pool.Capacity == 0)
+		return;
+
+	//Last frame's output list is this frame's input
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ParticleBinding, pool.Particles);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, AliveInBinding, pool.Alive[pool.Current]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, AliveOutBinding, pool.Alive[1 - pool.Current]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DeadBinding, pool.Dead);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CommandBinding, pool.Commands);
+
+	//New particles come off the dead list and get appended to the live one, the shader stops when the dead list runs out
+	if (emitCount > 0)
+	{
+		glm::vec3 direction = glm::length(emitter.Direction) > 0.0f ? glm::normalize(emitter.Direction) : glm::vec3(0.0f, 0.0f, 1.0f);
+		_emitShader->Bind();
+		_emitShader->SetUniform("u_EmitCount", int(emitCount));
+		_emitShader->SetUniform("u_Seed", int(state.Seed + state.Frame * 2654435761u));
+		_emitShader->SetUniformMatrix("u_World", world);
+		_emitShader->SetUniform("u_Direction", direction);
+		_emitShader->SetUniform("u_Spread", emitter.Spread);
+		_emitShader->SetUniform("u_EmitRadius", emitter.EmitRadius);
+		_emitShader->SetUniform("u_Lifetime", emitter.Lifetime);
+		_emitShader->SetUniform("u_Speed", emitter.Speed);
+		glDispatchCompute((emitCount + _groupSize - 1) / _groupSize, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	//Size the simulate dispatch to the live count, without it ever coming back to the CPU
+	_commandShader->Bind();
+	_commandShader->SetUniform("u_Stage", 0);
+	glDispatchCompute(1, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	_simulateShader->Bind();
+	_simulateShader->SetUniform("u_DeltaTime", deltaTime);
+	_simulateShader->SetUniform("u_Damping", 1.0f / (1.0f + emitter.Drag * deltaTime));
+	_simulateShader->SetUniform("u_GravityStep", emitter.Gravity * deltaTime);
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, pool.Commands);
+	glDispatchComputeIndirect(offsetof(ParticleCommands, GroupsX));
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, GL_NONE);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	//The survivors become next frame's input
+	_commandShader->Bind();
+	_commandShader->SetUniform("u_Stage", 1);
+	glDispatchCompute(1, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	for (GLuint binding = ParticleBinding; binding <= CommandBinding; binding++)
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, GL_NONE);
+	}
+	pool.Current = 1 - pool.Current;
+}
+
+void ParticleSystem::SortGpu(EmitterState& state, const glm::mat4& view)
+{
+	GpuPool& pool = state.Gpu;
+	if (pool.SortKeys == GL_NONE)
+	{
+		glCreateBuffers(1, &pool.SortKeys);
+		glNamedBufferStorage(pool.SortKeys, sizeof(glm::uvec2) * pool.SortSize, nullptr, 0);
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ParticleBinding, pool.Particles);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, AliveInBinding, pool.Alive[pool.Current]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CommandBinding, pool.Commands);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SortBinding, pool.SortKeys);
+
+	_sortShader->Bind();
+	_sortShader->SetUniformMatrix("u_View", view);
+	_sortShader->SetUniform("u_SortSize", int(pool.SortSize));
+	GLuint groups = (pool.SortSize + _groupSize - 1) / _groupSize;
+
+	//Depth keys for the live particles, the padding gets the smallest key so it sorts to the end
+	_sortShader->SetUniform("u_Stage", 0);
+	glDispatchCompute(groups, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	//Bitonic sort, far to near, the live count is only known on the GPU so the whole padded list gets sorted
+	int stepLocation = _sortShader->GetUniformLocation("u_Step");
+	_sortShader->SetUniform("u_Stage", 1);
+	for (uint32_t k = 2; k <= pool.SortSize; k <<= 1)
+	{
+		for (uint32_t j = k >> 1; j > 0; j >>= 1)
+		{
+			_sortShader->SetUniform(stepLocation, glm::ivec2(k, j));
+			glDispatchCompute(groups, 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		}
+	}
+
+	//Write the sorted indices back over the live list
+	_sortShader->SetUniform("u_Stage", 2);
+	glDispatchCompute(groups, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ParticleBinding, GL_NONE);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, AliveInBinding, GL_NONE);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CommandBinding, GL_NONE);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SortBinding, GL_NONE);
+}
+
+void ParticleSystem::SortCpu(EmitterState& state, const glm::mat4& view)
+{
+	const ParticlePool& pool = state.Cpu;
+	uint32_t count = pool.GetCount();
+
+	//Positive floats sort the same as their bits, flipping them puts the farthest first
+	std::vector<uint32_t> keys(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		float depth = -(view[0][2] * pool.PosX[i] + view[1][2] * pool.PosY[i] + view[2][2] * pool.PosZ[i] + view[3][2]);
+		depth = std::max(depth, 0.0f);
+		uint32_t bits;
+		memcpy(&bits, &depth, sizeof(bits));
+		keys[i] = ~bits;
+	}
+	RadixSort(keys, state.DrawOrder);
+}
+
+void ParticleSystem::UploadCpu(EmitterState& state)
+{
+	const ParticlePool& pool = state.Cpu;
+	uint32_t count = pool.GetCount();
+
+	std::vector<glm::vec4>& particles = _staging;
+	particles.resize(size_t(count) * 2);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		particles[i * 2 + 0] = glm::vec4(pool.PosX[i], pool.PosY[i], pool.PosZ[i], pool.Age[i]);
+		particles[i * 2 + 1] = glm::vec4(pool.VelX[i], pool.VelY[i], pool.VelZ[i], pool.Life[i]);
+	}
+
+	//Orphaned every upload, so a draw still reading the last emitter's data never stalls us
+	glNamedBufferData(_uploadParticles, sizeof(glm::vec4) * particles.size(), particles.data(), GL_STREAM_DRAW);
+	glNamedBufferData(_uploadIndices, sizeof(GLuint) * state.DrawOrder.size(), state.DrawOrder.data(), GL_STREAM_DRAW);
+}
+
+void ParticleSystem::Draw(EmitterState& state, const ParticleEmitter& emitter, const glm::mat4& view)
+{
+	if (!emitter.Enabled)
+		return;
+
+	bool sorted = emitter.Blend == ParticleBlend::Alpha;
+
+	if (emitter.UseGPU)
+	{
+		if (state.Gpu.Capacity == 0)
+			return;
+		if (sorted)
+		{
+			SortGpu(state, view);
+			_renderShader->Bind();
+		}
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, state.Gpu.Particles);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, state.Gpu.Alive[state.Gpu.Current]);
+	}
+	else
+	{
+		if (state.Cpu.GetCount() == 0)
+			return;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		state.DrawOrder.resize(state.Cpu.GetCount());
+		std::iota(state.DrawOrder.begin(), state.DrawOrder.end(), 0u);
+		if (sorted)
+		{
+			SortCpu(state, view);
+		}
+		UploadCpu(state);
+		_stats.CpuTime += ElapsedMs(start);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _uploadParticles);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _uploadIndices);
+	}
+
+	_renderShader->SetUniform("u_StartColor", emitter.StartColor);
+	_renderShader->SetUniform("u_EndColor", emitter.EndColor);
+	_renderShader->SetUniform("u_Size", emitter.Size);
+
+	//Every particle is a 4 vertex strip, the GPU pools draw however many survived without the count coming back
+	if (emitter.UseGPU)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, state.Gpu.Commands);
+		glDrawArraysIndirect(GL_TRIANGLE_STRIP, (const void*)offsetof(ParticleCommands, DrawCount));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, GL_NONE);
+	}
+	else
+	{
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, state.Cpu.GetCount());
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, GL_NONE);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, GL_NONE);
+}
+
+bool ParticleSystem::SelfTest()
+{
+	const float deltaTime = 1.0f / 60.0f;
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> range(-5.0f, 5.0f);
+	std::uniform_real_distribution<float> life(0.1f, 1.0f);
+
+	//An odd count so the SIMD loop has a partial group at the end
+	const uint32_t count = 10003;
+	ParticlePool simd(count);
+	ParticleEmitter emitter;
+	emitter.Lifetime = glm::vec2(0.1f, 1.0f);
+	simd.Emit(emitter, glm::mat4(1.0f), count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		simd.PosX[i] = range(random);
+		simd.PosY[i] = range(random);
+		simd.PosZ[i] = range(random);
+		simd.VelX[i] = range(random);
+		simd.VelY[i] = range(random);
+		simd.VelZ[i] = range(random);
+		simd.Life[i] = life(random);
+	}
+	ParticlePool scalar = simd;
+
+	//Both compact the same way, so the particles should stay in the same order
+	for (int step = 0; step < 30; step++)
+	{
+		simd.Update(glm::vec3(0.5f, -1.0f, -9.8f), 0.7f, deltaTime);
+		scalar.UpdateReference(glm::vec3(0.5f, -1.0f, -9.8f), 0.7f, deltaTime);
+
+		if (simd.GetCount() != scalar.GetCount())
+		{
+			LOG_ERROR("Particle self test failed: step {} has {} particles alive, expected {}", step, simd.GetCount(), scalar.GetCount());
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < simd.GetCount(); i++)
+	{
+		glm::vec3 a = glm::vec3(simd.PosX[i], simd.PosY[i], simd.PosZ[i]);
+		glm::vec3 b = glm::vec3(scalar.PosX[i], scalar.PosY[i], scalar.PosZ[i]);
+		glm::vec3 va = glm::vec3(simd.VelX[i], simd.VelY[i], simd.VelZ[i]);
+		glm::vec3 vb = glm::vec3(scalar.VelX[i], scalar.VelY[i], scalar.VelZ[i]);
+		if (glm::length(a - b) > 1e-4f || glm::length(va - vb) > 1e-4f || simd.Age[i] != scalar.Age[i])
+		{
+			LOG_ERROR("Particle self test failed: particle {} is at ({}, {}, {}), expected ({}, {}, {})", i, a.x, a.y, a.z, b.x, b.y, b.z);
+			return false;
+		}
+	}
+
+	//With no drag, n steps of semi-implicit Euler land at p0 + n*dt*v0 + g*dt^2*n(n+1)/2
+	ParticlePool motion(4);
+	emitter.Lifetime = glm::vec2(100.0f);
+	motion.Emit(emitter, glm::mat4(1.0f), 4);
+	std::vector<glm::vec3> startPosition, startVelocity;
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		startPosition.push_back(glm::vec3(motion.PosX[i], motion.PosY[i], motion.PosZ[i]));
+		startVelocity.push_back(glm::vec3(motion.VelX[i], motion.VelY[i], motion.VelZ[i]));
+	}
+	const glm::vec3 gravity = glm::vec3(1.0f, 2.0f, -9.8f);
+	const int steps = 120;
+	for (int step = 0; step < steps; step++)
+	{
+		motion.Update(gravity, 0.0f, deltaTime);
+	}
+	float n = float(steps);
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		glm::vec3 expected = startPosition[i] + n * deltaTime * startVelocity[i] + gravity * deltaTime * deltaTime * n * (n + 1.0f) * 0.5f;
+		glm::vec3 actual = glm::vec3(motion.PosX[i], motion.PosY[i], motion.PosZ[i]);
+		if (glm::length(actual - expected) > 1e-3f)
+		{
+			LOG_ERROR("Particle self test failed: ballistic particle {} is at ({}, {}, {}), expected ({}, {}, {})", i,
+				actual.x, actual.y, actual.z, expected.x, expected.y, expected.z);
+			return false;
+		}
+	}
+
+	//Drag alone scales the velocity by 1 / (1 + drag * dt) every step, and everything dies once its lifetime is up
+	ParticlePool drag(5);
+	emitter.Lifetime = glm::vec2(0.5f);
+	drag.Emit(emitter, glm::mat4(1.0f), 5);
+	float speed = drag.VelZ[0];
+	for (int step = 0; step < 29; step++)
+	{
+		drag.Update(glm::vec3(0.0f), 2.0f, deltaTime);
+	}
+	float expectedSpeed = speed * std::pow(1.0f / (1.0f + 2.0f * deltaTime), 29.0f);
+	if (drag.GetCount() != 5 || std::abs(drag.VelZ[0] - expectedSpeed) > 1e-4f)
+	{
+		LOG_ERROR("Particle self test failed: dragged particle has speed {}, expected {} ({} alive)", drag.VelZ[0], expectedSpeed, drag.GetCount());
+		return false;
+	}
+	drag.Update(glm::vec3(0.0f), 2.0f, deltaTime);
+	drag.Update(glm::vec3(0.0f), 2.0f, deltaTime);
+	if (drag.GetCount() != 0)
+	{
+		LOG_ERROR("Particle self test failed: {} particles outlived their lifetime", drag.GetCount());
+		return false;
+	}
+
+	LOG_INFO("Particle self test passed: {} particles, {} alive after 30 steps", count, simd.GetCount());
+	return true;
+}
+
+void ParticleSystem::RunBenchmark(uint32_t particleCount, unsigned frames)
+{
+	const float deltaTime = 1.0f / 60.0f;
+
+	//Lifetimes long enough that nothing dies, so both sides simulate the full count every frame
+	ParticleEmitter emitter;
+	emitter.MaxParticles = particleCount;
+	emitter.Lifetime = glm::vec2(100.0f, 200.0f);
+	emitter.EmitRadius = 5.0f;
+	emitter.Drag = 0.1f;
+
+	ParticleSystem system;
+	system.Init();
+	EmitterState state;
+	system.CreateGpuPool(state.Gpu, particleCount);
+
+	GLuint query = GL_NONE;
+	glGenQueries(1, &query);
+
+	//The first frame fills the pool
+	system.SimulateGpu(state, emitter, glm::mat4(1.0f), particleCount, deltaTime);
+	glFinish();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	glBeginQuery(GL_TIME_ELAPSED, query);
+	for (unsigned i = 0; i < frames; i++)
+	{
+		system.SimulateGpu(state, emitter, glm::mat4(1.0f), 0, deltaTime);
+	}
+	glEndQuery(GL_TIME_ELAPSED);
+	glFinish();
+	double gpuWall = ElapsedMs(start);
+	GLuint64 gpuNs = 0;
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpuNs);
+
+	ParticleCommands commands;
+	glGetNamedBufferSubData(state.Gpu.Commands, 0, sizeof(commands), &commands);
+
+	//Sorting is what the alpha mode adds on top
+	glm::mat4 view = glm::lookAt(glm::vec3(20.0f, 20.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	glBeginQuery(GL_TIME_ELAPSED, query);
+	system.SortGpu(state, view);
+	glEndQuery(GL_TIME_ELAPSED);
+	GLuint64 sortNs = 0;
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &sortNs);
+
+	glDeleteQueries(1, &query);
+	system.DeleteGpuPool(state.Gpu);
+
+	//Same work on the CPU
+	state.Cpu = ParticlePool(particleCount, 1234);
+	state.Cpu.Emit(emitter, glm::mat4(1.0f), particleCount);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned i = 0; i < frames; i++)
+	{
+		state.Cpu.Update(emitter.Gravity, emitter.Drag, deltaTime);
+	}
+	double simd = ElapsedMs(start) / frames;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned i = 0; i < frames; i++)
+	{
+		state.Cpu.UpdateReference(emitter.Gravity, emitter.Drag, deltaTime);
+	}
+	double scalar = ElapsedMs(start) / frames;
+
+	start = std::chrono::high_resolution_clock::now();
+	state.DrawOrder.resize(state.Cpu.GetCount());
+	std::iota(state.DrawOrder.begin(), state.DrawOrder.end(), 0u);
+	system.SortCpu(state, view);
+	double cpuSort = ElapsedMs(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	system.UploadCpu(state);
+	glFinish();
+	double upload = ElapsedMs(start);
+
+	system.Unload();
+
+	LOG_INFO("Particles {} over {} frames: GPU {:.3f} ms/frame ({:.3f} ms wall), CPU SIMD {:.3f} ms/frame, CPU scalar {:.3f} ms/frame, CPU upload {:.3f} ms",
+		particleCount, frames, gpuNs / 1000000.0 / frames, gpuWall / frames, simd, scalar, upload);
+	LOG_INFO("Particle depth sort: GPU bitonic {:.3f} ms, CPU radix {:.3f} ms", sortNs / 1000000.0, cpuSort);
+	if (commands.AliveCount != particleCount || state.Cpu.GetCount() != particleCount)
+	{
+		LOG_WARN("Particle benchmark expected {} live particles, GPU has {} and CPU has {}", particleCount, commands.AliveCount, state.Cpu.GetCount());
+	}
+}
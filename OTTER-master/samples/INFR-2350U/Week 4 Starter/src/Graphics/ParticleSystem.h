@@ -0,0 +1,193 @@
+#pragma once
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLM/glm.hpp>
+#include <entt.hpp>
+#include <Shader.h>
+
+//How an emitter's particles get blended into the scene
+enum class ParticleBlend
+{
+	//Order doesn't matter, so nothing gets sorted
+	Additive,
+	//Sorted back to front every frame
+	Alpha
+};
+
+//Component that makes an entity spray particles from its Transform
+struct ParticleEmitter
+{
+	//Particles spawned per second
+	float EmitRate = 2000.0f;
+	//Most particles alive at once, the pool is this big
+	uint32_t MaxParticles = 20000;
+	//Min and max lifetime in seconds
+	glm::vec2 Lifetime = glm::vec2(1.0f, 2.0f);
+	//Min and max launch speed
+	glm::vec2 Speed = glm::vec2(2.0f, 4.0f);
+	//Launch direction in the entity's space, and how far particles can stray from it (0 is a line, 1 is a hemisphere)
+	glm::vec3 Direction = glm::vec3(0.0f, 0.0f, 1.0f);
+	float Spread = 0.3f;
+	//Particles spawn anywhere inside this radius
+	float EmitRadius = 0.1f;
+	glm::vec3 Gravity = glm::vec3(0.0f, 0.0f, -9.8f);
+	//Velocity lost per second, 0 for none
+	float Drag = 0.0f;
+	glm::vec4 StartColor = glm::vec4(1.0f, 0.6f, 0.2f, 1.0f);
+	glm::vec4 EndColor = glm::vec4(1.0f, 0.1f, 0.0f, 0.0f);
+	//World size at birth and death
+	glm::vec2 Size = glm::vec2(0.1f, 0.02f);
+	ParticleBlend Blend = ParticleBlend::Additive;
+	//Simulates with compute shaders, otherwise the CPU does it and uploads the results
+	bool UseGPU = true;
+	bool Enabled = true;
+};
+
+//Per frame numbers for every emitter together
+struct ParticleStats
+{
+	unsigned Emitters = 0;
+	//Only the CPU emitters are counted, GPU counts never come back to the CPU
+	unsigned CpuParticles = 0;
+	unsigned GpuCapacity = 0;
+	//CPU time spent simulating and uploading, in milliseconds
+	double CpuTime = 0.0;
+};
+
+//Particles stored as a structure of arrays, so SIMD can update 4 at a time
+//*Live particles are always packed at the front, dead ones get swapped out
+class ParticlePool
+{
+public:
+	ParticlePool(uint32_t capacity = 0, uint32_t seed = 1);
+
+	//Changes the capacity, keeping as many live particles as fit
+	void Resize(uint32_t capacity);
+	//Kills every particle
+	void Clear();
+
+	//Spawns up to count particles (as many as there's room for) at a world position
+	void Emit(const ParticleEmitter& emitter, const glm::mat4& world, uint32_t count);
+	//Steps every particle forward and removes the dead ones
+	//*4 particles at a time with SSE where it's there
+	void Update(const glm::vec3& gravity, float drag, float deltaTime);
+	//Same as Update with a plain loop, used to check it
+	void UpdateReference(const glm::vec3& gravity, float drag, float deltaTime);
+
+	//Getters
+	uint32_t GetCount() const;
+	uint32_t GetCapacity() const;
+
+	//Arrays are padded to a multiple of 4, the padding past the count is junk
+	std::vector<float> PosX, PosY, PosZ;
+	std::vector<float> VelX, VelY, VelZ;
+	std::vector<float> Age, Life;
+
+private:
+	//Swaps dead particles out from the front, keeping the live ones packed
+	void Compact();
+
+	uint32_t _count = 0;
+	uint32_t _capacity = 0;
+	uint32_t _random;
+};
+
+//Simulates and draws every ParticleEmitter in a registry
+//*The CPU pools work without an OpenGL context (Init/Update/Render need one)
+class ParticleSystem
+{
+public:
+	ParticleSystem();
+	~ParticleSystem();
+
+	//Loads the shaders
+	void Init();
+	//Deletes every emitter's buffers and the shaders
+	void Unload();
+
+	//Emits and simulates every enabled emitter, making or dropping their pools as needed
+	void Update(entt::registry& registry, float deltaTime);
+	//Draws every emitter into the bound framebuffer, after the opaque scene
+	//*Additive emitters go first, then alpha emitters sorted back to front
+	void Render(entt::registry& registry, const glm::mat4& view, const glm::mat4& projection);
+
+	//Getters
+	const ParticleStats& GetStats() const;
+
+	//Checks the SIMD update against the scalar one and against closed form motion, and logs the results
+	//*Doesn't need an OpenGL context
+	static bool SelfTest();
+	//Simulates a million particles on the GPU and on the CPU and logs the timings
+	static void RunBenchmark(uint32_t particleCount = 1000000, unsigned frames = 60);
+
+private:
+	//GPU side buffers for one emitter
+	struct GpuPool
+	{
+		uint32_t Capacity = 0;
+		//Capacity rounded up to a power of 2, for the bitonic sort
+		uint32_t SortSize = 0;
+		//vec4 position/age and vec4 velocity/lifetime per particle
+		GLuint Particles = GL_NONE;
+		//Indices of the live particles, ping ponged every frame
+		GLuint Alive[2] = { GL_NONE, GL_NONE };
+		//Indices of the free particles
+		GLuint Dead = GL_NONE;
+		//Draw command, dispatch command and counters
+		GLuint Commands = GL_NONE;
+		//Depth and index pairs for the alpha sort
+		GLuint SortKeys = GL_NONE;
+		int Current = 0;
+	};
+
+	//Everything an emitter entity owns
+	struct EmitterState
+	{
+		ParticlePool Cpu;
+		GpuPool Gpu;
+		//Fractional particles carried over to the next frame
+		float EmitAccumulator = 0.0f;
+		uint32_t Frame = 0;
+		uint32_t Seed = 1;
+		//Order the CPU particles get drawn in
+		std::vector<GLuint> DrawOrder;
+		bool Seen = false;
+	};
+
+	void CreateGpuPool(GpuPool& pool, uint32_t capacity);
+	void DeleteGpuPool(GpuPool& pool);
+	//Runs emit, simulate and compaction on the GPU
+	void SimulateGpu(EmitterState& state, const ParticleEmitter& emitter, const glm::mat4& world, uint32_t emitCount, float deltaTime);
+	//Uploads a CPU pool in the layout the render shader reads
+	void UploadCpu(EmitterState& state);
+	//Sorts the GPU live list back to front
+	void SortGpu(EmitterState& state, const glm::mat4& view);
+	//Sorts the CPU draw order back to front
+	void SortCpu(EmitterState& state, const glm::mat4& view);
+	//Draws an emitter's particles with the render shader, the view is only needed for sorting
+	void Draw(EmitterState& state, const ParticleEmitter& emitter, const glm::mat4& view);
+
+	std::unordered_map<entt::entity, std::unique_ptr<EmitterState>> _emitters;
+
+	Shader::sptr _emitShader = nullptr;
+	Shader::sptr _simulateShader = nullptr;
+	Shader::sptr _commandShader = nullptr;
+	Shader::sptr _sortShader = nullptr;
+	Shader::sptr _renderShader = nullptr;
+	//The render shader pulls everything out of storage buffers, but core profile still wants a VAO bound
+	GLuint _emptyVao = GL_NONE;
+
+	//CPU particles get uploaded here in the same layout the GPU pools use
+	GLuint _uploadParticles = GL_NONE;
+	GLuint _uploadIndices = GL_NONE;
+	std::vector<glm::vec4> _staging;
+
+	ParticleStats _stats;
+	bool _isInit = false;
+
+	//Threads per compute group
+	static const unsigned _groupSize = 256;
+};
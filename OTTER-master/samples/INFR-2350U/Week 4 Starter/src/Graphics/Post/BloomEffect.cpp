@@ -1,30 +1,35 @@
 #include "BloomEffect.h"
+#include "Utilities/Profiler.h"
 
 void BloomEffect::Init(unsigned width, unsigned height)
 {
 	int index = int(_buffers.size());
 
 	_buffers.push_back(new Framebuffer());
-	_buffers[index]->AddColorTarget(GL_RGBA8);
+	_buffers[index]->AddColorTarget(_colorFormat);
 	_buffers[index]->AddDepthTarget();
+	_buffers[index]->Reserve(_maxWidth, _maxHeight);
 	_buffers[index]->Init(width, height);
 	index++;
 
 	_buffers.push_back(new Framebuffer());
-	_buffers[index]->AddColorTarget(GL_RGBA8);
+	_buffers[index]->AddColorTarget(_colorFormat);
 	_buffers[index]->AddDepthTarget();
+	_buffers[index]->Reserve(unsigned(_maxWidth / _downscale), unsigned(_maxHeight / _downscale));
 	_buffers[index]->Init(unsigned(width / _downscale), unsigned(height / _downscale));
 	index++;
 
 	_buffers.push_back(new Framebuffer());
-	_buffers[index]->AddColorTarget(GL_RGBA8);
+	_buffers[index]->AddColorTarget(_colorFormat);
 	_buffers[index]->AddDepthTarget();
+	_buffers[index]->Reserve(unsigned(_maxWidth / _downscale), unsigned(_maxHeight / _downscale));
 	_buffers[index]->Init(unsigned(width / _downscale), unsigned(height / _downscale));
 	index++;
 
 	_buffers.push_back(new Framebuffer());
-	_buffers[index]->AddColorTarget(GL_RGBA8);
+	_buffers[index]->AddColorTarget(_colorFormat);
 	_buffers[index]->AddDepthTarget();
+	_buffers[index]->Reserve(_maxWidth, _maxHeight);
 	_buffers[index]->Init(width, height);
 
 	//Load in the shaders
@@ -59,29 +64,37 @@ void BloomEffect::Init(unsigned width, unsigned height)
 	_shaders[index2]->Link();
 	index2++;
 
-	_pixelSize = glm::vec2(1.f / width, 1.f / height);
+	//Offsets are in UVs of the allocated textures, which stay the same size as the render resolution changes
+	_pixelSize = glm::vec2(1.f / _buffers[0]->GetAllocatedWidth(), 1.f / _buffers[0]->GetAllocatedHeight());
 
 	PostEffect::Init(width, height);
 }
 
 void BloomEffect::ApplyEffect(PostEffect* buffer)
 {
+	ProfileScope scope("Bloom Effect");
+
 	//Draws previous buffer to first render target
+	Profiler::Push("Copy");
 	BindShader(0);
 	buffer->BindColorAsTexture(0, 0, 0);
 	_buffers[0]->RenderToFSQ();
 	buffer->UnbindTexture(0);
 	UnbindShader();
+	Profiler::Pop();
 
 	//Bright pass
+	Profiler::Push("Bright Pass");
 	BindShader(1);
 	_shaders[1]->SetUniform("u_Threshold", _threshold);
 	BindColorAsTexture(0, 0, 0);
 	_buffers[1]->RenderToFSQ();
 	UnbindTexture(0);
 	UnbindShader();
+	Profiler::Pop();
 
 	//Computes blur (vert and hori)
+	Profiler::Push("Blur");
 	for (unsigned int i = 0; i < _passes; ++i)
 	{
 		//Horizontal pass
@@ -100,8 +113,10 @@ void BloomEffect::ApplyEffect(PostEffect* buffer)
 		UnbindTexture(0);
 		UnbindShader();
 	}
+	Profiler::Pop();
 
 	//Composite scene and bloom
+	Profiler::Push("Composite");
 	BindShader(4);
 	buffer->BindColorAsTexture(0, 0, 0);
 	BindColorAsTexture(1, 0, 1);
@@ -109,6 +124,7 @@ void BloomEffect::ApplyEffect(PostEffect* buffer)
 	UnbindTexture(1);
 	UnbindTexture(0);
 	UnbindShader();
+	Profiler::Pop();
 }
 
 void BloomEffect::Reshape(unsigned width, unsigned height)
@@ -119,6 +135,11 @@ void BloomEffect::Reshape(unsigned width, unsigned height)
 	_buffers[3]->Reshape(width, height);
 }
 
+bool BloomEffect::IsHDR() const
+{
+	return true;
+}
+
 float BloomEffect::GetDownscale() const
 {
 	return _downscale;
@@ -137,6 +158,9 @@ unsigned BloomEffect::GetPasses() const
 void BloomEffect::SetDownscale(float downscale)
 {
 	_downscale = downscale;
+	//Keep the blur buffers' allocations in proportion so they share a UV scale with the full size ones
+	_buffers[1]->Reserve(unsigned(_maxWidth / _downscale), unsigned(_maxHeight / _downscale));
+	_buffers[2]->Reserve(unsigned(_maxWidth / _downscale), unsigned(_maxHeight / _downscale));
 	Reshape(_buffers[0]->_width, _buffers[0]->_height);
 }
 
@@ -15,6 +15,9 @@ public:
 	//Reshapes the buffers
 	void Reshape(unsigned width, unsigned height) override;
 
+	//Bloom picks out the bright parts of the HDR scene, so it runs before tonemapping
+	bool IsHDR() const override;
+
 	//Getters
 	float GetDownscale() const;
 	float GetThreshold() const;
@@ -1,11 +1,13 @@
 #include "ColorCorrectEffect.h"
+#include "Utilities/Profiler.h"
 
 void ColorCorrectEffect::Init(unsigned width, unsigned height)
 {
 	int index = int(_buffers.size());
 	_buffers.push_back(new Framebuffer());
-	_buffers[index]->AddColorTarget(GL_RGBA8);
+	_buffers[index]->AddColorTarget(_colorFormat);
 	_buffers[index]->AddDepthTarget();
+	_buffers[index]->Reserve(_maxWidth, _maxHeight);
 	_buffers[index]->Init(width, height);
 
 	//Loads the shaders
@@ -23,6 +25,8 @@ void ColorCorrectEffect::Init(unsigned width, unsigned height)
 
 void ColorCorrectEffect::ApplyEffect(PostEffect* buffer)
 {
+	ProfileScope scope("Color Correct Effect");
+
 	BindShader(0);
 	buffer->BindColorAsTexture(0, 0, 0);
 	_Lut.bind(30);
@@ -1,11 +1,13 @@
 #include "GreyscaleEffect.h"
+#include "Utilities/Profiler.h"
 
 void GreyscaleEffect::Init(unsigned width, unsigned height)
 {
     int index = int(_buffers.size());
     _buffers.push_back(new Framebuffer());
-    _buffers[index]->AddColorTarget(GL_RGBA8);
+    _buffers[index]->AddColorTarget(_colorFormat);
     _buffers[index]->AddDepthTarget();
+    _buffers[index]->Reserve(_maxWidth, _maxHeight);
     _buffers[index]->Init(width, height);
 
     //Loads the shaders
@@ -18,6 +20,8 @@ void GreyscaleEffect::Init(unsigned width, unsigned height)
 
 void GreyscaleEffect::ApplyEffect(PostEffect* buffer)
 {
+    ProfileScope scope("Greyscale Effect");
+
     BindShader(0);
     _shaders[0]->SetUniform("u_Intensity", _intensity);
 
@@ -1,4 +1,8 @@
 #include "PostEffect.h"
+#include "Utilities/Profiler.h"
+
+unsigned PostEffect::_maxWidth = 0;
+unsigned PostEffect::_maxHeight = 0;
 
 void PostEffect::Init(unsigned width, unsigned height)
 {
@@ -7,8 +11,9 @@ void PostEffect::Init(unsigned width, unsigned height)
 
 		int index = int(_buffers.size());
 		_buffers.push_back(new Framebuffer());
-		_buffers[index]->AddColorTarget(GL_RGBA8);
+		_buffers[index]->AddColorTarget(_colorFormat);
 		_buffers[index]->AddDepthTarget();
+		_buffers[index]->Reserve(_maxWidth, _maxHeight);
 		_buffers[index]->Init(width, height);
 	}
 
@@ -21,6 +26,8 @@ void PostEffect::Init(unsigned width, unsigned height)
 
 void PostEffect::ApplyEffect(PostEffect* previousBuffer)
 {
+	ProfileScope scope("Passthrough Effect");
+
 	BindShader(_shaders.size() - 1);
 
 	previousBuffer->BindColorAsTexture(0, 0, 0);
@@ -54,6 +61,11 @@ void PostEffect::Reshape(unsigned width, unsigned height)
 	}
 }
 
+bool PostEffect::IsHDR() const
+{
+	return false;
+}
+
 void PostEffect::Clear()
 {
 	for (unsigned int i = 0; i < _buffers.size(); i++)
@@ -80,11 +92,20 @@ void PostEffect::Unload()
 void PostEffect::BindBuffer(int index)
 {
 	_buffers[index]->Bind();
+	_boundBuffer = index;
 }
 
 void PostEffect::UnbindBuffer()
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
+	if (_boundBuffer >= 0)
+	{
+		_buffers[_boundBuffer]->Unbind();
+		_boundBuffer = -1;
+	}
+	else
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
+	}
 }
 
 void PostEffect::BindColorAsTexture(int index, int colorBuffer, int textureSlot)
@@ -106,9 +127,36 @@ void PostEffect::UnbindTexture(int textureSlot)
 void PostEffect::BindShader(int index)
 {
 	_shaders[index]->Bind();
+	//The buffers might only be partly in use, so the quad's UVs need scaling to match
+	_shaders[index]->SetUniform("u_UVScale", _buffers[0]->GetUVScale());
 }
 
 void PostEffect::UnbindShader()
 {
 	glUseProgram(GL_NONE);
 }
+
+Framebuffer* PostEffect::GetBuffer(int index) const
+{
+	return _buffers[index];
+}
+
+void PostEffect::SetColorFormat(GLenum format)
+{
+	_colorFormat = format;
+	for (unsigned int i = 0; i < _buffers.size(); i++)
+	{
+		_buffers[i]->SetColorFormat(0, format);
+	}
+}
+
+GLenum PostEffect::GetColorFormat() const
+{
+	return _colorFormat;
+}
+
+void PostEffect::SetMaxSize(unsigned width, unsigned height)
+{
+	_maxWidth = width;
+	_maxHeight = height;
+}
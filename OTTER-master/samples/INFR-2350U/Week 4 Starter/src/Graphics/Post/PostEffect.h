@@ -16,6 +16,9 @@ public:
 	//Reshapes the buffer
 	virtual void Reshape(unsigned width, unsigned height);
 
+	//Does this effect work on the HDR scene (before tonemapping) instead of the tonemapped image
+	virtual bool IsHDR() const;
+
 	//Clears the buffers
 	void Clear();
 
@@ -24,6 +27,7 @@ public:
 
 	//Binds buffers
 	void BindBuffer(int index);
+	//Unbinds the last bound buffer (resolving it if it's multisampled)
 	void UnbindBuffer();
 
 	//Bind textures
@@ -35,10 +39,31 @@ public:
 	void BindShader(int index);
 	void UnbindShader();
 
+	//Gets one of the buffers (buffer 0 holds the output of the effect)
+	Framebuffer* GetBuffer(int index) const;
+
+	//Sets the format of this effect's color buffers (GL_RGBA8 by default)
+	void SetColorFormat(GLenum format);
+	GLenum GetColorFormat() const;
+
+	//Sets the size every effect's buffers get allocated at
+	//*Call before Init, reshaping to anything smaller won't reallocate the buffers
+	static void SetMaxSize(unsigned width, unsigned height);
+
 protected:
 	//Holds all our buffers for the effects
 	std::vector<Framebuffer*> _buffers;
 
 	//Holds all our shaders for the effects
 	std::vector<Shader::sptr> _shaders;
+
+	//Buffer that was last bound with BindBuffer
+	int _boundBuffer = -1;
+
+	//Format of the color buffers
+	GLenum _colorFormat = GL_RGBA8;
+
+	//Size buffers are allocated at (zero means just use the size they're initialized with)
+	static unsigned _maxWidth;
+	static unsigned _maxHeight;
 };
\ No newline at end of file
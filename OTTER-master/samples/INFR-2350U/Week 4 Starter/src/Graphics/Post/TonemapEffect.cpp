@@ -0,0 +1,172 @@
+#include "TonemapEffect.h"
+#include "Utilities/Profiler.h"
+
+#include <Timing.h>
+
+void TonemapEffect::Init(unsigned width, unsigned height)
+{
+	int index = int(_buffers.size());
+	_buffers.push_back(new Framebuffer());
+	_buffers[index]->AddColorTarget(_colorFormat);
+	_buffers[index]->AddDepthTarget();
+	_buffers[index]->Reserve(_maxWidth, _maxHeight);
+	_buffers[index]->Init(width, height);
+
+	//Set up shaders
+	index = int(_shaders.size());
+	_shaders.push_back(Shader::Create());
+	_shaders[index]->LoadShaderPartFromFile("shaders/passthrough_vert.glsl", GL_VERTEX_SHADER);
+	_shaders[index]->LoadShaderPartFromFile("shaders/Post/tonemap_frag.glsl", GL_FRAGMENT_SHADER);
+	_shaders[index]->Link();
+
+	_histogramShader = Shader::Create();
+	_histogramShader->LoadShaderPartFromFile("shaders/Post/luminance_histogram_comp.glsl", GL_COMPUTE_SHADER);
+	_histogramShader->Link();
+
+	_averageShader = Shader::Create();
+	_averageShader->LoadShaderPartFromFile("shaders/Post/luminance_average_comp.glsl", GL_COMPUTE_SHADER);
+	_averageShader->Link();
+
+	//The histogram starts empty, the averaging pass clears it again after reading it each frame
+	glCreateBuffers(1, &_histogramBuffer);
+	glNamedBufferStorage(_histogramBuffer, sizeof(GLuint) * _histogramBins, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	GLuint zero = 0;
+	glClearNamedBufferData(_histogramBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+	//Start adapted to a mid grey scene
+	float exposure[2] = { 0.5f, _keyValue / 0.5f };
+	glCreateBuffers(1, &_exposureBuffer);
+	glNamedBufferStorage(_exposureBuffer, sizeof(exposure), exposure, 0);
+}
+
+void TonemapEffect::ApplyEffect(PostEffect* buffer)
+{
+	ProfileScope scope("Tonemap Effect");
+
+	if (_autoExposure)
+	{
+		Profiler::Push("Luminance Reduction");
+		ComputeExposure(buffer->GetBuffer(0));
+		Profiler::Pop();
+	}
+
+	BindShader(0);
+	_shaders[0]->SetUniform("u_Exposure", _exposure);
+	_shaders[0]->SetUniform("u_AutoExposure", _autoExposure ? 1 : 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _exposureBuffer);
+
+	buffer->BindColorAsTexture(0, 0, 0);
+
+	_buffers[0]->RenderToFSQ();
+
+	buffer->UnbindTexture(0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, GL_NONE);
+
+	UnbindShader();
+}
+
+void TonemapEffect::Unload()
+{
+	PostEffect::Unload();
+
+	glDeleteBuffers(1, &_histogramBuffer);
+	glDeleteBuffers(1, &_exposureBuffer);
+	_histogramBuffer = GL_NONE;
+	_exposureBuffer = GL_NONE;
+
+	_histogramShader = nullptr;
+	_averageShader = nullptr;
+}
+
+void TonemapEffect::ComputeExposure(const Framebuffer* source)
+{
+	glm::ivec2 size = glm::ivec2(source->_width, source->_height);
+	float range = _maxLogLuminance - _minLogLuminance;
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _histogramBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _exposureBuffer);
+
+	//Each group bins a tile of pixels in shared memory, then adds its bins to the global histogram
+	_histogramShader->Bind();
+	_histogramShader->SetUniform("u_Size", size);
+	_histogramShader->SetUniform("u_MinLogLuminance", _minLogLuminance);
+	_histogramShader->SetUniform("u_InvLogLuminanceRange", 1.0f / range);
+	source->BindColorAsTexture(0, 0);
+	glDispatchCompute((size.x + _groupSize - 1) / _groupSize, (size.y + _groupSize - 1) / _groupSize, 1);
+	source->UnbindTexture(0);
+
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	//One group reduces the histogram to an average and eases the exposure toward it
+	_averageShader->Bind();
+	_averageShader->SetUniform("u_PixelCount", size.x * size.y);
+	_averageShader->SetUniform("u_MinLogLuminance", _minLogLuminance);
+	_averageShader->SetUniform("u_LogLuminanceRange", range);
+	_averageShader->SetUniform("u_DeltaTime", Timing::Instance().DeltaTime);
+	_averageShader->SetUniform("u_AdaptationSpeed", _adaptationSpeed);
+	_averageShader->SetUniform("u_KeyValue", _keyValue);
+	glDispatchCompute(1, 1, 1);
+
+	//The tonemap pass reads the exposure out of the buffer
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, GL_NONE);
+	glUseProgram(GL_NONE);
+}
+
+bool TonemapEffect::GetAutoExposure() const
+{
+	return _autoExposure;
+}
+
+float TonemapEffect::GetExposure() const
+{
+	return _exposure;
+}
+
+float TonemapEffect::GetKeyValue() const
+{
+	return _keyValue;
+}
+
+float TonemapEffect::GetAdaptationSpeed() const
+{
+	return _adaptationSpeed;
+}
+
+float TonemapEffect::GetMinLogLuminance() const
+{
+	return _minLogLuminance;
+}
+
+float TonemapEffect::GetMaxLogLuminance() const
+{
+	return _maxLogLuminance;
+}
+
+void TonemapEffect::SetAutoExposure(bool autoExposure)
+{
+	_autoExposure = autoExposure;
+}
+
+void TonemapEffect::SetExposure(float exposure)
+{
+	_exposure = exposure;
+}
+
+void TonemapEffect::SetKeyValue(float key)
+{
+	_keyValue = key;
+}
+
+void TonemapEffect::SetAdaptationSpeed(float speed)
+{
+	_adaptationSpeed = speed;
+}
+
+void TonemapEffect::SetLuminanceRange(float minLogLuminance, float maxLogLuminance)
+{
+	_minLogLuminance = minLogLuminance;
+	//Keep the range from collapsing, we divide by it
+	_maxLogLuminance = maxLogLuminance > minLogLuminance + 0.1f ? maxLogLuminance : minLogLuminance + 0.1f;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Graphics/Post/PostEffect.h"
+
+//Takes the HDR scene down to displayable colors
+//*Auto exposure builds a luminance histogram of the scene in a compute shader, then averages it on the GPU
+//*and eases toward it over time, nothing gets read back to the CPU
+class TonemapEffect : public PostEffect
+{
+public:
+	//Initializes the framebuffer, shaders and the histogram/exposure buffers
+	void Init(unsigned width, unsigned height) override;
+
+	//Tonemaps the buffer's HDR color into this effect
+	void ApplyEffect(PostEffect* buffer) override;
+
+	//Deletes the histogram/exposure buffers along with everything PostEffect unloads
+	void Unload();
+
+	//Getters
+	bool GetAutoExposure() const;
+	float GetExposure() const;
+	float GetKeyValue() const;
+	float GetAdaptationSpeed() const;
+	float GetMinLogLuminance() const;
+	float GetMaxLogLuminance() const;
+
+	//Setters
+	void SetAutoExposure(bool autoExposure);
+	//With auto exposure on this is compensation on top of it, otherwise it's the exposure itself
+	void SetExposure(float exposure);
+	//Brightness the average luminance gets mapped to
+	void SetKeyValue(float key);
+	//How quickly the exposure catches up to the scene (higher is faster)
+	void SetAdaptationSpeed(float speed);
+	//Range of log2 luminance the histogram covers
+	void SetLuminanceRange(float minLogLuminance, float maxLogLuminance);
+
+private:
+	//Runs the histogram and averaging compute passes on the source
+	void ComputeExposure(const Framebuffer* source);
+
+	bool _autoExposure = true;
+	float _exposure = 1.0f;
+	float _keyValue = 0.4f;
+	float _adaptationSpeed = 1.5f;
+	float _minLogLuminance = -8.0f;
+	float _maxLogLuminance = 4.0f;
+
+	Shader::sptr _histogramShader;
+	Shader::sptr _averageShader;
+
+	//256 bins of pixel counts
+	GLuint _histogramBuffer = GL_NONE;
+	//Adapted luminance and the exposure that goes with it
+	GLuint _exposureBuffer = GL_NONE;
+
+	static const int _histogramBins = 256;
+	static const int _groupSize = 16;
+};
@@ -0,0 +1,156 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+//Shares assets by name and lets them go once nothing uses them
+//*Entries only hold weak references unless they're pinned, so a mesh stays loaded exactly as long as some renderer (or
+//*anything else) holds on to it, and the next lookup after that loads it again
+//*Every call locks, so worker threads can check what's loaded while the main thread adds to it
+template <typename T>
+class AssetCache
+{
+public:
+	typedef std::shared_ptr<T> sptr;
+
+	//Adds an asset under a name, replacing whatever was there
+	//*Pinned assets stay loaded until they're removed or the cache is cleared
+	void Add(const std::string& name, const sptr& asset, bool pinned = false)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		Entry& entry = _entries[name];
+		entry.Weak = asset;
+		entry.Pinned = pinned ? asset : nullptr;
+		_names[asset.get()] = name;
+	}
+
+	//The asset with this name, or nullptr if it was never loaded or everything using it let go
+	sptr Find(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		return _Find(name);
+	}
+
+	//The asset with this name, calling load to make it if it isn't loaded
+	//*load runs with the cache locked, so it shouldn't use the cache itself
+	template <typename Loader>
+	sptr GetOrLoad(const std::string& name, Loader load)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		sptr asset = _Find(name);
+		if (asset != nullptr)
+		{
+			_hits++;
+			return asset;
+		}
+
+		_misses++;
+		asset = load();
+		if (asset != nullptr)
+		{
+			Entry& entry = _entries[name];
+			entry.Weak = asset;
+			entry.Pinned = nullptr;
+			_names[asset.get()] = name;
+		}
+		return asset;
+	}
+
+	//The name an asset was added under, or an empty string if it isn't in the cache
+	//*Checks the entry still points at this asset, in case a freed asset's address got reused
+	std::string NameOf(const T* asset)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		auto name = _names.find(asset);
+		if (name == _names.end())
+			return std::string();
+		auto entry = _entries.find(name->second);
+		if (entry == _entries.end() || entry->second.Weak.lock().get() != asset)
+			return std::string();
+		return name->second;
+	}
+
+	void Remove(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		auto entry = _entries.find(name);
+		if (entry == _entries.end())
+			return;
+		auto owner = _names.find(entry->second.Weak.lock().get());
+		if (owner != _names.end() && owner->second == name)
+			_names.erase(owner);
+		_entries.erase(entry);
+	}
+
+	//Forgets every asset that nothing uses anymore
+	void Prune()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		for (auto it = _names.begin(); it != _names.end();)
+		{
+			auto entry = _entries.find(it->second);
+			if (entry == _entries.end() || entry->second.Weak.expired())
+				it = _names.erase(it);
+			else
+				++it;
+		}
+		for (auto it = _entries.begin(); it != _entries.end();)
+		{
+			if (it->second.Weak.expired())
+				it = _entries.erase(it);
+			else
+				++it;
+		}
+	}
+
+	void Clear()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_entries.clear();
+		_names.clear();
+	}
+
+	//Getters
+	//How many assets are loaded right now
+	size_t GetAlive()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		size_t alive = 0;
+		for (const auto& [name, entry] : _entries)
+		{
+			if (!entry.Weak.expired())
+				alive++;
+		}
+		return alive;
+	}
+	size_t GetHits()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		return _hits;
+	}
+	size_t GetMisses()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		return _misses;
+	}
+
+private:
+	struct Entry
+	{
+		std::weak_ptr<T> Weak;
+		sptr Pinned;
+	};
+
+	sptr _Find(const std::string& name)
+	{
+		auto entry = _entries.find(name);
+		return entry == _entries.end() ? nullptr : entry->second.Weak.lock();
+	}
+
+	std::mutex _lock;
+	std::unordered_map<std::string, Entry> _entries;
+	std::unordered_map<const T*, std::string> _names;
+	size_t _hits = 0;
+	size_t _misses = 0;
+};
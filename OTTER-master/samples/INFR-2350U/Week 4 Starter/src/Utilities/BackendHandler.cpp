@@ -50,30 +50,8 @@ void BackendHandler::GlfwWindowResizedCallback(GLFWwindow* window, int width, in
 	{
 		cam.ResizeWindow(width, height);
 	});
-	Application::Instance().ActiveScene->Registry().view<Framebuffer>().each([=](Framebuffer& buf)
-	{
-		buf.Reshape(width, height);
-	});
-	Application::Instance().ActiveScene->Registry().view<PostEffect>().each([=](PostEffect& buf)
-	{
-		buf.Reshape(width, height);
-	});
-	Application::Instance().ActiveScene->Registry().view<GreyscaleEffect>().each([=](GreyscaleEffect& buf)
-	{
-		buf.Reshape(width, height);
-	});
-	Application::Instance().ActiveScene->Registry().view<SepiaEffect>().each([=](SepiaEffect& buf)
-	{
-		buf.Reshape(width, height);
-	});
-	Application::Instance().ActiveScene->Registry().view<ColorCorrectEffect>().each([=](ColorCorrectEffect& buf)
-	{
-		buf.Reshape(width, height);
-	});
-	Application::Instance().ActiveScene->Registry().view<BloomEffect>().each([=](BloomEffect& buf)
-	{
-		buf.Reshape(width, height);
-	});
+	//The effects get reshaped to the render resolution, which is a scale of the window size
+	DynamicResolution::SetWindowSize(width, height);
 }
 
 bool BackendHandler::InitGLFW()
@@ -187,9 +165,12 @@ void BackendHandler::RenderImGui()
 
 void BackendHandler::RenderVAO(const Shader::sptr& shader, const VertexArrayObject::sptr& vao, const glm::mat4& viewProjection, const Transform& transform)
 {
-	shader->SetUniformMatrix("u_ModelViewProjection", viewProjection * transform.WorldTransform());
-	shader->SetUniformMatrix("u_Model", transform.WorldTransform());
+	//Quantized positions get put back into local space first, the normals were never quantized so the normal matrix stays the same
+	glm::mat4 model = vao->HasDequantization() ? transform.WorldTransform() * vao->GetDequantization() : transform.WorldTransform();
+	shader->SetUniformMatrix("u_ModelViewProjection", viewProjection * model);
+	shader->SetUniformMatrix("u_Model", model);
 	shader->SetUniformMatrix("u_NormalMatrix", transform.WorldNormalMatrix());
+	shader->SetUniform("u_OctahedralNormals", vao->HasOctahedralNormals() ? 1 : 0);
 	vao->Render();
 }
 
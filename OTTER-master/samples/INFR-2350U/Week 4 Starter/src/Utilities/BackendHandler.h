@@ -2,10 +2,12 @@
 
 #include "Utilities/Util.h"
 #include "Utilities/EnvironmentGenerator.h"
+#include "Utilities/DynamicResolution.h"
 #include "Graphics/Post/GreyscaleEffect.h"
 #include "Graphics/Post/SepiaEffect.h"
 #include "Graphics/Post/ColorCorrectEffect.h"
 #include "Graphics/Post/BloomEffect.h"
+#include "Graphics/Post/TonemapEffect.h"
 
 #include <iostream>
 #include <Logging.h>
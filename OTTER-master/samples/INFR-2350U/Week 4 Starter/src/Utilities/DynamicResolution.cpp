@@ -0,0 +1,217 @@
+#include "DynamicResolution.h"
+
+#include <cmath>
+#include <Logging.h>
+#include "imgui.h"
+
+std::vector<PostEffect*> DynamicResolution::_effects;
+
+unsigned DynamicResolution::_windowWidth = 0;
+unsigned DynamicResolution::_windowHeight = 0;
+unsigned DynamicResolution::_renderWidth = 0;
+unsigned DynamicResolution::_renderHeight = 0;
+
+float DynamicResolution::_scale = 1.0f;
+float DynamicResolution::_minScale = 0.5f;
+float DynamicResolution::_maxScale = 1.0f;
+float DynamicResolution::_targetFPS = 60.0f;
+
+float DynamicResolution::_averageFrameTime = 1.0f / 60.0f;
+float DynamicResolution::_cooldown = 0.0f;
+
+bool DynamicResolution::_enabled = false;
+
+GLuint DynamicResolution::_sampler = GL_NONE;
+
+void DynamicResolution::Init(unsigned width, unsigned height)
+{
+	_windowWidth = width;
+	_windowHeight = height;
+	_renderWidth = width;
+	_renderHeight = height;
+	_averageFrameTime = 1.0f / _targetFPS;
+
+	glGenSamplers(1, &_sampler);
+	glSamplerParameteri(_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glSamplerParameteri(_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glSamplerParameteri(_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void DynamicResolution::Unload()
+{
+	if (_sampler != GL_NONE)
+	{
+		glDeleteSamplers(1, &_sampler);
+		_sampler = GL_NONE;
+	}
+	_effects.clear();
+}
+
+void DynamicResolution::AddEffect(PostEffect* effect)
+{
+	_effects.push_back(effect);
+}
+
+void DynamicResolution::Update(float deltaTime)
+{
+	//Smooth out the frame time so one slow frame doesn't drop the resolution
+	_averageFrameTime += (deltaTime - _averageFrameTime) * 0.1f;
+
+	if (!_enabled)
+		return;
+
+	//Give the average time to catch up with the last change
+	_cooldown -= deltaTime;
+	if (_cooldown > 0.0f)
+		return;
+
+	float budget = 1.0f / _targetFPS;
+	float scale = _scale;
+
+	if (_averageFrameTime > budget * 1.05f)
+	{
+		//Over budget, cost goes with the pixel count so drop by the square root of how far over we are
+		scale = _scale * sqrtf(budget / _averageFrameTime);
+	}
+	else if (_averageFrameTime < budget * 0.85f)
+	{
+		//Plenty of headroom, creep back up slowly so we don't bounce
+		scale = _scale + 0.05f;
+	}
+
+	//Snap to steps so tiny changes don't reshape everything every frame
+	scale = roundf(scale * 40.0f) / 40.0f;
+	scale = glm::clamp(scale, _minScale, _maxScale);
+
+	if (scale != _scale)
+	{
+		_scale = scale;
+		ApplyScale();
+		_cooldown = 0.25f;
+	}
+}
+
+void DynamicResolution::Upscale(PostEffect* effect)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
+	glViewport(0, 0, _windowWidth, _windowHeight);
+
+	//A sampler overrides the texture's own filtering, so only the upscale is filtered
+	bool filter = _renderWidth != _windowWidth || _renderHeight != _windowHeight;
+	if (filter)
+	{
+		glBindSampler(0, _sampler);
+	}
+
+	effect->DrawToScreen();
+
+	if (filter)
+	{
+		glBindSampler(0, GL_NONE);
+	}
+}
+
+void DynamicResolution::RenderImGui()
+{
+	if (!ImGui::CollapsingHeader("Dynamic Resolution"))
+		return;
+
+	bool enabled = _enabled;
+	if (ImGui::Checkbox("Enabled", &enabled))
+	{
+		SetEnabled(enabled);
+	}
+
+	float targetFPS = _targetFPS;
+	if (ImGui::SliderFloat("Target FPS", &targetFPS, 30.0f, 240.0f))
+	{
+		SetTargetFPS(targetFPS);
+	}
+
+	float scale = _scale;
+	if (ImGui::SliderFloat("Render Scale", &scale, _minScale, _maxScale))
+	{
+		SetScale(scale);
+	}
+
+	ImGui::Text("Render Resolution: %ux%u (window %ux%u)", _renderWidth, _renderHeight, _windowWidth, _windowHeight);
+	ImGui::Text("Average Frame: %.2f ms (budget %.2f ms)", _averageFrameTime * 1000.0f, 1000.0f / _targetFPS);
+}
+
+bool DynamicResolution::GetEnabled()
+{
+	return _enabled;
+}
+
+float DynamicResolution::GetScale()
+{
+	return _scale;
+}
+
+float DynamicResolution::GetTargetFPS()
+{
+	return _targetFPS;
+}
+
+unsigned DynamicResolution::GetRenderWidth()
+{
+	return _renderWidth;
+}
+
+unsigned DynamicResolution::GetRenderHeight()
+{
+	return _renderHeight;
+}
+
+void DynamicResolution::SetWindowSize(unsigned width, unsigned height)
+{
+	_windowWidth = width;
+	_windowHeight = height;
+	ApplyScale();
+}
+
+void DynamicResolution::SetEnabled(bool enabled)
+{
+	_enabled = enabled;
+	_cooldown = 0.0f;
+}
+
+void DynamicResolution::SetScale(float scale)
+{
+	_scale = glm::clamp(scale, _minScale, _maxScale);
+	ApplyScale();
+}
+
+void DynamicResolution::SetScaleRange(float minScale, float maxScale)
+{
+	_minScale = minScale;
+	_maxScale = maxScale;
+	SetScale(_scale);
+}
+
+void DynamicResolution::SetTargetFPS(float fps)
+{
+	_targetFPS = fps > 1.0f ? fps : 1.0f;
+}
+
+void DynamicResolution::ApplyScale()
+{
+	//Minimized windows are zero sized, keep at least a pixel
+	unsigned width = unsigned(roundf(_windowWidth * _scale));
+	unsigned height = unsigned(roundf(_windowHeight * _scale));
+	width = width > 0 ? width : 1;
+	height = height > 0 ? height : 1;
+
+	if (width == _renderWidth && height == _renderHeight)
+		return;
+
+	_renderWidth = width;
+	_renderHeight = height;
+
+	//The buffers are reserved at full size so this doesn't reallocate anything (unless the window grew past it)
+	for (PostEffect* effect : _effects)
+	{
+		effect->Reshape(width, height);
+	}
+}
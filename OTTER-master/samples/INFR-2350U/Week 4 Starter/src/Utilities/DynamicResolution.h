@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+
+#include "Graphics/Post/PostEffect.h"
+
+//Scales the resolution the scene and effects render at to hold a target frame rate
+//*The effects' buffers are reserved at full size, so changing the scale only changes their viewports
+class DynamicResolution abstract
+{
+public:
+	//Sets up the controller for the window size
+	static void Init(unsigned width, unsigned height);
+	//Deletes the upscaling sampler
+	static void Unload();
+
+	//Adds an effect that gets reshaped to the render resolution
+	static void AddEffect(PostEffect* effect);
+
+	//Moves the render scale toward whatever holds the target frame rate
+	static void Update(float deltaTime);
+
+	//Draws the output of the effect stretched over the whole window
+	static void Upscale(PostEffect* effect);
+
+	//Draws the controls
+	static void RenderImGui();
+
+	//Getters
+	static bool GetEnabled();
+	static float GetScale();
+	static float GetTargetFPS();
+	static unsigned GetRenderWidth();
+	static unsigned GetRenderHeight();
+
+	//Setters
+	//Called when the window is resized
+	static void SetWindowSize(unsigned width, unsigned height);
+	static void SetEnabled(bool enabled);
+	//Sets the scale directly (the controller will move it again if it's enabled)
+	static void SetScale(float scale);
+	static void SetScaleRange(float minScale, float maxScale);
+	static void SetTargetFPS(float fps);
+
+private:
+	static std::vector<PostEffect*> _effects;
+
+	static unsigned _windowWidth;
+	static unsigned _windowHeight;
+	static unsigned _renderWidth;
+	static unsigned _renderHeight;
+
+	static float _scale;
+	static float _minScale;
+	static float _maxScale;
+	static float _targetFPS;
+
+	//Smoothed frame time in seconds
+	static float _averageFrameTime;
+	//Time left before the scale is allowed to change again
+	static float _cooldown;
+
+	static bool _enabled;
+
+	//Linear sampler used when upscaling, the framebuffers themselves use nearest filtering
+	static GLuint _sampler;
+
+	//Resizes the effects if the render resolution changed
+	static void ApplyScale();
+};
@@ -1,4 +1,5 @@
 #include "EnvironmentGenerator.h"
+#include "Utilities/SceneSerializer.h"
 
 //The gameobject references to the spawned objects
 std::vector<std::vector<GameObject>> EnvironmentGenerator::_objectsSpawned;
@@ -7,11 +8,14 @@ std::vector<std::vector<GameObject>> EnvironmentGenerator::_objectsSpawned;
 std::vector<VertexArrayObject::sptr> EnvironmentGenerator::_vaosToSpawn;
 std::vector<bool> EnvironmentGenerator::_loadedIn;
 std::vector<ShaderMaterial::sptr> EnvironmentGenerator::_materialsForSpawning;
+std::vector<entt::entity> EnvironmentGenerator::_prefabs;
 std::vector<int> EnvironmentGenerator::_numToSpawn;
 std::vector<glm::vec2> EnvironmentGenerator::_spawnFromAll;
 std::vector<glm::vec2> EnvironmentGenerator::_spawnToAll;
 std::vector<std::vector<glm::vec2>> EnvironmentGenerator::_avoidFromAll;
 std::vector<std::vector<glm::vec2>> EnvironmentGenerator::_avoidToAll;
+std::vector<float> EnvironmentGenerator::_minSpacingAll;
+uint64_t EnvironmentGenerator::_seed = 1;
 
 //The filenames of the objects to spawn
 std::vector<std::string> EnvironmentGenerator::_objectsToSpawn;
@@ -25,31 +29,50 @@ void EnvironmentGenerator::RegenerateEnvironment()
 {
 	CleanEnvironment();
 
+	//Next seed, so every regeneration looks different but can still be gotten back
+	_seed++;
 	GenerateEnvironment();
 }
 
 void EnvironmentGenerator::GenerateEnvironment()
 {
+	//Place every object at once, the placement spreads the objects across threads
+	std::vector<PlacementRequest> requests(_objectsToSpawn.size());
+	for (size_t i = 0; i < _objectsToSpawn.size(); i++)
+	{
+		requests[i].From = _spawnFromAll[i];
+		requests[i].To = _spawnToAll[i];
+		requests[i].AvoidFrom = _avoidFromAll[i];
+		requests[i].AvoidTo = _avoidToAll[i];
+		requests[i].Count = uint32_t(std::max(_numToSpawn[i], 0));
+		requests[i].MinSpacing = _minSpacingAll[i];
+	}
+	std::vector<PlacementResult> placements = Placement::Place(requests, _seed);
+
 	for (int i = 0; i < _objectsToSpawn.size(); i++)
 	{
 		std::vector<GameObject> temp;
 		{
-			//Load in this object vao
+			//Make the prefab for this object
 			if (!_loadedIn[i])
 			{
-				VertexArrayObject::sptr vao = ObjLoader::LoadFromFile(_objectsToSpawn[i]);
-				_vaosToSpawn.push_back(vao);
+				entt::registry& prefabs = GameScene::Prefabs();
+				_prefabs[i] = prefabs.create();
+				prefabs.emplace<Transform>(_prefabs[i], entt::handle(prefabs, _prefabs[i]));
+				prefabs.emplace<GameObjectTag>(_prefabs[i], _objectsToSpawn[i]);
+				prefabs.emplace<RendererComponent>(_prefabs[i]).SetMesh(_vaosToSpawn[i]).SetMaterial(_materialsForSpawning[i]);
 				_loadedIn[i] = true;
 			}
 
-			for (int j = 0; j < _numToSpawn[i]; j++)
+			//Every copy gets made in one go, they're all named after the file so FindAll can get them back
+			//*There can be fewer than asked for if the spacing didn't leave room for them all
+			const PlacementResult& placement = placements[i];
+			GameScene::sptr& scene = Application::Instance().ActiveScene;
+			std::vector<entt::entity> spawned = scene->CreateEntities(_prefabs[i], placement.Positions.size(), placement.Positions.data(), placement.Rotations.data());
+			temp.reserve(spawned.size());
+			for (entt::entity entity : spawned)
 			{
-				temp.push_back(Application::Instance().ActiveScene->CreateEntity(_objectsToSpawn[i] + (std::to_string(j + 1))));
-				temp[j].emplace<RendererComponent>().SetMesh(_vaosToSpawn[i]).SetMaterial(_materialsForSpawning[i]);
-				//Randomly places
-				temp[j].get<Transform>().SetLocalPosition(glm::vec3(Util::GetRandomNumberBetween(_spawnFromAll[i],
-					_spawnToAll[i], _avoidFromAll[i], _avoidToAll[i]), 0.0f));
-				temp[j].get<Transform>().SetLocalRotation(Util::GetRandomNumberBetween(glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 0.f, 360.0f)));
+				temp.push_back(GameObject(scene->Registry(), entity));
 			}
 		}
 
@@ -60,12 +83,14 @@ void EnvironmentGenerator::GenerateEnvironment()
 
 void EnvironmentGenerator::CleanEnvironment()
 {
-	//Remove all the entities
-	for (int i = 0; i < _objectsSpawned.size(); i++)
+	//Queue all the entities, the scene destroys them together on its next Poll
+	//*Ones that were already removed, or that belong to a scene that's been swapped out, get skipped
+	GameScene::sptr& scene = Application::Instance().ActiveScene;
+	for (std::vector<GameObject>& objects : _objectsSpawned)
 	{
-		for (int j = 0; j < _objectsSpawned[i].size(); j++)
+		for (GameObject& object : objects)
 		{
-			Application::Instance().ActiveScene->RemoveEntity(_objectsSpawned[i][j]);
+			scene->RemoveEntity(object);
 		}
 	}
 
@@ -75,6 +100,16 @@ void EnvironmentGenerator::CleanEnvironment()
 
 void EnvironmentGenerator::CleanUpPointers()
 {
+	//Destroy the prefabs, they hold onto the vaos and materials too
+	for (size_t i = 0; i < _prefabs.size(); i++)
+	{
+		if (_prefabs[i] != entt::null)
+		{
+			GameScene::Prefabs().destroy(_prefabs[i]);
+			_prefabs[i] = entt::null;
+		}
+		_loadedIn[i] = false;
+	}
 	//Clear up vao references so the smart pointers can clear
 	_vaosToSpawn.clear();
 	//Clear up material references so the smart pointers can clear
@@ -82,7 +117,7 @@ void EnvironmentGenerator::CleanUpPointers()
 }
 
 void EnvironmentGenerator::AddObjectToGeneration(std::string fileName, ShaderMaterial::sptr objMat, int numToSpawn, glm::vec2 spawnFrom, 
-													glm::vec2 spawnTo, std::vector<glm::vec2> avoidFrom, std::vector<glm::vec2> avoidTo)
+													glm::vec2 spawnTo, std::vector<glm::vec2> avoidFrom, std::vector<glm::vec2> avoidTo, float minSpacing)
 {
 	//Find the filename in the list
 	int index = Util::FindInVector(fileName, _objectsToSpawn);
@@ -94,7 +129,7 @@ void EnvironmentGenerator::AddObjectToGeneration(std::string fileName, ShaderMat
 	}
 
 	//Loads in the mesh and adds to list
-	VertexArrayObject::sptr vao = ObjLoader::LoadFromFile(fileName);
+	VertexArrayObject::sptr vao = SceneSerializer::LoadMesh(fileName);
 	_vaosToSpawn.push_back(vao);
 	//Adds material to list
 	_materialsForSpawning.push_back(objMat);
@@ -106,11 +141,13 @@ void EnvironmentGenerator::AddObjectToGeneration(std::string fileName, ShaderMat
 	_spawnToAll.push_back(spawnTo);
 	_avoidFromAll.push_back(avoidFrom);
 	_avoidToAll.push_back(avoidTo);
+	_minSpacingAll.push_back(minSpacing);
 
 	//Adds the filename to the list
 	_objectsToSpawn.push_back(fileName);
-	//Sets it as not loaded
+	//Sets it as not loaded, the prefab gets made the first time it spawns
 	_loadedIn.push_back(false);
+	_prefabs.push_back(entt::null);
 }
 
 void EnvironmentGenerator::RemoveObjectFromGeneration(std::string fileName)
@@ -126,9 +163,17 @@ void EnvironmentGenerator::RemoveObjectFromGeneration(std::string fileName)
 	_vaosToSpawn.erase(_vaosToSpawn.begin() + index);
 	_loadedIn.erase(_loadedIn.begin() + index);
 	_materialsForSpawning.erase(_materialsForSpawning.begin() + index);
+	if (_prefabs[index] != entt::null)
+	{
+		GameScene::Prefabs().destroy(_prefabs[index]);
+	}
+	_prefabs.erase(_prefabs.begin() + index);
 	_numToSpawn.erase(_numToSpawn.begin() + index);
+	_spawnFromAll.erase(_spawnFromAll.begin() + index);
+	_spawnToAll.erase(_spawnToAll.begin() + index);
 	_avoidFromAll.erase(_avoidFromAll.begin() + index);
 	_avoidToAll.erase(_avoidToAll.begin() + index);
+	_minSpacingAll.erase(_minSpacingAll.begin() + index);
 	
 	//erase the filename from the list
 	_objectsToSpawn.erase(_objectsToSpawn.begin() + index);
@@ -138,3 +183,13 @@ std::vector<std::string> EnvironmentGenerator::GetObjectsOnList()
 {
 	return _objectsToSpawn;
 }
+
+void EnvironmentGenerator::SetSeed(uint64_t seed)
+{
+	_seed = seed;
+}
+
+uint64_t EnvironmentGenerator::GetSeed()
+{
+	return _seed;
+}
@@ -4,9 +4,11 @@
 #include <ObjLoader.h>
 #include <RendererComponent.h>
 #include <Transform.h>
+#include <GameObjectTag.h>
 #include <vector>
 
 #include "Utilities/Util.h"
+#include "Utilities/Placement.h"
 
 class EnvironmentGenerator abstract
 {
@@ -22,13 +24,18 @@ public:
 	static void CleanUpPointers();
 
 	//Adds object to generation
+	//*minSpacing keeps copies of this object at least that far apart (0 lets them overlap)
 	static void AddObjectToGeneration(std::string fileName, ShaderMaterial::sptr objMat, int numToSpawn, 
 										glm::vec2 spawnFrom, glm::vec2 spawnTo, std::vector<glm::vec2> avoidFrom, 
-											std::vector<glm::vec2> avoidTo);
+											std::vector<glm::vec2> avoidTo, float minSpacing = 0.0f);
 	//Removes object from generation
 	static void RemoveObjectFromGeneration(std::string fileName);
 
 	static std::vector<std::string> GetObjectsOnList();
+
+	//The same seed always generates the same environment, regenerating moves onto the next seed
+	static void SetSeed(uint64_t seed);
+	static uint64_t GetSeed();
 private:
 	//The gameobjects spawned here
 	static std::vector<std::vector<GameObject>> _objectsSpawned;
@@ -37,11 +44,15 @@ private:
 	static std::vector<VertexArrayObject::sptr> _vaosToSpawn;
 	static std::vector<bool> _loadedIn;
 	static std::vector<ShaderMaterial::sptr> _materialsForSpawning;
+	//Prefab for each object, every spawn is a copy of it
+	static std::vector<entt::entity> _prefabs;
 	static std::vector<int> _numToSpawn;
 	static std::vector<glm::vec2> _spawnFromAll;
 	static std::vector<glm::vec2> _spawnToAll;
 	static std::vector<std::vector<glm::vec2>> _avoidFromAll;
 	static std::vector<std::vector<glm::vec2>> _avoidToAll;
+	static std::vector<float> _minSpacingAll;
+	static uint64_t _seed;
 
 	//Allows us to go through and remove from list
 	static std::vector<std::string> _objectsToSpawn;
@@ -0,0 +1,408 @@
+#include "Placement.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <Logging.h>
+#include "Utilities/Util.h"
+
+namespace
+{
+	uint64_t SplitMix64(uint64_t& state)
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	uint32_t RotateLeft(uint32_t x, int k)
+	{
+		return (x << k) | (x >> (32 - k));
+	}
+
+	double ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//Buckets the avoid zones by the cells they touch, so a point only tests the zones near it
+	//*Cells a zone covers completely are flagged, those reject without testing anything
+	class AvoidGrid
+	{
+	public:
+		AvoidGrid(const PlacementRequest& request)
+		{
+			size_t count = std::min(request.AvoidFrom.size(), request.AvoidTo.size());
+			if (count == 0)
+				return;
+
+			_from = request.From;
+			glm::vec2 size = glm::max(request.To - request.From, glm::vec2(1e-6f));
+			//A few cells per zone along each side keeps the lists short without a huge grid
+			int resolution = glm::clamp(int(std::sqrt(float(count)) * 4.0f), 1, 256);
+			_cells = glm::ivec2(resolution);
+			_cellSize = size / glm::vec2(_cells);
+
+			_zones.resize(count);
+			std::vector<std::vector<uint32_t>> lists(size_t(_cells.x) * _cells.y);
+			_blocked.assign(lists.size(), 0);
+			for (size_t i = 0; i < count; i++)
+			{
+				glm::vec2 min = glm::min(request.AvoidFrom[i], request.AvoidTo[i]);
+				glm::vec2 max = glm::max(request.AvoidFrom[i], request.AvoidTo[i]);
+				_zones[i] = glm::vec4(min, max);
+
+				glm::ivec2 first = CellOf(min);
+				glm::ivec2 last = CellOf(max);
+				for (int y = first.y; y <= last.y; y++)
+				{
+					for (int x = first.x; x <= last.x; x++)
+					{
+						size_t cell = size_t(y) * _cells.x + x;
+						glm::vec2 cellMin = _from + glm::vec2(x, y) * _cellSize;
+						glm::vec2 cellMax = cellMin + _cellSize;
+						if (glm::all(glm::lessThanEqual(min, cellMin)) && glm::all(glm::greaterThanEqual(max, cellMax)))
+							_blocked[cell] = 1;
+						else
+							lists[cell].push_back(uint32_t(i));
+					}
+				}
+			}
+
+			//Flatten the lists so a lookup is one contiguous run
+			_cellStart.resize(lists.size() + 1);
+			_cellStart[0] = 0;
+			for (size_t i = 0; i < lists.size(); i++)
+			{
+				_cellStart[i + 1] = _cellStart[i] + uint32_t(lists[i].size());
+				_cellZones.insert(_cellZones.end(), lists[i].begin(), lists[i].end());
+			}
+		}
+
+		bool Contains(glm::vec2 point) const
+		{
+			if (_zones.empty())
+				return false;
+
+			glm::ivec2 cell2 = CellOf(point);
+			size_t cell = size_t(cell2.y) * _cells.x + cell2.x;
+			if (_blocked[cell])
+				return true;
+			for (uint32_t i = _cellStart[cell]; i < _cellStart[cell + 1]; i++)
+			{
+				const glm::vec4& zone = _zones[_cellZones[i]];
+				if (point.x >= zone.x && point.y >= zone.y && point.x <= zone.z && point.y <= zone.w)
+					return true;
+			}
+			return false;
+		}
+
+	private:
+		glm::ivec2 CellOf(glm::vec2 point) const
+		{
+			glm::ivec2 cell = glm::ivec2(glm::floor((point - _from) / _cellSize));
+			return glm::clamp(cell, glm::ivec2(0), _cells - 1);
+		}
+
+		glm::vec2 _from = glm::vec2(0.0f);
+		glm::vec2 _cellSize = glm::vec2(1.0f);
+		glm::ivec2 _cells = glm::ivec2(1);
+		//min xy, max zw
+		std::vector<glm::vec4> _zones;
+		std::vector<uint8_t> _blocked;
+		std::vector<uint32_t> _cellStart;
+		std::vector<uint32_t> _cellZones;
+	};
+
+	//Points placed so far, bucketed by a uniform grid so spacing checks only look at nearby cells
+	class SpacingGrid
+	{
+	public:
+		SpacingGrid(const PlacementRequest& request) :
+			_spacing(request.MinSpacing)
+		{
+			_from = request.From;
+			glm::vec2 size = glm::max(request.To - request.From, glm::vec2(1e-6f));
+			//Cells of spacing / sqrt(2) hold one point at most, but really small spacings would need a huge grid,
+			//so the cells get capped and just hold a few points each instead
+			const float maxCells = float(1 << 22);
+			float cellSize = std::max(_spacing / std::sqrt(2.0f), std::sqrt(size.x * size.y / maxCells));
+			_cells = glm::max(glm::ivec2(glm::ceil(size / cellSize)), glm::ivec2(1));
+			_cellSize = cellSize;
+			_reach = int(std::ceil(_spacing / cellSize));
+			_heads.assign(size_t(_cells.x) * _cells.y, -1);
+			_spacingSq = _spacing * _spacing;
+		}
+
+		bool Fits(glm::vec2 point, const std::vector<glm::vec3>& positions) const
+		{
+			glm::ivec2 cell = CellOf(point);
+			glm::ivec2 first = glm::max(cell - _reach, glm::ivec2(0));
+			glm::ivec2 last = glm::min(cell + _reach, _cells - 1);
+			for (int y = first.y; y <= last.y; y++)
+			{
+				for (int x = first.x; x <= last.x; x++)
+				{
+					for (int i = _heads[size_t(y) * _cells.x + x]; i != -1; i = _next[i])
+					{
+						glm::vec2 offset = glm::vec2(positions[i]) - point;
+						if (glm::dot(offset, offset) < _spacingSq)
+							return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		void Add(glm::vec2 point, int index)
+		{
+			glm::ivec2 cell2 = CellOf(point);
+			size_t cell = size_t(cell2.y) * _cells.x + cell2.x;
+			if (_next.size() <= size_t(index))
+				_next.resize(size_t(index) + 1);
+			_next[index] = _heads[cell];
+			_heads[cell] = index;
+		}
+
+	private:
+		glm::ivec2 CellOf(glm::vec2 point) const
+		{
+			glm::ivec2 cell = glm::ivec2(glm::floor((point - _from) / _cellSize));
+			return glm::clamp(cell, glm::ivec2(0), _cells - 1);
+		}
+
+		float _spacing;
+		float _spacingSq;
+		glm::vec2 _from;
+		float _cellSize;
+		glm::ivec2 _cells;
+		//How many cells either side a neighbour could be in
+		int _reach;
+		//First point in each cell, and the next point in the same cell for each point
+		std::vector<int> _heads;
+		std::vector<int> _next;
+	};
+}
+
+Xoshiro128::Xoshiro128(uint64_t seed)
+{
+	uint64_t state = seed;
+	uint64_t a = SplitMix64(state);
+	uint64_t b = SplitMix64(state);
+	_state[0] = uint32_t(a);
+	_state[1] = uint32_t(a >> 32);
+	_state[2] = uint32_t(b);
+	_state[3] = uint32_t(b >> 32);
+}
+
+uint32_t Xoshiro128::Next()
+{
+	uint32_t result = RotateLeft(_state[1] * 5, 7) * 9;
+	uint32_t t = _state[1] << 9;
+	_state[2] ^= _state[0];
+	_state[3] ^= _state[1];
+	_state[1] ^= _state[2];
+	_state[0] ^= _state[3];
+	_state[2] ^= t;
+	_state[3] = RotateLeft(_state[3], 11);
+	return result;
+}
+
+float Xoshiro128::NextFloat()
+{
+	//Top 24 bits, exactly what a float can hold
+	return float(Next() >> 8) * (1.0f / 16777216.0f);
+}
+
+float Xoshiro128::NextFloat(float from, float to)
+{
+	return from + (to - from) * NextFloat();
+}
+
+uint64_t Placement::RequestSeed(uint64_t seed, size_t index)
+{
+	uint64_t state = seed ^ (uint64_t(index) * 0xD1B54A32D192ED03ull);
+	return SplitMix64(state);
+}
+
+PlacementResult Placement::Place(const PlacementRequest& request, uint64_t seed)
+{
+	PlacementResult result;
+	result.Positions.reserve(request.Count);
+	result.Rotations.reserve(request.Count);
+
+	Xoshiro128 random(seed);
+	AvoidGrid avoid(request);
+	glm::vec2 min = glm::min(request.From, request.To);
+	glm::vec2 max = glm::max(request.From, request.To);
+
+	//Dart throwing: keep guessing until enough land somewhere allowed, giving up once the area's clearly full
+	const size_t maxAttempts = size_t(request.Count) * 30 + 1000;
+	size_t attempts = 0;
+	if (request.MinSpacing > 0.0f)
+	{
+		SpacingGrid spacing(request);
+		while (result.Positions.size() < request.Count && attempts < maxAttempts)
+		{
+			attempts++;
+			glm::vec2 point = glm::vec2(random.NextFloat(min.x, max.x), random.NextFloat(min.y, max.y));
+			if (avoid.Contains(point) || !spacing.Fits(point, result.Positions))
+				continue;
+
+			spacing.Add(point, int(result.Positions.size()));
+			result.Positions.push_back(glm::vec3(point, 0.0f));
+			result.Rotations.push_back(glm::vec3(0.0f, 0.0f, random.NextFloat(0.0f, 360.0f)));
+		}
+	}
+	else
+	{
+		while (result.Positions.size() < request.Count && attempts < maxAttempts)
+		{
+			attempts++;
+			glm::vec2 point = glm::vec2(random.NextFloat(min.x, max.x), random.NextFloat(min.y, max.y));
+			if (avoid.Contains(point))
+				continue;
+
+			result.Positions.push_back(glm::vec3(point, 0.0f));
+			result.Rotations.push_back(glm::vec3(0.0f, 0.0f, random.NextFloat(0.0f, 360.0f)));
+		}
+	}
+
+	result.Rejected = attempts - result.Positions.size();
+	result.Complete = result.Positions.size() == request.Count;
+	return result;
+}
+
+std::vector<PlacementResult> Placement::Place(const std::vector<PlacementRequest>& requests, uint64_t seed, unsigned threads)
+{
+	std::vector<PlacementResult> results(requests.size());
+	if (threads == 0)
+	{
+		threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	threads = std::min(threads, unsigned(std::max<size_t>(requests.size(), 1)));
+
+	//Threads grab the next request until they run out, each request only depends on its own seed
+	std::atomic<size_t> next(0);
+	auto work = [&]() {
+		for (size_t i = next++; i < requests.size(); i = next++)
+		{
+			results[i] = Place(requests[i], RequestSeed(seed, i));
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned t = 1; t < threads; t++)
+	{
+		workers.emplace_back(work);
+	}
+	//This thread works too
+	work();
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		if (!results[i].Complete)
+		{
+			LOG_WARN("Only {} of {} objects fit in placement {}, the area's too full for that spacing",
+				results[i].Positions.size(), requests[i].Count, i);
+		}
+	}
+	return results;
+}
+
+bool Placement::RunBenchmark(size_t count)
+{
+	//A village sized layout: 8 kinds of objects over the same area, with roads and buildings to stay off
+	const size_t types = 8;
+	std::vector<PlacementRequest> requests(types);
+	for (size_t i = 0; i < types; i++)
+	{
+		PlacementRequest& request = requests[i];
+		request.From = glm::vec2(-1000.0f);
+		request.To = glm::vec2(1000.0f);
+		request.Count = uint32_t(count / types);
+		for (int road = -900; road <= 900; road += 100)
+		{
+			request.AvoidFrom.push_back(glm::vec2(float(road) - 2.0f, -1000.0f));
+			request.AvoidTo.push_back(glm::vec2(float(road) + 2.0f, 1000.0f));
+			request.AvoidFrom.push_back(glm::vec2(-1000.0f, float(road) - 2.0f));
+			request.AvoidTo.push_back(glm::vec2(1000.0f, float(road) + 2.0f));
+		}
+		request.AvoidFrom.push_back(glm::vec2(-50.0f));
+		request.AvoidTo.push_back(glm::vec2(50.0f));
+	}
+
+	//Without spacing first, the same as the old generator did it
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<PlacementResult> uniform = Placement::Place(requests, 1234);
+	double uniformTime = ElapsedMs(start);
+
+	//Then with spacing, the per type counts fit easily at this spacing
+	for (PlacementRequest& request : requests)
+	{
+		request.MinSpacing = 1.0f;
+	}
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<PlacementResult> spaced = Placement::Place(requests, 1234);
+	double spacedTime = ElapsedMs(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<PlacementResult> serial = Placement::Place(requests, 1234, 1);
+	double serialTime = ElapsedMs(start);
+
+	//The old way, with its recursive retries, timed on a slice and scaled up
+	const size_t utilCount = std::min<size_t>(count, 20000);
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < utilCount; i++)
+	{
+		Util::GetRandomNumberBetween(requests[0].From, requests[0].To, requests[0].AvoidFrom, requests[0].AvoidTo);
+	}
+	double utilTime = ElapsedMs(start) * double(count) / double(utilCount);
+
+	//Same seed has to give the same layout however many threads ran it, everything has to stay out of
+	//the avoid zones and (for the spaced run) be far enough apart
+	bool ok = true;
+	AvoidGrid check(requests[0]);
+	size_t placed = 0;
+	for (size_t i = 0; i < types; i++)
+	{
+		ok = ok && uniform[i].Complete && spaced[i].Complete;
+		ok = ok && spaced[i].Positions == serial[i].Positions && spaced[i].Rotations == serial[i].Rotations;
+		placed += spaced[i].Positions.size();
+		for (const std::vector<glm::vec3>* positions : { &uniform[i].Positions, &spaced[i].Positions })
+		{
+			for (const glm::vec3& position : *positions)
+			{
+				bool inside = glm::all(glm::greaterThanEqual(glm::vec2(position), requests[i].From)) && glm::all(glm::lessThanEqual(glm::vec2(position), requests[i].To));
+				ok = ok && inside && !check.Contains(glm::vec2(position));
+			}
+		}
+
+		//Brute force is too slow for every point, so check a sample against everything
+		const std::vector<glm::vec3>& positions = spaced[i].Positions;
+		for (size_t a = 0; a < positions.size() && a < 200; a++)
+		{
+			for (size_t b = 0; b < positions.size(); b++)
+			{
+				if (a != b && glm::distance(glm::vec2(positions[a]), glm::vec2(positions[b])) < requests[i].MinSpacing)
+					ok = false;
+			}
+		}
+	}
+	ok = ok && Placement::Place(requests, 99, 1)[0].Positions != serial[0].Positions;
+
+	LOG_INFO("Placement ({} objects, {} types): {:.1f} ms uniform, {:.1f} ms spaced ({:.1f} ms on one thread), Util::GetRandomNumberBetween would take {:.1f} ms",
+		placed, types, uniformTime, spacedTime, serialTime, utilTime);
+	if (!ok)
+	{
+		LOG_ERROR("Placement broke a rule, or wasn't deterministic");
+	}
+	return ok;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <GLM/glm.hpp>
+
+//Small, fast random number generator (xoshiro128**)
+//*Cheap to make, so every thread or job gets its own instead of sharing rand()
+class Xoshiro128
+{
+public:
+	//The seed gets spread over the whole state with splitmix64, so nearby seeds still give unrelated numbers
+	explicit Xoshiro128(uint64_t seed = 1);
+
+	uint32_t Next();
+	//Between 0 and 1, never 1
+	float NextFloat();
+	float NextFloat(float from, float to);
+
+private:
+	uint32_t _state[4];
+};
+
+//Where and how to scatter one kind of object on the ground (z = 0)
+struct PlacementRequest
+{
+	//Corners of the area to place in
+	glm::vec2 From = glm::vec2(-10.0f);
+	glm::vec2 To = glm::vec2(10.0f);
+	//Rectangles inside the area that nothing gets placed in (inclusive, like Util::CheckNumBetween)
+	std::vector<glm::vec2> AvoidFrom;
+	std::vector<glm::vec2> AvoidTo;
+	uint32_t Count = 0;
+	//Smallest distance allowed between two objects, 0 places them anywhere
+	float MinSpacing = 0.0f;
+};
+
+//What came out of one request
+struct PlacementResult
+{
+	std::vector<glm::vec3> Positions;
+	//Euler degrees, only spun around z
+	std::vector<glm::vec3> Rotations;
+	//Samples thrown away for landing in an avoid zone or too close to another object
+	size_t Rejected = 0;
+	//False if the area filled up before Count objects fit
+	bool Complete = true;
+};
+
+//Scatters objects over an area, keeping out of avoid zones and (optionally) away from each other
+//*Spacing uses dart throwing over a uniform grid (Poisson disk sampling), avoid zones are looked up through a grid too
+//*Every request has its own generator seeded from the seed and its index, so the output only depends on the seed
+class Placement abstract
+{
+public:
+	//Places every request, spread across threads (0 uses every core)
+	static std::vector<PlacementResult> Place(const std::vector<PlacementRequest>& requests, uint64_t seed, unsigned threads = 0);
+	//Places a single request on this thread
+	static PlacementResult Place(const PlacementRequest& request, uint64_t seed);
+
+	//Places a million objects with and without spacing, checks the results and logs the timings
+	static bool RunBenchmark(size_t count = 1000000);
+
+private:
+	//The seed a request is placed with, mixed so that neighbouring requests don't share sequences
+	static uint64_t RequestSeed(uint64_t seed, size_t index);
+};
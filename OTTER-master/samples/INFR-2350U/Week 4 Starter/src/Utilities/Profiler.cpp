@@ -0,0 +1,293 @@
+#include "Profiler.h"
+
+#include <fstream>
+#include <functional>
+#include <json.hpp>
+#include <Logging.h>
+#include "imgui.h"
+
+ProfileFrame Profiler::_frames[2];
+std::vector<GLuint> Profiler::_queryPools[2];
+int Profiler::_current = 0;
+bool Profiler::_recording = false;
+
+std::vector<int> Profiler::_stack;
+
+ProfileFrame Profiler::_lastFrame;
+std::vector<ProfileFrame> Profiler::_history;
+
+uint64_t Profiler::_frameCount = 0;
+float Profiler::_frameBudget = 1000.0f / 60.0f;
+bool Profiler::_enabled = true;
+
+std::chrono::high_resolution_clock::time_point Profiler::_epoch = std::chrono::high_resolution_clock::now();
+
+void Profiler::BeginFrame()
+{
+	if (!_enabled)
+	{
+		_recording = false;
+		return;
+	}
+
+	//This slot was last written two frames ago, so its queries should be done by now
+	_current = int(_frameCount % 2);
+	Resolve(_current);
+
+	ProfileFrame& frame = _frames[_current];
+	frame.Samples.clear();
+	frame.Index = _frameCount;
+	frame.Start = Now();
+
+	_stack.clear();
+	_recording = true;
+}
+
+void Profiler::EndFrame()
+{
+	if (!_recording)
+		return;
+
+	//Close anything that was left open
+	while (!_stack.empty())
+	{
+		Pop();
+	}
+
+	ProfileFrame& frame = _frames[_current];
+	frame.CpuTime = Now() - frame.Start;
+
+	_frameCount++;
+	_recording = false;
+}
+
+void Profiler::Push(const std::string& name)
+{
+	if (!_recording)
+		return;
+
+	ProfileFrame& frame = _frames[_current];
+	std::vector<GLuint>& pool = _queryPools[_current];
+
+	int index = int(frame.Samples.size());
+
+	//Grow the query pool if this frame has more scopes than we've seen before
+	if (pool.size() < size_t(index + 1) * 2)
+	{
+		size_t oldSize = pool.size();
+		pool.resize(oldSize + 32);
+		glGenQueries(GLsizei(pool.size() - oldSize), &pool[oldSize]);
+	}
+
+	ProfileSample sample;
+	sample.Name = name;
+	sample.Parent = _stack.empty() ? -1 : _stack.back();
+	sample.Depth = int(_stack.size());
+	sample.Queries[0] = pool[index * 2];
+	sample.Queries[1] = pool[index * 2 + 1];
+	sample.CpuStart = Now() - frame.Start;
+
+	//Timestamps can nest, unlike GL_TIME_ELAPSED queries
+	glQueryCounter(sample.Queries[0], GL_TIMESTAMP);
+
+	frame.Samples.push_back(sample);
+	_stack.push_back(index);
+}
+
+void Profiler::Pop()
+{
+	if (!_recording || _stack.empty())
+		return;
+
+	ProfileFrame& frame = _frames[_current];
+	ProfileSample& sample = frame.Samples[_stack.back()];
+	_stack.pop_back();
+
+	glQueryCounter(sample.Queries[1], GL_TIMESTAMP);
+	sample.CpuTime = Now() - frame.Start - sample.CpuStart;
+}
+
+void Profiler::RenderImGui()
+{
+	if (!ImGui::CollapsingHeader("Profiler"))
+		return;
+
+	bool enabled = _enabled;
+	if (ImGui::Checkbox("Enabled", &enabled))
+	{
+		SetEnabled(enabled);
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Export Chrome Trace"))
+	{
+		ExportChromeTrace("profile.json");
+	}
+	ImGui::SliderFloat("Frame Budget (ms)", &_frameBudget, 1.0f, 50.0f);
+
+	//Frame time history
+	float frameTimes[128] = { 0.0f };
+	size_t count = _history.size() < 128 ? _history.size() : 128;
+	for (size_t i = 0; i < count; i++)
+	{
+		frameTimes[i] = float(_history[_history.size() - count + i].CpuTime);
+	}
+	ImGui::PlotLines("CPU Frame (ms)", frameTimes, int(count), 0, nullptr, 0.0f, _frameBudget * 2.0f, ImVec2(0.0f, 60.0f));
+
+	const ProfileFrame& frame = _lastFrame;
+	ImGui::Text("Frame %llu: %.3f ms CPU", (unsigned long long)frame.Index, frame.CpuTime);
+
+	ImGui::Columns(3, "ProfilerColumns");
+	ImGui::Text("Scope"); ImGui::NextColumn();
+	ImGui::Text("CPU (ms)"); ImGui::NextColumn();
+	ImGui::Text("GPU (ms)"); ImGui::NextColumn();
+	ImGui::Separator();
+
+	//Draws a scope and then its children
+	std::function<void(int)> drawSample = [&](int index) {
+		const ProfileSample& sample = frame.Samples[index];
+
+		bool hasChildren = index + 1 < int(frame.Samples.size()) && frame.Samples[index + 1].Parent == index;
+		ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_DefaultOpen;
+		if (!hasChildren)
+			flags |= ImGuiTreeNodeFlags_Leaf;
+
+		bool open = ImGui::TreeNodeEx((void*)(intptr_t)index, flags, "%s", sample.Name.c_str());
+		ImGui::NextColumn();
+
+		//Anything that blows the budget by itself gets flagged
+		ImVec4 color = ImVec4(1.0f, 1.0f, 1.0f, 1.0f);
+		ImVec4 overBudget = ImVec4(1.0f, 0.3f, 0.3f, 1.0f);
+		ImGui::TextColored(sample.CpuTime > _frameBudget ? overBudget : color, "%.3f", sample.CpuTime);
+		ImGui::NextColumn();
+		ImGui::TextColored(sample.GpuTime > _frameBudget ? overBudget : color, "%.3f", sample.GpuTime);
+		ImGui::NextColumn();
+
+		if (open)
+		{
+			for (int i = index + 1; i < int(frame.Samples.size()) && frame.Samples[i].Depth > sample.Depth; i++)
+			{
+				if (frame.Samples[i].Parent == index)
+					drawSample(i);
+			}
+			ImGui::TreePop();
+		}
+	};
+
+	for (int i = 0; i < int(frame.Samples.size()); i++)
+	{
+		if (frame.Samples[i].Parent == -1)
+			drawSample(i);
+	}
+
+	ImGui::Columns(1);
+}
+
+bool Profiler::ExportChromeTrace(const std::string& path)
+{
+	nlohmann::json events = nlohmann::json::array();
+
+	//Name the two tracks
+	events.push_back({ { "name", "thread_name" }, { "ph", "M" }, { "pid", 0 }, { "tid", 0 }, { "args", { { "name", "CPU" } } } });
+	events.push_back({ { "name", "thread_name" }, { "ph", "M" }, { "pid", 0 }, { "tid", 1 }, { "args", { { "name", "GPU" } } } });
+
+	for (const ProfileFrame& frame : _history)
+	{
+		for (const ProfileSample& sample : frame.Samples)
+		{
+			//Trace times are in microseconds
+			events.push_back({
+				{ "name", sample.Name }, { "cat", "CPU" }, { "ph", "X" }, { "pid", 0 }, { "tid", 0 },
+				{ "ts", (frame.Start + sample.CpuStart) * 1000.0 }, { "dur", sample.CpuTime * 1000.0 },
+				{ "args", { { "frame", frame.Index } } }
+			});
+			//GPU scopes are lined up with the start of the CPU frame that submitted them
+			events.push_back({
+				{ "name", sample.Name }, { "cat", "GPU" }, { "ph", "X" }, { "pid", 0 }, { "tid", 1 },
+				{ "ts", (frame.Start + sample.GpuStart) * 1000.0 }, { "dur", sample.GpuTime * 1000.0 },
+				{ "args", { { "frame", frame.Index } } }
+			});
+		}
+	}
+
+	std::ofstream file(path);
+	if (!file.is_open())
+	{
+		LOG_WARN("Could not open \"{}\" to write the profile trace", path);
+		return false;
+	}
+
+	file << nlohmann::json({ { "traceEvents", events }, { "displayTimeUnit", "ms" } }).dump();
+	LOG_INFO("Wrote {} frames of profiling data to \"{}\"", _history.size(), path);
+	return true;
+}
+
+const ProfileFrame& Profiler::GetLastFrame()
+{
+	return _lastFrame;
+}
+
+bool Profiler::GetEnabled()
+{
+	return _enabled;
+}
+
+void Profiler::SetEnabled(bool enabled)
+{
+	_enabled = enabled;
+}
+
+void Profiler::SetFrameBudget(float milliseconds)
+{
+	_frameBudget = milliseconds;
+}
+
+void Profiler::Shutdown()
+{
+	for (int i = 0; i < 2; i++)
+	{
+		if (!_queryPools[i].empty())
+		{
+			glDeleteQueries(GLsizei(_queryPools[i].size()), _queryPools[i].data());
+			_queryPools[i].clear();
+		}
+		_frames[i].Samples.clear();
+	}
+	_recording = false;
+}
+
+double Profiler::Now()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - _epoch).count();
+}
+
+void Profiler::Resolve(int frameIndex)
+{
+	ProfileFrame& frame = _frames[frameIndex];
+	if (frame.Samples.empty())
+		return;
+
+	//The first scope opened is the earliest timestamp in the frame
+	GLuint64 base = 0;
+	glGetQueryObjectui64v(frame.Samples[0].Queries[0], GL_QUERY_RESULT, &base);
+
+	for (ProfileSample& sample : frame.Samples)
+	{
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v(sample.Queries[0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(sample.Queries[1], GL_QUERY_RESULT, &end);
+
+		//Nanoseconds to milliseconds
+		sample.GpuStart = double(start - base) / 1000000.0;
+		sample.GpuTime = double(end - start) / 1000000.0;
+	}
+
+	_lastFrame = frame;
+	_history.push_back(frame);
+	if (_history.size() > _maxHistory)
+	{
+		_history.erase(_history.begin());
+	}
+
+	//So we don't resolve the same frame twice if the profiler gets toggled
+	frame.Samples.clear();
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include <glad/glad.h>
+
+//A single timed scope within a frame
+struct ProfileSample
+{
+	std::string Name;
+	//Index of the enclosing scope in the frame (-1 for top level scopes)
+	int Parent = -1;
+	int Depth = 0;
+	//Times are in milliseconds, CpuStart is relative to the start of the frame
+	double CpuStart = 0.0;
+	double CpuTime = 0.0;
+	double GpuStart = 0.0;
+	double GpuTime = 0.0;
+	//Timestamp queries for the start and end of the scope
+	GLuint Queries[2] = { GL_NONE, GL_NONE };
+};
+
+//All the scopes recorded in one frame
+struct ProfileFrame
+{
+	uint64_t Index = 0;
+	//Start of the frame in milliseconds since the profiler started
+	double Start = 0.0;
+	double CpuTime = 0.0;
+	std::vector<ProfileSample> Samples;
+};
+
+class Profiler abstract
+{
+public:
+	//Starts recording a new frame
+	//*Resolves the GPU timers from two frames ago, which have had a whole frame to come back
+	static void BeginFrame();
+	//Finishes recording the current frame
+	static void EndFrame();
+
+	//Opens and closes a timed scope, scopes nest inside whatever scope is currently open
+	static void Push(const std::string& name);
+	static void Pop();
+
+	//Draws the last resolved frame as a tree, along with the frame time history
+	static void RenderImGui();
+
+	//Writes the recorded history to a Chrome trace (chrome://tracing or ui.perfetto.dev)
+	static bool ExportChromeTrace(const std::string& path);
+
+	//Getters
+	static const ProfileFrame& GetLastFrame();
+	static bool GetEnabled();
+
+	//Setters
+	static void SetEnabled(bool enabled);
+	//Sets the frame budget in ms, scopes over budget get highlighted in the UI
+	static void SetFrameBudget(float milliseconds);
+
+	//Deletes all the query objects
+	static void Shutdown();
+
+private:
+	//Double buffered frames, we write one while the other's GPU results come back
+	static ProfileFrame _frames[2];
+	static std::vector<GLuint> _queryPools[2];
+	static int _current;
+	static bool _recording;
+
+	//Indices of the open scopes
+	static std::vector<int> _stack;
+
+	//Frames that have been fully resolved
+	static ProfileFrame _lastFrame;
+	static std::vector<ProfileFrame> _history;
+	static const size_t _maxHistory = 600;
+
+	static uint64_t _frameCount;
+	static float _frameBudget;
+	static bool _enabled;
+
+	static std::chrono::high_resolution_clock::time_point _epoch;
+
+	static double Now();
+	static void Resolve(int frame);
+};
+
+//Times everything until it goes out of scope
+struct ProfileScope
+{
+	ProfileScope(const std::string& name) { Profiler::Push(name); }
+	~ProfileScope() { Profiler::Pop(); }
+};
@@ -0,0 +1,352 @@
+#include "SceneBenchmarks.h"
+
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include <Logging.h>
+#include <Scene.h>
+#include <GameObjectTag.h>
+#include <Transform.h>
+#include <RendererComponent.h>
+#include <IndexPacking.h>
+#include <ObjLoader.h>
+
+namespace
+{
+	double ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//Triangles come back in the same place, but can start from a different corner
+	bool SameTriangles(const std::vector<uint32_t>& expected, const std::vector<uint32_t>& actual)
+	{
+		if (expected.size() != actual.size())
+			return false;
+		for (size_t i = 0; i + 2 < expected.size(); i += 3)
+		{
+			bool match = false;
+			for (int rotation = 0; rotation < 3 && !match; rotation++)
+			{
+				match = actual[i] == expected[i + rotation] && actual[i + 1] == expected[i + (rotation + 1) % 3] && actual[i + 2] == expected[i + (rotation + 2) % 3];
+			}
+			if (!match)
+				return false;
+		}
+		return true;
+	}
+
+	//How FindFirst used to work, checking every tag in the scene
+	entt::entity FindFirstLinear(entt::registry& registry, const std::string& name)
+	{
+		uint32_t hash = entt::hashed_string::value(name.c_str());
+		for (entt::entity entity : registry.view<GameObjectTag>())
+		{
+			const GameObjectTag& tag = registry.get<GameObjectTag>(entity);
+			if (tag.HashedName == hash && tag.Name == name)
+				return entity;
+		}
+		return entt::null;
+	}
+}
+
+bool SceneBenchmarks::RunNameLookup(size_t entityCount)
+{
+	//Every name is used by 4 entities, so FindAll has something to find
+	const size_t nameCount = std::max<size_t>(entityCount / 4, 1);
+	GameScene::sptr scene = GameScene::Create("Name Lookup Benchmark");
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < entityCount; i++)
+	{
+		scene->CreateEntity("Entity " + std::to_string(i % nameCount));
+	}
+	double create = ElapsedMs(start);
+
+	//Names picked up front so making the strings isn't timed
+	std::mt19937 random(42);
+	std::uniform_int_distribution<size_t> pick(0, nameCount - 1);
+	std::vector<std::string> names(100000);
+	for (std::string& name : names)
+	{
+		name = "Entity " + std::to_string(pick(random));
+	}
+
+	size_t found = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for (const std::string& name : names)
+	{
+		found += scene->FindFirst(name).entity() != entt::null ? 1 : 0;
+	}
+	double indexed = ElapsedMs(start) / names.size();
+
+	//The scan is slow enough that a handful of lookups gives a good average
+	const size_t linearLookups = 50;
+	size_t linearFound = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < linearLookups; i++)
+	{
+		linearFound += FindFirstLinear(scene->Registry(), names[i]) != entt::null ? 1 : 0;
+	}
+	double linear = ElapsedMs(start) / linearLookups;
+
+	start = std::chrono::high_resolution_clock::now();
+	size_t all = 0;
+	for (size_t i = 0; i < 10000; i++)
+	{
+		all += scene->FindAll(names[i]).size();
+	}
+	double findAll = ElapsedMs(start) / 10000;
+
+	//The index has to follow entities being renamed and removed
+	bool ok = found == names.size() && linearFound == linearLookups && (entityCount < nameCount * 4 || all == 40000);
+	if (entityCount >= 8)
+	{
+		const std::string name = "Entity 1";
+		std::vector<entt::handle> matches = scene->FindAll(name);
+		ok = ok && !matches.empty() && scene->FindFirst(name) == matches[0];
+
+		scene->Registry().destroy(matches[0]);
+		ok = ok && scene->FindAll(name).size() == matches.size() - 1;
+		ok = ok && (matches.size() == 1 || scene->FindFirst(name) == matches[1]);
+
+		GameObject renamed = scene->FindFirst("Entity 2");
+		scene->SetName(renamed, "Renamed");
+		ok = ok && scene->FindFirst("Renamed") == renamed && !(scene->FindFirst("Entity 2") == renamed);
+
+		scene->Registry().patch<GameObjectTag>(renamed, [](GameObjectTag& tag) { tag = GameObjectTag("Patched"); });
+		ok = ok && scene->FindFirst("Patched") == renamed && scene->FindFirst("Renamed").entity() == entt::null;
+		ok = ok && scene->FindFirst("Not In The Scene").entity() == entt::null;
+	}
+
+	LOG_INFO("Name lookup ({} entities): created in {:.1f} ms, FindFirst {:.3f} us indexed vs {:.3f} us scanning ({:.0f}x), FindAll {:.3f} us",
+		entityCount, create, indexed * 1000.0, linear * 1000.0, linear / std::max(indexed, 1e-9), findAll * 1000.0);
+	if (!ok)
+	{
+		LOG_ERROR("Name index doesn't match the scene");
+	}
+	return ok;
+}
+
+bool SceneBenchmarks::RunPrefabInstancing(size_t instanceCount)
+{
+	GameScene::RegisterComponentType<RendererComponent>();
+
+	//A prop like the ones the environment generator scatters around
+	entt::registry& prefabs = GameScene::Prefabs();
+	entt::entity prefab = prefabs.create();
+	prefabs.emplace<Transform>(prefab, entt::handle(prefabs, prefab)).SetLocalScale(glm::vec3(2.0f)).SetLocalRotation(0.0f, 0.0f, 45.0f);
+	prefabs.emplace<GameObjectTag>(prefab, "Prop");
+	ShaderMaterial::sptr material = ShaderMaterial::Create();
+	prefabs.emplace<RendererComponent>(prefab).SetMaterial(material);
+
+	std::vector<glm::vec3> positions(instanceCount);
+	for (size_t i = 0; i < instanceCount; i++)
+	{
+		positions[i] = glm::vec3(float(i % 1000), float(i / 1000), 0.0f);
+	}
+
+	double single = 0.0;
+	{
+		GameScene::sptr scene = GameScene::Create("Prefab Benchmark");
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < instanceCount; i++)
+		{
+			scene->CreateEntity(prefab).get<Transform>().SetLocalPosition(positions[i]);
+		}
+		single = ElapsedMs(start);
+	}
+
+	GameScene::sptr scene = GameScene::Create("Prefab Benchmark");
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<entt::entity> instances = scene->CreateEntities(prefab, instanceCount, positions.data());
+	double bulk = ElapsedMs(start);
+
+	//Every instance needs its own transform pointing back at its own entity, and a copy of everything else
+	entt::registry& registry = scene->Registry();
+	bool ok = instances.size() == instanceCount && registry.size<Transform>() == instanceCount &&
+		registry.size<RendererComponent>() == instanceCount && scene->FindAll("Prop").size() == instanceCount;
+	for (size_t i = 0; ok && i < instanceCount; i++)
+	{
+		const Transform& transform = registry.get<Transform>(instances[i]);
+		ok = transform.GetLocalPosition() == positions[i] && transform.GetLocalScale() == glm::vec3(2.0f) &&
+			transform.GetLocalRotation() == glm::vec3(0.0f, 0.0f, 45.0f) && registry.get<RendererComponent>(instances[i]).Material == material;
+	}
+	if (ok && instanceCount > 1)
+	{
+		//Parenting only works if the transform's handle is in this scene and not the prefab registry
+		registry.get<Transform>(instances[1]).SetParent(entt::handle(registry, instances[0]));
+		ok = registry.get<Transform>(instances[1]).GetHierarchyDepth() == 1;
+	}
+	prefabs.destroy(prefab);
+
+	LOG_INFO("Prefab instancing ({} instances): CreateEntities {:.1f} ms, CreateEntity loop {:.1f} ms ({:.1f}x)",
+		instanceCount, bulk, single, single / std::max(bulk, 1e-9));
+	if (!ok)
+	{
+		LOG_ERROR("Prefab instances don't match the prefab");
+	}
+	return ok;
+}
+
+bool SceneBenchmarks::RunBulkRemoval(size_t entityCount)
+{
+	GameScene::RegisterComponentType<RendererComponent>();
+	entt::registry& prefabs = GameScene::Prefabs();
+	entt::entity prefab = prefabs.create();
+	prefabs.emplace<Transform>(prefab, entt::handle(prefabs, prefab));
+	prefabs.emplace<GameObjectTag>(prefab, "Prop");
+	prefabs.emplace<RendererComponent>(prefab).SetMaterial(ShaderMaterial::Create());
+
+	//Half the entities, in a random order like gameplay would remove them
+	std::vector<size_t> order(entityCount);
+	for (size_t i = 0; i < entityCount; i++)
+	{
+		order[i] = i;
+	}
+	std::shuffle(order.begin(), order.end(), std::mt19937(7));
+	order.resize(entityCount / 2);
+
+	double single = 0.0;
+	{
+		GameScene::sptr scene = GameScene::Create("Removal Benchmark");
+		std::vector<entt::entity> entities = scene->CreateEntities(prefab, entityCount);
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i : order)
+		{
+			scene->Registry().destroy(entities[i]);
+		}
+		single = ElapsedMs(start);
+	}
+
+	GameScene::sptr scene = GameScene::Create("Removal Benchmark");
+	entt::registry& registry = scene->Registry();
+	std::vector<entt::entity> entities = scene->CreateEntities(prefab, entityCount);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t i : order)
+	{
+		scene->RemoveEntity(entt::handle(registry, entities[i]));
+	}
+	scene->Poll();
+	double queued = ElapsedMs(start);
+
+	const size_t remaining = entityCount - order.size();
+	bool ok = registry.alive() == remaining && registry.size<Transform>() == remaining &&
+		registry.size<RendererComponent>() == remaining && scene->FindAll("Prop").size() == remaining;
+
+	//A handle to a removed entity has to stay invalid after its id gets reused
+	if (!order.empty())
+	{
+		entt::handle stale = entt::handle(registry, entities[order[0]]);
+		GameObject reused = scene->CreateEntity("Reused");
+		ok = ok && !scene->IsValid(stale) && scene->IsValid(reused);
+		scene->RemoveEntity(stale);
+		scene->Poll();
+		ok = ok && scene->IsValid(reused) && scene->FindFirst("Reused") == reused;
+
+		//Removing twice before a Poll is fine too
+		scene->RemoveEntity(reused);
+		scene->RemoveEntity(reused);
+		scene->Poll();
+		ok = ok && !scene->IsValid(reused);
+	}
+
+	//Clearing everything out should hand the pool memory back
+	start = std::chrono::high_resolution_clock::now();
+	for (entt::entity entity : entities)
+	{
+		scene->RemoveEntity(entt::handle(registry, entity));
+	}
+	scene->Poll();
+	double clear = ElapsedMs(start);
+	ok = ok && registry.alive() == 0 && registry.capacity<Transform>() == 0 && registry.capacity<GameObjectTag>() == 0 &&
+		scene->FindAll("Prop").empty();
+	prefabs.destroy(prefab);
+
+	LOG_INFO("Removal ({} of {} entities): queued and polled {:.1f} ms, destroyed one at a time {:.1f} ms ({:.1f}x), clearing the rest {:.1f} ms",
+		order.size(), entityCount, queued, single, single / std::max(queued, 1e-9), clear);
+	if (!ok)
+	{
+		LOG_ERROR("Scene doesn't match after removing entities");
+	}
+	return ok;
+}
+
+bool SceneBenchmarks::RunIndexPacking(const std::vector<std::string>& files)
+{
+	bool passed = true;
+	size_t totalIndices = 0, totalEncoded = 0;
+	for (const std::string& file : files)
+	{
+		MeshBuilder<VertexPosNormTexCol> mesh;
+		try
+		{
+			mesh = ObjLoader::ParseFile(file);
+		}
+		catch (const std::exception&)
+		{
+			LOG_WARN("Index packing benchmark: couldn't open {}", file);
+			continue;
+		}
+		const size_t vertexCount = mesh.GetVertexCount();
+		std::vector<uint32_t> indices(mesh.GetIndexDataPtr(), mesh.GetIndexDataPtr() + mesh.GetIndexCount());
+
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<uint8_t> encoded = IndexPacking::Encode(indices.data(), indices.size());
+		double encodeTime = ElapsedMs(start);
+		start = std::chrono::high_resolution_clock::now();
+		std::vector<uint32_t> decoded;
+		bool decodedAll = IndexPacking::Decode(encoded.data(), encoded.size(), indices.size(), vertexCount, decoded);
+		double decodeTime = ElapsedMs(start);
+		if (!decodedAll || !SameTriangles(indices, decoded))
+		{
+			LOG_ERROR("Index packing benchmark failed: {} didn't decode to the same triangles", file);
+			passed = false;
+		}
+
+		//Splitting far below 16 bits, so even the small models end up in a few pieces
+		std::vector<uint32_t> sources;
+		std::vector<uint16_t> local;
+		std::vector<VertexArrayObject::SubMesh> subMeshes;
+		const size_t limit = std::max<size_t>(vertexCount / 4, 64);
+		start = std::chrono::high_resolution_clock::now();
+		IndexPacking::Split(indices, vertexCount, sources, local, subMeshes, limit);
+		double splitTime = ElapsedMs(start);
+		std::vector<uint32_t> rebuilt;
+		rebuilt.reserve(indices.size());
+		for (const VertexArrayObject::SubMesh& subMesh : subMeshes)
+		{
+			size_t used = 0;
+			for (GLsizei i = 0; i < subMesh.IndexCount; i++)
+			{
+				uint32_t slot = subMesh.BaseVertex + local[subMesh.FirstIndex + i];
+				used = std::max<size_t>(used, local[subMesh.FirstIndex + i] + 1);
+				rebuilt.push_back(slot < sources.size() ? sources[slot] : UINT32_MAX);
+			}
+			if (used > limit)
+			{
+				LOG_ERROR("Index packing benchmark failed: a sub-mesh of {} uses {} vertices, over the limit of {}", file, used, limit);
+				passed = false;
+			}
+		}
+		if (rebuilt != indices)
+		{
+			LOG_ERROR("Index packing benchmark failed: {} came out of splitting with different triangles", file);
+			passed = false;
+		}
+
+		totalIndices += indices.size();
+		totalEncoded += encoded.size();
+		LOG_INFO("{}: {} indices, {} KB as 32 bit, {} KB as 16 bit, {:.1f} KB encoded ({:.2f} bytes each), {:.2f} ms to encode, {:.2f} ms to decode",
+			file, indices.size(), indices.size() * 4 / 1024, indices.size() * 2 / 1024, encoded.size() / 1024.0, double(encoded.size()) / std::max<size_t>(indices.size(), 1), encodeTime, decodeTime);
+		LOG_INFO("  Split into {} sub-meshes of at most {} vertices in {:.2f} ms, {} vertices after copying the shared ones",
+			subMeshes.size(), limit, splitTime, sources.size());
+	}
+
+	LOG_INFO("{} indices: {} KB as 32 bit -> {} KB as 16 bit -> {:.1f} KB encoded", totalIndices, totalIndices * 4 / 1024, totalIndices * 2 / 1024, totalEncoded / 1024.0);
+	if (passed)
+		LOG_INFO("Index packing benchmark passed");
+	return passed;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//Benchmarks and checks for GameScene and the meshes it loads, run from the debug window
+//*They build their own scenes and meshes, so the active scene is never touched
+class SceneBenchmarks abstract
+{
+public:
+	//Times FindFirst against the old linear scan over every tag, checks FindAll/SetName/removal and logs the results
+	static bool RunNameLookup(size_t entityCount = 1000000);
+	//Times CreateEntities against stamping a prefab one CreateEntity at a time, checks the instances and logs the results
+	static bool RunPrefabInstancing(size_t instanceCount = 1000000);
+	//Times queued removal against destroying entities one at a time, checks stale handles and pool compaction and logs the results
+	static bool RunBulkRemoval(size_t entityCount = 1000000);
+	//Compresses and splits the indices of the OBJ files given with IndexPacking, checks every triangle comes back and
+	//*logs the sizes and timings
+	static bool RunIndexPacking(const std::vector<std::string>& files);
+};
@@ -0,0 +1,1004 @@
+#include "SceneSerializer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <Logging.h>
+#include <Transform.h>
+#include <GameObjectTag.h>
+#include <RendererComponent.h>
+#include <Camera.h>
+#include <ObjLoader.h>
+#include <MeshFile.h>
+#include <CameraControlBehaviour.h>
+#include <FollowPathBehaviour.h>
+#include <SimpleMoveBehaviour.h>
+#include <GLM/gtc/quaternion.hpp>
+#include <CerealGLM.h>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+
+AssetCache<VertexArrayObject> SceneSerializer::_meshes;
+AssetCache<ShaderMaterial> SceneSerializer::_materials;
+AssetCache<Texture2D> SceneSerializer::_textures;
+std::unordered_map<std::type_index, SceneSerializer::BehaviourType> SceneSerializer::_behaviourTypes;
+SceneIOStats SceneSerializer::_lastStats;
+VertexCompression SceneSerializer::_meshCompression = VertexCompression::Packed;
+
+namespace
+{
+	//Bumped whenever the layout changes, older files get refused instead of misread
+	const uint32_t SceneVersion = 1;
+	//Components refer to entities by their position in the file, this means no entity
+	const uint32_t NoEntity = 0xFFFFFFFF;
+
+	double ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//Meshes that aren't registered can still be loaded if the name is the path to an .obj
+	bool IsObjFile(const std::string& path)
+	{
+		std::error_code error;
+		return std::filesystem::path(path).extension() == ".obj" && std::filesystem::exists(path, error);
+	}
+
+	//Where an .obj's baked mesh goes
+	std::string BakedMeshPath(const std::string& path)
+	{
+		return std::filesystem::path(path).replace_extension(".mesh").generic_string();
+	}
+
+	struct TransformData
+	{
+		glm::vec3 Position = glm::vec3(0.0f);
+		//Euler degrees, the same thing the setters take
+		glm::vec3 Rotation = glm::vec3(0.0f);
+		glm::vec3 Scale = glm::vec3(1.0f);
+		uint32_t Parent = NoEntity;
+
+		template <typename Archive>
+		void serialize(Archive& archive)
+		{
+			archive(cereal::make_nvp("Position", Position), cereal::make_nvp("Rotation", Rotation),
+				cereal::make_nvp("Scale", Scale), cereal::make_nvp("Parent", Parent));
+		}
+	};
+
+	//Indices into the file's mesh and material names
+	struct RendererData
+	{
+		uint32_t Mesh = 0;
+		uint32_t Material = 0;
+
+		template <typename Archive>
+		void serialize(Archive& archive)
+		{
+			archive(cereal::make_nvp("Mesh", Mesh), cereal::make_nvp("Material", Material));
+		}
+	};
+
+	struct CameraData
+	{
+		bool IsOrtho = false;
+		float OrthoHeight = 1.0f;
+		float NearPlane = 0.1f;
+		float FarPlane = 1000.0f;
+		float FovDegrees = 90.0f;
+		glm::vec3 Position = glm::vec3(0.0f);
+		glm::vec3 Forward = glm::vec3(0.0f, 0.0f, 1.0f);
+		glm::vec3 Up = glm::vec3(0.0f, 1.0f, 0.0f);
+
+		template <typename Archive>
+		void serialize(Archive& archive)
+		{
+			archive(cereal::make_nvp("IsOrtho", IsOrtho), cereal::make_nvp("OrthoHeight", OrthoHeight),
+				cereal::make_nvp("NearPlane", NearPlane), cereal::make_nvp("FarPlane", FarPlane),
+				cereal::make_nvp("FovDegrees", FovDegrees), cereal::make_nvp("Position", Position),
+				cereal::make_nvp("Forward", Forward), cereal::make_nvp("Up", Up));
+		}
+	};
+
+	//Every behaviour of one type, the payloads go through the type's own serialize
+	template <typename Archive>
+	struct BehaviourColumn
+	{
+		std::string Type;
+		std::vector<uint32_t> Owners;
+		std::vector<uint8_t> Enabled;
+		std::vector<std::shared_ptr<IBehaviour>> Behaviours;
+		std::function<void(Archive&, IBehaviour&)> Serialize;
+		//Makes a behaviour to load into from the type name, and picks the function that reads it
+		//*Set while loading, since the type is only known once its column is read (per thread, so workers can read at once)
+		static inline thread_local std::function<std::shared_ptr<IBehaviour>(const std::string&, std::function<void(Archive&, IBehaviour&)>&)> Resolve;
+
+		//Writes the payloads as an array, so they line up with the owners
+		struct Payloads
+		{
+			BehaviourColumn* Column;
+
+			template <typename A>
+			void save(A& archive) const
+			{
+				archive(cereal::make_size_tag(cereal::size_type(Column->Behaviours.size())));
+				for (const std::shared_ptr<IBehaviour>& behaviour : Column->Behaviours)
+				{
+					Column->Serialize(archive, *behaviour);
+				}
+			}
+
+			template <typename A>
+			void load(A& archive)
+			{
+				cereal::size_type count = 0;
+				archive(cereal::make_size_tag(count));
+				Column->Behaviours.resize(size_t(count));
+				for (std::shared_ptr<IBehaviour>& behaviour : Column->Behaviours)
+				{
+					behaviour = Column->Resolve(Column->Type, Column->Serialize);
+					if (behaviour == nullptr)
+						throw cereal::Exception("Behaviour type " + Column->Type + " isn't registered");
+					Column->Serialize(archive, *behaviour);
+				}
+			}
+		};
+
+		template <typename A>
+		void save(A& archive) const
+		{
+			Payloads payloads = { const_cast<BehaviourColumn*>(this) };
+			archive(cereal::make_nvp("Type", Type), cereal::make_nvp("Owners", Owners),
+				cereal::make_nvp("Enabled", Enabled), cereal::make_nvp("Data", payloads));
+		}
+
+		template <typename A>
+		void load(A& archive)
+		{
+			Payloads payloads = { this };
+			archive(cereal::make_nvp("Type", Type), cereal::make_nvp("Owners", Owners),
+				cereal::make_nvp("Enabled", Enabled), cereal::make_nvp("Data", payloads));
+		}
+	};
+
+	//A behaviour column once it's been read, it no longer needs the archive
+	struct BehaviourData
+	{
+		std::vector<uint32_t> Owners;
+		std::vector<uint8_t> Enabled;
+		std::vector<std::shared_ptr<IBehaviour>> Behaviours;
+	};
+}
+
+//Everything in a scene file, laid out the way it was read
+struct SceneChunk::Columns
+{
+	std::vector<std::string> MeshNames;
+	std::vector<std::string> MaterialNames;
+	std::vector<uint32_t> TransformOwners, TagOwners, RendererOwners, CameraOwners;
+	std::vector<TransformData> Transforms;
+	std::vector<std::string> Tags;
+	std::vector<RendererData> Renderers;
+	std::vector<CameraData> Cameras;
+	std::vector<BehaviourData> Behaviours;
+	//Parallel to MeshNames, the meshes that weren't loaded yet when the chunk was read
+	std::vector<std::shared_ptr<MeshBuilder<VertexPosNormTexCol>>> ParsedMeshes;
+};
+
+bool SceneSerializer::Save(const GameScene::sptr& scene, const std::string& path, SceneFormat format)
+{
+	return Write(*scene, nullptr, path, format);
+}
+
+bool SceneSerializer::Save(const GameScene::sptr& scene, const std::vector<entt::entity>& entities, const std::string& path, SceneFormat format)
+{
+	return Write(*scene, &entities, path, format);
+}
+
+bool SceneSerializer::Write(GameScene& scene, const std::vector<entt::entity>* entities, const std::string& path, SceneFormat format)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	_lastStats = SceneIOStats();
+	RegisterDefaultBehaviours();
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		LOG_ERROR("Could not open {} to save the scene", path);
+		return false;
+	}
+
+	//The archives only finish writing when they're destroyed, so they get their own scope
+	if (format == SceneFormat::Binary)
+	{
+		cereal::BinaryOutputArchive archive(file);
+		SaveScene(archive, scene, entities);
+	}
+	else
+	{
+		cereal::JSONOutputArchive archive(file);
+		SaveScene(archive, scene, entities);
+	}
+
+	_lastStats.ArchiveTime = _lastStats.TotalTime = ElapsedMs(start);
+	return file.good();
+}
+
+bool SceneSerializer::Load(const GameScene::sptr& scene, const std::string& path, SceneFormat format)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	_lastStats = SceneIOStats();
+
+	SceneChunk::sptr chunk = Read(path, format);
+	if (chunk == nullptr)
+		return false;
+
+	_lastStats.ArchiveTime = chunk->GetReadTime();
+	Restore(scene, *chunk, &_lastStats);
+	_lastStats.TotalTime = ElapsedMs(start);
+	return true;
+}
+
+SceneChunk::sptr SceneSerializer::Read(const std::string& path, SceneFormat format)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	RegisterDefaultBehaviours();
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		LOG_ERROR("Could not open {} to load a scene from", path);
+		return nullptr;
+	}
+
+	SceneChunk::sptr chunk = std::make_shared<SceneChunk>();
+	chunk->_columns = std::make_shared<SceneChunk::Columns>();
+	try
+	{
+		if (format == SceneFormat::Binary)
+		{
+			cereal::BinaryInputArchive archive(file);
+			ReadScene(archive, *chunk);
+		}
+		else
+		{
+			cereal::JSONInputArchive archive(file);
+			ReadScene(archive, *chunk);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		LOG_ERROR("Failed to load scene {}: {}", path, e.what());
+		return nullptr;
+	}
+	std::error_code error;
+	chunk->_fileSize = size_t(std::filesystem::file_size(path, error));
+
+	//Meshes that aren't loaded yet get parsed here, so restoring only has to upload them
+	SceneChunk::Columns& columns = *chunk->_columns;
+	columns.ParsedMeshes.resize(columns.MeshNames.size());
+	for (size_t i = 0; i < columns.MeshNames.size(); i++)
+	{
+		const std::string& name = columns.MeshNames[i];
+		if (!IsObjFile(name) || _meshes.Find(name) != nullptr)
+			continue;
+		try
+		{
+			columns.ParsedMeshes[i] = std::make_shared<MeshBuilder<VertexPosNormTexCol>>(ParseMesh(name));
+		}
+		catch (const std::exception& e)
+		{
+			LOG_WARN("Could not read mesh {}: {}", name, e.what());
+		}
+	}
+
+	chunk->_readTime = ElapsedMs(start);
+	return chunk;
+}
+
+template <typename Archive>
+void SceneSerializer::SaveScene(Archive& archive, GameScene& scene, const std::vector<entt::entity>* subset)
+{
+	entt::registry& registry = scene.Registry();
+
+	//Give every saved entity a slot in the file, in the order they were made (each goes newest first)
+	std::vector<entt::entity> entities;
+	if (subset != nullptr)
+	{
+		entities = *subset;
+	}
+	else
+	{
+		entities.reserve(registry.alive());
+		registry.each([&](entt::entity entity) {
+			entities.push_back(entity);
+		});
+		std::reverse(entities.begin(), entities.end());
+	}
+	std::unordered_map<entt::entity, uint32_t> slots;
+	slots.reserve(entities.size());
+	for (size_t i = 0; i < entities.size(); i++)
+	{
+		slots[entities[i]] = uint32_t(i);
+	}
+	_lastStats.Entities = entities.size();
+
+	//Components of entities that aren't being saved get skipped, and so do links to them
+	auto slotOf = [&slots](entt::entity entity) {
+		auto slot = slots.find(entity);
+		return slot == slots.end() ? NoEntity : slot->second;
+	};
+	//Calls function with every entity that has a T and its T, when saving a subset only its entities are
+	//*checked, so writing a few entities out of a big scene doesn't walk every pool
+	auto each = [&](auto* type, auto function) {
+		using T = std::remove_pointer_t<decltype(type)>;
+		if (subset != nullptr)
+		{
+			for (entt::entity entity : entities)
+			{
+				T* component = registry.try_get<T>(entity);
+				if (component != nullptr)
+					function(entity, *component);
+			}
+		}
+		else
+		{
+			registry.view<T>().each(function);
+		}
+	};
+
+	std::vector<uint32_t> transformOwners;
+	std::vector<TransformData> transforms;
+	each((Transform*)nullptr, [&](entt::entity entity, Transform& transform) {
+		uint32_t slot = slotOf(entity);
+		if (slot == NoEntity)
+			return;
+
+		TransformData data;
+		data.Position = transform.GetLocalPosition();
+		data.Rotation = transform.GetLocalRotation();
+		data.Scale = transform.GetLocalScale();
+		data.Parent = slotOf(transform.GetParent());
+		transformOwners.push_back(slot);
+		transforms.push_back(data);
+	});
+
+	std::vector<uint32_t> tagOwners;
+	std::vector<std::string> tags;
+	each((GameObjectTag*)nullptr, [&](entt::entity entity, GameObjectTag& tag) {
+		uint32_t slot = slotOf(entity);
+		if (slot == NoEntity)
+			return;
+		tagOwners.push_back(slot);
+		tags.push_back(tag.Name);
+	});
+
+	//Assets are written once each as names, renderers just hold indices into them
+	std::vector<std::string> meshNames, materialNames;
+	std::unordered_map<const VertexArrayObject*, uint32_t> meshSlots;
+	std::unordered_map<const ShaderMaterial*, uint32_t> materialSlots;
+	std::vector<uint32_t> rendererOwners;
+	std::vector<RendererData> renderers;
+	each((RendererComponent*)nullptr, [&](entt::entity entity, RendererComponent& renderer) {
+		uint32_t slot = slotOf(entity);
+		if (slot == NoEntity)
+			return;
+
+		//Names only get looked up the first time an asset comes up
+		auto mesh = meshSlots.find(renderer.Mesh.get());
+		if (mesh == meshSlots.end())
+		{
+			std::string name = _meshes.NameOf(renderer.Mesh.get());
+			if (name.empty())
+			{
+				_lastStats.MissingAssets++;
+				return;
+			}
+			mesh = meshSlots.emplace(renderer.Mesh.get(), uint32_t(meshNames.size())).first;
+			meshNames.push_back(name);
+		}
+		auto material = materialSlots.find(renderer.Material.get());
+		if (material == materialSlots.end())
+		{
+			std::string name = _materials.NameOf(renderer.Material.get());
+			if (name.empty())
+			{
+				_lastStats.MissingAssets++;
+				return;
+			}
+			material = materialSlots.emplace(renderer.Material.get(), uint32_t(materialNames.size())).first;
+			materialNames.push_back(name);
+		}
+
+		RendererData data;
+		data.Mesh = mesh->second;
+		data.Material = material->second;
+		rendererOwners.push_back(slot);
+		renderers.push_back(data);
+	});
+	if (_lastStats.MissingAssets > 0)
+	{
+		LOG_WARN("{} renderers use a mesh or material that isn't registered, they won't be saved", _lastStats.MissingAssets);
+	}
+
+	std::vector<uint32_t> cameraOwners;
+	std::vector<CameraData> cameras;
+	each((Camera*)nullptr, [&](entt::entity entity, Camera& camera) {
+		uint32_t slot = slotOf(entity);
+		if (slot == NoEntity)
+			return;
+
+		CameraData data;
+		data.IsOrtho = camera.GetIsOrtho();
+		data.OrthoHeight = camera.GetOrthoHeight();
+		data.NearPlane = camera.GetNearPlane();
+		data.FarPlane = camera.GetFarPlane();
+		data.FovDegrees = camera.GetFovDegrees();
+		data.Position = camera.GetPosition();
+		data.Forward = camera.GetForward();
+		data.Up = camera.GetUp();
+		cameraOwners.push_back(slot);
+		cameras.push_back(data);
+	});
+
+	//One column per behaviour type, anything that isn't registered gets left out
+	std::vector<BehaviourColumn<Archive>> behaviours;
+	std::unordered_map<std::type_index, size_t> behaviourSlots;
+	size_t unregistered = 0;
+	each((BehaviourBinding*)nullptr, [&](entt::entity entity, BehaviourBinding& binding) {
+		uint32_t owner = slotOf(entity);
+		if (owner == NoEntity)
+			return;
+
+		for (const std::shared_ptr<IBehaviour>& behaviour : binding.Behaviours)
+		{
+			std::type_index type = std::type_index(typeid(*behaviour));
+			auto slot = behaviourSlots.find(type);
+			if (slot == behaviourSlots.end())
+			{
+				auto registered = _behaviourTypes.find(type);
+				if (registered == _behaviourTypes.end())
+				{
+					unregistered++;
+					continue;
+				}
+
+				BehaviourColumn<Archive> column;
+				column.Type = registered->second.Name;
+				if constexpr (std::is_same_v<Archive, cereal::BinaryOutputArchive>)
+					column.Serialize = registered->second.SaveBinary;
+				else
+					column.Serialize = registered->second.SaveJson;
+				slot = behaviourSlots.emplace(type, behaviours.size()).first;
+				behaviours.push_back(column);
+			}
+
+			BehaviourColumn<Archive>& column = behaviours[slot->second];
+			column.Owners.push_back(owner);
+			column.Enabled.push_back(behaviour->Enabled ? 1 : 0);
+			column.Behaviours.push_back(behaviour);
+		}
+	});
+	if (unregistered > 0)
+	{
+		LOG_WARN("{} behaviours aren't registered with the scene serializer, they won't be saved", unregistered);
+	}
+
+	archive(cereal::make_nvp("Version", SceneVersion), cereal::make_nvp("Name", scene.Name),
+		cereal::make_nvp("EntityCount", uint32_t(entities.size())),
+		cereal::make_nvp("Meshes", meshNames), cereal::make_nvp("Materials", materialNames),
+		cereal::make_nvp("TransformOwners", transformOwners), cereal::make_nvp("Transforms", transforms),
+		cereal::make_nvp("TagOwners", tagOwners), cereal::make_nvp("Tags", tags),
+		cereal::make_nvp("RendererOwners", rendererOwners), cereal::make_nvp("Renderers", renderers),
+		cereal::make_nvp("CameraOwners", cameraOwners), cereal::make_nvp("Cameras", cameras),
+		cereal::make_nvp("Behaviours", behaviours));
+}
+
+template <typename Archive>
+void SceneSerializer::ReadScene(Archive& archive, SceneChunk& chunk)
+{
+	uint32_t version = 0;
+	archive(cereal::make_nvp("Version", version));
+	if (version != SceneVersion)
+		throw cereal::Exception("Scene version " + std::to_string(version) + " isn't supported");
+
+	SceneChunk::Columns& columns = *chunk._columns;
+	std::vector<BehaviourColumn<Archive>> behaviours;
+
+	archive(cereal::make_nvp("Name", chunk._name), cereal::make_nvp("EntityCount", chunk._entityCount),
+		cereal::make_nvp("Meshes", columns.MeshNames), cereal::make_nvp("Materials", columns.MaterialNames),
+		cereal::make_nvp("TransformOwners", columns.TransformOwners), cereal::make_nvp("Transforms", columns.Transforms),
+		cereal::make_nvp("TagOwners", columns.TagOwners), cereal::make_nvp("Tags", columns.Tags),
+		cereal::make_nvp("RendererOwners", columns.RendererOwners), cereal::make_nvp("Renderers", columns.Renderers),
+		cereal::make_nvp("CameraOwners", columns.CameraOwners), cereal::make_nvp("Cameras", columns.Cameras));
+
+	//Behaviour payloads can only be read once their type is known, so the column looks it up as it goes
+	BehaviourColumn<Archive>::Resolve = [](const std::string& type, std::function<void(Archive&, IBehaviour&)>& serialize) -> std::shared_ptr<IBehaviour> {
+		for (const auto& [index, registered] : _behaviourTypes)
+		{
+			if (registered.Name != type)
+				continue;
+			if constexpr (std::is_same_v<Archive, cereal::BinaryInputArchive>)
+				serialize = registered.LoadBinary;
+			else
+				serialize = registered.LoadJson;
+			return registered.Create();
+		}
+		return nullptr;
+	};
+	archive(cereal::make_nvp("Behaviours", behaviours));
+
+	//Every owner has to point at an entity in the file, and only behaviours can have more than one per entity
+	//*entt doesn't check for doubled up components in release builds, it just corrupts the pool
+	const uint32_t entityCount = chunk._entityCount;
+	auto checkOwners = [entityCount](const std::vector<uint32_t>& owners, size_t components, const char* type, bool unique) {
+		if (owners.size() != components)
+			throw cereal::Exception(std::string("Mismatched ") + type + " column");
+		std::vector<bool> seen(unique ? entityCount : 0, false);
+		for (uint32_t owner : owners)
+		{
+			if (owner >= entityCount)
+				throw cereal::Exception(std::string("A ") + type + " belongs to an entity that isn't in the file");
+			if (unique)
+			{
+				if (seen[owner])
+					throw cereal::Exception(std::string("An entity has more than one ") + type);
+				seen[owner] = true;
+			}
+		}
+		return seen;
+	};
+	std::vector<bool> hasTransform = checkOwners(columns.TransformOwners, columns.Transforms.size(), "transform", true);
+	checkOwners(columns.TagOwners, columns.Tags.size(), "tag", true);
+	checkOwners(columns.RendererOwners, columns.Renderers.size(), "renderer", true);
+	checkOwners(columns.CameraOwners, columns.Cameras.size(), "camera", true);
+	for (const BehaviourColumn<Archive>& column : behaviours)
+	{
+		checkOwners(column.Owners, column.Behaviours.size(), "behaviour", false);
+		if (column.Enabled.size() != column.Behaviours.size())
+			throw cereal::Exception("Mismatched behaviour column");
+	}
+
+	//Parents have to be transforms in the file, and following them up has to end somewhere
+	std::vector<uint32_t> parents(entityCount, NoEntity);
+	for (size_t i = 0; i < columns.Transforms.size(); i++)
+	{
+		uint32_t parent = columns.Transforms[i].Parent;
+		if (parent != NoEntity && (parent >= entityCount || !hasTransform[parent]))
+			throw cereal::Exception("A transform's parent isn't in the file");
+		parents[columns.TransformOwners[i]] = parent;
+	}
+	//1 is on the chain being followed, 2 is known to reach a root. Running into a 1 means the chain loops
+	std::vector<uint8_t> marks(entityCount, 0);
+	for (uint32_t start = 0; start < entityCount; start++)
+	{
+		uint32_t current = start;
+		while (current != NoEntity && marks[current] == 0)
+		{
+			marks[current] = 1;
+			current = parents[current];
+		}
+		if (current != NoEntity && marks[current] == 1)
+			throw cereal::Exception("The transform hierarchy has a cycle");
+		for (current = start; current != NoEntity && marks[current] == 1; current = parents[current])
+		{
+			marks[current] = 2;
+		}
+	}
+	for (const RendererData& data : columns.Renderers)
+	{
+		if (data.Mesh >= columns.MeshNames.size() || data.Material >= columns.MaterialNames.size())
+			throw cereal::Exception("A renderer refers to an asset that isn't in the file");
+	}
+
+	//The chunk outlives the archive, so the behaviours are kept without their serialize functions
+	columns.Behaviours.resize(behaviours.size());
+	for (size_t i = 0; i < behaviours.size(); i++)
+	{
+		columns.Behaviours[i].Owners = std::move(behaviours[i].Owners);
+		columns.Behaviours[i].Enabled = std::move(behaviours[i].Enabled);
+		columns.Behaviours[i].Behaviours = std::move(behaviours[i].Behaviours);
+	}
+}
+
+std::vector<entt::entity> SceneSerializer::Restore(const GameScene::sptr& scene, SceneChunk& chunk, SceneIOStats* stats)
+{
+	if (chunk._columns == nullptr)
+	{
+		LOG_ERROR("Scene chunk {} has already been restored", chunk._name);
+		return std::vector<entt::entity>();
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	SceneIOStats localStats;
+	SceneIOStats& result = stats != nullptr ? *stats : localStats;
+	SceneChunk::Columns& columns = *chunk._columns;
+	entt::registry& registry = scene->Registry();
+
+	//Everything's been read and checked (owners, parents and asset indices), so from here on nothing can fail halfway
+	std::vector<entt::entity> entities(chunk._entityCount);
+	registry.reserve(registry.size() + entities.size());
+	registry.create(entities.begin(), entities.end());
+	result.Entities = entities.size();
+
+	//Picks out the entities a column belongs to, in column order
+	auto owners = [&entities](const std::vector<uint32_t>& slots) {
+		std::vector<entt::entity> result(slots.size());
+		for (size_t i = 0; i < slots.size(); i++)
+		{
+			result[i] = entities[slots[i]];
+		}
+		return result;
+	};
+
+	{
+		std::vector<entt::entity> transformEntities = owners(columns.TransformOwners);
+		std::vector<Transform> components;
+		components.reserve(columns.Transforms.size());
+		for (size_t i = 0; i < columns.Transforms.size(); i++)
+		{
+			Transform transform = Transform(entt::handle(registry, transformEntities[i]));
+			transform.SetLocalPosition(columns.Transforms[i].Position);
+			transform.SetLocalRotation(columns.Transforms[i].Rotation);
+			transform.SetLocalScale(columns.Transforms[i].Scale);
+			components.push_back(transform);
+		}
+		registry.reserve<Transform>(registry.size<Transform>() + components.size());
+		registry.insert<Transform>(transformEntities.begin(), transformEntities.end(), components.begin(), components.end());
+
+		//SetParent re-sorts every transform each time it's called, so the whole hierarchy goes in at once
+		std::vector<std::pair<entt::entity, entt::entity>> links;
+		for (size_t i = 0; i < columns.Transforms.size(); i++)
+		{
+			if (columns.Transforms[i].Parent != NoEntity)
+			{
+				links.push_back({ transformEntities[i], entities[columns.Transforms[i].Parent] });
+			}
+		}
+		if (!links.empty())
+		{
+			Transform::SetParents(registry, links);
+		}
+	}
+
+	{
+		std::vector<entt::entity> tagEntities = owners(columns.TagOwners);
+		std::vector<GameObjectTag> components;
+		components.reserve(columns.Tags.size());
+		for (const std::string& tag : columns.Tags)
+		{
+			components.emplace_back(tag);
+		}
+		registry.reserve<GameObjectTag>(registry.size<GameObjectTag>() + components.size());
+		registry.insert<GameObjectTag>(tagEntities.begin(), tagEntities.end(), components.begin(), components.end());
+	}
+
+	{
+		//Look every asset up once, not once per renderer
+		//*Meshes that were parsed while reading only need uploading, anything else loaded is shared with whoever loaded it
+		std::vector<VertexArrayObject::sptr> meshes(columns.MeshNames.size());
+		std::vector<ShaderMaterial::sptr> materials(columns.MaterialNames.size());
+		for (size_t i = 0; i < columns.MeshNames.size(); i++)
+		{
+			const std::string& name = columns.MeshNames[i];
+			const std::shared_ptr<MeshBuilder<VertexPosNormTexCol>>& parsed = columns.ParsedMeshes[i];
+			meshes[i] = _meshes.GetOrLoad(name, [&]() -> VertexArrayObject::sptr {
+				if (parsed != nullptr)
+					return parsed->Bake(_meshCompression);
+				if (IsObjFile(name))
+					return ParseMesh(name).Bake(_meshCompression);
+				return nullptr;
+			});
+			if (meshes[i] == nullptr)
+				LOG_WARN("Scene uses mesh {}, which isn't registered", name);
+		}
+		for (size_t i = 0; i < columns.MaterialNames.size(); i++)
+		{
+			materials[i] = _materials.Find(columns.MaterialNames[i]);
+			if (materials[i] == nullptr)
+				LOG_WARN("Scene uses material {}, which isn't registered", columns.MaterialNames[i]);
+		}
+
+		//Renderers without both assets would break drawing, so they're left off
+		std::vector<entt::entity> rendererEntities;
+		std::vector<RendererComponent> components;
+		rendererEntities.reserve(columns.Renderers.size());
+		components.reserve(columns.Renderers.size());
+		for (size_t i = 0; i < columns.Renderers.size(); i++)
+		{
+			RendererComponent renderer;
+			renderer.Mesh = meshes[columns.Renderers[i].Mesh];
+			renderer.Material = materials[columns.Renderers[i].Material];
+			if (renderer.Mesh == nullptr || renderer.Material == nullptr)
+			{
+				result.MissingAssets++;
+				continue;
+			}
+			rendererEntities.push_back(entities[columns.RendererOwners[i]]);
+			components.push_back(renderer);
+		}
+		registry.reserve<RendererComponent>(registry.size<RendererComponent>() + components.size());
+		registry.insert<RendererComponent>(rendererEntities.begin(), rendererEntities.end(), components.begin(), components.end());
+	}
+
+	for (size_t i = 0; i < columns.Cameras.size(); i++)
+	{
+		const CameraData& data = columns.Cameras[i];
+		Camera& camera = registry.emplace<Camera>(entities[columns.CameraOwners[i]]);
+		camera.SetClippingPlanes(data.NearPlane, data.FarPlane);
+		camera.SetFovDegrees(data.FovDegrees);
+		camera.SetOrthoHeight(data.OrthoHeight);
+		camera.SetIsOrtho(data.IsOrtho);
+		camera.SetPosition(data.Position);
+		camera.SetForward(data.Forward);
+		camera.SetUp(data.Up);
+	}
+
+	//Behaviours load last, so OnLoad can see every other component
+	std::vector<std::pair<entt::entity, std::shared_ptr<IBehaviour>>> loaded;
+	for (BehaviourData& column : columns.Behaviours)
+	{
+		for (size_t i = 0; i < column.Behaviours.size(); i++)
+		{
+			entt::entity entity = entities[column.Owners[i]];
+			column.Behaviours[i]->Enabled = column.Enabled[i] != 0;
+			registry.get_or_emplace<BehaviourBinding>(entity).Behaviours.push_back(column.Behaviours[i]);
+			loaded.push_back({ entity, column.Behaviours[i] });
+		}
+	}
+	for (auto& [entity, behaviour] : loaded)
+	{
+		behaviour->OnLoad(entt::handle(registry, entity));
+	}
+
+	//The behaviours belong to the scene now, so the chunk can't be restored a second time
+	chunk._columns = nullptr;
+
+	result.RestoreTime = ElapsedMs(start);
+	if (result.MissingAssets > 0)
+	{
+		LOG_WARN("{} renderers were left off because their assets aren't registered", result.MissingAssets);
+	}
+	return entities;
+}
+
+void SceneSerializer::RegisterMesh(const std::string& name, const VertexArrayObject::sptr& mesh)
+{
+	_meshes.Add(name, mesh, true);
+}
+
+void SceneSerializer::RegisterMaterial(const std::string& name, const ShaderMaterial::sptr& material)
+{
+	_materials.Add(name, material, true);
+}
+
+VertexArrayObject::sptr SceneSerializer::LoadMesh(const std::string& path)
+{
+	return _meshes.GetOrLoad(path, [&]() {
+		return ParseMesh(path).Bake(_meshCompression);
+	});
+}
+
+MeshBuilder<VertexPosNormTexCol> SceneSerializer::ParseMesh(const std::string& path)
+{
+	//A baked mesh older than its .obj is out of date
+	std::string baked = BakedMeshPath(path);
+	std::error_code error;
+	std::filesystem::file_time_type bakedTime = std::filesystem::last_write_time(baked, error);
+	if (!error)
+	{
+		std::filesystem::file_time_type objTime = std::filesystem::last_write_time(path, error);
+		MeshBuilder<VertexPosNormTexCol> mesh;
+		if ((error || bakedTime >= objTime) && MeshFile::Load(baked, mesh))
+			return mesh;
+	}
+	return ObjLoader::ParseFile(path);
+}
+
+size_t SceneSerializer::BakeMeshes(const std::string& folder)
+{
+	size_t count = 0;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(folder, error))
+	{
+		if (entry.path().extension() != ".obj")
+			continue;
+		std::string path = entry.path().generic_string();
+		try
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			MeshBuilder<VertexPosNormTexCol> mesh = ObjLoader::ParseFile(path);
+			if (MeshFile::Save(BakedMeshPath(path), mesh))
+			{
+				LOG_INFO("Baked {} in {:.1f} ms", path, ElapsedMs(start));
+				count++;
+			}
+		}
+		catch (const std::exception& e)
+		{
+			LOG_WARN("Could not bake mesh {}: {}", path, e.what());
+		}
+	}
+	return count;
+}
+
+Texture2D::sptr SceneSerializer::LoadTexture(const std::string& path)
+{
+	return _textures.GetOrLoad(path, [&]() {
+		return Texture2D::LoadFromFile(path);
+	});
+}
+
+void SceneSerializer::ClearAssets()
+{
+	_meshes.Clear();
+	_materials.Clear();
+	_textures.Clear();
+}
+
+void SceneSerializer::SetMeshCompression(VertexCompression compression)
+{
+	_meshCompression = compression;
+}
+
+VertexCompression SceneSerializer::GetMeshCompression()
+{
+	return _meshCompression;
+}
+
+AssetCache<VertexArrayObject>& SceneSerializer::GetMeshCache()
+{
+	return _meshes;
+}
+
+AssetCache<ShaderMaterial>& SceneSerializer::GetMaterialCache()
+{
+	return _materials;
+}
+
+AssetCache<Texture2D>& SceneSerializer::GetTextureCache()
+{
+	return _textures;
+}
+
+const SceneIOStats& SceneSerializer::GetLastStats()
+{
+	return _lastStats;
+}
+
+void SceneSerializer::RegisterDefaultBehaviours()
+{
+	//Reads can start on several threads at once, only the first one registers
+	static std::once_flag registered;
+	std::call_once(registered, []() {
+		RegisterBehaviour<CameraControlBehaviour>("CameraControl");
+		RegisterBehaviour<FollowPathBehaviour>("FollowPath");
+		RegisterBehaviour<SimpleMoveBehaviour>("SimpleMove");
+	});
+}
+
+void SceneSerializer::RunBenchmark(size_t entityCount)
+{
+	//Stand in assets, registered under names no real scene uses
+	const int meshCount = 4;
+	const int materialCount = 3;
+	std::vector<VertexArrayObject::sptr> meshes;
+	std::vector<ShaderMaterial::sptr> materials;
+	for (int i = 0; i < meshCount; i++)
+	{
+		meshes.push_back(VertexArrayObject::Create());
+		RegisterMesh("benchmark_mesh_" + std::to_string(i), meshes.back());
+	}
+	for (int i = 0; i < materialCount; i++)
+	{
+		materials.push_back(ShaderMaterial::Create());
+		RegisterMaterial("benchmark_material_" + std::to_string(i), materials.back());
+	}
+
+	//Built the way the samples build their scenes, one entity at a time
+	auto start = std::chrono::high_resolution_clock::now();
+	GameScene::sptr source = GameScene::Create("benchmark");
+	entt::entity previous = entt::null;
+	for (size_t i = 0; i < entityCount; i++)
+	{
+		GameObject object = source->CreateEntity("Entity " + std::to_string(i));
+		if (i % 1000 == 1)
+		{
+			object.get<Transform>().SetParent(GameObject(source->Registry(), previous));
+		}
+		previous = object.entity();
+		float f = float(i);
+		object.get<Transform>().SetLocalPosition(f, f * 0.5f, -f).SetLocalRotation(f, 0.0f, 90.0f).SetLocalScale(glm::vec3(1.0f + f * 0.001f));
+		object.emplace<RendererComponent>().SetMesh(meshes[i % meshCount]).SetMaterial(materials[i % materialCount]);
+		if (i % 100 == 0)
+		{
+			auto path = BehaviourBinding::Bind<FollowPathBehaviour>(object);
+			path->Points = { glm::vec3(f), glm::vec3(-f) };
+			path->Speed = f;
+		}
+	}
+	Camera& camera = source->CreateEntity("Camera").emplace<Camera>();
+	camera.SetClippingPlanes(0.5f, 250.0f);
+	camera.SetFovDegrees(60.0f);
+	double build = ElapsedMs(start);
+
+	//Checks that a loaded scene matches the source, entity for entity (both are created in the same order)
+	auto compare = [&](const GameScene::sptr& loaded) {
+		std::vector<entt::entity> expected, actual;
+		source->Registry().each([&](entt::entity entity) { expected.push_back(entity); });
+		loaded->Registry().each([&](entt::entity entity) { actual.push_back(entity); });
+		if (expected.size() != actual.size())
+			return false;
+
+		for (size_t i = 0; i < expected.size(); i++)
+		{
+			GameObject a = GameObject(source->Registry(), expected[i]);
+			GameObject b = GameObject(loaded->Registry(), actual[i]);
+			if (a.get<GameObjectTag>().Name != b.get<GameObjectTag>().Name)
+				return false;
+			if (glm::any(glm::notEqual(a.get<Transform>().GetLocalPosition(), b.get<Transform>().GetLocalPosition())) ||
+				glm::any(glm::notEqual(a.get<Transform>().GetLocalRotation(), b.get<Transform>().GetLocalRotation())) ||
+				glm::any(glm::notEqual(a.get<Transform>().GetLocalScale(), b.get<Transform>().GetLocalScale())))
+				return false;
+			entt::entity parentA = a.get<Transform>().GetParent();
+			entt::entity parentB = b.get<Transform>().GetParent();
+			if ((parentA == entt::null) != (parentB == entt::null))
+				return false;
+			if (parentA != entt::null && source->Registry().get<GameObjectTag>(parentA).Name != loaded->Registry().get<GameObjectTag>(parentB).Name)
+				return false;
+			if (a.has<RendererComponent>() != b.has<RendererComponent>())
+				return false;
+			if (a.has<RendererComponent>() && (a.get<RendererComponent>().Mesh != b.get<RendererComponent>().Mesh ||
+				a.get<RendererComponent>().Material != b.get<RendererComponent>().Material))
+				return false;
+			if (a.has<Camera>() != b.has<Camera>())
+				return false;
+			if (a.has<Camera>() && (a.get<Camera>().GetFarPlane() != b.get<Camera>().GetFarPlane() ||
+				a.get<Camera>().GetFovDegrees() != b.get<Camera>().GetFovDegrees()))
+				return false;
+			auto pathA = BehaviourBinding::Get<FollowPathBehaviour>(a);
+			auto pathB = BehaviourBinding::Get<FollowPathBehaviour>(b);
+			if ((pathA == nullptr) != (pathB == nullptr))
+				return false;
+			if (pathA != nullptr && (pathA->Points != pathB->Points || pathA->Speed != pathB->Speed))
+				return false;
+		}
+		return true;
+	};
+
+	const SceneFormat formats[2] = { SceneFormat::Binary, SceneFormat::Json };
+	const char* formatNames[2] = { "binary", "JSON" };
+	const char* paths[2] = { "scene_benchmark.bin", "scene_benchmark.json" };
+	for (int i = 0; i < 2; i++)
+	{
+		Save(source, paths[i], formats[i]);
+		double save = _lastStats.TotalTime;
+		size_t size = size_t(std::filesystem::file_size(paths[i]));
+
+		GameScene::sptr loaded = GameScene::Create("loaded");
+		bool ok = Load(loaded, paths[i], formats[i]);
+		SceneIOStats stats = _lastStats;
+		ok = ok && compare(loaded);
+
+		LOG_INFO("Scene {} ({} entities): save {:.1f} ms, load {:.1f} ms ({:.1f} ms reading, {:.1f} ms restoring), {:.2f} MB, {}",
+			formatNames[i], stats.Entities, save, stats.TotalTime, stats.ArchiveTime, stats.RestoreTime,
+			size / (1024.0 * 1024.0), ok ? "round trip matches" : "ROUND TRIP MISMATCH");
+		if (!ok)
+		{
+			LOG_ERROR("Scene {} round trip didn't match the source scene", formatNames[i]);
+		}
+		std::filesystem::remove(paths[i]);
+	}
+	LOG_INFO("Scene built one entity at a time: {:.1f} ms for {} entities", build, entityCount);
+
+	for (int i = 0; i < meshCount; i++)
+	{
+		_meshes.Remove("benchmark_mesh_" + std::to_string(i));
+	}
+	for (int i = 0; i < materialCount; i++)
+	{
+		_materials.Remove("benchmark_material_" + std::to_string(i));
+	}
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include <Scene.h>
+#include <IBehaviour.h>
+#include <VertexArrayObject.h>
+#include <VertexPacking.h>
+#include <VertexTypes.h>
+#include <MeshBuilder.h>
+#include <ShaderMaterial.h>
+#include <Texture2D.h>
+
+#include "Utilities/AssetCache.h"
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/archives/json.hpp>
+
+//Which cereal archive a scene file uses
+enum class SceneFormat
+{
+	//Small and fast, for shipping scenes
+	Binary,
+	//Readable and diffable, for editing scenes by hand
+	Json
+};
+
+//How long the last save or load took
+struct SceneIOStats
+{
+	size_t Entities = 0;
+	//Reading or writing the file
+	double ArchiveTime = 0.0;
+	//Creating the entities and their components (loading only)
+	double RestoreTime = 0.0;
+	double TotalTime = 0.0;
+	//Renderers dropped because their mesh or material wasn't registered
+	size_t MissingAssets = 0;
+};
+
+//A scene file that's been read and checked, but not added to a scene yet
+//*Reading one doesn't touch any scene or OpenGL, so it can happen on a worker thread
+//*Restoring hands its behaviours to the scene, so a chunk can only be restored once
+class SceneChunk
+{
+public:
+	typedef std::shared_ptr<SceneChunk> sptr;
+
+	//Getters
+	const std::string& GetName() const { return _name; }
+	uint32_t GetEntityCount() const { return _entityCount; }
+	size_t GetFileSize() const { return _fileSize; }
+	//How long reading, checking and parsing new meshes took
+	double GetReadTime() const { return _readTime; }
+
+private:
+	friend class SceneSerializer;
+	struct Columns;
+
+	std::string _name;
+	uint32_t _entityCount = 0;
+	size_t _fileSize = 0;
+	double _readTime = 0.0;
+	std::shared_ptr<Columns> _columns;
+};
+
+//Saves and loads the entities in a GameScene with cereal
+//*Components are written a column at a time (every Transform, then every tag, and so on), so loading can
+//*create all the entities at once, reserve every pool up front and insert each component type in one go
+//*Meshes and materials are saved as names, they have to be registered (or be loadable .obj files) to load again
+//*Registered assets stay loaded, ones loaded from files are shared and only kept while something uses them
+class SceneSerializer abstract
+{
+public:
+	//Writes every entity in a scene to a file
+	static bool Save(const GameScene::sptr& scene, const std::string& path, SceneFormat format = SceneFormat::Binary);
+	//Writes just the given entities, in that order, links to anything else are dropped
+	static bool Save(const GameScene::sptr& scene, const std::vector<entt::entity>& entities, const std::string& path, SceneFormat format = SceneFormat::Binary);
+	//Adds every entity in a file to a scene, keeping whatever is already there
+	static bool Load(const GameScene::sptr& scene, const std::string& path, SceneFormat format = SceneFormat::Binary);
+	//Reads a file without adding it to a scene, nullptr if it couldn't be read
+	//*Safe to call from any thread, as long as nothing registers behaviours at the same time
+	//*.obj meshes that aren't loaded yet get parsed here as well, so restoring only has to upload them
+	static SceneChunk::sptr Read(const std::string& path, SceneFormat format = SceneFormat::Binary);
+	//Adds a chunk's entities to a scene, returning them in file order
+	//*Main thread only, stats are filled in if given
+	static std::vector<entt::entity> Restore(const GameScene::sptr& scene, SceneChunk& chunk, SceneIOStats* stats = nullptr);
+
+	//Gives a mesh a name that scene files can refer to it by
+	static void RegisterMesh(const std::string& name, const VertexArrayObject::sptr& mesh);
+	//Gives a material a name that scene files can refer to it by
+	static void RegisterMaterial(const std::string& name, const ShaderMaterial::sptr& material);
+	//Loads an .obj under its path, later calls get the same mesh back as long as something still uses it
+	static VertexArrayObject::sptr LoadMesh(const std::string& path);
+	//Reads an .obj into a mesh builder, from the baked .mesh next to it instead if that's newer (see BakeMeshes)
+	//*Safe to call from any thread, throws if neither can be read
+	static MeshBuilder<VertexPosNormTexCol> ParseMesh(const std::string& path);
+	//Writes a baked .mesh next to every .obj in a folder, those load without parsing or optimizing the .obj again
+	//*Returns how many were written
+	static size_t BakeMeshes(const std::string& folder);
+	//Loads an image under its path, shared the same way as LoadMesh
+	static Texture2D::sptr LoadTexture(const std::string& path);
+	//Forgets every registered and loaded asset
+	static void ClearAssets();
+	//How meshes loaded from files store their vertices on the GPU (see VertexCompression), packed by default
+	//*Only meshes loaded after it's changed use it, ones already loaded keep their format until they're unloaded
+	static void SetMeshCompression(VertexCompression compression);
+	static VertexCompression GetMeshCompression();
+
+	//Lets a behaviour type be saved, T has to have a default constructor and a serialize function
+	template <typename T>
+	static void RegisterBehaviour(const std::string& name)
+	{
+		BehaviourType type;
+		type.Name = name;
+		type.Create = []() { return std::make_shared<T>(); };
+		type.SaveBinary = [](cereal::BinaryOutputArchive& archive, IBehaviour& behaviour) { archive(static_cast<T&>(behaviour)); };
+		type.LoadBinary = [](cereal::BinaryInputArchive& archive, IBehaviour& behaviour) { archive(static_cast<T&>(behaviour)); };
+		type.SaveJson = [](cereal::JSONOutputArchive& archive, IBehaviour& behaviour) { archive(static_cast<T&>(behaviour)); };
+		type.LoadJson = [](cereal::JSONInputArchive& archive, IBehaviour& behaviour) { archive(static_cast<T&>(behaviour)); };
+		_behaviourTypes[std::type_index(typeid(T))] = type;
+	}
+
+	//Getters
+	static const SceneIOStats& GetLastStats();
+	static AssetCache<VertexArrayObject>& GetMeshCache();
+	static AssetCache<ShaderMaterial>& GetMaterialCache();
+	static AssetCache<Texture2D>& GetTextureCache();
+
+	//Saves and loads a scene of 100k entities in both formats, checks that it comes back the same and logs the timings
+	static void RunBenchmark(size_t entityCount = 100000);
+
+private:
+	struct BehaviourType
+	{
+		std::string Name;
+		std::function<std::shared_ptr<IBehaviour>()> Create;
+		std::function<void(cereal::BinaryOutputArchive&, IBehaviour&)> SaveBinary;
+		std::function<void(cereal::BinaryInputArchive&, IBehaviour&)> LoadBinary;
+		std::function<void(cereal::JSONOutputArchive&, IBehaviour&)> SaveJson;
+		std::function<void(cereal::JSONInputArchive&, IBehaviour&)> LoadJson;
+	};
+
+	//Saves every entity if the subset is nullptr
+	static bool Write(GameScene& scene, const std::vector<entt::entity>* subset, const std::string& path, SceneFormat format);
+	template <typename Archive>
+	static void SaveScene(Archive& archive, GameScene& scene, const std::vector<entt::entity>* subset);
+	template <typename Archive>
+	static void ReadScene(Archive& archive, SceneChunk& chunk);
+
+	//Registers the behaviours that ship with the framework
+	static void RegisterDefaultBehaviours();
+
+	static AssetCache<VertexArrayObject> _meshes;
+	static AssetCache<ShaderMaterial> _materials;
+	static AssetCache<Texture2D> _textures;
+	static std::unordered_map<std::type_index, BehaviourType> _behaviourTypes;
+
+	static SceneIOStats _lastStats;
+	static VertexCompression _meshCompression;
+};
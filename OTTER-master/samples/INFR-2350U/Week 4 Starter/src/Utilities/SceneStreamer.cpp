@@ -0,0 +1,576 @@
+#include "SceneStreamer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <Logging.h>
+#include <Transform.h>
+#include <Camera.h>
+#include <GameObjectTag.h>
+#include <RendererComponent.h>
+
+namespace
+{
+	double ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//Cell files are named cell_x_y, returns false for anything else in the directory
+	bool ParseCellName(const std::filesystem::path& path, glm::ivec2& cell, SceneFormat& format)
+	{
+		std::string extension = path.extension().string();
+		if (extension == ".bin")
+			format = SceneFormat::Binary;
+		else if (extension == ".json")
+			format = SceneFormat::Json;
+		else
+			return false;
+
+		std::string name = path.stem().string();
+		char end = 0;
+		return sscanf(name.c_str(), "cell_%d_%d%c", &cell.x, &cell.y, &end) == 2;
+	}
+}
+
+SceneStreamer::SceneStreamer(const GameScene::sptr& scene, const std::string& directory, float cellSize, unsigned threads) :
+	_scene(scene),
+	_directory(directory),
+	_cellSize(cellSize > 0.0f ? cellSize : 1.0f)
+{
+	_loadRadius = _cellSize;
+	_unloadRadius = _cellSize * 1.5f;
+	Rescan();
+
+	//Reading is mostly waiting on the disk, so a couple of workers is plenty
+	threads = threads > 0 ? threads : 1;
+	for (unsigned i = 0; i < threads; i++)
+	{
+		_workers.emplace_back(&SceneStreamer::WorkerLoop, this);
+	}
+}
+
+SceneStreamer::~SceneStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(_jobLock);
+		_stopWorkers = true;
+	}
+	_jobSignal.notify_all();
+	for (std::thread& worker : _workers)
+	{
+		if (worker.joinable())
+			worker.join();
+	}
+}
+
+void SceneStreamer::Update(const glm::vec3& viewPosition)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//Cells unloaded last frame have been polled away by now, so their assets can go
+	if (_pruneAssets)
+	{
+		SceneSerializer::GetMeshCache().Prune();
+		SceneSerializer::GetTextureCache().Prune();
+		_pruneAssets = false;
+	}
+
+	//Pick up whatever the workers finished
+	std::vector<LoadResult> results;
+	{
+		std::lock_guard<std::mutex> lock(_resultLock);
+		results.swap(_results);
+		_stats.BytesRead = _bytesRead;
+		_stats.Bandwidth = _readTime > 0.0 ? (_bytesRead / (1024.0 * 1024.0)) / (_readTime / 1000.0) : 0.0;
+	}
+	for (LoadResult& result : results)
+	{
+		//Reads for cells that were dropped (or dropped and queued again) while being read are thrown away
+		auto cell = _cells.find(result.Key);
+		if (cell == _cells.end() || cell->second.State != CellState::Loading || cell->second.Ticket != result.Ticket)
+			continue;
+		cell->second.Chunk = result.Chunk;
+		cell->second.State = result.Chunk != nullptr ? CellState::Ready : CellState::Failed;
+	}
+
+	//Work out what to load and what to drop
+	std::vector<std::pair<float, Cell*>> toLoad;
+	std::vector<std::pair<float, Cell*>> ready;
+	std::vector<std::pair<uint64_t, uint32_t>> cancelled;
+	for (auto& [key, cell] : _cells)
+	{
+		float distance = DistanceTo(cell, viewPosition);
+		if (distance > _unloadRadius)
+		{
+			if (cell.State == CellState::Resident)
+			{
+				Unload(cell);
+			}
+			else if (cell.State != CellState::Unloaded)
+			{
+				if (cell.State == CellState::Loading)
+					cancelled.push_back({ key, cell.Ticket });
+				cell.Chunk = nullptr;
+				cell.State = CellState::Unloaded;
+			}
+		}
+		else if (distance <= _loadRadius && cell.State == CellState::Unloaded)
+		{
+			toLoad.push_back({ distance, &cell });
+		}
+		else if (cell.State == CellState::Ready)
+		{
+			ready.push_back({ distance, &cell });
+		}
+	}
+
+	//Nearest cells get read first
+	if (!toLoad.empty() || !cancelled.empty())
+	{
+		std::sort(toLoad.begin(), toLoad.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+		{
+			std::lock_guard<std::mutex> lock(_jobLock);
+			//Cancelled cells that no worker has picked up yet don't need reading at all
+			if (!cancelled.empty())
+			{
+				_jobs.erase(std::remove_if(_jobs.begin(), _jobs.end(), [&cancelled](const LoadJob& job) {
+					return std::find(cancelled.begin(), cancelled.end(), std::make_pair(job.Key, job.Ticket)) != cancelled.end();
+				}), _jobs.end());
+			}
+			for (auto& [distance, cell] : toLoad)
+			{
+				cell->State = CellState::Loading;
+				cell->Ticket = ++_nextTicket;
+				LoadJob job;
+				job.Key = KeyOf(cell->Coordinates);
+				job.Ticket = cell->Ticket;
+				job.Path = cell->Path;
+				job.Format = cell->Format;
+				_jobs.push_back(job);
+			}
+		}
+		_jobSignal.notify_all();
+	}
+
+	//Merge the nearest ready cells until the budget is spent
+	std::sort(ready.begin(), ready.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+	auto mergeStart = std::chrono::high_resolution_clock::now();
+	_stats.CellsMerged = 0;
+	for (auto& [distance, cell] : ready)
+	{
+		if (_stats.CellsMerged > 0 && ElapsedMs(mergeStart) >= _mergeBudget)
+			break;
+		cell->Entities = SceneSerializer::Restore(_scene, *cell->Chunk);
+		cell->Chunk = nullptr;
+		cell->State = CellState::Resident;
+		_stats.CellsMerged++;
+		_stats.CellsLoaded++;
+	}
+	_stats.MergeTime = ElapsedMs(mergeStart);
+
+	_stats.CellsResident = 0;
+	_stats.CellsInFlight = 0;
+	_stats.EntitiesResident = 0;
+	for (const auto& [key, cell] : _cells)
+	{
+		if (cell.State == CellState::Resident)
+		{
+			_stats.CellsResident++;
+			_stats.EntitiesResident += cell.Entities.size();
+		}
+		else if (cell.State == CellState::Loading || cell.State == CellState::Ready)
+		{
+			_stats.CellsInFlight++;
+		}
+	}
+	_stats.MeshesLoaded = SceneSerializer::GetMeshCache().GetAlive();
+	_stats.TexturesLoaded = SceneSerializer::GetTextureCache().GetAlive();
+
+	_stats.FrameTime = ElapsedMs(start);
+	_stats.WorstFrameTime = std::max(_stats.WorstFrameTime, _stats.FrameTime);
+}
+
+void SceneStreamer::UnloadAll()
+{
+	{
+		std::lock_guard<std::mutex> lock(_jobLock);
+		_jobs.clear();
+	}
+	for (auto& [key, cell] : _cells)
+	{
+		if (cell.State == CellState::Resident)
+		{
+			Unload(cell);
+		}
+		cell.Chunk = nullptr;
+		cell.State = CellState::Unloaded;
+	}
+	_stats.CellsResident = 0;
+	_stats.CellsInFlight = 0;
+	_stats.EntitiesResident = 0;
+}
+
+void SceneStreamer::Rescan()
+{
+	std::error_code error;
+	std::filesystem::directory_iterator files(_directory, error);
+	if (error)
+	{
+		LOG_WARN("Could not look for cells in {}: {}", _directory, error.message());
+		return;
+	}
+
+	size_t found = 0;
+	for (const std::filesystem::directory_entry& file : files)
+	{
+		glm::ivec2 coordinates;
+		SceneFormat format;
+		if (!file.is_regular_file(error) || !ParseCellName(file.path(), coordinates, format))
+			continue;
+
+		//Cells that are already known keep whatever state they're in
+		Cell& cell = _cells[KeyOf(coordinates)];
+		if (cell.Path.empty())
+		{
+			cell.Coordinates = coordinates;
+			cell.Path = file.path().string();
+			cell.Format = format;
+		}
+		found++;
+	}
+	LOG_INFO("Found {} cells in {}", found, _directory);
+}
+
+bool SceneStreamer::IsIdle() const
+{
+	for (const auto& [key, cell] : _cells)
+	{
+		if (cell.State == CellState::Loading || cell.State == CellState::Ready)
+			return false;
+	}
+	return true;
+}
+
+const StreamingStats& SceneStreamer::GetStats() const
+{
+	return _stats;
+}
+
+float SceneStreamer::GetLoadRadius() const
+{
+	return _loadRadius;
+}
+
+float SceneStreamer::GetUnloadRadius() const
+{
+	return _unloadRadius;
+}
+
+double SceneStreamer::GetMergeBudget() const
+{
+	return _mergeBudget;
+}
+
+size_t SceneStreamer::GetCellCount() const
+{
+	return _cells.size();
+}
+
+void SceneStreamer::SetRadii(float load, float unload)
+{
+	_loadRadius = std::max(load, 0.0f);
+	_unloadRadius = std::max(unload, _loadRadius);
+}
+
+void SceneStreamer::SetMergeBudget(double milliseconds)
+{
+	_mergeBudget = std::max(milliseconds, 0.0);
+}
+
+glm::ivec2 SceneStreamer::CellOf(const glm::vec3& position, float cellSize)
+{
+	return glm::ivec2(glm::floor(glm::vec2(position) / cellSize));
+}
+
+std::string SceneStreamer::CellPath(const std::string& directory, const glm::ivec2& cell, SceneFormat format)
+{
+	std::string name = "cell_" + std::to_string(cell.x) + "_" + std::to_string(cell.y) + (format == SceneFormat::Binary ? ".bin" : ".json");
+	return (std::filesystem::path(directory) / name).string();
+}
+
+size_t SceneStreamer::WriteCells(const GameScene::sptr& scene, const std::string& directory, float cellSize, SceneFormat format)
+{
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (error)
+	{
+		LOG_ERROR("Could not make the cell directory {}: {}", directory, error.message());
+		return 0;
+	}
+
+	//Cells left over from an older split would stream in alongside the new ones
+	for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(directory, error))
+	{
+		glm::ivec2 coordinates;
+		SceneFormat cellFormat;
+		if (ParseCellName(file.path(), coordinates, cellFormat))
+			std::filesystem::remove(file.path(), error);
+	}
+
+	//Entities are kept in the order they were made, so each cell loads back the same way
+	entt::registry& registry = scene->Registry();
+	std::vector<entt::entity> entities;
+	entities.reserve(registry.alive());
+	registry.each([&](entt::entity entity) {
+		entities.push_back(entity);
+	});
+	std::reverse(entities.begin(), entities.end());
+
+	std::unordered_map<uint64_t, std::pair<glm::ivec2, std::vector<entt::entity>>> cells;
+	for (entt::entity entity : entities)
+	{
+		if (!registry.has<Transform>(entity))
+			continue;
+
+		//Whole hierarchies go in the cell their root is in
+		entt::entity root = entity;
+		entt::entity parent = registry.get<Transform>(root).GetParent();
+		while (parent != entt::null && registry.valid(parent) && registry.has<Transform>(parent))
+		{
+			root = parent;
+			parent = registry.get<Transform>(root).GetParent();
+		}
+		if (registry.has<Camera>(root))
+			continue;
+
+		glm::ivec2 cell = CellOf(registry.get<Transform>(root).GetLocalPosition(), cellSize);
+		auto& entry = cells[KeyOf(cell)];
+		entry.first = cell;
+		entry.second.push_back(entity);
+	}
+
+	size_t written = 0;
+	for (const auto& [key, cell] : cells)
+	{
+		if (SceneSerializer::Save(scene, cell.second, CellPath(directory, cell.first, format), format))
+			written++;
+	}
+	LOG_INFO("Wrote {} cells of {} units to {}", written, cellSize, directory);
+	return written;
+}
+
+uint64_t SceneStreamer::KeyOf(const glm::ivec2& cell)
+{
+	return (uint64_t(uint32_t(cell.x)) << 32) | uint64_t(uint32_t(cell.y));
+}
+
+float SceneStreamer::DistanceTo(const Cell& cell, const glm::vec3& viewPosition) const
+{
+	glm::vec2 view = glm::vec2(viewPosition);
+	glm::vec2 min = glm::vec2(cell.Coordinates) * _cellSize;
+	glm::vec2 closest = glm::clamp(view, min, min + glm::vec2(_cellSize));
+	return glm::length(view - closest);
+}
+
+void SceneStreamer::Unload(Cell& cell)
+{
+	entt::registry& registry = _scene->Registry();
+	for (entt::entity entity : cell.Entities)
+	{
+		_scene->RemoveEntity(entt::handle(registry, entity));
+	}
+	cell.Entities.clear();
+	cell.State = CellState::Unloaded;
+	_stats.CellsUnloaded++;
+	_pruneAssets = true;
+}
+
+void SceneStreamer::WorkerLoop()
+{
+	while (true)
+	{
+		LoadJob job;
+		{
+			std::unique_lock<std::mutex> lock(_jobLock);
+			_jobSignal.wait(lock, [this]() { return _stopWorkers || !_jobs.empty(); });
+			if (_stopWorkers)
+				return;
+			job = _jobs.front();
+			_jobs.pop_front();
+		}
+
+		LoadResult result;
+		result.Key = job.Key;
+		result.Ticket = job.Ticket;
+		result.Chunk = SceneSerializer::Read(job.Path, job.Format);
+
+		std::lock_guard<std::mutex> lock(_resultLock);
+		if (result.Chunk != nullptr)
+		{
+			_bytesRead += result.Chunk->GetFileSize();
+			_readTime += result.Chunk->GetReadTime();
+		}
+		_results.push_back(result);
+	}
+}
+
+bool SceneStreamer::RunBenchmark(int cellsPerSide, size_t entitiesPerCell)
+{
+	const float cellSize = 50.0f;
+	const std::string directory = "stream_benchmark";
+	const std::string worldPath = "stream_benchmark_world.bin";
+	const int half = cellsPerSide / 2;
+
+	//Stand in assets, registered under names no real scene uses
+	const int meshCount = 4;
+	const int materialCount = 3;
+	std::vector<VertexArrayObject::sptr> meshes;
+	std::vector<ShaderMaterial::sptr> materials;
+	for (int i = 0; i < meshCount; i++)
+	{
+		meshes.push_back(VertexArrayObject::Create());
+		SceneSerializer::RegisterMesh("stream_mesh_" + std::to_string(i), meshes.back());
+	}
+	for (int i = 0; i < materialCount; i++)
+	{
+		materials.push_back(ShaderMaterial::Create());
+		SceneSerializer::RegisterMaterial("stream_material_" + std::to_string(i), materials.back());
+	}
+
+	//The world, a square of cells centred on the origin with a grid of objects in each
+	//*Every tenth object has a child, so hierarchies have to stay together
+	GameScene::sptr world = GameScene::Create("stream world");
+	entt::registry& worldRegistry = world->Registry();
+	const size_t perSide = size_t(std::ceil(std::sqrt(double(entitiesPerCell))));
+	const size_t perCell = entitiesPerCell + (entitiesPerCell + 9) / 10;
+	std::vector<std::pair<entt::entity, entt::entity>> links;
+	for (int y = -half; y < cellsPerSide - half; y++)
+	{
+		for (int x = -half; x < cellsPerSide - half; x++)
+		{
+			for (size_t i = 0; i < entitiesPerCell; i++)
+			{
+				std::string name = "Cell " + std::to_string(x) + " " + std::to_string(y) + " " + std::to_string(i);
+				GameObject object = world->CreateEntity(name);
+				glm::vec2 offset = (glm::vec2(float(i % perSide), float(i / perSide)) + 0.5f) / float(perSide);
+				glm::vec3 position = glm::vec3((glm::vec2(x, y) + offset) * cellSize, 0.0f);
+				object.get<Transform>().SetLocalPosition(position).SetLocalRotation(0.0f, 0.0f, float(i));
+				object.emplace<RendererComponent>().SetMesh(meshes[i % meshCount]).SetMaterial(materials[i % materialCount]);
+				if (i % 10 == 0)
+				{
+					GameObject child = world->CreateEntity(name + " child");
+					child.get<Transform>().SetLocalPosition(0.0f, 0.0f, 1.0f);
+					child.emplace<RendererComponent>().SetMesh(meshes[0]).SetMaterial(materials[0]);
+					links.push_back({ child.entity(), object.entity() });
+				}
+			}
+		}
+	}
+	Transform::SetParents(worldRegistry, links);
+	const size_t worldEntities = worldRegistry.alive();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	size_t written = WriteCells(world, directory, cellSize);
+	double writeTime = ElapsedMs(start);
+	size_t totalBytes = 0;
+	std::error_code error;
+	for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(directory, error))
+	{
+		totalBytes += size_t(file.file_size(error));
+	}
+
+	//What a frame would take if the whole world was loaded in one go instead
+	SceneSerializer::Save(world, worldPath);
+	GameScene::sptr whole = GameScene::Create("whole world");
+	start = std::chrono::high_resolution_clock::now();
+	SceneSerializer::Load(whole, worldPath);
+	double wholeLoad = ElapsedMs(start);
+	whole = nullptr;
+	world = nullptr;
+	std::filesystem::remove(worldPath, error);
+
+	//Fly diagonally across the world and partway back, the sleep stands in for the rest of a frame
+	GameScene::sptr scene = GameScene::Create("streamed");
+	SceneStreamer streamer(scene, directory, cellSize, 2);
+	streamer.SetRadii(cellSize * 1.5f, cellSize * 2.0f);
+	const int frames = 400;
+	const glm::vec3 from = glm::vec3(-float(half) * cellSize * 0.9f);
+	const glm::vec3 to = glm::vec3(float(half) * cellSize * 0.9f, float(half) * cellSize * 0.2f, 0.0f);
+	glm::vec3 view = from;
+	double mergeTotal = 0.0;
+	size_t mergeFrames = 0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		float t = float(frame) / float(frames - 1);
+		view = glm::mix(from, to, t < 0.75f ? t / 0.75f : 1.0f - (t - 0.75f));
+		view.z = 0.0f;
+		streamer.Update(view);
+		scene->Poll();
+		if (streamer.GetStats().CellsMerged > 0)
+		{
+			mergeTotal += streamer.GetStats().MergeTime;
+			mergeFrames++;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+	//Let everything that's in flight land
+	start = std::chrono::high_resolution_clock::now();
+	while (!streamer.IsIdle() && ElapsedMs(start) < 10000.0)
+	{
+		streamer.Update(view);
+		scene->Poll();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	streamer.Update(view);
+	scene->Poll();
+	StreamingStats stats = streamer.GetStats();
+
+	//Every cell in the load radius has to be in, nothing past the unload radius can be, and the scene holds exactly the resident cells
+	bool ok = streamer.IsIdle() && written == size_t(cellsPerSide * cellsPerSide) && streamer.GetCellCount() == written;
+	size_t expected = 0;
+	for (const auto& [key, cell] : streamer._cells)
+	{
+		float distance = streamer.DistanceTo(cell, view);
+		bool resident = cell.State == CellState::Resident;
+		if ((distance <= streamer._loadRadius && !resident) || (distance > streamer._unloadRadius && resident))
+			ok = false;
+		if (!resident)
+			continue;
+
+		expected += cell.Entities.size();
+		std::string first = "Cell " + std::to_string(cell.Coordinates.x) + " " + std::to_string(cell.Coordinates.y) + " 0";
+		GameObject object = scene->FindFirst(first);
+		if (cell.Entities.size() != perCell || !scene->IsValid(object) || !object.has<RendererComponent>() ||
+			object.get<RendererComponent>().Mesh != meshes[0] || CellOf(object.get<Transform>().GetLocalPosition(), cellSize) != cell.Coordinates)
+			ok = false;
+	}
+	ok = ok && expected > 0 && scene->Registry().alive() == expected;
+
+	streamer.UnloadAll();
+	scene->Poll();
+	ok = ok && scene->Registry().alive() == 0;
+
+	LOG_INFO("Streaming {} cells ({} entities, {:.1f} MB, written in {:.1f} ms): worst frame {:.2f} ms, average merge {:.2f} ms over {} frames, "
+		"{:.1f} MB read at {:.1f} MB/s, {} loads, {} unloads. Loading the whole world at once takes {:.1f} ms, {}",
+		written, worldEntities, totalBytes / (1024.0 * 1024.0), writeTime, stats.WorstFrameTime, mergeFrames > 0 ? mergeTotal / mergeFrames : 0.0,
+		mergeFrames, stats.BytesRead / (1024.0 * 1024.0), stats.Bandwidth, stats.CellsLoaded, stats.CellsUnloaded, wholeLoad,
+		ok ? "cells match" : "CELL MISMATCH");
+	if (!ok)
+	{
+		LOG_ERROR("Streaming benchmark ended up with the wrong cells loaded");
+	}
+
+	std::filesystem::remove_all(directory, error);
+	for (int i = 0; i < meshCount; i++)
+	{
+		SceneSerializer::GetMeshCache().Remove("stream_mesh_" + std::to_string(i));
+	}
+	for (int i = 0; i < materialCount; i++)
+	{
+		SceneSerializer::GetMaterialCache().Remove("stream_material_" + std::to_string(i));
+	}
+	return ok;
+}
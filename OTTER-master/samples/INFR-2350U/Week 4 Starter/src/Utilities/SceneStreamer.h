@@ -0,0 +1,166 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <GLM/glm.hpp>
+
+#include "Utilities/SceneSerializer.h"
+
+//How streaming is going, the times are in milliseconds
+struct StreamingStats
+{
+	//Cells merged into the scene right now, and their entities
+	size_t CellsResident = 0;
+	size_t EntitiesResident = 0;
+	//Cells queued, being read, or read and waiting to be merged
+	size_t CellsInFlight = 0;
+	//Totals since the streamer was made
+	size_t CellsLoaded = 0;
+	size_t CellsUnloaded = 0;
+	size_t BytesRead = 0;
+	//How fast the workers read cells, in MB per second spent reading
+	double Bandwidth = 0.0;
+	//Time Update took on the main thread last frame, and the worst frame so far (the biggest hitch)
+	double FrameTime = 0.0;
+	double WorstFrameTime = 0.0;
+	//How much of the last frame went into merging cells, and how many were merged
+	double MergeTime = 0.0;
+	size_t CellsMerged = 0;
+	//Shared assets that are loaded right now
+	size_t MeshesLoaded = 0;
+	size_t TexturesLoaded = 0;
+};
+
+//Streams a world that's been split into cells on the ground (x/y) plane, each cell a scene file
+//*Cells are read on worker threads as the view gets close, and merged into the scene between frames a few at a time
+//*so a frame never spends much longer than the merge budget on them. Cells unload once the view is far enough away,
+//*meshes and textures are shared between cells and freed once no cell uses them
+class SceneStreamer
+{
+public:
+	typedef std::shared_ptr<SceneStreamer> sptr;
+	static inline sptr Create(const GameScene::sptr& scene, const std::string& directory, float cellSize, unsigned threads = 2)
+	{
+		return std::make_shared<SceneStreamer>(scene, directory, cellSize, threads);
+	}
+
+	//Looks for cell files in the directory and starts the workers
+	SceneStreamer(const GameScene::sptr& scene, const std::string& directory, float cellSize, unsigned threads = 2);
+	//Stops the workers, resident cells stay in the scene
+	~SceneStreamer();
+
+	//Queues loads and unloads around the view, then merges finished cells (nearest first) until the budget runs out
+	//*Call once a frame, outside of rendering. Unloaded entities go away on the scene's next Poll
+	void Update(const glm::vec3& viewPosition);
+	//Unloads every resident cell and drops anything still loading
+	void UnloadAll();
+	//Looks for cell files again, for when new ones have been written
+	void Rescan();
+	//True once nothing is queued, loading or waiting to merge
+	bool IsIdle() const;
+
+	//Getters
+	const StreamingStats& GetStats() const;
+	float GetLoadRadius() const;
+	float GetUnloadRadius() const;
+	double GetMergeBudget() const;
+	size_t GetCellCount() const;
+
+	//Setters
+	//Cells load once the view is within the load radius of them, and only unload once it's past the unload radius
+	//*The gap keeps a cell on the edge from loading and unloading every frame, so unload never goes below load
+	void SetRadii(float load, float unload);
+	//Milliseconds a frame can spend merging cells, at least one ready cell is merged a frame whatever the budget
+	void SetMergeBudget(double milliseconds);
+
+	//Which cell a point falls in
+	static glm::ivec2 CellOf(const glm::vec3& position, float cellSize);
+	//Where a cell's file goes
+	static std::string CellPath(const std::string& directory, const glm::ivec2& cell, SceneFormat format = SceneFormat::Binary);
+	//Splits a scene into cell files by where each root entity is, children go with their root
+	//*Cameras stay out of the cells, since they're what does the streaming. Returns how many cells were written
+	static size_t WriteCells(const GameScene::sptr& scene, const std::string& directory, float cellSize, SceneFormat format = SceneFormat::Binary);
+
+	//Streams a generated world along a path, checks the right cells end up loaded and logs the hitches and bandwidth
+	static bool RunBenchmark(int cellsPerSide = 16, size_t entitiesPerCell = 400);
+
+private:
+	enum class CellState
+	{
+		Unloaded,
+		//Queued or being read
+		Loading,
+		//Read and waiting to be merged
+		Ready,
+		Resident,
+		//The file couldn't be read, tried again once the view leaves and comes back
+		Failed
+	};
+
+	struct Cell
+	{
+		glm::ivec2 Coordinates = glm::ivec2(0);
+		std::string Path;
+		SceneFormat Format = SceneFormat::Binary;
+		CellState State = CellState::Unloaded;
+		//Bumped whenever a load is started, so reads that finish after the cell was dropped can be told apart
+		uint32_t Ticket = 0;
+		SceneChunk::sptr Chunk;
+		std::vector<entt::entity> Entities;
+	};
+
+	struct LoadJob
+	{
+		uint64_t Key = 0;
+		uint32_t Ticket = 0;
+		std::string Path;
+		SceneFormat Format = SceneFormat::Binary;
+	};
+
+	struct LoadResult
+	{
+		uint64_t Key = 0;
+		uint32_t Ticket = 0;
+		SceneChunk::sptr Chunk;
+	};
+
+	static uint64_t KeyOf(const glm::ivec2& cell);
+	//Distance along the ground from the view to the closest point of a cell
+	float DistanceTo(const Cell& cell, const glm::vec3& viewPosition) const;
+	//Queues a cell's entities for removal
+	void Unload(Cell& cell);
+	//Worker thread loop
+	void WorkerLoop();
+
+	GameScene::sptr _scene;
+	std::string _directory;
+	float _cellSize;
+	float _loadRadius;
+	float _unloadRadius;
+	double _mergeBudget = 2.0;
+
+	std::unordered_map<uint64_t, Cell> _cells;
+	uint32_t _nextTicket = 0;
+	//Set when cells unload, their assets can only be let go after the scene polls
+	bool _pruneAssets = false;
+
+	//Worker state
+	std::vector<std::thread> _workers;
+	std::mutex _jobLock;
+	std::condition_variable _jobSignal;
+	std::deque<LoadJob> _jobs;
+	bool _stopWorkers = false;
+	std::mutex _resultLock;
+	std::vector<LoadResult> _results;
+	//Only touched under the result lock
+	double _readTime = 0.0;
+	size_t _bytesRead = 0;
+
+	StreamingStats _stats;
+};
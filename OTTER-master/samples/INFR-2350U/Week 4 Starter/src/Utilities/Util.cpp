@@ -1,5 +1,35 @@
 #include "Util.h"
 
+#include <Logging.h>
+
+namespace
+{
+    //How many times to retry landing outside the avoid ranges before giving up
+    //*Used to recurse instead, which could run out of stack when the ranges covered most of the space
+    const int MaxAttempts = 1000;
+
+    //Is the num inside any of the avoid ranges?
+    template <typename T>
+    bool IsAvoided(const T& num, const std::vector<T>& avoidFrom, const std::vector<T>& avoidTo)
+    {
+        for (size_t i = 0; i < avoidFrom.size(); i++)
+        {
+            if (Util::CheckNumBetween(num, avoidFrom[i], avoidTo[i]))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    //Every try landed in an avoid range, they probably cover the whole space
+    void WarnAvoidFailed()
+    {
+        LOG_WARN("GetRandomNumberBetween: no number outside the avoid ranges after {} tries, returning one inside them", MaxAttempts);
+    }
+}
+
 bool Util::Init()
 {
     //Seeds random so we can use it
@@ -62,17 +92,20 @@ bool Util::CheckNumBetween(glm::vec4 num, glm::vec4 min, glm::vec4 max)
 
 int Util::GetRandomNumberBetween(int from, int to, std::vector<int> avoidFrom, std::vector<int> avoidTo)
 {
-    //Just the typical random number generation within range
-    int randomNum = (rand() % (to - from)) + from;
-
-    for (int i = 0; i < avoidFrom.size(); i++)
+    int randomNum = from;
+    //Keeps trying until it's outside every avoid range, if they cover everything the last try gets returned (with a warning)
+    for (int attempt = 0; attempt < MaxAttempts; attempt++)
     {
-        if (CheckNumBetween(randomNum, avoidFrom[i], avoidTo[i]))
+        //Just the typical random number generation within range
+        randomNum = (rand() % (to - from)) + from;
+
+        if (!IsAvoided(randomNum, avoidFrom, avoidTo))
         {
-            return GetRandomNumberBetween(from, to, avoidFrom, avoidTo);
+            return randomNum;
         }
     }
 
+    WarnAvoidFailed();
     return randomNum;
 }
 
@@ -88,72 +121,77 @@ float Util::GetRandomNumberBetween(float from, float to, std::vector<float> avoi
     //Uses static casting to convert rand to a float to allow us
     //to divide it by RAND_MAX (which has been modified to suit our range)
     //in order to convert it into a float range
-    float randomNum = from + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (to - from)));
-
-    for (int i = 0; i < avoidFrom.size(); i++)
+    float randomNum = from;
+    for (int attempt = 0; attempt < MaxAttempts; attempt++)
     {
-        if (CheckNumBetween(randomNum, avoidFrom[i], avoidTo[i]))
+        randomNum = from + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (to - from)));
+
+        if (!IsAvoided(randomNum, avoidFrom, avoidTo))
         {
-            return GetRandomNumberBetween(from, to, avoidFrom, avoidTo);
+            return randomNum;
         }
     }
 
+    WarnAvoidFailed();
     return randomNum;
 }
 
 glm::vec2 Util::GetRandomNumberBetween(glm::vec2 from, glm::vec2 to, std::vector <glm::vec2> avoidFrom, std::vector <glm::vec2> avoidTo)
 {
-    //Calls the float version on individual components
     glm::vec2 randomNum;
-    randomNum.x = GetRandomNumberBetween(from.x, to.x);
-    randomNum.y = GetRandomNumberBetween(from.y, to.y);
-
-    for (int i = 0; i < avoidFrom.size(); i++)
+    for (int attempt = 0; attempt < MaxAttempts; attempt++)
     {
-        if (CheckNumBetween(randomNum, avoidFrom[i], avoidTo[i]))
+        //Calls the float version on individual components
+        randomNum.x = GetRandomNumberBetween(from.x, to.x);
+        randomNum.y = GetRandomNumberBetween(from.y, to.y);
+
+        if (!IsAvoided(randomNum, avoidFrom, avoidTo))
         {
-            return GetRandomNumberBetween(from, to, avoidFrom, avoidTo);
+            return randomNum;
         }
     }
 
+    WarnAvoidFailed();
     return randomNum;
 }
 
 glm::vec3 Util::GetRandomNumberBetween(glm::vec3 from, glm::vec3 to, std::vector <glm::vec3> avoidFrom, std::vector <glm::vec3> avoidTo)
 {
-    //Calls the float version on individual components
     glm::vec3 randomNum;
-    randomNum.x = GetRandomNumberBetween(from.x, to.x);
-    randomNum.y = GetRandomNumberBetween(from.y, to.y);
-    randomNum.z = GetRandomNumberBetween(from.z, to.z);
-    
-    for (int i = 0; i < avoidFrom.size(); i++)
+    for (int attempt = 0; attempt < MaxAttempts; attempt++)
     {
-        if (CheckNumBetween(randomNum, avoidFrom[i], avoidTo[i]))
+        //Calls the float version on individual components
+        randomNum.x = GetRandomNumberBetween(from.x, to.x);
+        randomNum.y = GetRandomNumberBetween(from.y, to.y);
+        randomNum.z = GetRandomNumberBetween(from.z, to.z);
+
+        if (!IsAvoided(randomNum, avoidFrom, avoidTo))
         {
-            return GetRandomNumberBetween(from, to, avoidFrom, avoidTo);
+            return randomNum;
         }
     }
 
+    WarnAvoidFailed();
     return randomNum;
 }
 
 glm::vec3 Util::GetRandomNumberBetween(glm::vec4 from, glm::vec4 to, std::vector <glm::vec4> avoidFrom, std::vector <glm::vec4> avoidTo)
 {
-    //Calls the float version on individual components
     glm::vec4 randomNum;
-    randomNum.x = GetRandomNumberBetween(from.x, to.x);
-    randomNum.y = GetRandomNumberBetween(from.y, to.y);
-    randomNum.z = GetRandomNumberBetween(from.z, to.z);
-    randomNum.w = GetRandomNumberBetween(from.w, to.w);
-    
-    for (int i = 0; i < avoidFrom.size(); i++)
+    for (int attempt = 0; attempt < MaxAttempts; attempt++)
     {
-        if (CheckNumBetween(randomNum, avoidFrom[i], avoidTo[i]))
+        //Calls the float version on individual components
+        randomNum.x = GetRandomNumberBetween(from.x, to.x);
+        randomNum.y = GetRandomNumberBetween(from.y, to.y);
+        randomNum.z = GetRandomNumberBetween(from.z, to.z);
+        randomNum.w = GetRandomNumberBetween(from.w, to.w);
+
+        if (!IsAvoided(randomNum, avoidFrom, avoidTo))
         {
-            return GetRandomNumberBetween(from, to, avoidFrom, avoidTo);
+            return randomNum;
         }
     }
 
+    WarnAvoidFailed();
     return randomNum;
 }
@@ -31,6 +31,7 @@ namespace Util
 	bool CheckNumBetween(glm::vec4 num, glm::vec4 min, glm::vec4 max);
 
 	//Get random number between two values, while avoiding multiple specific ranges of numbers (or none)
+	//*If the ranges cover everything it gives up after a while, logs a warning and returns a number inside them
 	int GetRandomNumberBetween(int from, int to, std::vector<int> avoidFrom = std::vector<int>(), std::vector<int> avoidTo = std::vector<int>());
 	float GetRandomNumberBetween(float from, float to, std::vector<float> avoidFrom = std::vector<float>(), std::vector<float> avoidTo = std::vector<float>());
 	glm::vec2 GetRandomNumberBetween(glm::vec2 from, glm::vec2 to, std::vector <glm::vec2> avoidFrom = std::vector <glm::vec2>(), std::vector <glm::vec2> avoidTo = std::vector <glm::vec2>());
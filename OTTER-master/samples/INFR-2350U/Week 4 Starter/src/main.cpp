@@ -1,5 +1,16 @@
 //Just a simple handler for simple initialization stuffs
 #include "Utilities/BackendHandler.h"
+#include "Graphics/FrameCapture.h"
+#include "Utilities/Profiler.h"
+#include "Utilities/DynamicResolution.h"
+#include "Graphics/LightClusters.h"
+#include "Graphics/CascadedShadows.h"
+#include "Graphics/ParticleSystem.h"
+#include "Graphics/LOD.h"
+#include "Utilities/SceneSerializer.h"
+#include "Utilities/SceneBenchmarks.h"
+#include "Utilities/Placement.h"
+#include "Utilities/SceneStreamer.h"
 
 #include <filesystem>
 #include <json.hpp>
@@ -8,14 +19,21 @@
 #include <Texture2D.h>
 #include <Texture2DData.h>
 #include <MeshBuilder.h>
+#include <MeshOptimizer.h>
 #include <MeshFactory.h>
 #include <NotObjLoader.h>
 #include <ObjLoader.h>
 #include <VertexTypes.h>
+#include <VertexPacking.h>
 #include <ShaderMaterial.h>
+#include <ShaderVariants.h>
+#include <ShaderWatcher.h>
 #include <RendererComponent.h>
 #include <TextureCubeMap.h>
 #include <TextureCubeMapData.h>
+#include <IBLBaker.h>
+#include <TTK/TTKContext.h>
+#include <TTK/SpriteBatch.h>
 
 #include <Timing.h>
 #include <GameObjectTag.h>
@@ -37,6 +55,13 @@ int main() {
 
 	BackendHandler::InitAll();
 
+	//Startup is timed from here to the first frame, turn the program cache off to compare against compiling everything
+	double startupTime = glfwGetTime();
+	Shader::SetCacheEnabled(true);
+
+	//Edits to any loaded shader (or the files it includes) get picked up while the app runs
+	ShaderWatcher::Init();
+
 	// Let OpenGL know that we want debug output, and route it to our handler function
 	glEnable(GL_DEBUG_OUTPUT);
 	glDebugMessageCallback(BackendHandler::GlDebugMessage, nullptr);
@@ -52,11 +77,33 @@ int main() {
 		passthroughShader->LoadShaderPartFromFile("shaders/passthrough_frag.glsl", GL_FRAGMENT_SHADER);
 		passthroughShader->Link();
 
-		// Load our shaders
-		Shader::sptr shader = Shader::Create();
-		shader->LoadShaderPartFromFile("shaders/vertex_shader.glsl", GL_VERTEX_SHADER);
-		shader->LoadShaderPartFromFile("shaders/frag_blinn_phong_textured.glsl", GL_FRAGMENT_SHADER);
-		shader->Link();
+		// Load our shaders, variants only get compiled once a material asks for them
+		ShaderVariants::sptr litShader = ShaderVariants::Create();
+		litShader->LoadShaderPartFromFile("shaders/vertex_shader.glsl", GL_VERTEX_SHADER);
+		litShader->LoadShaderPartFromFile("shaders/frag_blinn_phong_textured.glsl", GL_FRAGMENT_SHADER);
+
+		//Features that get compiled in or out of the lit shader
+		const uint32_t ambientKeyword = litShader->AddKeyword("AMBIENT");
+		const uint32_t diffuseKeyword = litShader->AddKeyword("DIFFUSE");
+		const uint32_t specularKeyword = litShader->AddKeyword("SPECULAR");
+		const uint32_t specularMapKeyword = litShader->AddKeyword("SPECULAR_MAP");
+		const uint32_t secondDiffuseKeyword = litShader->AddKeyword("SECOND_DIFFUSE");
+		const uint32_t clusteredKeyword = litShader->AddKeyword("CLUSTERED");
+		const uint32_t shadowsKeyword = litShader->AddKeyword("SHADOWS");
+		litShader->AddKeyword("IBL");
+		const uint32_t lightingKeywords = ambientKeyword | diffuseKeyword | specularKeyword;
+
+		//Writes depth only, used for the depth prepass
+		Shader::sptr depthShader = Shader::Create();
+		depthShader->LoadShaderPartFromFile("shaders/vertex_shader.glsl", GL_VERTEX_SHADER);
+		depthShader->LoadShaderPartFromFile("shaders/depth_prepass_frag.glsl", GL_FRAGMENT_SHADER);
+		depthShader->Link();
+
+		//Adds up how many fragments land on each pixel
+		Shader::sptr overdrawShader = Shader::Create();
+		overdrawShader->LoadShaderPartFromFile("shaders/vertex_shader.glsl", GL_VERTEX_SHADER);
+		overdrawShader->LoadShaderPartFromFile("shaders/overdraw_frag.glsl", GL_FRAGMENT_SHADER);
+		overdrawShader->Link();
 
 		glm::vec3 lightPos = glm::vec3(0.0f, 0.0f, 5.0f);
 		glm::vec3 lightCol = glm::vec3(1.0f);
@@ -67,21 +114,37 @@ int main() {
 		float     lightLinearFalloff = 0.09f;
 		float     lightQuadraticFalloff = 0.032f;
 
-		int condition = 0;
+		//Lighting baked from the skybox, replaces the ambient colour when it's on
+		TextureCubeMapData::sptr environmentData = nullptr;
+		IBLData::sptr ibl = nullptr;
+		TextureCubeMap::sptr specularEnvironment = nullptr;
+		bool useIBL = false;
+		float iblStrength = 1.0f;
+		//The skybox's images are Y up, this turns them to our Z up world
+		glm::mat3 environmentRotation = glm::mat3(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1, 0, 0)));
+
+		//Which lighting keywords the lit materials use, starts with no lighting
+		uint32_t lightingMode = 0;
 
 		// These are our application / scene level uniforms that don't necessarily update
-		// every frame
-		shader->SetUniform("u_LightPos", lightPos);
-		shader->SetUniform("u_LightCol", lightCol);
-		shader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-		shader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
-		shader->SetUniform("u_AmbientCol", ambientCol);
-		shader->SetUniform("u_AmbientStrength", ambientPow);
-		shader->SetUniform("u_LightAttenuationConstant", 1.0f);
-		shader->SetUniform("u_LightAttenuationLinear", lightLinearFalloff);
-		shader->SetUniform("u_LightAttenuationQuadratic", lightQuadraticFalloff);
-
-		shader->SetUniform("u_Condition", condition);
+		// every frame, every variant gets them when it's compiled
+		litShader->SetVariantSetup([&](const Shader::sptr& shader) {
+			shader->SetUniform("u_LightPos", lightPos);
+			shader->SetUniform("u_LightCol", lightCol);
+			shader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
+			shader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
+			shader->SetUniform("u_AmbientCol", ambientCol);
+			shader->SetUniform("u_AmbientStrength", ambientPow);
+			shader->SetUniform("u_LightAttenuationConstant", 1.0f);
+			shader->SetUniform("u_LightAttenuationLinear", lightLinearFalloff);
+			shader->SetUniform("u_LightAttenuationQuadratic", lightQuadraticFalloff);
+			shader->SetUniformMatrix("u_EnvironmentRotation", environmentRotation);
+			shader->SetUniform("u_IBLStrength", iblStrength);
+			if (ibl != nullptr)
+			{
+				ibl->SetUniforms(shader);
+			}
+		});
 
 		PostEffect* basicEffect;
 
@@ -93,6 +156,84 @@ int main() {
 		ColorCorrectEffect* colorCorrectEffect;
 
 		BloomEffect* bloomEffect;
+
+		//Tonemaps the HDR scene, always runs
+		TonemapEffect* tonemapEffect;
+		//Format of the HDR buffers (the scene and bloom)
+		const GLenum hdrFormats[] = { GL_RGBA16F, GL_R11F_G11F_B10F };
+		int hdrFormat = 0;
+
+		FrameCapture frameCapture;
+		bool runCaptureBenchmark = false;
+
+		//Streams cells written from the scene back in around the camera
+		SceneStreamer::sptr streamer;
+		const float streamCellSize = 10.0f;
+
+		//Scene rendering modes
+		bool depthPrepass = false;
+		bool showOverdraw = false;
+		int msaaMode = 0;
+		//Render layers at or above this (the skybox) aren't part of the depth prepass
+		const int prepassLayerLimit = 100;
+
+		//Counts the fragments that pass the depth test in the main pass
+		GLuint fragmentQuery = GL_NONE;
+		bool fragmentQueryPending = false;
+		GLuint64 fragmentsDrawn = 0;
+		glGenQueries(1, &fragmentQuery);
+		//TTK's benchmarks make their own draw calls, so they wait until the frame is done instead of running mid-GUI
+		bool runLineBenchmark = false;
+		bool runTextBenchmark = false;
+		bool runSpriteBenchmark = false;
+
+		//Clustered point lights
+		LightClusters lightClusters;
+		lightClusters.Init();
+		std::vector<PointLight> pointLights;
+		bool useClusteredLighting = false;
+		int pointLightCount = 256;
+		//Sun with cascaded shadows
+		CascadedShadows shadows;
+		shadows.Init();
+		bool useShadows = false;
+		glm::vec3 sunDirection = glm::normalize(glm::vec3(-0.4f, -0.6f, -1.0f));
+		glm::vec3 sunColor = glm::vec3(1.0f, 0.95f, 0.85f);
+		//Draws and culled casters per cascade last frame
+		int shadowDraws[CascadedShadows::MaxCascades] = { 0 };
+		int shadowCulled[CascadedShadows::MaxCascades] = { 0 };
+		//Particle emitters, simulated on the GPU unless an emitter says otherwise
+		ParticleSystem particles;
+		particles.Init();
+		bool runParticleBenchmark = false;
+		//Swaps meshes for simpler ones as they get smaller on screen
+		LODSystem lods;
+		//Running average of the scene draw's GPU and CPU time with LOD off ([0]) and on ([1])
+		glm::dvec2 lodDrawTimes[2] = { glm::dvec2(0.0), glm::dvec2(0.0) };
+		//Materials that use the lit shader, the lighting toggles switch their variants
+		std::vector<ShaderMaterial::sptr> litMaterials;
+
+		//Swaps the lighting keywords on every lit material, keeping their own keywords
+		auto setLightingMode = [&](uint32_t mode) {
+			lightingMode = mode;
+			for (ShaderMaterial::sptr& mat : litMaterials)
+			{
+				mat->SetKeywords((mat->Keywords & ~lightingKeywords) | mode);
+			}
+		};
+
+		//Scatters lights over the ground around the farm
+		auto generatePointLights = [&]() {
+			pointLights.resize(pointLightCount);
+			for (PointLight& light : pointLights)
+			{
+				glm::vec3 position = Util::GetRandomNumberBetween(glm::vec3(-16.0f, -16.0f, 0.5f), glm::vec3(16.0f, 16.0f, 3.0f));
+				glm::vec3 color = Util::GetRandomNumberBetween(glm::vec3(0.2f), glm::vec3(1.0f));
+				light.PositionRadius = glm::vec4(position, Util::GetRandomNumberBetween(1.5f, 4.0f));
+				light.ColorIntensity = glm::vec4(color, 2.0f);
+			}
+		};
+		generatePointLights();
 		
 		// We'll add some ImGui controls to control our shader
 		BackendHandler::imGuiCallbacks.push_back([&]() {
@@ -103,35 +244,35 @@ int main() {
 				if (ImGui::Button("No Lighting"))
 				{
 					toggleMode = 0;
-					shader->SetUniform("u_Condition", 0); 
+					setLightingMode(0);
 					activeEffect = 0;
 				}
 				//Toggles on ambient lighting only
 				if (ImGui::Button("Ambient Only"))
 				{
 					toggleMode = 1;
-					shader->SetUniform("u_Condition", 1);
+					setLightingMode(ambientKeyword);
 					activeEffect = 0;
 				}
 				//Toggles on specular lighting only
 				if (ImGui::Button("Specular Only"))
 				{
 					toggleMode = 2;
-					shader->SetUniform("u_Condition", 2);
+					setLightingMode(specularKeyword);
 					activeEffect = 0;
 				}
 				//Toggles on ambient + specular + diffuse lighitng (DEFAULT) 
 				if (ImGui::Button("Ambient + Specular + Diffuse"))
 				{
 					toggleMode = 3;
-					shader->SetUniform("u_Condition", 3);
+					setLightingMode(lightingKeywords);
 					activeEffect = 0;
 				}
 				//Ambient + Specular + Diffuse + Bloom
 				if (ImGui::Button("Ambient + Specular + Diffuse + Bloom"))
 				{
 					toggleMode = 4;
-					shader->SetUniform("u_Condition", 3);
+					setLightingMode(lightingKeywords);
 					activeEffect = 4;
 				}
 
@@ -250,6 +391,504 @@ int main() {
 				}
 			}
 
+			if (ImGui::CollapsingHeader("HDR"))
+			{
+				if (ImGui::Combo("Scene Format", &hdrFormat, "RGBA16F\0" "R11G11B10F\0"))
+				{
+					basicEffect->SetColorFormat(hdrFormats[hdrFormat]);
+					bloomEffect->SetColorFormat(hdrFormats[hdrFormat]);
+				}
+
+				bool autoExposure = tonemapEffect->GetAutoExposure();
+				float exposure = tonemapEffect->GetExposure();
+				float keyValue = tonemapEffect->GetKeyValue();
+				float adaptationSpeed = tonemapEffect->GetAdaptationSpeed();
+				float luminanceRange[2] = { tonemapEffect->GetMinLogLuminance(), tonemapEffect->GetMaxLogLuminance() };
+
+				if (ImGui::Checkbox("Auto Exposure", &autoExposure))
+				{
+					tonemapEffect->SetAutoExposure(autoExposure);
+				}
+				if (ImGui::SliderFloat(autoExposure ? "Exposure Compensation" : "Exposure", &exposure, 0.05f, 8.0f))
+				{
+					tonemapEffect->SetExposure(exposure);
+				}
+				if (autoExposure)
+				{
+					if (ImGui::SliderFloat("Key Value", &keyValue, 0.05f, 1.0f))
+					{
+						tonemapEffect->SetKeyValue(keyValue);
+					}
+					if (ImGui::SliderFloat("Adaptation Speed", &adaptationSpeed, 0.1f, 10.0f))
+					{
+						tonemapEffect->SetAdaptationSpeed(adaptationSpeed);
+					}
+					if (ImGui::SliderFloat2("Log Luminance Range", luminanceRange, -16.0f, 16.0f))
+					{
+						tonemapEffect->SetLuminanceRange(luminanceRange[0], luminanceRange[1]);
+					}
+
+					//The reduction's cost comes straight from the profiler's last resolved frame
+					for (const ProfileSample& sample : Profiler::GetLastFrame().Samples)
+					{
+						if (sample.Name == "Luminance Reduction")
+						{
+							ImGui::Text("Luminance Reduction: %.3f ms GPU, %.3f ms CPU", sample.GpuTime, sample.CpuTime);
+						}
+					}
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Rendering"))
+			{
+				if (ImGui::Combo("MSAA", &msaaMode, "Off\0" "2x\0" "4x\0" "8x\0"))
+				{
+					basicEffect->GetBuffer(0)->SetSamples(1 << msaaMode);
+				}
+				ImGui::Checkbox("Depth Prepass", &depthPrepass);
+				ImGui::Checkbox("Overdraw View", &showOverdraw);
+				//Only meshes loaded after it changes pick it up, everything already loaded keeps its format
+				int meshCompression = (int)SceneSerializer::GetMeshCompression();
+				if (ImGui::Combo("Mesh Vertex Format", &meshCompression, "Float (48 bytes)\0" "Packed (24 bytes)\0" "Quantized (20 bytes)\0"))
+				{
+					SceneSerializer::SetMeshCompression((VertexCompression)meshCompression);
+				}
+
+				//Average number of fragments shaded per sample, 1.0 means nothing got drawn over
+				Framebuffer* sceneBuffer = basicEffect->GetBuffer(0);
+				double samples = double(sceneBuffer->_width) * sceneBuffer->_height * sceneBuffer->GetSamples();
+				ImGui::Text("Main Pass Fragments: %llu (%.2fx overdraw)", (unsigned long long)fragmentsDrawn, samples > 0.0 ? fragmentsDrawn / samples : 0.0);
+				ImGui::Text("Lit Shader Variants: %zu", litShader->GetVariantCount());
+				ImGui::Text("Shader Reloads: %d (%d failed)", ShaderWatcher::GetReloadCount(), ShaderWatcher::GetFailedCount());
+
+				//Streams a million lines through TTK's debug drawing, between frames so nothing on screen is disturbed
+				if (ImGui::Button("Run Debug Draw Benchmark"))
+				{
+					runLineBenchmark = true;
+				}
+				//Batched text through TTK's glyph cache, ASCII and then more Unicode than the atlas can hold at once
+				if (ImGui::Button("Run Text Benchmark"))
+				{
+					runTextBenchmark = true;
+				}
+				//100k animated sprites drawn one at a time, batched, and batched out of an atlas
+				if (ImGui::Button("Run Sprite Benchmark"))
+				{
+					runSpriteBenchmark = true;
+				}
+				//Vertex cache and overdraw ordering on every model the scene uses, CPU only
+				if (ImGui::Button("Run Mesh Optimizer Benchmark"))
+				{
+					std::vector<std::string> models;
+					for (const auto& entry : std::filesystem::directory_iterator("models"))
+					{
+						if (entry.path().extension() == ".obj")
+							models.push_back(entry.path().generic_string());
+					}
+					MeshOptimizer::RunBenchmark(models);
+				}
+				//Packs and quantizes the same models, checking how far each attribute moves, CPU only
+				if (ImGui::Button("Run Vertex Packing Benchmark"))
+				{
+					std::vector<std::string> models;
+					for (const auto& entry : std::filesystem::directory_iterator("models"))
+					{
+						if (entry.path().extension() == ".obj")
+							models.push_back(entry.path().generic_string());
+					}
+					VertexPacking::RunBenchmark(models);
+				}
+				//Compresses and splits the same models' indices, checking every triangle comes back, CPU only
+				if (ImGui::Button("Run Index Packing Benchmark"))
+				{
+					std::vector<std::string> models;
+					for (const auto& entry : std::filesystem::directory_iterator("models"))
+					{
+						if (entry.path().extension() == ".obj")
+							models.push_back(entry.path().generic_string());
+					}
+					SceneBenchmarks::RunIndexPacking(models);
+				}
+				//Meshes load from these from then on, until their .obj is changed
+				if (ImGui::Button("Bake Meshes"))
+				{
+					SceneSerializer::BakeMeshes("models");
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Clustered Lighting"))
+			{
+				if (ImGui::Checkbox("Enabled##Clustered", &useClusteredLighting))
+				{
+					for (ShaderMaterial::sptr& mat : litMaterials)
+					{
+						mat->EnableKeyword("CLUSTERED", useClusteredLighting);
+					}
+				}
+				if (ImGui::SliderInt("Point Lights", &pointLightCount, 0, 4096))
+				{
+					generatePointLights();
+				}
+
+				glm::uvec3 grid = lightClusters.GetGridSize();
+				ImGui::Text("Grid: %ux%ux%u (%u clusters)", grid.x, grid.y, grid.z, lightClusters.GetClusterCount());
+				ImGui::Text("Binning: %.3f ms, %zu indices, max %u per cluster", lightClusters.GetBinTime(),
+					lightClusters.GetLightIndices().size(), lightClusters.GetMaxLightsPerCluster());
+
+				//These are CPU only, so they can run right here
+				if (ImGui::Button("Run Self Test"))
+				{
+					LightClusters::SelfTest();
+				}
+				ImGui::SameLine();
+				if (ImGui::Button("Run Binning Benchmark"))
+				{
+					LightClusters::RunBenchmark();
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Shadows"))
+			{
+				if (ImGui::Checkbox("Enabled##Shadows", &useShadows))
+				{
+					for (ShaderMaterial::sptr& mat : litMaterials)
+					{
+						mat->EnableKeyword("SHADOWS", useShadows);
+					}
+				}
+				if (ImGui::SliderFloat3("Sun Direction", &sunDirection.x, -1.0f, 1.0f))
+				{
+					//Keep it pointing down so it can't flip to zero
+					sunDirection.z = glm::min(sunDirection.z, -0.05f);
+					sunDirection = glm::normalize(sunDirection);
+				}
+				ImGui::ColorEdit3("Sun Color", &sunColor.x);
+
+				int cascadeCount = shadows.GetCascadeCount();
+				if (ImGui::SliderInt("Cascades", &cascadeCount, 1, CascadedShadows::MaxCascades))
+				{
+					shadows.SetCascadeCount(cascadeCount);
+				}
+				float splitLambda = shadows.GetSplitLambda();
+				if (ImGui::SliderFloat("Split Lambda", &splitLambda, 0.0f, 1.0f))
+				{
+					shadows.SetSplitLambda(splitLambda);
+				}
+				float shadowDistance = shadows.GetShadowDistance();
+				if (ImGui::SliderFloat("Shadow Distance", &shadowDistance, 5.0f, 200.0f))
+				{
+					shadows.SetShadowDistance(shadowDistance);
+				}
+				float depthBias = shadows.GetDepthBias();
+				if (ImGui::SliderFloat("Depth Bias", &depthBias, 0.0f, 0.01f, "%.4f"))
+				{
+					shadows.SetDepthBias(depthBias);
+				}
+
+				for (int i = 0; i < shadows.GetCascadeCount(); i++)
+				{
+					const ShadowCascade& cascade = shadows.GetCascade(i);
+					ImGui::Text("Cascade %d: %.1f - %.1f, %d drawn, %d culled", i, cascade.SplitNear, cascade.SplitFar, shadowDraws[i], shadowCulled[i]);
+					//Each cascade's pass has its own profiler scope
+					std::string scope = "Shadow Cascade " + std::to_string(i);
+					for (const ProfileSample& sample : Profiler::GetLastFrame().Samples)
+					{
+						if (sample.Name == scope)
+						{
+							ImGui::SameLine();
+							ImGui::Text("(%.3f ms GPU, %.3f ms CPU)", sample.GpuTime, sample.CpuTime);
+						}
+					}
+				}
+
+				//CPU only, so it can run right here
+				if (ImGui::Button("Run Self Test##Shadows"))
+				{
+					CascadedShadows::SelfTest();
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Image Based Lighting"))
+			{
+				if (ImGui::Checkbox("Enabled##IBL", &useIBL))
+				{
+					for (ShaderMaterial::sptr& mat : litMaterials)
+					{
+						mat->EnableKeyword("IBL", useIBL);
+					}
+				}
+				if (ImGui::SliderFloat("Strength##IBL", &iblStrength, 0.0f, 4.0f))
+				{
+					litShader->ForEachVariant([&](const Shader::sptr& shader) {
+						shader->SetUniform("u_IBLStrength", iblStrength);
+					});
+				}
+
+				const IBLBaker::BakeStats& bakeStats = IBLBaker::GetLastStats();
+				if (bakeStats.FromCache)
+				{
+					ImGui::Text("Loaded from cache in %.2f ms (%.2f ms hashing)", bakeStats.TotalMs, bakeStats.HashMs);
+				}
+				else
+				{
+					ImGui::Text("Baked in %.1f ms on %u threads", bakeStats.TotalMs, bakeStats.Threads);
+					ImGui::Text("Irradiance: %.2f ms, Specular: %.1f ms", bakeStats.IrradianceMs, bakeStats.SpecularMs);
+				}
+
+				//Skips the cache so the bake actually runs
+				if (ImGui::Button("Rebake"))
+				{
+					bool cacheEnabled = IBLBaker::GetCacheEnabled();
+					IBLBaker::SetCacheEnabled(false);
+					IBLData::sptr rebaked = IBLBaker::Bake(environmentData);
+					IBLBaker::SetCacheEnabled(cacheEnabled);
+					if (rebaked != nullptr)
+					{
+						ibl = rebaked;
+						specularEnvironment = ibl->CreateSpecularMap();
+						for (ShaderMaterial::sptr& mat : litMaterials)
+						{
+							mat->Set("s_SpecularEnvironment", specularEnvironment);
+						}
+						litShader->ForEachVariant([&](const Shader::sptr& shader) {
+							ibl->SetUniforms(shader);
+						});
+					}
+				}
+				ImGui::SameLine();
+				//CPU only, so they can run right here
+				if (ImGui::Button("Run Self Test##IBL"))
+				{
+					IBLBaker::SelfTest();
+				}
+				ImGui::SameLine();
+				if (ImGui::Button("Run Bake Benchmark"))
+				{
+					IBLBaker::RunBenchmark();
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Particles"))
+			{
+				const ParticleStats& stats = particles.GetStats();
+				ImGui::Text("Emitters: %u, CPU particles: %u, GPU capacity: %u", stats.Emitters, stats.CpuParticles, stats.GpuCapacity);
+				ImGui::Text("CPU time: %.3f ms", stats.CpuTime);
+
+				//The scene gets made after this callback, so it comes from the application
+				entt::registry& registry = Application::Instance().ActiveScene->Registry();
+				registry.view<ParticleEmitter, GameObjectTag>().each([&](ParticleEmitter& emitter, GameObjectTag& tag) {
+					if (ImGui::TreeNode(tag.Name.c_str()))
+					{
+						ImGui::Checkbox("Enabled", &emitter.Enabled);
+						ImGui::Checkbox("Simulate on GPU", &emitter.UseGPU);
+						int blend = int(emitter.Blend);
+						if (ImGui::Combo("Blending", &blend, "Additive\0" "Alpha (sorted)\0"))
+						{
+							emitter.Blend = ParticleBlend(blend);
+						}
+						ImGui::DragFloat("Emit Rate", &emitter.EmitRate, 100.0f, 0.0f, 1000000.0f);
+						int maxParticles = int(emitter.MaxParticles);
+						if (ImGui::DragInt("Max Particles", &maxParticles, 1000.0f, 1, 4000000))
+						{
+							emitter.MaxParticles = uint32_t(std::max(maxParticles, 1));
+						}
+						ImGui::DragFloat2("Lifetime", &emitter.Lifetime.x, 0.05f, 0.0f, 60.0f);
+						ImGui::DragFloat2("Speed", &emitter.Speed.x, 0.1f, 0.0f, 100.0f);
+						ImGui::SliderFloat("Spread", &emitter.Spread, 0.0f, 1.0f);
+						ImGui::DragFloat3("Gravity", &emitter.Gravity.x, 0.1f);
+						ImGui::SliderFloat("Drag", &emitter.Drag, 0.0f, 5.0f);
+						ImGui::ColorEdit4("Start Color", &emitter.StartColor.x);
+						ImGui::ColorEdit4("End Color", &emitter.EndColor.x);
+						ImGui::DragFloat2("Size", &emitter.Size.x, 0.005f, 0.0f, 10.0f);
+						ImGui::TreePop();
+					}
+				});
+
+				for (const ProfileSample& sample : Profiler::GetLastFrame().Samples)
+				{
+					if (sample.Name == "Particle Update" || sample.Name == "Particle Draw")
+					{
+						ImGui::Text("%s: %.3f ms GPU, %.3f ms CPU", sample.Name.c_str(), sample.GpuTime, sample.CpuTime);
+					}
+				}
+
+				//The self test is CPU only, the benchmark needs the GPU so it waits until between frames
+				if (ImGui::Button("Run Self Test##Particles"))
+				{
+					ParticleSystem::SelfTest();
+				}
+				ImGui::SameLine();
+				if (ImGui::Button("Run Particle Benchmark"))
+				{
+					runParticleBenchmark = true;
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Level of Detail"))
+			{
+				bool lodEnabled = lods.IsEnabled();
+				if (ImGui::Checkbox("Enabled##LOD", &lodEnabled))
+				{
+					lods.SetEnabled(lodEnabled);
+				}
+				float hysteresis = lods.GetHysteresis();
+				if (ImGui::SliderFloat("Hysteresis", &hysteresis, 0.0f, 0.5f))
+				{
+					lods.SetHysteresis(hysteresis);
+				}
+
+				const LODStats& stats = lods.GetStats();
+				ImGui::Text("Groups: %u, %u fading, %u culled", unsigned(stats.Groups), unsigned(stats.Fading), unsigned(stats.Culled));
+				for (size_t i = 0; i < stats.LevelCounts.size(); i++)
+				{
+					ImGui::Text("Level %u: %u", unsigned(i), unsigned(stats.LevelCounts[i]));
+				}
+				ImGui::Text("Triangles: %u drawn, %u at full detail (%.1f%%)", unsigned(stats.TrianglesDrawn), unsigned(stats.TrianglesFull),
+					100.0 * stats.TrianglesDrawn / std::max<size_t>(stats.TrianglesFull, 1));
+				ImGui::Text("Selection: %.3f ms CPU", stats.CpuTime);
+				//Both are kept, so flipping Enabled shows what LOD saves
+				ImGui::Text("Scene Draw at full detail: %.3f ms GPU, %.3f ms CPU", lodDrawTimes[0].x, lodDrawTimes[0].y);
+				ImGui::Text("Scene Draw with LOD: %.3f ms GPU, %.3f ms CPU", lodDrawTimes[1].x, lodDrawTimes[1].y);
+
+				entt::registry& registry = Application::Instance().ActiveScene->Registry();
+				registry.view<LODGroup, GameObjectTag>().each([&](LODGroup& group, GameObjectTag& tag) {
+					if (ImGui::TreeNode(tag.Name.c_str()))
+					{
+						ImGui::Text("Level %d, screen size %.3f%s", group.Level, group.ScreenSize, group.Culled ? ", culled" : "");
+						for (size_t i = 0; i < group.Levels.size(); i++)
+						{
+							std::string label = "Level " + std::to_string(i) + " (" + std::to_string(group.Levels[i].Triangles) + " triangles)";
+							ImGui::SliderFloat(label.c_str(), &group.Levels[i].ScreenSize, 0.0f, 1.0f);
+						}
+						ImGui::SliderFloat("Cull Below", &group.CullScreenSize, 0.0f, 0.1f);
+						ImGui::SliderFloat("Fade Time", &group.FadeTime, 0.0f, 2.0f);
+						ImGui::TreePop();
+					}
+				});
+
+				if (ImGui::Button("Run LOD Benchmark"))
+				{
+					LODSystem::RunBenchmark();
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Scene"))
+			{
+				GameScene::sptr& activeScene = Application::Instance().ActiveScene;
+				ImGui::Text("Entities: %u", unsigned(activeScene->Registry().alive()));
+				if (ImGui::Button("Save Binary"))
+				{
+					SceneSerializer::Save(activeScene, "scene.bin", SceneFormat::Binary);
+				}
+				ImGui::SameLine();
+				if (ImGui::Button("Save JSON"))
+				{
+					SceneSerializer::Save(activeScene, "scene.json", SceneFormat::Json);
+				}
+				//Loading adds to the scene, so loading what was just saved doubles everything up
+				if (ImGui::Button("Load Binary"))
+				{
+					SceneSerializer::Load(activeScene, "scene.bin", SceneFormat::Binary);
+				}
+				ImGui::SameLine();
+				if (ImGui::Button("Load JSON"))
+				{
+					SceneSerializer::Load(activeScene, "scene.json", SceneFormat::Json);
+				}
+				const SceneIOStats& stats = SceneSerializer::GetLastStats();
+				ImGui::Text("Last: %u entities in %.2f ms (%.2f ms archive, %.2f ms restore), %u missing assets",
+					unsigned(stats.Entities), stats.TotalTime, stats.ArchiveTime, stats.RestoreTime, unsigned(stats.MissingAssets));
+				if (ImGui::Button("Run Scene Benchmark"))
+				{
+					SceneSerializer::RunBenchmark();
+				}
+				ImGui::SameLine();
+				if (ImGui::Button("Run Name Lookup Benchmark"))
+				{
+					SceneBenchmarks::RunNameLookup();
+				}
+				if (ImGui::Button("Run Prefab Benchmark"))
+				{
+					SceneBenchmarks::RunPrefabInstancing();
+				}
+				ImGui::SameLine();
+				if (ImGui::Button("Run Removal Benchmark"))
+				{
+					SceneBenchmarks::RunBulkRemoval();
+				}
+				if (ImGui::Button("Run Placement Benchmark"))
+				{
+					Placement::RunBenchmark();
+				}
+
+				//Streamed cells get added on top of whatever is already loaded
+				if (ImGui::Button("Write Cells"))
+				{
+					SceneStreamer::WriteCells(activeScene, "cells", streamCellSize);
+				}
+				ImGui::SameLine();
+				bool streaming = streamer != nullptr;
+				if (ImGui::Checkbox("Stream Cells", &streaming))
+				{
+					if (streaming)
+					{
+						streamer = SceneStreamer::Create(activeScene, "cells", streamCellSize);
+					}
+					else
+					{
+						streamer->UnloadAll();
+						streamer = nullptr;
+					}
+				}
+				if (streamer != nullptr)
+				{
+					float radii[2] = { streamer->GetLoadRadius(), streamer->GetUnloadRadius() };
+					if (ImGui::DragFloat2("Load/Unload Radius", radii, 0.5f, 0.0f, 500.0f))
+					{
+						streamer->SetRadii(radii[0], radii[1]);
+					}
+					float budget = float(streamer->GetMergeBudget());
+					if (ImGui::SliderFloat("Merge Budget (ms)", &budget, 0.1f, 16.0f))
+					{
+						streamer->SetMergeBudget(budget);
+					}
+					const StreamingStats& streamStats = streamer->GetStats();
+					ImGui::Text("Cells: %u resident (%u entities), %u in flight, %u loaded, %u unloaded", unsigned(streamStats.CellsResident),
+						unsigned(streamStats.EntitiesResident), unsigned(streamStats.CellsInFlight), unsigned(streamStats.CellsLoaded), unsigned(streamStats.CellsUnloaded));
+					ImGui::Text("Read %.2f MB at %.1f MB/s, merged %u cells in %.2f ms (worst frame %.2f ms)", streamStats.BytesRead / (1024.0 * 1024.0),
+						streamStats.Bandwidth, unsigned(streamStats.CellsMerged), streamStats.MergeTime, streamStats.WorstFrameTime);
+					ImGui::Text("Shared meshes: %u, textures: %u", unsigned(streamStats.MeshesLoaded), unsigned(streamStats.TexturesLoaded));
+				}
+				if (ImGui::Button("Run Streaming Benchmark"))
+				{
+					SceneStreamer::RunBenchmark();
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Capture"))
+			{
+				if (ImGui::Button("Screenshot"))
+				{
+					frameCapture.Screenshot("screenshot_" + std::to_string(frameCapture.GetFramesCaptured()) + ".png");
+				}
+				if (ImGui::Button(frameCapture.IsRecording() ? "Stop Recording" : "Start Recording"))
+				{
+					if (frameCapture.IsRecording())
+						frameCapture.StopRecording();
+					else
+						frameCapture.StartRecording("recording");
+				}
+				if (ImGui::Button("Run Readback Benchmark"))
+				{
+					runCaptureBenchmark = true;
+				}
+				ImGui::Text("Captured: %llu Written: %llu Dropped: %llu", (unsigned long long)frameCapture.GetFramesCaptured(),
+					(unsigned long long)frameCapture.GetFramesWritten(), (unsigned long long)frameCapture.GetFramesDropped());
+			}
+
+			DynamicResolution::RenderImGui();
+			Profiler::RenderImGui();
+
 			ImGui::Text("Q/E -> Yaw\nLeft/Right -> Roll\nUp/Down -> Pitch\nY -> Toggle Mode");
 		
 			minFps = FLT_MAX;
@@ -274,19 +913,31 @@ int main() {
 		#pragma region TEXTURE LOADING
 
 		// Load some textures from files
-		Texture2D::sptr grass = Texture2D::LoadFromFile("images/grass.jpg");
-		Texture2D::sptr noSpec = Texture2D::LoadFromFile("images/grassSpec.png");
-
-		Texture2D::sptr house = Texture2D::LoadFromFile("images/houseTex.png");
-		Texture2D::sptr barrel = Texture2D::LoadFromFile("images/wood.jpg");
-		Texture2D::sptr barrelNormal = Texture2D::LoadFromFile("images/woodNormal.jpg");
-		Texture2D::sptr tree = Texture2D::LoadFromFile("images/tree.png");
-		Texture2D::sptr straw = Texture2D::LoadFromFile("images/straw.jpg");
-		Texture2D::sptr strawBump = Texture2D::LoadFromFile("images/strawBump.jpg");
-		Texture2D::sptr horse = Texture2D::LoadFromFile("images/horse.jpg");
-
-		// Load the cube map
-		TextureCubeMap::sptr environmentMap = TextureCubeMap::LoadFromImages("images/cubemaps/skybox/ToonSky.jpg"); 
+		Texture2D::sptr grass = SceneSerializer::LoadTexture("images/grass.jpg");
+		Texture2D::sptr noSpec = SceneSerializer::LoadTexture("images/grassSpec.png");
+
+		Texture2D::sptr house = SceneSerializer::LoadTexture("images/houseTex.png");
+		Texture2D::sptr barrel = SceneSerializer::LoadTexture("images/wood.jpg");
+		Texture2D::sptr barrelNormal = SceneSerializer::LoadTexture("images/woodNormal.jpg");
+		Texture2D::sptr tree = SceneSerializer::LoadTexture("images/tree.png");
+		Texture2D::sptr straw = SceneSerializer::LoadTexture("images/straw.jpg");
+		Texture2D::sptr strawBump = SceneSerializer::LoadTexture("images/strawBump.jpg");
+		Texture2D::sptr horse = SceneSerializer::LoadTexture("images/horse.jpg");
+
+		// Load the cube map, keeping the data around to bake lighting from
+		environmentData = TextureCubeMapData::LoadFromImages("images/cubemaps/skybox/ToonSky.jpg");
+		environmentData->DebugName = "ToonSky";
+		TextureCubeMap::sptr environmentMap = TextureCubeMap::Create();
+		environmentMap->LoadData(environmentData);
+
+		//Bake (or load from the cache) the lighting for the lit shader
+		ibl = IBLBaker::Bake(environmentData);
+		if (ibl != nullptr)
+		{
+			specularEnvironment = ibl->CreateSpecularMap();
+		}
+		//Lets the prefiltered mips blend across cube faces
+		glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
 		// Creating an empty texture
 		Texture2DDescription desc = Texture2DDescription();  
@@ -317,60 +968,71 @@ int main() {
 
 		// Create a material and set some properties for it
 		ShaderMaterial::sptr noTex = ShaderMaterial::Create();
-		noTex->Shader = shader;
+		noTex->SetVariants(litShader, lightingMode);
 		noTex->Set("s_Diffuse", texture2);
 		noTex->Set("u_Shininess", 2.0f);
-		noTex->Set("u_TextureMix", 0.0f);
 
 		ShaderMaterial::sptr grassMat = ShaderMaterial::Create();
-		grassMat->Shader = shader;
+		grassMat->SetVariants(litShader, lightingMode | specularMapKeyword);
 		grassMat->Set("s_Diffuse", grass);
 		grassMat->Set("s_Specular", noSpec);
 		grassMat->Set("u_Shininess", 2.0f);
-		grassMat->Set("u_TextureMix", 0.0f);
 
 		ShaderMaterial::sptr houseMat = ShaderMaterial::Create();
-		houseMat->Shader = shader;
+		houseMat->SetVariants(litShader, lightingMode);
 		houseMat->Set("s_Diffuse", house);
 		houseMat->Set("u_Shininess", 2.0f);
-		houseMat->Set("u_TextureMix", 0.0f);
 
 		ShaderMaterial::sptr barrelMat = ShaderMaterial::Create();
-		barrelMat->Shader = shader;
+		barrelMat->SetVariants(litShader, lightingMode | secondDiffuseKeyword);
 		barrelMat->Set("s_Diffuse", barrel);
 		barrelMat->Set("s_Diffuse2", barrelNormal);
 		barrelMat->Set("u_Shininess", 2.0f);
 		barrelMat->Set("u_TextureMix", 0.25f);
 
 		ShaderMaterial::sptr treeMat = ShaderMaterial::Create();
-		treeMat->Shader = shader;
+		treeMat->SetVariants(litShader, lightingMode);
 		treeMat->Set("s_Diffuse", tree);
 		treeMat->Set("u_Shininess", 2.0f);
-		treeMat->Set("u_TextureMix", 0.0f);
 
 		ShaderMaterial::sptr strawMat = ShaderMaterial::Create();
-		strawMat->Shader = shader;
+		strawMat->SetVariants(litShader, lightingMode | secondDiffuseKeyword);
 		strawMat->Set("s_Diffuse", straw);
 		strawMat->Set("s_Diffuse2", strawBump);
 		strawMat->Set("u_Shininess", 2.0f);
 		strawMat->Set("u_TextureMix", 0.25f);
 
 		ShaderMaterial::sptr horseMat = ShaderMaterial::Create();
-		horseMat->Shader = shader;
+		horseMat->SetVariants(litShader, lightingMode);
 		horseMat->Set("s_Diffuse", horse);
 		horseMat->Set("u_Shininess", 2.0f);
-		horseMat->Set("u_TextureMix", 0.0f);
+
+		litMaterials = { noTex, grassMat, houseMat, barrelMat, treeMat, strawMat, horseMat };
+		for (ShaderMaterial::sptr& mat : litMaterials)
+		{
+			//Falls back to the skybox itself if the bake failed
+			mat->Set("s_SpecularEnvironment", specularEnvironment != nullptr ? specularEnvironment : environmentMap);
+		}
+
+		//Names that saved scenes refer to the materials by
+		SceneSerializer::RegisterMaterial("noTex", noTex);
+		SceneSerializer::RegisterMaterial("grass", grassMat);
+		SceneSerializer::RegisterMaterial("house", houseMat);
+		SceneSerializer::RegisterMaterial("barrel", barrelMat);
+		SceneSerializer::RegisterMaterial("tree", treeMat);
+		SceneSerializer::RegisterMaterial("straw", strawMat);
+		SceneSerializer::RegisterMaterial("horse", horseMat);
 
 		//Objects
 		GameObject groundObj = scene->CreateEntity("Ground"); 
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/plane.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/plane.obj");
 			groundObj.emplace<RendererComponent>().SetMesh(vao).SetMaterial(grassMat);
 		}
 
 		GameObject houseObj = scene->CreateEntity("House");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/house.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/house.obj");
 			houseObj.emplace<RendererComponent>().SetMesh(vao).SetMaterial(houseMat);
 			houseObj.get<Transform>().SetLocalPosition(0.0f, -12.0f, 0.1f);
 			houseObj.get<Transform>().SetLocalRotation(90.0f, 0.0f, 180.0f);
@@ -378,7 +1040,7 @@ int main() {
 
 		GameObject barrelObj = scene->CreateEntity("Barrel");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/barrel.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/barrel.obj");
 			barrelObj.emplace<RendererComponent>().SetMesh(vao).SetMaterial(barrelMat);
 			barrelObj.get<Transform>().SetLocalPosition(-9.0f, -8.0f, -0.1f);
 			barrelObj.get<Transform>().SetLocalRotation(90.0f, 0.0f, 0.0f);
@@ -387,7 +1049,7 @@ int main() {
 
 		GameObject barrelObj2 = scene->CreateEntity("Barrel2");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/barrel.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/barrel.obj");
 			barrelObj2.emplace<RendererComponent>().SetMesh(vao).SetMaterial(barrelMat);
 			barrelObj2.get<Transform>().SetLocalPosition(-12.0f, -6.0f, -0.1f);
 			barrelObj2.get<Transform>().SetLocalRotation(90.0f, 0.0f, 0.0f);
@@ -396,7 +1058,7 @@ int main() {
 
 		GameObject barrelObj3 = scene->CreateEntity("Barrel3");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/barrel.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/barrel.obj");
 			barrelObj3.emplace<RendererComponent>().SetMesh(vao).SetMaterial(barrelMat);
 			barrelObj3.get<Transform>().SetLocalPosition(7.0f, -5.0f, -0.1f);
 			barrelObj3.get<Transform>().SetLocalRotation(90.0f, 0.0f, 0.0f);
@@ -405,7 +1067,7 @@ int main() {
 
 		GameObject barrelObj4 = scene->CreateEntity("Barrel4");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/barrel.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/barrel.obj");
 			barrelObj4.emplace<RendererComponent>().SetMesh(vao).SetMaterial(barrelMat);
 			barrelObj4.get<Transform>().SetLocalPosition(14.0f, 4.0f, -0.1f);
 			barrelObj4.get<Transform>().SetLocalRotation(90.0f, 0.0f, 0.0f);
@@ -414,7 +1076,7 @@ int main() {
 
 		GameObject treeObj = scene->CreateEntity("Tree");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/tree.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/tree.obj");
 			treeObj.emplace<RendererComponent>().SetMesh(vao).SetMaterial(treeMat);
 			treeObj.get<Transform>().SetLocalPosition(13.0f, -12.0f, 0.45f);
 			treeObj.get<Transform>().SetLocalScale(glm::vec3(0.1f));
@@ -422,7 +1084,7 @@ int main() {
 
 		GameObject treeObj2 = scene->CreateEntity("Tree2");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/tree.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/tree.obj");
 			treeObj2.emplace<RendererComponent>().SetMesh(vao).SetMaterial(treeMat);
 			treeObj2.get<Transform>().SetLocalPosition(-13.0f, -12.0f, 0.45f);
 			treeObj2.get<Transform>().SetLocalScale(glm::vec3(0.1f));
@@ -430,7 +1092,7 @@ int main() {
 
 		GameObject treeObj3 = scene->CreateEntity("Tree3");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/tree.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/tree.obj");
 			treeObj3.emplace<RendererComponent>().SetMesh(vao).SetMaterial(treeMat);
 			treeObj3.get<Transform>().SetLocalPosition(15.0f, -5.0f, 0.45f);
 			treeObj3.get<Transform>().SetLocalScale(glm::vec3(0.1f));
@@ -438,7 +1100,7 @@ int main() {
 
 		GameObject treeObj4 = scene->CreateEntity("Tree4");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/tree.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/tree.obj");
 			treeObj4.emplace<RendererComponent>().SetMesh(vao).SetMaterial(treeMat);
 			treeObj4.get<Transform>().SetLocalPosition(-15.0f, -6.f, 0.45f);
 			treeObj4.get<Transform>().SetLocalScale(glm::vec3(0.1f));
@@ -446,7 +1108,7 @@ int main() {
 
 		GameObject treeObj5 = scene->CreateEntity("Tree5");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/tree.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/tree.obj");
 			treeObj5.emplace<RendererComponent>().SetMesh(vao).SetMaterial(treeMat);
 			treeObj5.get<Transform>().SetLocalPosition(-15.0f, 14.f, 0.45f);
 			treeObj5.get<Transform>().SetLocalScale(glm::vec3(0.1f));
@@ -454,7 +1116,7 @@ int main() {
 
 		GameObject strawObj = scene->CreateEntity("Straw");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/straw.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/straw.obj");
 			strawObj.emplace<RendererComponent>().SetMesh(vao).SetMaterial(strawMat);
 			strawObj.get<Transform>().SetLocalPosition(-12.0f, 3.0f, 0.9f);
 			strawObj.get<Transform>().SetLocalRotation(90.0f, 0.0f, 90.0f);
@@ -463,7 +1125,7 @@ int main() {
 
 		GameObject strawObj2 = scene->CreateEntity("Straw2");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/straw.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/straw.obj");
 			strawObj2.emplace<RendererComponent>().SetMesh(vao).SetMaterial(strawMat);
 			strawObj2.get<Transform>().SetLocalPosition(-12.0f, 10.0f, 0.9f);
 			strawObj2.get<Transform>().SetLocalRotation(90.0f, 0.0f, 90.0f);
@@ -472,17 +1134,21 @@ int main() {
 
 		GameObject strawObj3 = scene->CreateEntity("Straw3");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/straw.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/straw.obj");
 			strawObj3.emplace<RendererComponent>().SetMesh(vao).SetMaterial(strawMat);
 			strawObj3.get<Transform>().SetLocalPosition(9.0f, 3.0f, 0.9f);
 			strawObj3.get<Transform>().SetLocalRotation(90.0f, 0.0f, 45.0f);
 			strawObj3.get<Transform>().SetLocalScale(glm::vec3(0.03f));
 		}
 
+		//The horses get simpler as they get further away, the first level is the same mesh LoadMesh gives
+		std::vector<LODLevel> horseLevels = LODSystem::LoadChain("models/horse.obj");
+
 		GameObject horseObj = scene->CreateEntity("Horse"); 
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/horse.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/horse.obj");
 			horseObj.emplace<RendererComponent>().SetMesh(vao).SetMaterial(horseMat);
+			horseObj.emplace<LODGroup>().Levels = horseLevels;
 			horseObj.get<Transform>().SetLocalPosition(13.0f, 0.0f, 0.0f);
 			horseObj.get<Transform>().SetLocalRotation(0.0f, 0.0f, 225.0f);
 			horseObj.get<Transform>().SetLocalScale(glm::vec3(0.002f));
@@ -490,8 +1156,9 @@ int main() {
 
 		GameObject horseObj2 = scene->CreateEntity("Horse2");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/horse.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/horse.obj");
 			horseObj2.emplace<RendererComponent>().SetMesh(vao).SetMaterial(horseMat);
+			horseObj2.emplace<LODGroup>().Levels = horseLevels;
 			horseObj2.get<Transform>().SetLocalPosition(-14.0f, 3.0f, 0.0f);
 			horseObj2.get<Transform>().SetLocalRotation(0.0f, 0.0f, 90.0f);
 			horseObj2.get<Transform>().SetLocalScale(glm::vec3(0.002f));
@@ -499,8 +1166,9 @@ int main() {
 
 		GameObject horseObj3 = scene->CreateEntity("Horse3");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/horse.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/horse.obj");
 			horseObj3.emplace<RendererComponent>().SetMesh(vao).SetMaterial(horseMat);
+			horseObj3.emplace<LODGroup>().Levels = horseLevels;
 			horseObj3.get<Transform>().SetLocalPosition(-14.0f, 10.0f, 0.0f);
 			horseObj3.get<Transform>().SetLocalRotation(0.0f, 0.0f, 90.0f);
 			horseObj3.get<Transform>().SetLocalScale(glm::vec3(0.002f));
@@ -508,8 +1176,9 @@ int main() {
 
 		GameObject horseObj4 = scene->CreateEntity("Horse4");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/horse.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/horse.obj");
 			horseObj4.emplace<RendererComponent>().SetMesh(vao).SetMaterial(horseMat);
+			horseObj4.emplace<LODGroup>().Levels = horseLevels;
 			horseObj4.get<Transform>().SetLocalPosition(14.0f, 14.0f, 0.0f);
 			horseObj4.get<Transform>().SetLocalRotation(0.0f, 0.0f, -90.0f);
 			horseObj4.get<Transform>().SetLocalScale(glm::vec3(0.002f));
@@ -522,8 +1191,9 @@ int main() {
 
 		GameObject horseObj5 = scene->CreateEntity("Horse5");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/horse.obj");
+			VertexArrayObject::sptr vao = SceneSerializer::LoadMesh("models/horse.obj");
 			horseObj5.emplace<RendererComponent>().SetMesh(vao).SetMaterial(horseMat);
+			horseObj5.emplace<LODGroup>().Levels = horseLevels;
 			horseObj5.get<Transform>().SetLocalPosition(4.0f, -3.0f, 0.0f);
 			horseObj5.get<Transform>().SetLocalRotation(0.0f, 0.0f, -90.0f);
 			horseObj5.get<Transform>().SetLocalScale(glm::vec3(0.002f));
@@ -536,6 +1206,38 @@ int main() {
 			pathing->Speed = 6.0f;
 		}
 
+		//Sparks spraying up, and smoke drifting off above them
+		GameObject sparksObj = scene->CreateEntity("Sparks");
+		{
+			sparksObj.get<Transform>().SetLocalPosition(6.0f, 6.0f, 0.2f);
+			ParticleEmitter& emitter = sparksObj.emplace<ParticleEmitter>();
+			emitter.EmitRate = 20000.0f;
+			emitter.MaxParticles = 50000;
+			emitter.Speed = glm::vec2(3.0f, 6.0f);
+			emitter.Spread = 0.4f;
+			emitter.StartColor = glm::vec4(4.0f, 2.0f, 0.6f, 1.0f);
+			emitter.EndColor = glm::vec4(2.0f, 0.3f, 0.0f, 0.0f);
+			emitter.Size = glm::vec2(0.05f, 0.01f);
+		}
+
+		GameObject smokeObj = scene->CreateEntity("Smoke");
+		{
+			smokeObj.get<Transform>().SetLocalPosition(6.0f, 6.0f, 1.0f);
+			ParticleEmitter& emitter = smokeObj.emplace<ParticleEmitter>();
+			emitter.EmitRate = 300.0f;
+			emitter.MaxParticles = 2000;
+			emitter.Lifetime = glm::vec2(3.0f, 5.0f);
+			emitter.Speed = glm::vec2(0.5f, 1.0f);
+			emitter.Spread = 0.2f;
+			emitter.EmitRadius = 0.3f;
+			emitter.Gravity = glm::vec3(0.3f, 0.0f, 0.2f);
+			emitter.Drag = 0.5f;
+			emitter.StartColor = glm::vec4(0.3f, 0.3f, 0.3f, 0.6f);
+			emitter.EndColor = glm::vec4(0.6f, 0.6f, 0.6f, 0.0f);
+			emitter.Size = glm::vec2(0.4f, 1.5f);
+			emitter.Blend = ParticleBlend::Alpha;
+		}
+
 		// Create an object to be our camera
 		GameObject cameraObject = scene->CreateEntity("Camera");
 		{
@@ -555,9 +1257,14 @@ int main() {
 		int width, height;
 		glfwGetWindowSize(BackendHandler::window, &width, &height);
 
+		//Allocate the effect buffers big enough for the whole monitor so resizing never reallocates them
+		const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+		PostEffect::SetMaxSize(glm::max(videoMode->width, width), glm::max(videoMode->height, height));
+
 		GameObject framebufferObject = scene->CreateEntity("Basic Effect");
 		{
 			basicEffect = &framebufferObject.emplace<PostEffect>();
+			basicEffect->SetColorFormat(hdrFormats[hdrFormat]);
 			basicEffect->Init(width, height);
 		}
 		effects.push_back(basicEffect);
@@ -586,10 +1293,26 @@ int main() {
 		GameObject bloomEffectObject = scene->CreateEntity("Bloom Effect");
 		{
 			bloomEffect = &bloomEffectObject.emplace<BloomEffect>();
+			bloomEffect->SetColorFormat(hdrFormats[hdrFormat]);
 			bloomEffect->Init(width, height);
 		}
 		effects.push_back(bloomEffect);
 
+		GameObject tonemapEffectObject = scene->CreateEntity("Tonemap Effect");
+		{
+			tonemapEffect = &tonemapEffectObject.emplace<TonemapEffect>();
+			tonemapEffect->Init(width, height);
+		}
+
+		frameCapture.Init(width, height);
+
+		DynamicResolution::Init(width, height);
+		for (PostEffect* effect : effects)
+		{
+			DynamicResolution::AddEffect(effect);
+		}
+		DynamicResolution::AddEffect(tonemapEffect);
+
 		#pragma endregion 
 		//////////////////////////////////////////////////////////////////////////////////////////
 
@@ -604,7 +1327,7 @@ int main() {
 			ShaderMaterial::sptr skyboxMat = ShaderMaterial::Create();
 			skyboxMat->Shader = skybox;  
 			skyboxMat->Set("s_Environment", environmentMap);
-			skyboxMat->Set("u_EnvironmentRotation", glm::mat3(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1, 0, 0))));
+			skyboxMat->Set("u_EnvironmentRotation", environmentRotation);
 			skyboxMat->RenderLayer = 100;
 
 			MeshBuilder<VertexPosNormTexCol> mesh;
@@ -615,6 +1338,8 @@ int main() {
 			GameObject skyboxObj = scene->CreateEntity("skybox");  
 			skyboxObj.get<Transform>().SetLocalPosition(0.0f, 0.0f, 0.0f);
 			skyboxObj.get_or_emplace<RendererComponent>().SetMesh(meshVao).SetMaterial(skyboxMat);
+			SceneSerializer::RegisterMesh("skybox", meshVao);
+			SceneSerializer::RegisterMaterial("skybox", skyboxMat);
 		}
 		////////////////////////////////////////////////////////////////////////////////////////
 
@@ -633,9 +1358,19 @@ int main() {
 		Timing& time = Timing::Instance();
 		time.LastFrame = glfwGetTime();
 
+		const Shader::CacheStats& shaderStats = Shader::GetCacheStats();
+		LOG_INFO("Startup took {:.1f} ms", (time.LastFrame - startupTime) * 1000.0);
+		LOG_INFO("Shaders: {} programs, {} from memory, {} from disk, {} compiled ({} stages shared), {:.1f} ms compiling, {:.1f} ms loading binaries",
+			shaderStats.Programs, shaderStats.MemoryHits, shaderStats.DiskHits, shaderStats.Compiled, shaderStats.StagesShared,
+			shaderStats.CompileMs, shaderStats.LoadMs);
+
 		///// Game loop /////
 		while (!glfwWindowShouldClose(BackendHandler::window)) {
 			glfwPollEvents();
+			Profiler::BeginFrame();
+
+			//Rebuild any shaders that were edited, between frames so nothing changes mid draw
+			ShaderWatcher::Poll();
 
 			// Update the timing
 			time.CurrentFrame = glfwGetTime();
@@ -649,6 +1384,9 @@ int main() {
 			if (frameIx >= 128)
 				frameIx = 0;
 
+			//Pick this frame's render resolution before anything gets drawn
+			DynamicResolution::Update(time.DeltaTime);
+
 			// We'll make sure our UI isn't focused before we start handling input for our game
 			if (!ImGui::IsAnyWindowFocused()) {
 				// We need to poll our key watchers so they can do their logic with the GLFW state
@@ -681,6 +1419,7 @@ int main() {
 			}
 
 			// Iterate over all the behaviour binding components
+			Profiler::Push("Update");
 			scene->Registry().view<BehaviourBinding>().each([&](entt::entity entity, BehaviourBinding& binding) {
 				// Iterate over all the behaviour scripts attached to the entity, and update them in sequence (if enabled)
 				for (const auto& behaviour : binding.Behaviours) {
@@ -689,8 +1428,18 @@ int main() {
 					}
 				}
 			});
+			Profiler::Pop();
+
+			//Cells finished since last frame get merged in before the transforms are updated
+			if (streamer != nullptr)
+			{
+				Profiler::Push("Streaming");
+				streamer->Update(cameraObject.get<Transform>().GetLocalPosition());
+				Profiler::Pop();
+			}
 
 			// Clear the screen
+			Profiler::Push("Scene Draw");
 			basicEffect->Clear();
 			for (int i = 0; i < effects.size(); i++)
 			{
@@ -713,6 +1462,36 @@ int main() {
 			glm::mat4 projection = cameraObject.get<Camera>().GetProjection();
 			glm::mat4 viewProjection = projection * view;
 
+			//Average last frame's draw time into whichever setting it was drawn with
+			for (const ProfileSample& sample : Profiler::GetLastFrame().Samples)
+			{
+				if (sample.Name == "Scene Draw")
+				{
+					glm::dvec2& average = lodDrawTimes[lods.IsEnabled() ? 1 : 0];
+					average = glm::mix(average, glm::dvec2(sample.GpuTime, sample.CpuTime), 0.05);
+				}
+			}
+			//Every pass below draws the levels picked here, shadows included
+			Profiler::Push("LOD Select");
+			lods.Update(scene->Registry(), view, projection, time.DeltaTime);
+			Profiler::Pop();
+
+			//Emitters spawn from this frame's transforms
+			Profiler::Push("Particle Update");
+			particles.Update(scene->Registry(), time.DeltaTime);
+			Profiler::Pop();
+
+			//Bin the point lights for the clustered shader
+			if (useClusteredLighting)
+			{
+				Profiler::Push("Light Binning");
+				Camera& camera = cameraObject.get<Camera>();
+				lightClusters.BuildGrid(projection, camera.GetNearPlane(), camera.GetFarPlane());
+				lightClusters.Bin(pointLights, view);
+				lightClusters.Upload(pointLights);
+				Profiler::Pop();
+			}
+
 			//Rotates the horse when moving
 			if (horseObj4.get<Transform>().GetLocalPosition().x <= -6.9f)
 			{
@@ -758,45 +1537,257 @@ int main() {
 				return false;
 			});
 
+			//Render the shadow casters into each cascade
+			if (useShadows)
+			{
+				Profiler::Push("Shadows");
+				Camera& camera = cameraObject.get<Camera>();
+				shadows.Update(view, projection, camera.GetNearPlane(), camera.GetFarPlane(), sunDirection);
+
+				depthShader->Bind();
+				for (int i = 0; i < shadows.GetCascadeCount(); i++)
+				{
+					Profiler::Push("Shadow Cascade " + std::to_string(i));
+					const ShadowCascade& cascade = shadows.GetCascade(i);
+					shadowDraws[i] = 0;
+					shadowCulled[i] = 0;
+
+					shadows.BeginCascade(i);
+					renderGroup.each([&](entt::entity e, RendererComponent& renderer, Transform& transform) {
+						//The skybox doesn't cast shadows
+						if (renderer.Material->RenderLayer >= prepassLayerLimit)
+							return;
+						if (renderer.Mesh->HasBounds() && !shadows.IsVisible(i, transform.WorldTransform(), renderer.Mesh->GetBoundsMin(), renderer.Mesh->GetBoundsMax()))
+						{
+							shadowCulled[i]++;
+							return;
+						}
+						LODSystem::Render(depthShader, renderer.Mesh, scene->Registry().try_get<LODGroup>(e), cascade.ViewProjection, transform);
+						shadowDraws[i]++;
+					});
+					shadows.EndCascade();
+					Profiler::Pop();
+				}
+				Profiler::Pop();
+			}
+
 			// Start by assuming no shader or material is applied
 			Shader::sptr current = nullptr;
 			ShaderMaterial::sptr currentMat = nullptr;
 
 			basicEffect->BindBuffer(0);
+			//Only draw into the part of the buffer that the render resolution uses
+			basicEffect->GetBuffer(0)->SetViewport();
+
+			//The overdraw view adds fragments up, so it has to start from black
+			if (showOverdraw)
+			{
+				glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+				glClear(GL_COLOR_BUFFER_BIT);
+				glClearColor(0.08f, 0.17f, 0.31f, 1.0f);
+			}
+
+			//Lay down depth first so the main pass only shades the closest surface
+			if (depthPrepass)
+			{
+				Profiler::Push("Depth Prepass");
+				glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+				glDepthFunc(GL_LESS);
+				depthShader->Bind();
+				renderGroup.each([&](entt::entity e, RendererComponent& renderer, Transform& transform) {
+					if (renderer.Material->RenderLayer >= prepassLayerLimit)
+						return;
+					LODSystem::Render(depthShader, renderer.Mesh, scene->Registry().try_get<LODGroup>(e), viewProjection, transform);
+				});
+				glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+				Profiler::Pop();
+			}
+
+			//After a prepass only the fragments that match the depth buffer exactly get shaded
+			glDepthFunc(depthPrepass ? GL_EQUAL : GL_LEQUAL);
+			bool lateLayer = false;
+
+			if (showOverdraw)
+			{
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_ONE, GL_ONE);
+				overdrawShader->Bind();
+			}
+
+			//Grab last frame's fragment count if it's back, we skip counting until it is so we never stall
+			if (fragmentQueryPending)
+			{
+				GLint available = 0;
+				glGetQueryObjectiv(fragmentQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+				if (available)
+				{
+					glGetQueryObjectui64v(fragmentQuery, GL_QUERY_RESULT, &fragmentsDrawn);
+					fragmentQueryPending = false;
+				}
+			}
+			bool countFragments = !fragmentQueryPending;
+			if (countFragments)
+			{
+				glBeginQuery(GL_SAMPLES_PASSED, fragmentQuery);
+			}
 
 			// Iterate over the render group components and draw them
 			renderGroup.each( [&](entt::entity e, RendererComponent& renderer, Transform& transform) {
+				//Layers that skipped the prepass go back to the normal depth test (sorting puts them last)
+				if (!lateLayer && renderer.Material->RenderLayer >= prepassLayerLimit)
+				{
+					glDepthFunc(GL_LEQUAL);
+					lateLayer = true;
+				}
+
+				//The overdraw view draws everything with one shader (the skybox needs its own, so it's skipped)
+				if (showOverdraw)
+				{
+					if (!lateLayer)
+						LODSystem::Render(overdrawShader, renderer.Mesh, scene->Registry().try_get<LODGroup>(e), viewProjection, transform);
+					return;
+				}
+
 				// If the shader has changed, set up it's uniforms
 				if (current != renderer.Material->Shader) {
 					current = renderer.Material->Shader;
 					current->Bind();
 					BackendHandler::SetupShaderForFrame(current, view, projection);
+
+					if (useClusteredLighting && (litShader->GetVariantKeywords(current) & clusteredKeyword))
+					{
+						Framebuffer* sceneBuffer = basicEffect->GetBuffer(0);
+						lightClusters.Apply(current, glm::vec2(sceneBuffer->_width, sceneBuffer->_height));
+					}
+					if (useShadows && (litShader->GetVariantKeywords(current) & shadowsKeyword))
+					{
+						shadows.Apply(current);
+						current->SetUniform("u_SunDirection", sunDirection);
+						current->SetUniform("u_SunColor", sunColor);
+					}
 				}
 				// If the material has changed, apply it
 				if (currentMat != renderer.Material) {
 					currentMat = renderer.Material;
 					currentMat->Apply();
 				}
-				// Render the mesh
-				BackendHandler::RenderVAO(renderer.Material->Shader, renderer.Mesh, viewProjection, transform);
+				// Render the mesh, LOD groups draw both levels while they crossfade
+				LODSystem::Render(renderer.Material->Shader, renderer.Mesh, scene->Registry().try_get<LODGroup>(e), viewProjection, transform);
 			});
 
+			if (countFragments)
+			{
+				glEndQuery(GL_SAMPLES_PASSED);
+				fragmentQueryPending = true;
+			}
+
+			if (showOverdraw)
+			{
+				glDisable(GL_BLEND);
+			}
+			glDepthFunc(GL_LEQUAL);
+
+			//Transparent, so after everything opaque (and the skybox)
+			if (!showOverdraw)
+			{
+				Profiler::Push("Particle Draw");
+				particles.Render(scene->Registry(), view, projection);
+				Profiler::Pop();
+			}
+
 			basicEffect->UnbindBuffer();
+			Profiler::Pop();
+
+			Profiler::Push("Post Processing");
+			PostEffect* activePost = effects[activeEffect];
+			PostEffect* finalEffect = basicEffect;
+
+			//The overdraw view is shown raw, the counts would mean nothing after exposure
+			if (!showOverdraw)
+			{
+				//HDR effects (bloom) work on the scene before it's tonemapped
+				PostEffect* hdrResult = basicEffect;
+				if (activePost != basicEffect && activePost->IsHDR())
+				{
+					activePost->ApplyEffect(basicEffect);
+					hdrResult = activePost;
+				}
+
+				tonemapEffect->ApplyEffect(hdrResult);
+				finalEffect = tonemapEffect;
+
+				//Everything else works on the tonemapped image
+				if (activePost != basicEffect && !activePost->IsHDR())
+				{
+					activePost->ApplyEffect(tonemapEffect);
+					finalEffect = activePost;
+				}
+			}
 
-			effects[activeEffect]->ApplyEffect(basicEffect);
+			//Grab the frame before ImGui draws over it
+			Profiler::Push("Capture");
+			frameCapture.Capture(finalEffect->GetBuffer(0));
+			Profiler::Pop();
 			
-			effects[activeEffect]->DrawToScreen();
+			DynamicResolution::Upscale(finalEffect);
+			Profiler::Pop();
 		
 			// Draw our ImGui content
+			Profiler::Push("ImGui");
 			BackendHandler::RenderImGui();
+			Profiler::Pop();
 
 			scene->Poll();
+
+			Profiler::Push("Swap");
 			glfwSwapBuffers(BackendHandler::window);
+			Profiler::Pop();
+
+			Profiler::EndFrame();
 			time.LastFrame = time.CurrentFrame;
+
+			//Done between frames so the benchmark doesn't disturb our framebuffers mid-frame
+			if (runCaptureBenchmark)
+			{
+				FrameCapture::RunBenchmark();
+				runCaptureBenchmark = false;
+			}
+			if (runParticleBenchmark)
+			{
+				ParticleSystem::RunBenchmark();
+				runParticleBenchmark = false;
+			}
+			if (runLineBenchmark)
+			{
+				TTK::Context::Instance().RunLineBenchmark();
+				runLineBenchmark = false;
+			}
+			if (runTextBenchmark)
+			{
+				TTK::FontRenderer::Instance().RunBenchmark(TTK::Context::Instance().GetDefaultFont());
+				runTextBenchmark = false;
+			}
+			if (runSpriteBenchmark)
+			{
+				TTK::SpriteBatch::RunBenchmark();
+				runSpriteBenchmark = false;
+			}
 		}
 
 		// Nullify scene so that we can release references
+		streamer = nullptr;
 		Application::Instance().ActiveScene = nullptr;
+		SceneSerializer::ClearAssets();
+		ShaderWatcher::Shutdown();
+		Shader::ClearCache();
+		frameCapture.Unload();
+		lightClusters.Unload();
+		shadows.Unload();
+		particles.Unload();
+		DynamicResolution::Unload();
+		glDeleteQueries(1, &fragmentQuery);
+		Profiler::Shutdown();
+		TTK::Context::DestroyContext();
 		BackendHandler::ShutdownImGui();
 	}	
 